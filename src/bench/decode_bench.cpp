@@ -0,0 +1,140 @@
+#include <resources/image_decoder.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// photon-decode-bench, compares the image decoders against stb_image on a fixed corpus (single threaded, so MB/s per core)
+// usage: photon-decode-bench [--iterations=N] <corpus file or dir>
+
+// throughput is measured in decoded megabytes (texels) per second, every file is decoded [iterations] times by each decoder
+// and the decoded texels are checked against stb_image
+
+namespace fs = std::filesystem;
+
+namespace photon::bench {
+    struct corpus_file {
+        std::string name;
+        std::vector<std::byte> data;
+    };
+
+    struct decoder_result {
+        double seconds = 0.0;
+        uint64_t decoded_bytes = 0;
+        uint32_t file_count = 0;
+        uint32_t mismatch_count = 0;
+    };
+
+    static std::vector<corpus_file> read_corpus(const fs::path& path) {
+        std::vector<fs::path> paths;
+
+        if (fs::is_directory(path)) {
+            for (const fs::directory_entry& entry : fs::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) paths.push_back(entry.path());
+            }
+        } else {
+            paths.push_back(path);
+        }
+
+        std::sort(paths.begin(), paths.end()); // fixed order for comparable runs
+
+        std::vector<corpus_file> corpus;
+
+        for (const fs::path& file_path : paths) {
+            std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+            if (!file) continue;
+
+            corpus_file& file_data = corpus.emplace_back(corpus_file{ .name = file_path.string(), .data = std::vector<std::byte>(static_cast<size_t>(file.tellg())) });
+
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(file_data.data.data()), file_data.data.size());
+        }
+
+        return corpus;
+    }
+
+    static bool is_same_image(const decoded_image& a, const decoded_image& b) noexcept {
+        if (a.width != b.width || a.height != b.height || a.component_count != b.component_count) return false;
+
+        return std::equal(a.texels.get(), a.texels.get() + static_cast<size_t>(a.width) * a.height * a.component_count, b.texels.get());
+    }
+
+    static int run(int argc, char** argv) {
+        uint32_t iterations = 5;
+        std::optional<fs::path> corpus_path;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+
+            if (arg.starts_with("--iterations=")) {
+                iterations = std::max(1, std::stoi(std::string(arg.substr(13))));
+            } else if (!arg.starts_with("--") && !corpus_path) {
+                corpus_path = fs::path(arg);
+            } else {
+                P_LOG_E("Unknown option: {}", arg);
+                return 1;
+            }
+        }
+
+        if (!corpus_path) {
+            P_LOG_E("usage: photon-decode-bench [--iterations=N] <corpus file or dir>");
+            return 1;
+        }
+
+        std::vector<corpus_file> corpus = read_corpus(corpus_path.value());
+
+        const image_decoder& reference = get_stb_decoder();
+        const image_decoder* decoders[] = { &get_png_decoder(), &reference };
+        decoder_result results[std::size(decoders)];
+
+        for (const corpus_file& file : corpus) {
+            std::optional<decoded_image> expected = reference.decode(file.data);
+
+            if (!expected) {
+                P_LOG_W("stb_image can't decode {}, skipped", file.name);
+                continue;
+            }
+
+            for (size_t i = 0; i < std::size(decoders); i++) {
+                if (!decoders[i]->can_decode(file.data)) continue;
+
+                // the first decode is a warm up, its result is checked
+                std::optional<decoded_image> image = decoders[i]->decode(file.data);
+
+                if (!image) continue; // left to the fallback
+
+                if (!is_same_image(image.value(), expected.value())) {
+                    P_LOG_W("{} decoded {} differently than stb_image", decoders[i]->get_name(), file.name);
+                    results[i].mismatch_count++;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+
+                for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+                    image = decoders[i]->decode(file.data);
+                }
+
+                results[i].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                results[i].decoded_bytes += static_cast<uint64_t>(image->width) * image->height * image->component_count * iterations;
+                results[i].file_count++;
+            }
+        }
+
+        for (size_t i = 0; i < std::size(decoders); i++) {
+            const decoder_result& result = results[i];
+            double megabytes_per_second = result.seconds > 0.0 ? static_cast<double>(result.decoded_bytes) / (1024.0 * 1024.0) / result.seconds : 0.0;
+
+            P_LOG_I("{:<12} {:>5} files {:>10.1f} MB/s per core {:>4} mismatches", decoders[i]->get_name(), result.file_count, megabytes_per_second, result.mismatch_count);
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    return photon::bench::run(argc, argv);
+}
@@ -0,0 +1,453 @@
+#include <tests/test_device.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <functional>
+#include <string>
+#include <vector>
+
+// photon-mip-bench, compares the memory and minified sampling cost of a loaded texture as linear single level image (the old
+// texture::load_file() path), optimal single level image and optimal image with a full generated mip chain
+// usage: photon-mip-bench [--size=N] [--iterations=N]
+
+// memory is the size the device requires for the image, sampling runs a compute pass (shaders/mip_bench.comp) averaging
+// a 2x2 footprint per output texel at 1x, 4x, 16x and 64x minification, timed with timestamp queries on the graphics queue
+// note: images without the matching level sample their finest one, so their taps are scattered across the whole image
+
+namespace photon::bench {
+    using namespace rendering;
+
+    static const uint32_t mip_bench_spv[] = {
+#include <shaders/mip_bench.comp.spv.inc>
+    };
+
+    // matches the push constants of mip_bench.comp
+    struct bench_params {
+        uint32_t output_size;
+        float lod;
+    };
+
+    constexpr vk::Format image_format = vk::Format::eR8G8B8A8Srgb;
+    constexpr uint32_t minifications[] = { 1, 4, 16, 64 };
+
+    struct image_variant {
+        const char* name;
+        vk::ImageTiling tiling;
+        bool has_mips;
+    };
+
+    constexpr image_variant variants[] = {
+        { "linear 1 level", vk::ImageTiling::eLinear, false },
+        { "optimal 1 level", vk::ImageTiling::eOptimal, false },
+        { "optimal mips", vk::ImageTiling::eOptimal, true },
+    };
+
+    // the compute pipeline sampling the image of a variant into a storage buffer
+    struct sample_pass {
+        vk::DescriptorSetLayout set_layout;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline pipeline;
+        vk::DescriptorPool descriptor_pool;
+        vk::DescriptorSet descriptor_set;
+        vk::Sampler sampler;
+        vk::QueryPool query_pool;
+
+        VkBuffer output_buf;
+        VmaAllocation output_alloc;
+    };
+
+    static sample_pass create_sample_pass(vulkan_device& device, uint32_t image_size) {
+        vk::Device dev = device.get_device();
+        sample_pass pass;
+
+        vk::DescriptorSetLayoutBinding bindings[] = {
+            {
+                .binding = 0,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            },
+            {
+                .binding = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            },
+        };
+
+        pass.set_layout = dev.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+            .bindingCount = 2,
+            .pBindings = bindings,
+        });
+
+        vk::PushConstantRange push_range{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(bench_params),
+        };
+
+        pass.pipeline_layout = dev.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts = &pass.set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_range,
+        });
+
+        vk::ShaderModule shader = dev.createShaderModule(vk::ShaderModuleCreateInfo{
+            .codeSize = sizeof(mip_bench_spv),
+            .pCode = mip_bench_spv,
+        });
+
+        vk::ComputePipelineCreateInfo pipeline_info{
+            .stage{
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = shader,
+                .pName = "main",
+            },
+            .layout = pass.pipeline_layout,
+        };
+
+        pass.pipeline = dev.createComputePipeline(nullptr, pipeline_info).value;
+
+        dev.destroyShaderModule(shader);
+
+        vk::DescriptorPoolSize pool_sizes[] = {
+            { .type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = 1 },
+            { .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1 },
+        };
+
+        pass.descriptor_pool = dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+            .maxSets = 1,
+            .poolSizeCount = 2,
+            .pPoolSizes = pool_sizes,
+        });
+
+        vk::DescriptorSetAllocateInfo set_info{
+            .descriptorPool = pass.descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &pass.set_layout,
+        };
+
+        pass.descriptor_set = dev.allocateDescriptorSets(set_info)[0];
+
+        pass.sampler = dev.createSampler(vk::SamplerCreateInfo{
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eLinear,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+            .maxLod = VK_LOD_CLAMP_NONE,
+        });
+
+        pass.query_pool = dev.createQueryPool(vk::QueryPoolCreateInfo{
+            .queryType = vk::QueryType::eTimestamp,
+            .queryCount = 2,
+        });
+
+        // sized for the largest output (no minification)
+        vk::BufferCreateInfo buffer_info{
+            .size = static_cast<VkDeviceSize>(image_size) * image_size * 4 * sizeof(float),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &alloc_cinfo, &pass.output_buf, &pass.output_alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        return pass;
+    }
+
+    static void destroy_sample_pass(vulkan_device& device, sample_pass& pass) noexcept {
+        vk::Device dev = device.get_device();
+
+        vmaDestroyBuffer(device.get_allocator(), pass.output_buf, pass.output_alloc);
+
+        dev.destroyQueryPool(pass.query_pool);
+        dev.destroySampler(pass.sampler);
+        dev.destroyDescriptorPool(pass.descriptor_pool);
+        dev.destroyPipeline(pass.pipeline);
+        dev.destroyPipelineLayout(pass.pipeline_layout);
+        dev.destroyDescriptorSetLayout(pass.set_layout);
+    }
+
+    // records commands with [record] into a one time command buffer on the graphics queue and waits for them
+    static void run_commands(vulkan_device& device, const std::function<void(vk::CommandBuffer)>& record) {
+        vk::CommandPool pool = device.get_device().createCommandPool(vk::CommandPoolCreateInfo{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = device.get_queue_family(false),
+        });
+
+        vk::CommandBufferAllocateInfo cmd_info{
+            .commandPool = pool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        };
+
+        vk::CommandBuffer cmd = device.get_device().allocateCommandBuffers(cmd_info)[0];
+
+        cmd.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+        record(cmd);
+        cmd.end();
+
+        vk::Fence fence = device.get_device().createFence({});
+
+        vk::SubmitInfo submit_info{
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmd,
+        };
+
+        device.submit(std::span(&submit_info, 1), fence);
+
+        vk::Result res = device.get_device().waitForFences(fence, vk::True, std::numeric_limits<uint64_t>::max());
+        vk::resultCheck(res, "waitForFences");
+
+        device.get_device().destroyFence(fence);
+        device.get_device().destroyCommandPool(pool);
+    }
+
+    // milliseconds per pass sampling [view] into an output of [output_size]^2 texels, averaged over [iterations] passes
+    static double time_sampling(vulkan_device& device, sample_pass& pass, vk::ImageView view, uint32_t output_size, float lod, uint32_t iterations) {
+        vk::DescriptorImageInfo image_info{
+            .sampler = pass.sampler,
+            .imageView = view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorBufferInfo buffer_info{
+            .buffer = pass.output_buf,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+
+        vk::WriteDescriptorSet writes[] = {
+            {
+                .dstSet = pass.descriptor_set,
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo = &image_info,
+            },
+            {
+                .dstSet = pass.descriptor_set,
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &buffer_info,
+            },
+        };
+
+        device.get_device().updateDescriptorSets(writes, {});
+
+        bench_params params{
+            .output_size = output_size,
+            .lod = lod,
+        };
+
+        uint32_t group_count = (output_size + 7) / 8;
+
+        run_commands(device, [&](vk::CommandBuffer cmd) {
+            cmd.resetQueryPool(pass.query_pool, 0, 2);
+
+            cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pass.pipeline);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pass.pipeline_layout, 0, pass.descriptor_set, {});
+            cmd.pushConstants(pass.pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+
+            // the passes run one after another, the first one (untimed) warms up the caches
+            vk::MemoryBarrier2 pass_barrier{
+                .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+            };
+
+            for (uint32_t i = 0; i <= iterations; i++) {
+                if (i == 1) cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, pass.query_pool, 0);
+
+                cmd.dispatch(group_count, group_count, 1);
+                cmd.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &pass_barrier });
+            }
+
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, pass.query_pool, 1);
+        });
+
+        std::array<uint64_t, 2> timestamps;
+
+        vk::Result res = device.get_device().getQueryPoolResults(pass.query_pool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+        vk::resultCheck(res, "getQueryPoolResults");
+
+        double period = device.get_physical_device().getProperties().limits.timestampPeriod;
+        return static_cast<double>(timestamps[1] - timestamps[0]) * period / 1e6 / iterations;
+    }
+
+    static bool is_variant_supported(vulkan_device& device, const image_variant& variant) {
+        vk::FormatProperties properties = device.get_physical_device().getFormatProperties(image_format);
+        vk::FormatFeatureFlags features = variant.tiling == vk::ImageTiling::eLinear ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+
+        vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear | vk::FormatFeatureFlagBits::eTransferDst;
+        if (variant.has_mips) required |= vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eTransferSrc;
+
+        return (features & required) == required;
+    }
+
+    static void run_variant(vulkan_device& device, sample_pass& pass, const image_variant& variant, uint32_t image_size, std::span<const std::byte> texels, uint32_t iterations) {
+        constexpr uint32_t max_frames_in_flight = 2;
+
+        uint32_t level_count = variant.has_mips ? std::bit_width(image_size) : 1;
+
+        vk::ImageCreateInfo image_info{
+            .imageType = vk::ImageType::e2D,
+            .format = image_format,
+            .extent = { image_size, image_size, 1 },
+            .mipLevels = level_count,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = variant.tiling,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | (variant.has_mips ? vk::ImageUsageFlagBits::eTransferSrc : vk::ImageUsageFlags{}),
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkImage image;
+        VmaAllocation alloc;
+
+        VkResult res = vmaCreateImage(device.get_allocator(), &static_cast<VkImageCreateInfo&>(image_info), &alloc_cinfo, &image, &alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateImage");
+
+        VkDeviceSize memory_size = device.get_device().getImageMemoryRequirements(image).size;
+        bool is_ready;
+
+        {
+            asset_streamer streamer(device, max_frames_in_flight, asset_streamer::streamer_config{
+                .staging_ring_size = 32 * 1024 * 1024,
+                .thread_staging_ring_size = 16 * 1024 * 1024,
+                .frame_byte_budget = 32 * 1024 * 1024,
+                .frame_copy_budget = 512,
+                .stream_aging_frames = 8,
+                .use_submit_thread = false,
+                .use_gpu_transcoding = false,
+                .use_gpu_decompression = false,
+            });
+
+            tests::test_frames frames(device, max_frames_in_flight);
+
+            multi_fence_view ready_fence = streamer.stream(asset_streamer::image_stream_info{
+                .image = image,
+                .format = image_format,
+                .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .sharing_mode = vk::SharingMode::eExclusive,
+                .image_subresource = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .level_count = 1,
+                .generated_level_count = level_count - 1,
+                .image_offset = { 0, 0, 0 },
+                .image_extent = { image_size, image_size, 1 },
+                .dst_alloc = VK_NULL_HANDLE,
+                .is_host_copyable = false,
+            }, texels.data(), texels.size(), stream_priority::normal);
+
+            is_ready = frames.run_until_ready(streamer, std::span(&ready_fence, 1), std::chrono::seconds(60));
+
+            // flushes the staging of the finished stream before the streamer is destroyed
+            for (uint32_t i = 0; i < max_frames_in_flight; i++) frames.frame(streamer);
+            device.get_device().waitIdle();
+        }
+
+        if (!is_ready) {
+            vmaDestroyImage(device.get_allocator(), image, alloc);
+            return;
+        }
+
+        vk::ImageView view = device.get_device().createImageView(vk::ImageViewCreateInfo{
+            .image = image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = image_format,
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = level_count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        });
+
+        std::string timings;
+
+        for (uint32_t minification : minifications) {
+            uint32_t output_size = std::max(1U, image_size / minification);
+            double ms = time_sampling(device, pass, view, output_size, std::log2(static_cast<float>(minification)), iterations);
+
+            timings += std::format(" {:>4}x {:>8.3f} ms", minification, ms);
+        }
+
+        P_LOG_I("{:<16} {:>2} levels {:>8.1f} MiB{}", variant.name, level_count, memory_size / (1024.0 * 1024.0), timings);
+
+        device.get_device().destroyImageView(view);
+        vmaDestroyImage(device.get_allocator(), image, alloc);
+    }
+
+    static int run(int argc, char** argv) {
+        uint32_t image_size = 4096;
+        uint32_t iterations = 20;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (arg.starts_with("--size=")) {
+                image_size = std::bit_floor(static_cast<uint32_t>(std::max(std::stoi(arg.substr(7)), 64)));
+            } else if (arg.starts_with("--iterations=")) {
+                iterations = std::max(std::stoi(arg.substr(13)), 1);
+            } else {
+                P_LOG_E("usage: photon-mip-bench [--size=N] [--iterations=N]");
+                return 1;
+            }
+        }
+
+        vulkan_instance instance = tests::create_test_instance();
+        vulkan_device device = tests::create_test_device(instance);
+
+        if (!device.get_physical_device().getQueueFamilyProperties()[device.get_queue_family(false)].timestampValidBits) {
+            P_LOG_E("The graphics queue doesn't support timestamps!");
+            return 1;
+        }
+
+        // noise, so neighbouring texels don't compress or hit in caches any better than real texture content would
+        std::vector<std::byte> texels(static_cast<size_t>(image_size) * image_size * 4);
+        for (size_t i = 0; i < texels.size(); i++) texels[i] = static_cast<std::byte>((i * 2654435761ULL) >> 13);
+
+        P_LOG_I("{}x{} {} image, sampled at 1/N of its size (ms per pass)", image_size, image_size, vk::to_string(image_format));
+
+        sample_pass pass = create_sample_pass(device, image_size);
+
+        for (const image_variant& variant : variants) {
+            if (!is_variant_supported(device, variant)) {
+                P_LOG_I("{:<16} not supported by the device", variant.name);
+                continue;
+            }
+
+            run_variant(device, pass, variant, image_size, texels, iterations);
+        }
+
+        destroy_sample_pass(device, pass);
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    return photon::bench::run(argc, argv);
+}
@@ -0,0 +1,169 @@
+#include <cook/pack_writer.hpp>
+#include <core/logger.hpp>
+#include <core/mapped_file.hpp>
+#include <core/worker_pool.hpp>
+#include <resources/asset_pack_format.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// photon-pack-bench, compares reading a corpus from a compressed and an uncompressed asset pack
+// usage: photon-pack-bench [--threads=N] <input dir>
+
+// both packs are written to the temp dir, then every entry is read (mapping, copy or decompression) into a preallocated buffer,
+// once with the pack evicted from the page cache (cold, linux only) and once right after (warm)
+// throughput is measured in uncompressed megabytes per second, so it's the effective read speed seen by the loaders
+
+namespace fs = std::filesystem;
+
+namespace photon::bench {
+    struct read_result {
+        double cold_seconds = 0.0;
+        double warm_seconds = 0.0;
+        uint64_t size = 0; // uncompressed
+        uint64_t file_size = 0;
+    };
+
+    // drops the cached pages of the file, so the next read comes from the disk
+    static bool evict_file(const fs::path& path) noexcept {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        ::fdatasync(fd);
+        bool is_evicted = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+
+        ::close(fd);
+        return is_evicted;
+#else
+        return false;
+#endif
+    }
+
+    // maps the pack and reads every entry, returns the elapsed seconds or nullopt if the pack is malformed
+    static std::optional<double> read_pack(const fs::path& path, std::vector<std::byte>& buffer, worker_pool& pool, uint64_t& size) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::optional<mapped_file> file = mapped_file::map(path.string());
+        if (!file) return std::nullopt;
+
+        // note: the writer is trusted here, the runtime checks of asset_pack::open() are skipped
+        std::span<const std::byte> data = file->get_data();
+        const pack::header* header = reinterpret_cast<const pack::header*>(data.data());
+        const pack::entry* entries = reinterpret_cast<const pack::entry*>(data.data() + header->toc_offset);
+
+        size = 0;
+
+        for (uint32_t id = 0; id < header->entry_count; id++) {
+            const pack::entry& entry = entries[id];
+
+            if (buffer.size() < entry.size) buffer.resize(entry.size);
+
+            if (!pack::read_payload(entry, data.subspan(entry.offset, entry.stored_size), 0, std::span(buffer).first(entry.size), &pool)) return std::nullopt;
+
+            size += entry.size;
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static int run(int argc, char** argv) {
+        uint32_t thread_count = std::thread::hardware_concurrency();
+        std::optional<fs::path> input;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+
+            if (arg.starts_with("--threads=")) {
+                thread_count = std::max(1, std::stoi(std::string(arg.substr(10))));
+            } else if (!arg.starts_with("--") && !input) {
+                input = fs::path(arg);
+            } else {
+                P_LOG_E("Unknown option: {}", arg);
+                return 1;
+            }
+        }
+
+        if (!input || !fs::is_directory(input.value())) {
+            P_LOG_E("usage: photon-pack-bench [--threads=N] <input dir>");
+            return 1;
+        }
+
+        std::vector<cook::pack_source> sources;
+
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input.value())) {
+            if (!entry.is_regular_file() || entry.path().filename().string().starts_with('.')) continue;
+
+            sources.push_back({
+                .name = fs::relative(entry.path(), input.value()).generic_string(),
+                .path = entry.path(),
+            });
+        }
+
+        std::sort(sources.begin(), sources.end(), [](const cook::pack_source& a, const cook::pack_source& b) { return a.name < b.name; });
+
+        worker_pool pool(thread_count);
+
+        const char* names[] = { "uncompressed", "compressed" };
+        fs::path paths[] = { fs::temp_directory_path() / "photon-pack-bench.raw.pak", fs::temp_directory_path() / "photon-pack-bench.lz.pak" };
+        read_result results[std::size(paths)];
+
+        std::vector<std::byte> buffer;
+        bool is_cold = true;
+
+        for (size_t i = 0; i < std::size(paths); i++) {
+            {
+                std::ofstream file(paths[i], std::ios::binary | std::ios::trunc);
+
+                if (!file || !cook::write_pack(file, sources, i == 1 ? &pool : nullptr)) {
+                    P_LOG_E("Failed to write pack: {}", paths[i].string());
+                    return 1;
+                }
+            }
+
+            results[i].file_size = fs::file_size(paths[i]);
+
+            is_cold &= evict_file(paths[i]);
+
+            std::optional<double> cold_seconds = read_pack(paths[i], buffer, pool, results[i].size);
+            std::optional<double> warm_seconds = read_pack(paths[i], buffer, pool, results[i].size);
+
+            fs::remove(paths[i]);
+
+            if (!cold_seconds || !warm_seconds) {
+                P_LOG_E("Malformed pack: {}", paths[i].string());
+                return 1;
+            }
+
+            results[i].cold_seconds = cold_seconds.value();
+            results[i].warm_seconds = warm_seconds.value();
+        }
+
+        if (!is_cold) P_LOG_W("The page cache couldn't be dropped, cold reads are cached");
+
+        for (size_t i = 0; i < std::size(paths); i++) {
+            const read_result& result = results[i];
+            double megabytes = static_cast<double>(result.size) / (1024.0 * 1024.0);
+
+            P_LOG_I("{:<12} {:>10} bytes ({:>5.3f} of raw) cold {:>10.1f} MB/s warm {:>10.1f} MB/s", names[i], result.file_size,
+                static_cast<double>(result.file_size) / static_cast<double>(std::max<uint64_t>(results[0].file_size, 1)),
+                megabytes / std::max(result.cold_seconds, 1e-9), megabytes / std::max(result.warm_seconds, 1e-9));
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    return photon::bench::run(argc, argv);
+}
@@ -0,0 +1,414 @@
+#include "bc_encoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace photon::cook {
+    size_t get_block_size(block_format format) noexcept {
+        return format == block_format::bc1 ? 8 : 16;
+    }
+
+    // principal axis of the points (power iteration on the covariance), zero for a single color
+    template<size_t dims>
+    static void get_principal_axis(const float (&points)[16][dims], float (&mean)[dims], float (&axis)[dims]) noexcept {
+        std::fill(std::begin(mean), std::end(mean), 0.f);
+
+        for (const auto& point : points) {
+            for (size_t c = 0; c < dims; c++) mean[c] += point[c] / 16.f;
+        }
+
+        float covariance[dims][dims] = {};
+
+        for (const auto& point : points) {
+            for (size_t i = 0; i < dims; i++) {
+                for (size_t j = 0; j < dims; j++) covariance[i][j] += (point[i] - mean[i]) * (point[j] - mean[j]);
+            }
+        }
+
+        // start from the channel with the highest variance
+        for (size_t c = 0; c < dims; c++) axis[c] = covariance[c][c];
+
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[dims] = {};
+
+            for (size_t i = 0; i < dims; i++) {
+                for (size_t j = 0; j < dims; j++) next[i] += covariance[i][j] * axis[j];
+            }
+
+            float length = 0.f;
+            for (size_t c = 0; c < dims; c++) length += next[c] * next[c];
+            length = std::sqrt(length);
+
+            if (length < 1e-6f) {
+                std::fill(std::begin(axis), std::end(axis), 0.f);
+                return;
+            }
+
+            for (size_t c = 0; c < dims; c++) axis[c] = next[c] / length;
+        }
+    }
+
+    // endpoints at the extremes of the points projected on the principal axis
+    template<size_t dims>
+    static void get_axis_endpoints(const float (&points)[16][dims], float (&e0)[dims], float (&e1)[dims]) noexcept {
+        float mean[dims], axis[dims];
+        get_principal_axis(points, mean, axis);
+
+        float min_t = std::numeric_limits<float>::max(), max_t = std::numeric_limits<float>::lowest();
+
+        for (const auto& point : points) {
+            float t = 0.f;
+            for (size_t c = 0; c < dims; c++) t += (point[c] - mean[c]) * axis[c];
+
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+
+        for (size_t c = 0; c < dims; c++) {
+            e0[c] = std::clamp(mean[c] + axis[c] * max_t, 0.f, 255.f);
+            e1[c] = std::clamp(mean[c] + axis[c] * min_t, 0.f, 255.f);
+        }
+    }
+
+    // least squares endpoints for fixed interpolation weights ([weights][i] is the weight of e0 for point i), false if degenerate
+    template<size_t dims>
+    static bool fit_endpoints(const float (&points)[16][dims], const float (&weights)[16], float (&e0)[dims], float (&e1)[dims]) noexcept {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float ax[dims] = {}, bx[dims] = {};
+
+        for (size_t i = 0; i < 16; i++) {
+            float a = weights[i], b = 1.f - weights[i];
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            for (size_t c = 0; c < dims; c++) {
+                ax[c] += a * points[i][c];
+                bx[c] += b * points[i][c];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) return false;
+
+        for (size_t c = 0; c < dims; c++) {
+            e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.f, 255.f);
+            e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.f, 255.f);
+        }
+
+        return true;
+    }
+
+    // bc1
+
+    struct bc1_block {
+        uint16_t color0, color1;
+        uint32_t indices;
+        int error;
+    };
+
+    inline static uint16_t pack_565(const float (&color)[3]) noexcept {
+        uint32_t r = static_cast<uint32_t>(color[0] * 31.f / 255.f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(color[1] * 63.f / 255.f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(color[2] * 31.f / 255.f + 0.5f);
+
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    inline static void unpack_565(uint16_t packed, int (&color)[3]) noexcept {
+        int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+
+        color[0] = r << 3 | r >> 2;
+        color[1] = g << 2 | g >> 4;
+        color[2] = b << 3 | b >> 2;
+    }
+
+    static bc1_block get_bc1_block(const texel_block& block, const float (&e0)[3], const float (&e1)[3]) noexcept {
+        bc1_block result{ .color0 = pack_565(e0), .color1 = pack_565(e1), .indices = 0, .error = 0 };
+
+        // four color mode requires color0 > color1, equal colors use the first palette entry only
+        if (result.color0 < result.color1) std::swap(result.color0, result.color1);
+
+        int palette[4][3];
+        unpack_565(result.color0, palette[0]);
+        unpack_565(result.color1, palette[1]);
+
+        for (size_t c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t palette_size = result.color0 == result.color1 ? 1 : 4;
+
+        for (size_t i = 0; i < 16; i++) {
+            int best_error = std::numeric_limits<int>::max();
+            uint32_t best_index = 0;
+
+            for (uint32_t p = 0; p < palette_size; p++) {
+                int error = 0;
+
+                for (size_t c = 0; c < 3; c++) {
+                    int d = static_cast<int>(block[i][c]) - palette[p][c];
+                    error += d * d;
+                }
+
+                if (error < best_error) {
+                    best_error = error;
+                    best_index = p;
+                }
+            }
+
+            result.indices |= best_index << (i * 2);
+            result.error += best_error;
+        }
+
+        return result;
+    }
+
+    void encode_bc1_block(const texel_block& block, std::byte* out) noexcept {
+        float points[16][3];
+
+        for (size_t i = 0; i < 16; i++) {
+            for (size_t c = 0; c < 3; c++) points[i][c] = block[i][c];
+        }
+
+        float e0[3], e1[3];
+        get_axis_endpoints(points, e0, e1);
+
+        // inset the endpoints a bit, the extremes are usually outliers
+        for (size_t c = 0; c < 3; c++) {
+            float inset = (e0[c] - e1[c]) / 16.f;
+            e0[c] -= inset;
+            e1[c] += inset;
+        }
+
+        bc1_block best = get_bc1_block(block, e0, e1);
+
+        // refine the endpoints for the chosen indices
+        constexpr float index_weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+        for (int iteration = 0; iteration < 2 && best.error > 0; iteration++) {
+            float weights[16];
+            for (size_t i = 0; i < 16; i++) weights[i] = index_weights[(best.indices >> (i * 2)) & 3];
+
+            if (!fit_endpoints(points, weights, e0, e1)) break;
+
+            bc1_block refined = get_bc1_block(block, e0, e1);
+            if (refined.error >= best.error) break;
+
+            best = refined;
+        }
+
+        std::memcpy(out, &best.color0, 2);
+        std::memcpy(out + 2, &best.color1, 2);
+        std::memcpy(out + 4, &best.indices, 4);
+    }
+
+    // bc4
+
+    void encode_bc4_block(const uint8_t values[16], std::byte* out) noexcept {
+        uint8_t min_value = *std::min_element(values, values + 16);
+        uint8_t max_value = *std::max_element(values, values + 16);
+
+        std::memset(out, 0, 8);
+        out[0] = static_cast<std::byte>(max_value);
+        out[1] = static_cast<std::byte>(min_value);
+
+        if (min_value == max_value) return;
+
+        // eight value mode (value0 > value1)
+        int palette[8] = { max_value, min_value };
+        for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * max_value + (i - 1) * min_value) / 7;
+
+        uint64_t indices = 0;
+
+        for (size_t i = 0; i < 16; i++) {
+            uint64_t best_index = 0;
+            int best_error = std::numeric_limits<int>::max();
+
+            for (uint64_t p = 0; p < 8; p++) {
+                int error = std::abs(static_cast<int>(values[i]) - palette[p]);
+
+                if (error < best_error) {
+                    best_error = error;
+                    best_index = p;
+                }
+            }
+
+            indices |= best_index << (i * 3);
+        }
+
+        std::memcpy(out + 2, &indices, 6); // note: little endian
+    }
+
+    void encode_bc3_block(const texel_block& block, std::byte* out) noexcept {
+        uint8_t alpha[16];
+        for (size_t i = 0; i < 16; i++) alpha[i] = block[i][3];
+
+        encode_bc4_block(alpha, out);
+        encode_bc1_block(block, out + 8); // note: bc3 color blocks always use the four color mode, which bc1 blocks here always do
+    }
+
+    void encode_bc5_block(const texel_block& block, std::byte* out) noexcept {
+        uint8_t red[16], green[16];
+
+        for (size_t i = 0; i < 16; i++) {
+            red[i] = block[i][0];
+            green[i] = block[i][1];
+        }
+
+        encode_bc4_block(red, out);
+        encode_bc4_block(green, out + 8);
+    }
+
+    // bc7, mode 6 (single subset, rgba 7.7.7.7 endpoints with a p-bit each, 4 bit indices)
+
+    struct bc7_mode6_block {
+        uint8_t endpoints[2][4]; // 7 bit
+        uint8_t p_bits[2];
+        uint8_t indices[16];
+        int error;
+    };
+
+    constexpr int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    static bc7_mode6_block get_bc7_block(const texel_block& block, const float (&e0)[4], const float (&e1)[4]) noexcept {
+        bc7_mode6_block best{ .error = std::numeric_limits<int>::max() };
+
+        for (uint8_t p_combination = 0; p_combination < 4; p_combination++) {
+            bc7_mode6_block result{ .p_bits = { static_cast<uint8_t>(p_combination & 1), static_cast<uint8_t>(p_combination >> 1) }, .error = 0 };
+
+            int values[2][4];
+
+            for (size_t c = 0; c < 4; c++) {
+                result.endpoints[0][c] = static_cast<uint8_t>(std::clamp((e0[c] - result.p_bits[0]) / 2.f + 0.5f, 0.f, 127.f));
+                result.endpoints[1][c] = static_cast<uint8_t>(std::clamp((e1[c] - result.p_bits[1]) / 2.f + 0.5f, 0.f, 127.f));
+
+                values[0][c] = result.endpoints[0][c] << 1 | result.p_bits[0];
+                values[1][c] = result.endpoints[1][c] << 1 | result.p_bits[1];
+            }
+
+            int palette[16][4];
+
+            for (size_t p = 0; p < 16; p++) {
+                for (size_t c = 0; c < 4; c++) palette[p][c] = ((64 - bc7_weights[p]) * values[0][c] + bc7_weights[p] * values[1][c] + 32) >> 6;
+            }
+
+            for (size_t i = 0; i < 16 && result.error < best.error; i++) {
+                int best_error = std::numeric_limits<int>::max();
+
+                for (uint8_t p = 0; p < 16; p++) {
+                    int error = 0;
+
+                    for (size_t c = 0; c < 4; c++) {
+                        int d = static_cast<int>(block[i][c]) - palette[p][c];
+                        error += d * d;
+                    }
+
+                    if (error < best_error) {
+                        best_error = error;
+                        result.indices[i] = p;
+                    }
+                }
+
+                result.error += best_error;
+            }
+
+            if (result.error < best.error) best = result;
+        }
+
+        return best;
+    }
+
+    void encode_bc7_block(const texel_block& block, std::byte* out) noexcept {
+        float points[16][4];
+
+        for (size_t i = 0; i < 16; i++) {
+            for (size_t c = 0; c < 4; c++) points[i][c] = block[i][c];
+        }
+
+        float e0[4], e1[4];
+        get_axis_endpoints(points, e0, e1);
+
+        bc7_mode6_block best = get_bc7_block(block, e0, e1);
+
+        for (int iteration = 0; iteration < 2 && best.error > 0; iteration++) {
+            float weights[16];
+            for (size_t i = 0; i < 16; i++) weights[i] = 1.f - bc7_weights[best.indices[i]] / 64.f;
+
+            if (!fit_endpoints(points, weights, e0, e1)) break;
+
+            bc7_mode6_block refined = get_bc7_block(block, e0, e1);
+            if (refined.error >= best.error) break;
+
+            best = refined;
+        }
+
+        // the msb of the first index is implicitly 0
+        if (best.indices[0] & 8) {
+            std::swap(best.endpoints[0], best.endpoints[1]);
+            std::swap(best.p_bits[0], best.p_bits[1]);
+
+            for (uint8_t& index : best.indices) index = 15 - index;
+        }
+
+        uint64_t bits[2] = {};
+        size_t bit_offset = 0;
+
+        auto write_bits = [&](uint64_t value, size_t count) {
+            for (size_t i = 0; i < count; i++, bit_offset++) {
+                bits[bit_offset / 64] |= ((value >> i) & 1) << (bit_offset % 64);
+            }
+        };
+
+        write_bits(1 << 6, 7); // mode 6
+
+        for (size_t c = 0; c < 4; c++) {
+            write_bits(best.endpoints[0][c], 7);
+            write_bits(best.endpoints[1][c], 7);
+        }
+
+        write_bits(best.p_bits[0], 1);
+        write_bits(best.p_bits[1], 1);
+
+        for (size_t i = 0; i < 16; i++) {
+            write_bits(best.indices[i], i == 0 ? 3 : 4);
+        }
+
+        std::memcpy(out, bits, 16); // note: little endian
+    }
+
+    std::vector<std::byte> encode_image(block_format format, const uint8_t* texels, uint32_t width, uint32_t height, worker_pool& pool) {
+        uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+        size_t block_size = get_block_size(format);
+
+        std::vector<std::byte> blocks(static_cast<size_t>(blocks_x) * blocks_y * block_size);
+
+        pool.parallel_for(blocks_y, [&](size_t block_y) {
+            texel_block block;
+
+            for (size_t block_x = 0; block_x < blocks_x; block_x++) {
+                for (size_t i = 0; i < 16; i++) {
+                    size_t x = std::min<size_t>(block_x * 4 + i % 4, width - 1);
+                    size_t y = std::min<size_t>(block_y * 4 + i / 4, height - 1);
+
+                    std::memcpy(block[i], texels + (y * width + x) * 4, 4);
+                }
+
+                std::byte* out = blocks.data() + (block_y * blocks_x + block_x) * block_size;
+
+                switch (format) {
+                    case block_format::bc1: encode_bc1_block(block, out); break;
+                    case block_format::bc3: encode_bc3_block(block, out); break;
+                    case block_format::bc5: encode_bc5_block(block, out); break;
+                    case block_format::bc7: encode_bc7_block(block, out); break;
+                }
+            }
+        });
+
+        return blocks;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <core/worker_pool.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace photon::cook {
+    enum class block_format {
+        bc1, // rgb, 4 bpp
+        bc3, // rgb + alpha, 8 bpp
+        bc5, // two channels (rg), 8 bpp, meant for normal maps
+        bc7, // rgba, 8 bpp, highest quality
+    };
+
+    size_t get_block_size(block_format format) noexcept;
+
+    // a 4x4 block of rgba8 texels in row order
+    using texel_block = uint8_t[16][4];
+
+    void encode_bc1_block(const texel_block& block, std::byte* out) noexcept; // 8 bytes, the alpha is ignored
+    void encode_bc4_block(const uint8_t values[16], std::byte* out) noexcept; // 8 bytes
+    void encode_bc3_block(const texel_block& block, std::byte* out) noexcept; // 16 bytes
+    void encode_bc5_block(const texel_block& block, std::byte* out) noexcept; // 16 bytes, red and green
+    void encode_bc7_block(const texel_block& block, std::byte* out) noexcept; // 16 bytes, mode 6 only
+
+    // encodes a whole rgba8 image (rows of blocks in parallel), blocks on the right and bottom edges repeat the edge texels
+    std::vector<std::byte> encode_image(block_format format, const uint8_t* texels, uint32_t width, uint32_t height, worker_pool& pool);
+}
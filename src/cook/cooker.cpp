@@ -0,0 +1,177 @@
+#include "cooker.hpp"
+#include "mip_filter.hpp"
+#include <resources/texture_container.hpp>
+#include <resources/image_decoder.hpp>
+#include <resources/texel_convert.hpp>
+#include <core/hash.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace photon::cook {
+    VkFormat get_vk_format(const cook_settings& settings) noexcept {
+        switch (settings.format) {
+            case block_format::bc1: return settings.is_srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case block_format::bc3: return settings.is_srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            case block_format::bc5: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case block_format::bc7: return settings.is_srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    uint64_t get_settings_hash(const cook_settings& settings) noexcept {
+        uint32_t key[] = { cooker_version, static_cast<uint32_t>(settings.format), settings.is_srgb, settings.is_normal_map };
+        return hash64(key, sizeof(key));
+    }
+
+    bool cook_texture(std::span<const std::byte> source, const cook_settings& settings, std::ostream& out, worker_pool& pool) {
+        std::optional<decoded_image> image = decode_image(source);
+
+        if (!image) {
+            P_LOG_E("Failed to decode a source image!");
+            return false;
+        }
+
+        uint32_t x = image->width, y = image->height;
+
+        // the mip filter works on rgba
+        std::vector<uint8_t> rgba_texels;
+
+        if (image->component_count != 4) {
+            rgba_texels.resize(static_cast<size_t>(x) * y * 4);
+            expand_to_rgba8(image->texels.get(), rgba_texels.data(), static_cast<size_t>(x) * y, image->component_count);
+        }
+
+        // bc5 is only used for non-color data
+        bool is_srgb = settings.is_srgb && settings.format != block_format::bc5;
+
+        float_image level = decode_rgba8(rgba_texels.empty() ? image->texels.get() : rgba_texels.data(), x, y, is_srgb, pool);
+        image.reset();
+
+        uint32_t level_count = std::bit_width(std::max(x, y));
+
+        std::vector<std::vector<std::byte>> levels;
+        levels.reserve(level_count);
+
+        for (uint32_t i = 0; i < level_count; i++) {
+            if (i != 0) {
+                level = downsample(level, pool);
+                if (settings.is_normal_map) normalize_normals(level, pool);
+            }
+
+            std::vector<uint8_t> texels = encode_rgba8(level, is_srgb, pool);
+            levels.emplace_back(encode_image(settings.format, texels.data(), level.width, level.height, pool));
+        }
+
+        write_ktx2(out, settings, x, y, levels);
+        return static_cast<bool>(out);
+    }
+
+    // basic data format descriptor (khr data format spec, chapter 5) describing the block compressed format
+
+    static std::vector<uint32_t> get_ktx2_dfd(const cook_settings& settings) noexcept {
+        constexpr uint32_t model_bc1a = 128, model_bc3 = 130, model_bc5 = 132, model_bc7 = 134;
+        constexpr uint32_t channel_color = 0, channel_green = 1, channel_alpha = 15;
+        constexpr uint32_t qualifier_linear = 1 << 4;
+
+        struct sample {
+            uint32_t bit_offset;
+            uint32_t bit_length;
+            uint32_t channel_type;
+        };
+
+        bool is_srgb = settings.is_srgb && settings.format != block_format::bc5;
+
+        uint32_t color_model = model_bc7;
+        std::vector<sample> samples;
+
+        switch (settings.format) {
+            case block_format::bc1:
+                color_model = model_bc1a;
+                samples = { { 0, 64, channel_color } };
+                break;
+
+            case block_format::bc3:
+                color_model = model_bc3;
+                samples = { { 0, 64, channel_alpha | (is_srgb ? qualifier_linear : 0) }, { 64, 64, channel_color } };
+                break;
+
+            case block_format::bc5:
+                color_model = model_bc5;
+                samples = { { 0, 64, channel_color }, { 64, 64, channel_green } };
+                break;
+
+            case block_format::bc7:
+                color_model = model_bc7;
+                samples = { { 0, 128, channel_color } };
+                break;
+        }
+
+        uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+        std::vector<uint32_t> dfd{
+            4 + block_size, // total size
+            0, // vendor: khronos, type: basic
+            2 | block_size << 16, // version 1.3
+            color_model | 1 << 8 /*bt709 primaries*/ | (is_srgb ? 2 : 1) << 16 /*transfer function*/ | 0 << 24 /*straight alpha*/,
+            3 | 3 << 8, // 4x4x1x1 texel blocks
+            static_cast<uint32_t>(get_block_size(settings.format)), // bytes in plane 0
+            0,
+        };
+
+        for (const sample& s : samples) {
+            dfd.insert(dfd.end(), { s.bit_offset | (s.bit_length - 1) << 16 | s.channel_type << 24, 0, 0, 0xFFFFFFFF });
+        }
+
+        return dfd;
+    }
+
+    void write_ktx2(std::ostream& out, const cook_settings& settings, uint32_t width, uint32_t height, const std::vector<std::vector<std::byte>>& levels) {
+        std::vector<uint32_t> dfd = get_ktx2_dfd(settings);
+
+        ktx2::header header{
+            .vk_format = static_cast<uint32_t>(get_vk_format(settings)),
+            .type_size = 1,
+            .pixel_width = width,
+            .pixel_height = height,
+            .pixel_depth = 0,
+            .layer_count = 0,
+            .face_count = 1,
+            .level_count = static_cast<uint32_t>(levels.size()),
+            .supercompression_scheme = 0,
+            .dfd_byte_offset = static_cast<uint32_t>(sizeof(ktx2::header) + sizeof(ktx2::level_index) * levels.size()),
+            .dfd_byte_length = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t)),
+            .kvd_byte_offset = 0,
+            .kvd_byte_length = 0,
+            .sgd_byte_offset = 0,
+            .sgd_byte_length = 0,
+        };
+
+        std::copy(std::begin(ktx2::identifier), std::end(ktx2::identifier), header.identifier);
+
+        // level data is aligned to lcm(block size, 4) and stored from the smallest level up
+
+        uint64_t alignment = get_block_size(settings.format);
+        uint64_t data_offset = (header.dfd_byte_offset + header.dfd_byte_length + alignment - 1) / alignment * alignment;
+
+        std::vector<ktx2::level_index> level_index(levels.size());
+
+        for (size_t i = levels.size(); i-- > 0;) {
+            level_index[i] = { .byte_offset = data_offset, .byte_length = levels[i].size(), .uncompressed_byte_length = levels[i].size() };
+            data_offset += levels[i].size();
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(level_index.data()), level_index.size() * sizeof(ktx2::level_index));
+        out.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+
+        uint64_t padding = level_index.empty() ? 0 : level_index.back().byte_offset - (header.dfd_byte_offset + header.dfd_byte_length);
+        for (uint64_t i = 0; i < padding; i++) out.put(0);
+
+        for (size_t i = levels.size(); i-- > 0;) {
+            out.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "bc_encoder.hpp"
+#include <core/worker_pool.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+namespace photon::cook {
+    // bump when the cooked output changes for the same input, invalidates every cached output
+    constexpr uint32_t cooker_version = 1;
+
+    struct cook_settings {
+        block_format format;
+        bool is_srgb; // color data, filtered in linear space and stored in an srgb format (ignored for bc5)
+        bool is_normal_map; // the mips are renormalized
+    };
+
+    VkFormat get_vk_format(const cook_settings& settings) noexcept;
+
+    // hash of everything besides the source data that affects the output
+    uint64_t get_settings_hash(const cook_settings& settings) noexcept;
+
+    // decodes a source image (anything stb_image reads), generates its full mip chain and writes it as a block compressed ktx2
+    // returns false (and logs) if the source can't be decoded
+    bool cook_texture(std::span<const std::byte> source, const cook_settings& settings, std::ostream& out, worker_pool& pool);
+
+    // writes a ktx2 file with [levels] (index 0 is the largest) of a 2D block compressed image
+    void write_ktx2(std::ostream& out, const cook_settings& settings, uint32_t width, uint32_t height, const std::vector<std::vector<std::byte>>& levels);
+}
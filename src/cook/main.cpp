@@ -0,0 +1,224 @@
+#include "cooker.hpp"
+#include <core/hash.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// photon-cook, cooks source images into gpu-ready ktx2 textures (see texture::load_container())
+// usage: photon-cook [--format=bc1|bc3|bc5|bc7] [--linear] [--normal] [--force] [--threads=N] <input file or dir> <output dir>
+
+// inputs are skipped if their content hash (incl. the cook settings) matches the one recorded in the output's manifest
+
+namespace fs = std::filesystem;
+
+namespace photon::cook {
+    constexpr std::string_view manifest_name = ".photon-cook-manifest";
+
+    struct cook_options {
+        std::optional<block_format> format; // nullopt picks bc5 for normal maps, bc7 otherwise
+        bool is_linear = false;
+        bool is_normal_map = false;
+        bool force = false;
+        uint32_t thread_count = std::thread::hardware_concurrency();
+
+        fs::path input;
+        fs::path output;
+    };
+
+    static bool is_source_image(const fs::path& path) noexcept {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp" || ext == ".psd" || ext == ".gif" || ext == ".hdr";
+    }
+
+    // normal maps are recognized by a "_n" or "_normal" suffix
+    static bool is_normal_map_name(const fs::path& path) noexcept {
+        std::string stem = path.stem().string();
+        return stem.ends_with("_n") || stem.ends_with("_normal");
+    }
+
+    static std::optional<cook_options> parse_options(int argc, char** argv) {
+        cook_options options;
+        std::vector<std::string_view> paths;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+
+            if (arg == "--format=bc1") options.format = block_format::bc1;
+            else if (arg == "--format=bc3") options.format = block_format::bc3;
+            else if (arg == "--format=bc5") options.format = block_format::bc5;
+            else if (arg == "--format=bc7") options.format = block_format::bc7;
+            else if (arg == "--linear") options.is_linear = true;
+            else if (arg == "--normal") options.is_normal_map = true;
+            else if (arg == "--force") options.force = true;
+            else if (arg.starts_with("--threads=")) options.thread_count = static_cast<uint32_t>(std::stoul(std::string(arg.substr(10))));
+            else if (arg.starts_with("--")) {
+                P_LOG_E("Unknown option: {}", arg);
+                return std::nullopt;
+            } else paths.push_back(arg);
+        }
+
+        if (paths.size() != 2) {
+            P_LOG_E("usage: photon-cook [--format=bc1|bc3|bc5|bc7] [--linear] [--normal] [--force] [--threads=N] <input file or dir> <output dir>");
+            return std::nullopt;
+        }
+
+        options.input = paths[0];
+        options.output = paths[1];
+
+        return options;
+    }
+
+    static cook_settings get_settings(const cook_options& options, const fs::path& source) noexcept {
+        bool is_normal_map = options.is_normal_map || (!options.format && is_normal_map_name(source));
+
+        return {
+            .format = options.format.value_or(is_normal_map ? block_format::bc5 : block_format::bc7),
+            .is_srgb = !options.is_linear && !is_normal_map,
+            .is_normal_map = is_normal_map,
+        };
+    }
+
+    // manifest lines are "<hash> <source path relative to the input>"
+
+    static std::map<std::string, uint64_t> read_manifest(const fs::path& path) {
+        std::map<std::string, uint64_t> manifest;
+        std::ifstream file(path);
+
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t split = line.find(' ');
+            if (split == std::string::npos) continue;
+
+            manifest[line.substr(split + 1)] = std::stoull(line.substr(0, split), nullptr, 16);
+        }
+
+        return manifest;
+    }
+
+    static void write_manifest(const fs::path& path, const std::map<std::string, uint64_t>& manifest) {
+        fs::path temp_path = path;
+        temp_path += ".tmp";
+
+        {
+            std::ofstream file(temp_path, std::ios::trunc);
+            for (const auto& [source, hash] : manifest) file << std::format("{:016x} {}\n", hash, source);
+        }
+
+        fs::rename(temp_path, path);
+    }
+
+    static std::vector<std::byte> read_file(const fs::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<std::byte> data(fs::file_size(path));
+
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (static_cast<size_t>(file.gcount()) != data.size()) data.clear();
+
+        return data;
+    }
+
+    static int run(const cook_options& options) {
+        std::vector<fs::path> sources;
+        fs::path input_root = fs::is_directory(options.input) ? options.input : options.input.parent_path();
+
+        if (fs::is_directory(options.input)) {
+            for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.input)) {
+                if (entry.is_regular_file() && is_source_image(entry.path())) sources.push_back(entry.path());
+            }
+        } else {
+            sources.push_back(options.input);
+        }
+
+        std::sort(sources.begin(), sources.end());
+
+        fs::create_directories(options.output);
+
+        fs::path manifest_path = options.output / manifest_name;
+        std::map<std::string, uint64_t> manifest = read_manifest(manifest_path);
+
+        // note: files are cooked one after another, each is spread over all cores (block rows are encoded in parallel)
+        worker_pool pool(options.thread_count);
+
+        size_t cooked_count = 0, skipped_count = 0, failed_count = 0;
+
+        for (const fs::path& source : sources) {
+            std::string relative = fs::relative(source, input_root).generic_string();
+
+            fs::path output_path = options.output / relative;
+            output_path.replace_extension(".ktx2");
+
+            std::vector<std::byte> data = read_file(source);
+            if (data.empty()) {
+                P_LOG_E("Failed to read: {}", source.string());
+                failed_count++;
+                continue;
+            }
+
+            cook_settings settings = get_settings(options, source);
+            uint64_t hash = hash64(data.data(), data.size(), get_settings_hash(settings));
+
+            auto cached = manifest.find(relative);
+
+            if (!options.force && cached != manifest.end() && cached->second == hash && fs::exists(output_path)) {
+                skipped_count++;
+                continue;
+            }
+
+            // written to a temporary file first, so an interrupted cook never leaves a truncated output behind
+            fs::create_directories(output_path.parent_path());
+
+            fs::path temp_path = output_path;
+            temp_path += ".tmp";
+
+            bool is_cooked;
+
+            {
+                std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+                is_cooked = file && cook_texture(data, settings, file, pool);
+            }
+
+            if (!is_cooked) {
+                P_LOG_E("Failed to cook: {}", source.string());
+                fs::remove(temp_path);
+                manifest.erase(relative);
+
+                failed_count++;
+                continue;
+            }
+
+            fs::rename(temp_path, output_path);
+            manifest[relative] = hash;
+
+            P_LOG_I("cooked {}", relative);
+            cooked_count++;
+        }
+
+        write_manifest(manifest_path, manifest);
+
+        P_LOG_I("{} cooked, {} up to date, {} failed", cooked_count, skipped_count, failed_count);
+        return failed_count ? 1 : 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::optional<photon::cook::cook_options> options = photon::cook::parse_options(argc, argv);
+    if (!options) return 2;
+
+    try {
+        return photon::cook::run(options.value());
+    } catch (std::exception& e) {
+        P_LOG_E("Cooking failed: {}", e.what());
+        return 1;
+    }
+}
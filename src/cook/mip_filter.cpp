@@ -0,0 +1,133 @@
+#include "mip_filter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHOTON_COOK_SSE2
+#endif
+
+namespace photon::cook {
+    static const std::array<float, 256>& get_srgb_to_linear_table() noexcept {
+        static const std::array<float, 256> table = []() {
+            std::array<float, 256> table;
+
+            for (size_t i = 0; i < table.size(); i++) {
+                float c = static_cast<float>(i) / 255.f;
+                table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            return table;
+        }();
+
+        return table;
+    }
+
+    // indexed by the linear value in 1/65535 steps, fine enough that even the darkest srgb steps round correctly
+    static const std::vector<uint8_t>& get_linear_to_srgb_table() noexcept {
+        static const std::vector<uint8_t> table = []() {
+            std::vector<uint8_t> table(65536);
+
+            for (size_t i = 0; i < table.size(); i++) {
+                float l = static_cast<float>(i) / 65535.f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+                table[i] = static_cast<uint8_t>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+            }
+
+            return table;
+        }();
+
+        return table;
+    }
+
+    inline static uint8_t quantize_unorm8(float value) noexcept {
+        return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+    }
+
+    float_image decode_rgba8(const uint8_t* texels, uint32_t width, uint32_t height, bool is_srgb, worker_pool& pool) {
+        const std::array<float, 256>& srgb_table = get_srgb_to_linear_table();
+
+        float_image image{ .width = width, .height = height };
+        image.texels.resize(static_cast<size_t>(width) * height * 4);
+
+        pool.parallel_for(height, [&](size_t y) {
+            const uint8_t* src = texels + y * width * 4;
+            float* dst = image.texels.data() + y * width * 4;
+
+            for (size_t i = 0; i < static_cast<size_t>(width) * 4; i++) {
+                dst[i] = is_srgb && i % 4 != 3 ? srgb_table[src[i]] : static_cast<float>(src[i]) / 255.f;
+            }
+        });
+
+        return image;
+    }
+
+    std::vector<uint8_t> encode_rgba8(const float_image& image, bool is_srgb, worker_pool& pool) {
+        const std::vector<uint8_t>& srgb_table = get_linear_to_srgb_table();
+
+        std::vector<uint8_t> texels(image.texels.size());
+
+        pool.parallel_for(image.height, [&](size_t y) {
+            const float* src = image.texels.data() + y * image.width * 4;
+            uint8_t* dst = texels.data() + y * image.width * 4;
+
+            for (size_t i = 0; i < static_cast<size_t>(image.width) * 4; i++) {
+                if (is_srgb && i % 4 != 3) {
+                    dst[i] = srgb_table[static_cast<size_t>(std::clamp(src[i], 0.f, 1.f) * 65535.f + 0.5f)];
+                } else {
+                    dst[i] = quantize_unorm8(src[i]);
+                }
+            }
+        });
+
+        return texels;
+    }
+
+    float_image downsample(const float_image& image, worker_pool& pool) {
+        float_image result{ .width = std::max(1U, image.width / 2), .height = std::max(1U, image.height / 2) };
+        result.texels.resize(static_cast<size_t>(result.width) * result.height * 4);
+
+        pool.parallel_for(result.height, [&](size_t y) {
+            const float* row0 = image.texels.data() + std::min<size_t>(y * 2, image.height - 1) * image.width * 4;
+            const float* row1 = image.texels.data() + std::min<size_t>(y * 2 + 1, image.height - 1) * image.width * 4;
+            float* dst = result.texels.data() + y * result.width * 4;
+
+            for (size_t x = 0; x < result.width; x++) {
+                size_t x0 = std::min<size_t>(x * 2, image.width - 1) * 4;
+                size_t x1 = std::min<size_t>(x * 2 + 1, image.width - 1) * 4;
+
+                // one texel is exactly one sse register
+#ifdef PHOTON_COOK_SSE2
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)), _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+                _mm_storeu_ps(dst + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+                for (size_t c = 0; c < 4; c++) {
+                    dst[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+                }
+#endif
+            }
+        });
+
+        return result;
+    }
+
+    void normalize_normals(float_image& image, worker_pool& pool) {
+        pool.parallel_for(image.height, [&](size_t y) {
+            float* row = image.texels.data() + y * image.width * 4;
+
+            for (size_t x = 0; x < image.width; x++) {
+                float* texel = row + x * 4;
+
+                float n[3] = { texel[0] * 2.f - 1.f, texel[1] * 2.f - 1.f, texel[2] * 2.f - 1.f };
+                float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length < 1e-6f) continue;
+
+                for (size_t c = 0; c < 3; c++) {
+                    texel[c] = n[c] / length * 0.5f + 0.5f;
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <core/worker_pool.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace photon::cook {
+    // rgba texels as linear floats, all filtering happens in linear space so srgb images don't darken in the mips
+    struct float_image {
+        uint32_t width;
+        uint32_t height;
+        std::vector<float> texels; // 4 floats per texel, rows are tightly packed
+    };
+
+    // converts 8 bit rgba texels to linear floats, [is_srgb] decodes the rgb channels from srgb (alpha is always linear)
+    float_image decode_rgba8(const uint8_t* texels, uint32_t width, uint32_t height, bool is_srgb, worker_pool& pool);
+
+    // quantizes back to 8 bit rgba, [is_srgb] encodes the rgb channels to srgb
+    std::vector<uint8_t> encode_rgba8(const float_image& image, bool is_srgb, worker_pool& pool);
+
+    // halves each dimension (to a minimum of 1) with a 2x2 box filter, odd edges are clamped
+    float_image downsample(const float_image& image, worker_pool& pool);
+
+    // renormalizes tangent space normals stored as [0, 1] rgb (averaging shortens them)
+    void normalize_normals(float_image& image, worker_pool& pool);
+}
@@ -0,0 +1,110 @@
+#include "pack_writer.hpp"
+#include <core/logger.hpp>
+#include <core/worker_pool.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// photon-pack, bundles a directory (usually the photon-cook output) into an asset pack (see resources/asset_pack.hpp)
+// usage: photon-pack [--no-compress] [--threads=N] <input dir> <output file>
+
+// assets are named by their path relative to the input dir, hidden files (like the cook manifest) are skipped,
+// payloads are compressed in chunks on N threads (all cores by default) unless --no-compress is given
+
+namespace fs = std::filesystem;
+
+namespace photon::cook {
+    struct pack_options {
+        fs::path input;
+        fs::path output;
+        bool compress = true;
+        uint32_t thread_count = std::thread::hardware_concurrency();
+    };
+
+    static std::optional<pack_options> parse_options(int argc, char** argv) {
+        pack_options options;
+        std::vector<std::string_view> paths;
+
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+
+            if (arg == "--no-compress") options.compress = false;
+            else if (arg.starts_with("--threads=")) options.thread_count = static_cast<uint32_t>(std::stoul(std::string(arg.substr(10))));
+            else if (arg.starts_with("--")) {
+                P_LOG_E("Unknown option: {}", arg);
+                return std::nullopt;
+            } else paths.push_back(arg);
+        }
+
+        if (paths.size() != 2 || !fs::is_directory(paths[0])) {
+            P_LOG_E("usage: photon-pack [--no-compress] [--threads=N] <input dir> <output file>");
+            return std::nullopt;
+        }
+
+        options.input = paths[0];
+        options.output = paths[1];
+
+        return options;
+    }
+
+    static int run_pack(const pack_options& options) {
+        const fs::path& input = options.input;
+        const fs::path& output = options.output;
+
+        std::vector<pack_source> sources;
+
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input)) {
+            if (!entry.is_regular_file() || entry.path().filename().string().starts_with('.')) continue;
+
+            sources.push_back({
+                .name = fs::relative(entry.path(), input).generic_string(),
+                .path = entry.path(),
+            });
+        }
+
+        // sorted so the same input always gives the same pack
+        std::sort(sources.begin(), sources.end(), [](const pack_source& a, const pack_source& b) { return a.name < b.name; });
+
+        // written to a temporary file first, so an interrupted run never leaves a truncated pack behind
+        fs::path temp_path = output;
+        temp_path += ".tmp";
+
+        std::unique_ptr<worker_pool> pool;
+        if (options.compress) pool = std::make_unique<worker_pool>(std::max(options.thread_count, 1U));
+
+        bool is_written;
+
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            is_written = file && write_pack(file, sources, pool.get());
+        }
+
+        if (!is_written) {
+            P_LOG_E("Failed to write pack: {}", output.string());
+            fs::remove(temp_path);
+            return 1;
+        }
+
+        fs::rename(temp_path, output);
+
+        P_LOG_I("packed {} assets ({} bytes)", sources.size(), fs::file_size(output));
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::optional<photon::cook::pack_options> options = photon::cook::parse_options(argc, argv);
+    if (!options) return 2;
+
+    try {
+        return photon::cook::run_pack(options.value());
+    } catch (std::exception& e) {
+        P_LOG_E("Packing failed: {}", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,179 @@
+#include "pack_writer.hpp"
+#include <core/logger.hpp>
+#include <resources/asset_pack_format.hpp>
+#include <resources/texture_container.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <fstream>
+#include <optional>
+
+namespace photon::cook {
+    static bool has_extension(const std::filesystem::path& path, std::string_view extension) noexcept {
+        std::string ext = path.extension().string();
+        return ext.size() == extension.size() && std::equal(ext.begin(), ext.end(), extension.begin(), [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    }
+
+    // reads the payload of a source and fills in the payload part of its entry
+    static std::optional<std::vector<std::byte>> read_payload(const std::filesystem::path& path, pack::entry& entry) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return std::nullopt;
+
+        std::vector<std::byte> payload;
+
+        if (!has_extension(path, ".ktx2") && !has_extension(path, ".dds")) {
+            entry.type = pack::entry_type::raw;
+            payload.resize(std::filesystem::file_size(path));
+            file.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+
+            if (static_cast<size_t>(file.gcount()) != payload.size()) return std::nullopt;
+
+            return payload;
+        }
+
+        std::optional<texture_container> container = read_texture_container(file);
+        if (!container) return std::nullopt;
+
+        uint32_t layer_count = container->layer_count * container->face_count;
+
+        entry.type = pack::entry_type::texture;
+        entry.texture = pack::texture_info{
+            .format = static_cast<uint32_t>(container->format),
+            .dimension_count = container->dimension_count,
+            .width = container->width,
+            .height = container->height,
+            .depth = container->depth,
+            .layer_count = container->layer_count,
+            .face_count = container->face_count,
+            .level_count = container->level_count,
+            .generate_levels = container->generate_levels ? 1U : 0U,
+            .is_layer_major = container->is_layer_major ? 1U : 0U,
+        };
+
+        auto read_range = [&](uint64_t offset, uint64_t size) {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(offset));
+
+            size_t begin = payload.size();
+            payload.resize(begin + size);
+            file.read(reinterpret_cast<char*>(payload.data() + begin), static_cast<std::streamsize>(size));
+
+            return static_cast<uint64_t>(file.gcount()) == size;
+        };
+
+        if (container->is_layer_major) {
+            // dds is already in stream order per layer, the chains of all layers follow each other
+            uint64_t file_size = std::filesystem::file_size(path);
+
+            if (file_size <= container->data_offset || !read_range(container->data_offset, file_size - container->data_offset) || payload.size() % layer_count != 0) {
+                P_LOG_E("DDS texel data doesn't split into {} layers! ({})", layer_count, path.string());
+                return std::nullopt;
+            }
+        } else {
+            // ktx2 stores the smallest level first, streams start at the largest one
+            for (uint32_t level = 0; level < container->level_count; level++) {
+                if (!read_range(container->levels[level].offset, container->levels[level].size)) {
+                    P_LOG_E("Truncated KTX2 level {}! ({})", level, path.string());
+                    return std::nullopt;
+                }
+            }
+        }
+
+        return payload;
+    }
+
+    bool write_pack(std::ostream& out, const std::vector<pack_source>& sources, worker_pool* pool) {
+        uint32_t entry_count = static_cast<uint32_t>(sources.size());
+
+        std::vector<pack::entry> entries(entry_count);
+        std::string names;
+
+        // the name index is at most half full, so probes stay short and always end at an empty slot
+        uint32_t index_size = std::bit_ceil(std::max(entry_count * 2, 1U));
+        std::vector<uint32_t> index(index_size, pack::no_entry);
+
+        for (uint32_t id = 0; id < entry_count; id++) {
+            const std::string& name = sources[id].name;
+            uint64_t hash = pack::hash_name(name);
+
+            uint32_t slot = static_cast<uint32_t>(hash) & (index_size - 1);
+
+            for (; index[slot] != pack::no_entry; slot = (slot + 1) & (index_size - 1)) {
+                if (sources[index[slot]].name == name) {
+                    P_LOG_E("Duplicate asset pack name: {}", name);
+                    return false;
+                }
+            }
+
+            index[slot] = id;
+
+            entries[id] = pack::entry{
+                .name_hash = hash,
+                .name_offset = static_cast<uint32_t>(names.size()),
+                .name_length = static_cast<uint32_t>(name.size()),
+            };
+
+            names += name;
+        }
+
+        pack::header header{
+            .magic = pack::magic,
+            .version = pack::version,
+            .entry_count = entry_count,
+            .index_size = index_size,
+            .toc_offset = pack::page_size,
+        };
+
+        header.index_offset = header.toc_offset + entries.size() * sizeof(pack::entry);
+        header.names_offset = header.index_offset + index.size() * sizeof(uint32_t);
+        header.toc_size = header.names_offset + names.size() - header.toc_offset;
+
+        // the payloads follow the table of contents, which is written once their offsets are known
+
+        const std::vector<char> padding(pack::page_size, 0);
+        uint64_t offset = pack::align_to_page(header.toc_offset + header.toc_size);
+
+        for (uint64_t zeros = offset; zeros > 0;) {
+            uint64_t size = std::min<uint64_t>(zeros, padding.size());
+            out.write(padding.data(), static_cast<std::streamsize>(size));
+            zeros -= size;
+        }
+
+        for (uint32_t id = 0; id < entry_count; id++) {
+            std::optional<std::vector<std::byte>> payload = read_payload(sources[id].path, entries[id]);
+
+            if (!payload) {
+                P_LOG_E("Failed to read: {}", sources[id].path.string());
+                return false;
+            }
+
+            std::optional<std::vector<std::byte>> compressed;
+            if (pool) compressed = pack::compress_payload(*payload, *pool);
+
+            const std::vector<std::byte>& stored = compressed ? *compressed : *payload;
+
+            entries[id].offset = offset;
+            entries[id].size = payload->size();
+            entries[id].stored_size = stored.size();
+            entries[id].compression = compressed ? pack::compression_type::lz_chunks : pack::compression_type::none;
+
+            out.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size()));
+
+            uint64_t end = offset + stored.size();
+            offset = pack::align_to_page(end);
+
+            out.write(padding.data(), static_cast<std::streamsize>(offset - end));
+        }
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        out.seekp(static_cast<std::streamoff>(header.toc_offset));
+        out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(pack::entry)));
+        out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(uint32_t)));
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+        return static_cast<bool>(out);
+    }
+}
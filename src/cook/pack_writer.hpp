@@ -0,0 +1,21 @@
+#pragma once
+
+#include <core/worker_pool.hpp>
+
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace photon::cook {
+    struct pack_source {
+        std::string name; // the name the asset is looked up by, a relative path with '/' separators
+        std::filesystem::path path;
+    };
+
+    // writes an asset pack (see resources/asset_pack_format.hpp) of [sources] to [out], which has to be seekable (the table of contents is written last)
+    // .ktx2 and .dds files become texture entries with their texel data repacked in stream order, everything else is stored as is
+    // payloads are compressed in chunks on [pool] if given (see pack::compress_payload()), entries that don't shrink are stored uncompressed
+    // returns false (and logs) if a source can't be read or a name is used twice
+    bool write_pack(std::ostream& out, const std::vector<pack_source>& sources, worker_pool* pool = nullptr);
+}
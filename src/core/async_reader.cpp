@@ -0,0 +1,560 @@
+#include "async_reader.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace photon {
+    // a single read is capped (the kernel caps it at ~2 GiB anyway and fixed reads take a 32 bit length), the rest is continued like a short read
+    static constexpr size_t max_read_size = size_t(1) << 30;
+
+#ifndef _WIN32
+    // marks the nop which wakes the completion thread for shutdown
+    static constexpr uint64_t stop_user_data = ~uint64_t(0);
+
+    static int uring_setup(uint32_t entries, io_uring_params& params) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    }
+
+    static int uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    static int uring_register(int fd, uint32_t opcode, const void* args, uint32_t arg_count) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, args, arg_count));
+    }
+
+    struct async_reader::uring {
+        ~uring() noexcept {
+            if (sqes) munmap(sqes, sqes_size);
+            if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+            if (sq_ring) munmap(sq_ring, sq_ring_size);
+            if (fd >= 0) close(fd);
+        }
+
+        // returns nullptr if io_uring isn't available (old kernel, blocked by seccomp, ...)
+        static std::unique_ptr<uring> create(uint32_t queue_depth) noexcept {
+            std::unique_ptr<uring> ring = std::make_unique<uring>();
+            io_uring_params params{};
+            params.flags = IORING_SETUP_CLAMP;
+
+            ring->fd = uring_setup(queue_depth, params);
+            if (ring->fd < 0) return nullptr;
+
+            ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+            // note: with IORING_FEAT_SINGLE_MMAP both rings share one mapping
+            if (params.features & IORING_FEAT_SINGLE_MMAP) ring->sq_ring_size = ring->cq_ring_size = std::max(ring->sq_ring_size, ring->cq_ring_size);
+
+            void* sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+            if (sq_ring == MAP_FAILED) return nullptr;
+
+            ring->sq_ring = sq_ring;
+
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                ring->cq_ring = ring->sq_ring;
+            } else {
+                void* cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+                if (cq_ring == MAP_FAILED) return nullptr;
+
+                ring->cq_ring = cq_ring;
+            }
+
+            ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) return nullptr;
+
+            ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+            std::byte* sq = static_cast<std::byte*>(ring->sq_ring);
+            std::byte* cq = static_cast<std::byte*>(ring->cq_ring);
+
+            ring->sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+            ring->sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+            ring->sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+            ring->cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+            ring->cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+            ring->cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+            ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            // one slot per read in flight, the completion queue holds twice the submission entries so it can't overflow
+            uint32_t slot_count = std::min(queue_depth, params.sq_entries);
+
+            ring->requests.resize(slot_count);
+            ring->iovecs.resize(slot_count);
+            ring->is_fixed.resize(slot_count, false);
+
+            for (uint32_t slot = slot_count; slot > 0; slot--) ring->free_slots.push_back(slot - 1);
+
+            return ring;
+        }
+
+        // takes a submission queue entry, only the submitting thread (holding the ring lock) writes the tail
+        io_uring_sqe& push_sqe() noexcept {
+            uint32_t index = sq_tail_local & sq_mask;
+
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+
+            sq_array[index] = index;
+            sq_tail_local++;
+            unsubmitted_count++;
+
+            return sqe;
+        }
+
+        // publishes the pushed entries and submits them
+        void submit() noexcept {
+            if (unsubmitted_count == 0) return;
+
+            std::atomic_ref<uint32_t>(*sq_tail).store(sq_tail_local, std::memory_order_release);
+
+            int result;
+            while ((result = uring_enter(fd, unsubmitted_count, 0, 0)) < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) { }
+
+            if (result < 0) {
+                P_LOG_E("io_uring_enter failed: {}", std::strerror(errno));
+                engine_abort();
+            }
+
+            // note: entries the kernel didn't consume stay in the ring and are submitted with the next ones
+            unsubmitted_count -= static_cast<uint32_t>(result);
+        }
+
+        int fd = -1;
+
+        void* sq_ring = nullptr;
+        size_t sq_ring_size = 0;
+        void* cq_ring = nullptr;
+        size_t cq_ring_size = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqes_size = 0;
+
+        uint32_t* sq_tail = nullptr;
+        uint32_t sq_mask = 0;
+        uint32_t* sq_array = nullptr;
+        uint32_t sq_tail_local = 0;
+        uint32_t unsubmitted_count = 0;
+
+        uint32_t* cq_head = nullptr;
+        uint32_t* cq_tail = nullptr;
+        uint32_t cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+
+        // indexed by the user data of the entries
+        std::vector<std::optional<read_request>> requests;
+        std::vector<iovec> iovecs;
+        std::vector<bool> is_fixed;
+        std::vector<uint32_t> free_slots;
+
+        uint32_t fixed_in_flight = 0;
+        size_t fixed_buffer_count = 0; // registered with the kernel (a prefix of [registered_buffers])
+        bool use_fixed_buffers = true; // false once a registration failed
+    };
+#else
+    struct async_reader::uring { };
+#endif
+
+    async_reader::file::~file() noexcept {
+#ifdef _WIN32
+        if (handle) CloseHandle(handle);
+#else
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    async_reader::async_reader(const reader_config& config) noexcept :
+        queue_depth{std::max(config.queue_depth, 1u)}
+    {
+#ifndef _WIN32
+        if (config.use_io_uring) {
+            ring = uring::create(queue_depth);
+
+            if (ring) {
+                completion_thread = std::thread(&async_reader::run_completions, this);
+            } else {
+                P_LOG_W("io_uring is not available ({}), falling back to threaded reads", std::strerror(errno));
+            }
+        }
+#endif
+
+        if (!ring) fallback_pool = std::make_unique<worker_pool>(std::max(config.fallback_thread_count, 1u));
+    }
+
+    async_reader::~async_reader() noexcept {
+        wait_idle();
+
+#ifndef _WIN32
+        if (ring) {
+            {
+                std::lock_guard lock(ring_lock);
+
+                io_uring_sqe& sqe = ring->push_sqe();
+                sqe.opcode = IORING_OP_NOP;
+                sqe.user_data = stop_user_data;
+
+                ring->submit();
+            }
+
+            completion_thread.join();
+            ring.reset();
+        }
+#endif
+
+        fallback_pool.reset();
+
+        reader_stats stats = get_stats();
+
+        P_LOG_D("async_reader reads: {} bytes: {} queue depth: {:.1f} (max {}) throughput: {:.1f} MB/s{}", stats.read_count, stats.read_bytes,
+            stats.average_queue_depth, stats.max_queue_depth, static_cast<double>(stats.read_bytes) / (1024.0 * 1024.0) / std::max(stats.busy_seconds, 1e-9),
+            is_using_io_uring() ? " (io_uring)" : "");
+    }
+
+    std::shared_ptr<const async_reader::file> async_reader::open(const std::string& path) noexcept {
+        std::shared_ptr<file> source(new file());
+
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER file_size{};
+
+        if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &file_size)) {
+            P_LOG_E("Failed to open file: {}", path);
+            if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+            return nullptr;
+        }
+
+        source->handle = handle;
+        source->size = static_cast<uint64_t>(file_size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat file_stat{};
+
+        if (fd < 0 || fstat(fd, &file_stat) != 0) {
+            P_LOG_E("Failed to open file: {}", path);
+            if (fd >= 0) close(fd);
+            return nullptr;
+        }
+
+        source->fd = fd;
+        source->size = static_cast<uint64_t>(file_stat.st_size);
+#endif
+
+        return source;
+    }
+
+    void async_reader::read(std::shared_ptr<const file> source, uint64_t offset, std::span<std::byte> dst, read_callback on_complete) {
+        {
+            std::lock_guard lock(pending_lock);
+            pending_count++;
+        }
+
+        read_request request{
+            .source = std::move(source),
+            .offset = offset,
+            .dst = dst,
+            .on_complete = std::move(on_complete),
+        };
+
+        if (ring) {
+            std::lock_guard lock(ring_lock);
+
+            queued_requests.push_back(std::move(request));
+            submit_queued();
+        } else {
+            fallback_pool->submit([this, request = std::move(request)]() mutable {
+                on_submitted();
+
+                std::optional<size_t> size = read_blocking(*request.source, request.offset, request.dst);
+
+                on_completed(size.value_or(0));
+                complete(std::move(request), size);
+            });
+        }
+    }
+
+    void async_reader::read_file(const std::string& path, file_callback on_complete) {
+        std::shared_ptr<const file> source = open(path);
+
+        if (!source) {
+            on_complete(std::nullopt);
+            return;
+        }
+
+        std::shared_ptr<std::vector<std::byte>> data = std::make_shared<std::vector<std::byte>>(source->get_size());
+        std::span<std::byte> dst = *data;
+
+        read(std::move(source), 0, dst, [data, path, on_complete = std::move(on_complete)](std::optional<size_t> size) {
+            if (!size || size.value() != data->size()) {
+                P_LOG_E("Failed to read file: {}", path);
+                on_complete(std::nullopt);
+                return;
+            }
+
+            on_complete(std::move(*data));
+        });
+    }
+
+    void async_reader::register_buffer(std::span<std::byte> buffer) {
+        if (!ring || buffer.empty()) return;
+
+        std::lock_guard lock(ring_lock);
+
+        bool is_registered = std::any_of(registered_buffers.begin(), registered_buffers.end(), [&](std::span<std::byte> registered) {
+            return buffer.data() >= registered.data() && buffer.data() + buffer.size() <= registered.data() + registered.size();
+        });
+
+        if (is_registered) return;
+
+        registered_buffers.push_back(buffer);
+        is_registration_dirty = true;
+
+        submit_queued();
+    }
+
+    void async_reader::wait_idle() noexcept {
+        std::unique_lock lock(pending_lock);
+        idle_cv.wait(lock, [&] { return pending_count == 0; });
+    }
+
+    async_reader::reader_stats async_reader::get_stats() const noexcept {
+        std::lock_guard lock(stats_lock);
+
+        std::chrono::steady_clock::duration busy = busy_time;
+        if (in_flight_count > 0) busy += std::chrono::steady_clock::now() - busy_begin;
+
+        return {
+            .read_count = read_count,
+            .read_bytes = read_bytes,
+            .max_queue_depth = max_queue_depth,
+            .average_queue_depth = submission_count > 0 ? static_cast<double>(queue_depth_sum) / static_cast<double>(submission_count) : 0.0,
+            .busy_seconds = std::chrono::duration<double>(busy).count(),
+        };
+    }
+
+    void async_reader::submit_queued() noexcept {
+#ifndef _WIN32
+        // the buffer table can only be replaced while no fixed reads use it
+        if (is_registration_dirty && ring->use_fixed_buffers && ring->fixed_in_flight == 0) {
+            std::vector<iovec> buffers;
+
+            for (std::span<std::byte> buffer : registered_buffers) buffers.push_back({ .iov_base = buffer.data(), .iov_len = buffer.size() });
+
+            if (ring->fixed_buffer_count > 0) uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+
+            if (uring_register(ring->fd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<uint32_t>(buffers.size())) < 0) {
+                // note: usually RLIMIT_MEMLOCK on older kernels, reads into these buffers just aren't fixed
+                P_LOG_W("Failed to register io_uring buffers ({}), using regular reads", std::strerror(errno));
+
+                ring->use_fixed_buffers = false;
+                ring->fixed_buffer_count = 0;
+            } else {
+                ring->fixed_buffer_count = buffers.size();
+            }
+
+            is_registration_dirty = false;
+        }
+
+        while (!queued_requests.empty() && !ring->free_slots.empty()) {
+            uint32_t slot = ring->free_slots.back();
+            ring->free_slots.pop_back();
+
+            read_request& request = ring->requests[slot].emplace(std::move(queued_requests.front()));
+            queued_requests.pop_front();
+
+            std::span<std::byte> dst = request.dst.subspan(request.read_size);
+            dst = dst.first(std::min(dst.size(), max_read_size));
+
+            io_uring_sqe& sqe = ring->push_sqe();
+            sqe.fd = request.source->fd;
+            sqe.off = request.offset + request.read_size;
+            sqe.user_data = slot;
+
+            auto fixed_buffer = std::find_if(registered_buffers.begin(), registered_buffers.begin() + ring->fixed_buffer_count, [&](std::span<std::byte> buffer) {
+                return dst.data() >= buffer.data() && dst.data() + dst.size() <= buffer.data() + buffer.size();
+            });
+
+            ring->is_fixed[slot] = fixed_buffer != registered_buffers.begin() + ring->fixed_buffer_count;
+
+            if (ring->is_fixed[slot]) {
+                sqe.opcode = IORING_OP_READ_FIXED;
+                sqe.addr = reinterpret_cast<uint64_t>(dst.data());
+                sqe.len = static_cast<uint32_t>(dst.size());
+                sqe.buf_index = static_cast<uint16_t>(fixed_buffer - registered_buffers.begin());
+
+                ring->fixed_in_flight++;
+            } else {
+                ring->iovecs[slot] = { .iov_base = dst.data(), .iov_len = dst.size() };
+
+                sqe.opcode = IORING_OP_READV;
+                sqe.addr = reinterpret_cast<uint64_t>(&ring->iovecs[slot]);
+                sqe.len = 1;
+            }
+
+            on_submitted();
+        }
+
+        ring->submit();
+#endif
+    }
+
+    void async_reader::run_completions() noexcept {
+#ifndef _WIN32
+        std::vector<std::pair<uint64_t, int32_t>> completions;
+        std::vector<std::pair<read_request, int32_t>> finished_requests;
+
+        for (;;) {
+            if (uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                P_LOG_E("io_uring_enter failed: {}", std::strerror(errno));
+                engine_abort();
+            }
+
+            uint32_t head = *ring->cq_head;
+            uint32_t tail = std::atomic_ref<uint32_t>(*ring->cq_tail).load(std::memory_order_acquire);
+
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = ring->cqes[head & ring->cq_mask];
+                completions.emplace_back(cqe.user_data, cqe.res);
+            }
+
+            std::atomic_ref<uint32_t>(*ring->cq_head).store(head, std::memory_order_release);
+
+            bool stop = false;
+
+            {
+                std::lock_guard lock(ring_lock);
+
+                for (auto [user_data, result] : completions) {
+                    if (user_data == stop_user_data) {
+                        stop = true;
+                        continue;
+                    }
+
+                    uint32_t slot = static_cast<uint32_t>(user_data);
+
+                    finished_requests.emplace_back(std::move(ring->requests[slot].value()), result);
+                    ring->requests[slot].reset();
+                    ring->free_slots.push_back(slot);
+
+                    if (ring->is_fixed[slot]) ring->fixed_in_flight--;
+                }
+            }
+
+            completions.clear();
+
+            for (auto& [request, result] : finished_requests) {
+                on_completed(result > 0 ? static_cast<size_t>(result) : 0);
+
+                if (result == -EINTR || result == -EAGAIN) {
+                    std::lock_guard lock(ring_lock);
+                    queued_requests.push_front(std::move(request));
+                } else if (result < 0) {
+                    complete(std::move(request), std::nullopt);
+                } else {
+                    request.read_size += static_cast<size_t>(result);
+
+                    // short reads are continued, unless the end of the file is reached
+                    if (result == 0 || request.read_size == request.dst.size()) {
+                        complete(std::move(request), request.read_size);
+                    } else {
+                        std::lock_guard lock(ring_lock);
+                        queued_requests.push_front(std::move(request));
+                    }
+                }
+            }
+
+            finished_requests.clear();
+
+            if (stop) return;
+
+            // the freed slots take the queued (and continued) reads
+            std::lock_guard lock(ring_lock);
+            submit_queued();
+        }
+#endif
+    }
+
+    void async_reader::complete(read_request&& request, std::optional<size_t> size) noexcept {
+        read_callback on_complete = std::move(request.on_complete);
+        request.source.reset();
+
+        on_complete(size);
+
+        if (size) {
+            std::lock_guard lock(stats_lock);
+            read_count++;
+        }
+
+        std::lock_guard lock(pending_lock);
+        if (--pending_count == 0) idle_cv.notify_all();
+    }
+
+    std::optional<size_t> async_reader::read_blocking(const file& source, uint64_t offset, std::span<std::byte> dst) noexcept {
+        size_t read_size = 0;
+
+        while (read_size < dst.size()) {
+            size_t size = std::min(dst.size() - read_size, max_read_size);
+
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset + read_size);
+            overlapped.OffsetHigh = static_cast<DWORD>((offset + read_size) >> 32);
+
+            DWORD result = 0;
+
+            if (!ReadFile(source.handle, dst.data() + read_size, static_cast<DWORD>(size), &result, &overlapped)) {
+                if (GetLastError() == ERROR_HANDLE_EOF) break;
+                return std::nullopt;
+            }
+#else
+            ssize_t result = pread(source.fd, dst.data() + read_size, size, static_cast<off_t>(offset + read_size));
+
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                return std::nullopt;
+            }
+#endif
+
+            if (result == 0) break;
+            read_size += static_cast<size_t>(result);
+        }
+
+        return read_size;
+    }
+
+    void async_reader::on_submitted() noexcept {
+        std::lock_guard lock(stats_lock);
+
+        if (in_flight_count++ == 0) busy_begin = std::chrono::steady_clock::now();
+
+        max_queue_depth = std::max(max_queue_depth, in_flight_count);
+        queue_depth_sum += in_flight_count;
+        submission_count++;
+    }
+
+    void async_reader::on_completed(size_t size) noexcept {
+        std::lock_guard lock(stats_lock);
+
+        read_bytes += size;
+        if (--in_flight_count == 0) busy_time += std::chrono::steady_clock::now() - busy_begin;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "worker_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace photon {
+    // asynchronous file reads for the asset loaders, many reads are kept in flight at once instead of blocking a loader thread on each
+
+    // on linux the reads are batched into an io_uring (raw syscalls, no liburing), reads into registered buffers (eg. streamer staging memory)
+    // use fixed buffers so their pages aren't pinned on every read, elsewhere (or if io_uring isn't available) reads run as pread on a set of threads
+
+    // note: completions run on the completion thread (or a fallback thread) and delay the following ones, so they should hand any real work
+    // (decoding) over to a worker_pool
+
+    class async_reader {
+    public:
+        struct reader_config {
+            uint32_t queue_depth; // reads in flight at once, further reads are queued until earlier ones complete
+            uint32_t fallback_thread_count; // pread threads if io_uring isn't used
+            bool use_io_uring; // false forces the fallback
+        };
+
+        // an open file, reads keep it open until they complete
+        class file {
+        public:
+            ~file() noexcept;
+
+            file(const file&) = delete;
+            file& operator=(const file&) = delete;
+
+            uint64_t get_size() const noexcept { return size; }
+
+        private:
+            file() noexcept = default;
+
+#ifdef _WIN32
+            void* handle = nullptr;
+#else
+            int fd = -1;
+#endif
+            uint64_t size = 0;
+
+            friend class async_reader;
+        };
+
+        // [size] is the amount of bytes read (only short at the end of the file), nullopt if the read failed
+        using read_callback = std::function<void(std::optional<size_t> size)>;
+        using file_callback = std::function<void(std::optional<std::vector<std::byte>> data)>;
+
+        struct reader_stats {
+            uint64_t read_count;
+            uint64_t read_bytes;
+
+            uint32_t max_queue_depth; // reads in flight at once
+            double average_queue_depth; // reads in flight, sampled on every submission
+            double busy_seconds; // with at least one read in flight, read_bytes / busy_seconds is the achieved throughput
+        };
+
+        explicit async_reader(const reader_config& config) noexcept;
+        ~async_reader() noexcept; // waits for the reads in flight and logs the stats
+
+        async_reader(const async_reader&) = delete;
+        async_reader& operator=(const async_reader&) = delete;
+
+        // returns nullptr (and logs) if the file can't be opened, can be called from any thread
+        static std::shared_ptr<const file> open(const std::string& path) noexcept;
+
+        // reads [dst.size()] bytes at [offset] into [dst], which must stay valid until [on_complete] ran, can be called from any thread
+        void read(std::shared_ptr<const file> source, uint64_t offset, std::span<std::byte> dst, read_callback on_complete);
+
+        // reads a whole file into a new buffer, nullopt if it can't be opened or read
+        void read_file(const std::string& path, file_callback on_complete);
+
+        // reads into [buffer] use io_uring fixed buffers once it's registered (if the kernel accepts it), the memory must stay valid as long as the reader,
+        // registering the same buffer again is a no-op
+        void register_buffer(std::span<std::byte> buffer);
+
+        // blocks until no reads are queued or in flight
+        void wait_idle() noexcept;
+
+        bool is_using_io_uring() const noexcept { return ring != nullptr; }
+        reader_stats get_stats() const noexcept;
+
+    private:
+        struct read_request {
+            std::shared_ptr<const file> source;
+            uint64_t offset;
+            std::span<std::byte> dst;
+            size_t read_size = 0; // so far, short reads are continued
+
+            read_callback on_complete;
+        };
+
+        // io_uring state, see async_reader.cpp
+        struct uring;
+
+        // moves queued requests into the submission queue while there is room, requires [ring_lock]
+        void submit_queued() noexcept;
+
+        void run_completions() noexcept;
+        void complete(read_request&& request, std::optional<size_t> size) noexcept;
+
+        // pread loop of the fallback, returns the bytes read or nullopt on error
+        static std::optional<size_t> read_blocking(const file& source, uint64_t offset, std::span<std::byte> dst) noexcept;
+
+        // queue depth and throughput accounting, called for every submitted (or continued) read and its completion
+        void on_submitted() noexcept;
+        void on_completed(size_t size) noexcept;
+
+        uint32_t queue_depth;
+
+        std::unique_ptr<uring> ring; // null if io_uring isn't used
+        std::mutex ring_lock; // guards [ring] submissions, [queued_requests] and [registered_buffers]
+        std::deque<read_request> queued_requests;
+        std::thread completion_thread;
+
+        std::vector<std::span<std::byte>> registered_buffers;
+        bool is_registration_dirty = false; // applied once no fixed reads are in flight
+
+        std::unique_ptr<worker_pool> fallback_pool; // only without io_uring
+
+        uint32_t pending_count = 0; // queued or in flight
+        std::mutex pending_lock; // guards [pending_count]
+        std::condition_variable idle_cv;
+
+        mutable std::mutex stats_lock; // guards the stats below
+        uint32_t in_flight_count = 0;
+        uint64_t read_count = 0;
+        uint64_t read_bytes = 0;
+        uint32_t max_queue_depth = 0;
+        uint64_t queue_depth_sum = 0;
+        uint64_t submission_count = 0;
+        std::chrono::steady_clock::duration busy_time{};
+        std::chrono::steady_clock::time_point busy_begin;
+    };
+}
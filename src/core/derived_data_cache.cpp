@@ -0,0 +1,177 @@
+#include "derived_data_cache.hpp"
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace photon {
+    static constexpr std::string_view entry_extension = ".ddc";
+    static constexpr std::string_view temp_extension = ".tmp";
+
+    // temp files older than this are left by crashed writers
+    static constexpr std::chrono::hours stale_temp_age{1};
+
+    derived_data_cache::derived_data_cache(const cache_config& config) noexcept :
+        path{config.path},
+        max_size{config.max_size}
+    {
+        std::random_device random;
+        temp_id = static_cast<uint64_t>(random()) << 32 | random();
+
+        std::error_code error;
+        fs::create_directories(path, error);
+
+        if (error) {
+            P_LOG_W("Failed to create the derived data cache: {} ({})", path.string(), error.message());
+            return;
+        }
+
+        trim();
+    }
+
+    derived_data_cache::~derived_data_cache() noexcept {
+        P_LOG_D("derived_data_cache hits: {} misses: {} size: {} / {} bytes", hit_count.load(), miss_count.load(), size.load(), max_size);
+    }
+
+    std::optional<mapped_file> derived_data_cache::find(const cache_key& key) noexcept {
+        fs::path entry_path = get_entry_path(key);
+
+        // note: checked first, as mapping a missing file logs an error
+        std::error_code error;
+
+        if (!fs::is_regular_file(entry_path, error)) {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        std::optional<mapped_file> entry = mapped_file::map(entry_path.string());
+
+        if (!entry) {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        // the modification time orders the entries for trim(), failing to bump it only makes the entry look older
+        fs::last_write_time(entry_path, fs::file_time_type::clock::now(), error);
+
+        hit_count.fetch_add(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    bool derived_data_cache::store(const cache_key& key, std::span<const std::span<const std::byte>> parts) noexcept {
+        fs::path entry_path = get_entry_path(key);
+        fs::path temp_path = entry_path;
+        temp_path += std::format(".{:016x}.{}{}", temp_id, temp_count.fetch_add(1, std::memory_order_relaxed), temp_extension);
+
+        uint64_t entry_size = 0;
+
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+
+            for (std::span<const std::byte> part : parts) {
+                if (!file) break;
+
+                file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+                entry_size += part.size();
+            }
+
+            if (file) file.close();
+
+            if (!file || entry_size == 0) {
+                P_LOG_W("Failed to write derived data cache entry: {}", temp_path.string());
+
+                std::error_code error;
+                fs::remove(temp_path, error);
+
+                return false;
+            }
+        }
+
+        // note: the rename replaces an existing entry atomically, readers see either the old or the new file
+        std::error_code error;
+        fs::rename(temp_path, entry_path, error);
+
+        if (error) {
+            fs::remove(temp_path, error);
+
+            // another writer may hold the entry (windows doesn't replace files in use), it has the same content
+            if (fs::is_regular_file(entry_path, error)) return true;
+
+            P_LOG_W("Failed to store derived data cache entry: {}", entry_path.string());
+            return false;
+        }
+
+        if (size.fetch_add(entry_size, std::memory_order_relaxed) + entry_size > max_size) trim();
+
+        return true;
+    }
+
+    void derived_data_cache::trim() noexcept {
+        std::unique_lock lock(trim_lock, std::try_to_lock);
+        if (!lock) return;
+
+        struct entry_info {
+            fs::path path;
+            fs::file_time_type last_use;
+            uint64_t size;
+        };
+
+        std::vector<entry_info> entries;
+        uint64_t total_size = 0;
+
+        // stores during the trim keep counting, so the counter is adjusted by the difference instead of overwritten
+        uint64_t counted_size = size.load(std::memory_order_relaxed);
+
+        fs::file_time_type now = fs::file_time_type::clock::now();
+        std::error_code error, entry_error; // note: entry errors only skip the entry, they must not end the iteration
+
+        for (fs::directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+            if (!it->is_regular_file(entry_error)) continue;
+
+            fs::file_time_type last_write = it->last_write_time(entry_error);
+            if (entry_error) continue;
+
+            std::string extension = it->path().extension().string();
+
+            if (extension == temp_extension) {
+                if (now - last_write > stale_temp_age) fs::remove(it->path(), entry_error);
+                continue;
+            }
+
+            if (extension != entry_extension) continue;
+
+            uint64_t entry_size = it->file_size(entry_error);
+            if (entry_error) continue;
+
+            entries.push_back({ .path = it->path(), .last_use = last_write, .size = entry_size });
+            total_size += entry_size;
+        }
+
+        // trims below the limit, so the following stores don't trim right away again
+        uint64_t target_size = max_size - max_size / 4;
+
+        if (total_size > max_size) {
+            std::sort(entries.begin(), entries.end(), [](const entry_info& a, const entry_info& b) { return a.last_use < b.last_use; });
+
+            for (const entry_info& entry : entries) {
+                if (total_size <= target_size) break;
+
+                // note: fails for entries mapped on windows, they're kept until the next trim
+                if (fs::remove(entry.path, error)) total_size -= entry.size;
+            }
+        }
+
+        size.fetch_add(total_size - counted_size, std::memory_order_relaxed);
+    }
+
+    fs::path derived_data_cache::get_entry_path(const cache_key& key) const {
+        return path / std::format("{:016x}{:016x}{}", key.content_hash, key.params_hash, entry_extension);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace photon {
+    // an on-disk cache of data derived from source assets (eg. decoded textures), later launches map the stored result instead of deriving it again
+
+    // entries are addressed by a hash of the source content and a hash of the derivation parameters, so changed sources or parameters simply miss
+    // and their old entries age out, every entry is written to a temp file and renamed into place, so concurrent writers (threads or processes)
+    // never expose partial entries, the last rename wins
+    // the cache is kept below its size limit by deleting the least recently used entries (hits bump the modification time)
+
+    class derived_data_cache {
+    public:
+        struct cache_config {
+            std::string path; // directory, created if missing
+            uint64_t max_size; // in bytes, trimmed on creation and whenever stores exceed it
+        };
+
+        struct cache_key {
+            uint64_t content_hash; // of the source data (see hash64())
+            uint64_t params_hash; // of the derivation parameters, incl. the version of the stored format
+        };
+
+        explicit derived_data_cache(const cache_config& config) noexcept;
+        ~derived_data_cache() noexcept; // logs the hit rate
+
+        derived_data_cache(const derived_data_cache&) = delete;
+        derived_data_cache& operator=(const derived_data_cache&) = delete;
+
+        // maps the entry of [key] and marks it as recently used, nullopt if there is none, can be called from any thread
+        // note: the entry can be replaced or trimmed while mapped, the mapping keeps its data
+        std::optional<mapped_file> find(const cache_key& key) noexcept;
+
+        // stores the concatenated [parts] as the entry of [key], returns false (and logs) if it couldn't be written, can be called from any thread
+        bool store(const cache_key& key, std::span<const std::span<const std::byte>> parts) noexcept;
+
+        // deletes the least recently used entries (and temp files left by crashed writers) until the cache fits into its size limit
+        void trim() noexcept;
+
+        uint64_t get_hit_count() const noexcept { return hit_count.load(std::memory_order_relaxed); }
+        uint64_t get_miss_count() const noexcept { return miss_count.load(std::memory_order_relaxed); }
+
+    private:
+        std::filesystem::path get_entry_path(const cache_key& key) const;
+
+        std::filesystem::path path;
+        uint64_t max_size;
+
+        uint64_t temp_id; // random, keeps the temp files of concurrent processes apart
+        std::atomic<uint64_t> temp_count = 0;
+
+        std::atomic<uint64_t> size = 0; // approximate, entries stored by other processes are only counted by trim()
+        std::mutex trim_lock; // only one thread trims at a time
+
+        std::atomic<uint64_t> hit_count = 0;
+        std::atomic<uint64_t> miss_count = 0;
+    };
+}
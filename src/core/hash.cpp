@@ -0,0 +1,84 @@
+#include "hash.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace photon {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    inline static uint64_t read64(const std::byte* data) noexcept {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline static uint32_t read32(const std::byte* data) noexcept {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline static uint64_t round(uint64_t acc, uint64_t input) noexcept {
+        return std::rotl(acc + input * prime2, 31) * prime1;
+    }
+
+    inline static uint64_t merge_round(uint64_t acc, uint64_t value) noexcept {
+        return (acc ^ round(0, value)) * prime1 + prime4;
+    }
+
+    uint64_t hash64(const void* data, size_t size, uint64_t seed) noexcept {
+        const std::byte* p = static_cast<const std::byte*>(data);
+        const std::byte* end = p + size;
+
+        uint64_t h;
+
+        if (size >= 32) {
+            uint64_t v1 = seed + prime1 + prime2;
+            uint64_t v2 = seed + prime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - prime1;
+
+            for (; end - p >= 32; p += 32) {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+
+            h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        } else {
+            h = seed + prime5;
+        }
+
+        h += size;
+
+        for (; end - p >= 8; p += 8) {
+            h = std::rotl(h ^ round(0, read64(p)), 27) * prime1 + prime4;
+        }
+
+        if (end - p >= 4) {
+            h = std::rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+            p += 4;
+        }
+
+        for (; p < end; p++) {
+            h = std::rotl(h ^ (static_cast<uint64_t>(*p) * prime5), 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+
+        return h;
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace photon {
+    // 64 bit non-cryptographic content hash (xxh64), stable across runs and platforms so it can be stored on disk
+    uint64_t hash64(const void* data, size_t size, uint64_t seed = 0) noexcept;
+}
@@ -0,0 +1,103 @@
+#include "mapped_file.hpp"
+#include <core/logger.hpp>
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace photon {
+    mapped_file::~mapped_file() noexcept {
+        unmap();
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept :
+        data{std::exchange(other.data, nullptr)},
+        size{std::exchange(other.size, 0)}
+    { }
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            unmap();
+
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+        }
+
+        return *this;
+    }
+
+    void mapped_file::unmap() noexcept {
+        if (!data) return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<std::byte*>(data), size);
+#endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    std::optional<mapped_file> mapped_file::map(const std::string& path) noexcept {
+        mapped_file file;
+
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER file_size{};
+
+        if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &file_size) || file_size.QuadPart == 0) {
+            P_LOG_E("Failed to open file for mapping: {}", path);
+            if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+            return std::nullopt;
+        }
+
+        // note: the view keeps the mapping (and the file) alive, so both handles can be closed right away
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(handle);
+
+        if (!view) {
+            P_LOG_E("Failed to map file: {}", path);
+            return std::nullopt;
+        }
+
+        file.data = static_cast<const std::byte*>(view);
+        file.size = static_cast<size_t>(file_size.QuadPart);
+#else
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat file_stat{};
+
+        if (fd < 0 || fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            P_LOG_E("Failed to open file for mapping: {}", path);
+            if (fd >= 0) close(fd);
+            return std::nullopt;
+        }
+
+        // note: the mapping keeps the file alive, so the descriptor can be closed right away
+        void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (view == MAP_FAILED) {
+            P_LOG_E("Failed to map file: {}", path);
+            return std::nullopt;
+        }
+
+        file.data = static_cast<const std::byte*>(view);
+        file.size = static_cast<size_t>(file_stat.st_size);
+#endif
+
+        return file;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace photon {
+    // a read-only memory mapping of a whole file, the pages are read by the os on first access
+
+    class mapped_file {
+    public:
+        mapped_file() noexcept = default;
+        ~mapped_file() noexcept;
+
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        // returns nullopt (and logs the reason) if the file can't be opened or mapped, note: empty files can't be mapped
+        static std::optional<mapped_file> map(const std::string& path) noexcept;
+
+        std::span<const std::byte> get_data() const noexcept { return { data, size }; }
+
+    private:
+        void unmap() noexcept;
+
+        const std::byte* data = nullptr;
+        size_t size = 0;
+    };
+}
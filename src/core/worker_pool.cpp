@@ -0,0 +1,102 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace photon {
+    worker_pool::worker_pool(uint32_t thread_count) {
+        thread_count = std::max(1U, thread_count);
+        workers.reserve(thread_count);
+
+        for (uint32_t i = 0; i < thread_count; i++) {
+            workers.emplace_back(&worker_pool::run_worker, this);
+        }
+    }
+
+    worker_pool::~worker_pool() noexcept {
+        {
+            std::lock_guard<std::mutex> l(tasks_lock);
+            stop = true;
+        }
+
+        tasks_cv.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void worker_pool::submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> l(tasks_lock);
+            tasks.emplace_back(std::move(task));
+        }
+
+        tasks_cv.notify_one();
+    }
+
+    void worker_pool::parallel_for(size_t count, const std::function<void(size_t)>& body) {
+        if (count == 0) return;
+
+        // indices are claimed from a shared counter, helpers which start after all indices were claimed just exit
+        // note: the state is shared as the caller doesn't wait for helpers which never got to run
+
+        struct loop_state {
+            std::atomic<size_t> next_index = 0;
+            std::atomic<size_t> done_count = 0;
+            size_t count;
+            const std::function<void(size_t)>* body;
+
+            std::mutex done_lock;
+            std::condition_variable done_cv;
+
+            void run() noexcept {
+                size_t local_done = 0;
+
+                for (size_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1)) {
+                    (*body)(i);
+                    local_done++;
+                }
+
+                if (local_done && done_count.fetch_add(local_done) + local_done == count) {
+                    std::lock_guard<std::mutex> l(done_lock);
+                    done_cv.notify_all();
+                }
+            }
+        };
+
+        auto state = std::make_shared<loop_state>();
+        state->count = count;
+        state->body = &body;
+
+        size_t helper_count = std::min(count - 1, workers.size());
+
+        for (size_t i = 0; i < helper_count; i++) {
+            submit([state]() { state->run(); });
+        }
+
+        state->run();
+
+        std::unique_lock<std::mutex> l(state->done_lock);
+        state->done_cv.wait(l, [&]() { return state->done_count.load() == count; });
+    }
+
+    void worker_pool::run_worker() noexcept {
+        while (true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> l(tasks_lock);
+                tasks_cv.wait(l, [this]() { return stop || !tasks.empty(); });
+
+                if (tasks.empty()) return; // stopped and drained
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace photon {
+    // a fixed set of worker threads running tasks in submission order
+
+    // note: tasks must not throw, parallel_for() can be called from within a task (the caller does the work if the pool is busy)
+
+    class worker_pool {
+    public:
+        explicit worker_pool(uint32_t thread_count = std::thread::hardware_concurrency());
+        ~worker_pool() noexcept; // finishes all queued tasks
+
+        worker_pool(const worker_pool&) = delete;
+        worker_pool& operator=(const worker_pool&) = delete;
+
+        void submit(std::function<void()> task);
+
+        // runs [body] for every index in [0, count) on the workers and the calling thread, returns once all are done
+        void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+        uint32_t get_thread_count() const noexcept { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+        void run_worker() noexcept;
+
+        std::vector<std::thread> workers;
+
+        std::deque<std::function<void()>> tasks;
+        std::mutex tasks_lock;
+        std::condition_variable tasks_cv;
+        bool stop = false;
+    };
+}
@@ -1,6 +1,8 @@
 #include "forward.hpp"
+#include <resources/virtual_texture.hpp>
 
 #include <cassert>
+#include <tuple>
 
 namespace photon::rendering {
     forward_renderer::forward_renderer(vulkan_device& device, vulkan_display& display, batch_buffer& shared_batch_buffer, uint32_t max_frames_in_flight) noexcept :
@@ -9,23 +11,28 @@ namespace photon::rendering {
         batcher{shared_batch_buffer},
         max_frames_in_flight{max_frames_in_flight}
     {
-        // create depth buffers
+        // create depth buffers and feedback pass resources
 
         depth_images.resize(max_frames_in_flight);
         depth_views.resize(max_frames_in_flight);
 
+        feedback_extents.resize(max_frames_in_flight);
+        feedback_images.resize(max_frames_in_flight);
+        feedback_views.resize(max_frames_in_flight);
+        feedback_depth_images.resize(max_frames_in_flight);
+        feedback_depth_views.resize(max_frames_in_flight);
+        feedback_buffers.resize(max_frames_in_flight);
+        feedback_mapped_data.resize(max_frames_in_flight);
+        is_feedback_written.resize(max_frames_in_flight, false);
+
         for (uint32_t i = 0; i < max_frames_in_flight; i++) {
             create_frame_resources(i);
         }
     }
 
     forward_renderer::~forward_renderer() noexcept {
-        for (auto view : depth_views) {
-            device.get_device().destroyImageView(view);
-        }
-        
-        for (auto& image : depth_images) {
-            vmaDestroyImage(device.get_allocator(), image.first, image.second);
+        for (uint32_t i = 0; i < max_frames_in_flight; i++) {
+            destroy_frame_resources(i);
         }
     }
 
@@ -42,6 +49,9 @@ namespace photon::rendering {
             cmd = batcher.begin_recording(begin_info);
         }
 
+        // note: recorded once the frame resources were refreshed after enabling the pass
+        if (feedback_buffers[ctx.frame_index].first) record_feedback_pass(cmd, ctx.frame_index);
+
         {
             // transition frame resources
 
@@ -174,31 +184,252 @@ namespace photon::rendering {
         ctx.cmds.emplace_back(cmd);
     }
 
+    std::span<const uint32_t> forward_renderer::get_feedback(uint32_t frame_index) {
+        if (!is_feedback_written[frame_index]) return {};
+
+        // note: no-op for host coherent memory
+        VkResult res = vmaInvalidateAllocation(device.get_allocator(), feedback_buffers[frame_index].second, 0, VK_WHOLE_SIZE);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaInvalidateAllocation");
+
+        return std::span(feedback_mapped_data[frame_index], static_cast<size_t>(feedback_extents[frame_index].width) * feedback_extents[frame_index].height);
+    }
+
+    void forward_renderer::record_feedback_pass(vk::CommandBuffer cmd, uint32_t frame_index) {
+        {
+            // transition feedback attachments (the last copy out of the feedback image finished with the previous frame using it)
+
+            std::array<vk::ImageMemoryBarrier2, 2> resource_barriers;
+
+            resource_barriers[0] = vk::ImageMemoryBarrier2{ /* feedback image */
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                .dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .image = feedback_images[frame_index].first,
+                .subresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            };
+
+            resource_barriers[1] = vk::ImageMemoryBarrier2{ /* feedback depth image */
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests,
+                .dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                .image = feedback_depth_images[frame_index].first,
+                .subresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eDepth,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            };
+
+            vk::DependencyInfo dep_info{
+                .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+                .imageMemoryBarrierCount = resource_barriers.size(),
+                .pImageMemoryBarriers = resource_barriers.data(),
+            };
+
+            cmd.pipelineBarrier2(dep_info);
+
+            // texels without a virtual texture are cleared to no_feedback
+
+            vk::RenderingAttachmentInfo color_info{
+                .imageView = feedback_views[frame_index],
+                .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eClear,
+                .storeOp = vk::AttachmentStoreOp::eStore,
+                .clearValue = {
+                    .color = { .uint32 = std::array<uint32_t, 4>{virtual_texture_cache::no_feedback, 0, 0, 0} }
+                }
+            };
+
+            vk::RenderingAttachmentInfo depth_info{
+                .imageView = feedback_depth_views[frame_index],
+                .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eClear,
+                .storeOp = vk::AttachmentStoreOp::eDontCare,
+                .clearValue = {
+                    .depthStencil = { .depth = 1.f, .stencil = 0 }
+                }
+            };
+
+            vk::RenderingInfo rendering_info{
+                .renderArea = { .extent = feedback_extents[frame_index] },
+                .layerCount = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &color_info,
+                .pDepthAttachment = &depth_info,
+            };
+
+            cmd.beginRendering(rendering_info);
+        }
+
+        // draw the page requests of the photon scene (vt_feedback() of shaders/virtual_texture.glsl with a lod bias of -log2(feedback_divisor))
+        // TODO: like the main pass, until the renderer draws a scene the pass only reports no_feedback
+
+        cmd.endRendering();
+
+        {
+            // copy the requests into the readback buffer, read by the host once the frame finished
+
+            vk::ImageMemoryBarrier2 copy_barrier{
+                .srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                .srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+                .oldLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+                .image = feedback_images[frame_index].first,
+                .subresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            };
+
+            vk::DependencyInfo copy_dep_info{
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers = &copy_barrier,
+            };
+
+            cmd.pipelineBarrier2(copy_dep_info);
+
+            vk::BufferImageCopy region{
+                .bufferOffset = 0,
+                .bufferRowLength = 0, // tightly packed
+                .bufferImageHeight = 0,
+                .imageSubresource{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { feedback_extents[frame_index].width, feedback_extents[frame_index].height, 1 },
+            };
+
+            cmd.copyImageToBuffer(feedback_images[frame_index].first, vk::ImageLayout::eTransferSrcOptimal, feedback_buffers[frame_index].first, region);
+
+            vk::BufferMemoryBarrier2 host_barrier{
+                .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+                .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+                .buffer = feedback_buffers[frame_index].first,
+                .offset = 0,
+                .size = vk::WholeSize,
+            };
+
+            vk::DependencyInfo host_dep_info{
+                .bufferMemoryBarrierCount = 1,
+                .pBufferMemoryBarriers = &host_barrier,
+            };
+
+            cmd.pipelineBarrier2(host_dep_info);
+        }
+
+        is_feedback_written[frame_index] = true;
+    }
+
     void forward_renderer::refresh(uint32_t frame_index) {
         // destroy old frame resources
-
-        device.get_device().destroyImageView(depth_views[frame_index]);
-        vmaDestroyImage(device.get_allocator(), depth_images[frame_index].first, depth_images[frame_index].second);
+        destroy_frame_resources(frame_index);
 
         // create new resources
         create_frame_resources(frame_index);
     }
 
     void forward_renderer::create_frame_resources(uint32_t frame_index) {
-        // depth images
-
         vk::Format depth_format = vk::Format::eD32Sfloat; // TODO: depth format selection
         vk::Extent2D display_extent = display.get_display_extent();
 
+        // depth images
+
+        std::tie(depth_images[frame_index], depth_views[frame_index]) = create_attachment(depth_format, display_extent, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth);
+
+        // feedback pass, the attachments at a fraction of the display resolution and a buffer the requests are copied to
+        // note: the handles stay null while the pass is disabled, destroying them is a no-op
+
+        if (!is_feedback_enabled) return;
+
+        vk::Extent2D feedback_extent{
+            .width = std::max(1U, display_extent.width / feedback_divisor),
+            .height = std::max(1U, display_extent.height / feedback_divisor),
+        };
+
+        std::tie(feedback_images[frame_index], feedback_views[frame_index]) = create_attachment(vk::Format::eR32Uint, feedback_extent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::ImageAspectFlagBits::eColor);
+        std::tie(feedback_depth_images[frame_index], feedback_depth_views[frame_index]) = create_attachment(depth_format, feedback_extent, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth);
+
+        vk::BufferCreateInfo buffer_info{
+            .size = static_cast<VkDeviceSize>(feedback_extent.width) * feedback_extent.height * sizeof(uint32_t),
+            .usage = vk::BufferUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo buffer_alloc_info{
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        VmaAllocationInfo alloc_info;
+        VkBuffer buf;
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &buffer_alloc_info, &buf, &feedback_buffers[frame_index].second, &alloc_info);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        feedback_buffers[frame_index].first = buf;
+        feedback_mapped_data[frame_index] = static_cast<const uint32_t*>(alloc_info.pMappedData);
+        feedback_extents[frame_index] = feedback_extent;
+        is_feedback_written[frame_index] = false;
+    }
+
+    void forward_renderer::destroy_frame_resources(uint32_t frame_index) noexcept {
+        vk::Device vk_device = device.get_device();
+
+        vk_device.destroyImageView(depth_views[frame_index]);
+        vmaDestroyImage(device.get_allocator(), depth_images[frame_index].first, depth_images[frame_index].second);
+
+        vk_device.destroyImageView(feedback_views[frame_index]);
+        vmaDestroyImage(device.get_allocator(), feedback_images[frame_index].first, feedback_images[frame_index].second);
+
+        vk_device.destroyImageView(feedback_depth_views[frame_index]);
+        vmaDestroyImage(device.get_allocator(), feedback_depth_images[frame_index].first, feedback_depth_images[frame_index].second);
+
+        vmaDestroyBuffer(device.get_allocator(), feedback_buffers[frame_index].first, feedback_buffers[frame_index].second);
+
+        // the pass can be disabled since, so the next create_frame_resources() might not replace them
+        feedback_views[frame_index] = nullptr;
+        feedback_images[frame_index] = {};
+        feedback_depth_views[frame_index] = nullptr;
+        feedback_depth_images[frame_index] = {};
+        feedback_buffers[frame_index] = {};
+        feedback_mapped_data[frame_index] = nullptr;
+        is_feedback_written[frame_index] = false;
+    }
+
+    std::pair<std::pair<vk::Image, VmaAllocation>, vk::ImageView> forward_renderer::create_attachment(vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect) {
         vk::ImageCreateInfo image_info{
             .imageType = vk::ImageType::e2D,
-            .format = depth_format,
-            .extent = { display_extent.width, display_extent.height, 1 },
+            .format = format,
+            .extent = { extent.width, extent.height, 1 },
             .mipLevels = 1,
             .arrayLayers = 1,
             .samples = vk::SampleCountFlagBits::e1,
             .tiling = vk::ImageTiling::eOptimal,
-            .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+            .usage = usage,
             .sharingMode = vk::SharingMode::eExclusive,
             .initialLayout = vk::ImageLayout::eUndefined,
         };
@@ -217,9 +448,9 @@ namespace photon::rendering {
         vk::ImageViewCreateInfo view_info{
             .image = image,
             .viewType = vk::ImageViewType::e2D,
-            .format = depth_format,
+            .format = format,
             .subresourceRange = {
-                .aspectMask = vk::ImageAspectFlagBits::eDepth, // | vk::ImageAspectFlagBits::eStencil
+                .aspectMask = aspect,
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
@@ -229,7 +460,6 @@ namespace photon::rendering {
 
         vk::ImageView view = device.get_device().createImageView(view_info);
 
-        depth_images[frame_index] = std::make_pair(image, alloc);
-        depth_views[frame_index] = view;
+        return std::make_pair(std::make_pair(image, alloc), view);
     }
 }
\ No newline at end of file
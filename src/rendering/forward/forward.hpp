@@ -5,6 +5,8 @@
 
 #include <resources/texture.hpp>
 
+#include <span>
+
 namespace photon::rendering {
     struct frame_context {
         std::vector<vk::CommandBuffer>& cmds;
@@ -14,7 +16,7 @@ namespace photon::rendering {
         uint32_t swapchain_image_index;
     };
 
-    // a simple straigthforward forward photon renderer implementation (single-threaded, single-cmd and single-pass)
+    // a simple straigthforward forward photon renderer implementation (single-threaded, single-cmd and single-pass besides the low resolution virtual texture feedback pass)
 
     class forward_renderer {
     public:
@@ -24,11 +26,29 @@ namespace photon::rendering {
         void frame(const frame_context& ctx);
         void refresh(uint32_t frame_index);
 
+        // virtual texture page requests of the last frame rendered with [frame_index] (see virtual_texture_cache::process_feedback()),
+        // only valid once that frame finished, empty if it wasn't rendered yet (or was resized since)
+        std::span<const uint32_t> get_feedback(uint32_t frame_index);
+
+        // the feedback pass renders at 1/[feedback_divisor] of the display resolution
+        static constexpr uint32_t feedback_divisor = 8;
+
+        // the feedback pass (and its readback) is only recorded while enabled, eg. once virtual textures are used,
+        // its resources are created or destroyed by the following refresh() of each frame
+        void set_feedback_enabled(bool is_enabled) noexcept { is_feedback_enabled = is_enabled; }
+
         // query vulkan images and image layouts that will contain rendering outputs (color, depth_stencil, normal, etc.), used by the post-processing stack
         // photon_buffers_layout get_rendering_layout() noexcept;
 
     private:
         void create_frame_resources(uint32_t frame_index);
+        void destroy_frame_resources(uint32_t frame_index) noexcept;
+
+        // renders the page requests of the scene and copies them into the readback buffer of the frame
+        void record_feedback_pass(vk::CommandBuffer cmd, uint32_t frame_index);
+
+        // creates a 2D image of [extent] with a single level and its view
+        std::pair<std::pair<vk::Image, VmaAllocation>, vk::ImageView> create_attachment(vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect);
 
         vulkan_device& device;
         vulkan_display& display;
@@ -37,6 +57,18 @@ namespace photon::rendering {
         std::vector<std::pair<vk::Image, VmaAllocation>> depth_images;
         std::vector<vk::ImageView> depth_views;
 
+        // feedback pass resources, indexed by frame_index
+        std::vector<vk::Extent2D> feedback_extents;
+        std::vector<std::pair<vk::Image, VmaAllocation>> feedback_images;
+        std::vector<vk::ImageView> feedback_views;
+        std::vector<std::pair<vk::Image, VmaAllocation>> feedback_depth_images;
+        std::vector<vk::ImageView> feedback_depth_views;
+
+        std::vector<std::pair<vk::Buffer, VmaAllocation>> feedback_buffers; // host visible readback
+        std::vector<const uint32_t*> feedback_mapped_data;
+        std::vector<bool> is_feedback_written;
+        bool is_feedback_enabled = false;
+
         uint32_t max_frames_in_flight;
     };
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 
 #include <memory>
 #include <limits>
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include <atomic>
 
 namespace photon::rendering {
     // a small helper wrapper around vk::Fence which allows for multiple observants (views)
@@ -13,6 +17,7 @@ namespace photon::rendering {
     // Vulkan timeline semaphores
 
     class multi_fence_view;
+    class multi_fence_promise;
 
     class multi_fence {
     public:
@@ -27,7 +32,7 @@ namespace photon::rendering {
             assert(status() == vk::Result::eSuccess && "Tried to reset a multi_fence without it being signaled");
             
             state->device.get_device().resetFences(state->fence);
-            state->reuse_index++;
+            state->reuse_index.fetch_add(1, std::memory_order_release);
         }
 
         vk::Result status() const { return state->device.get_device().getFenceStatus(state->fence); }
@@ -45,39 +50,105 @@ namespace photon::rendering {
             vk::Fence fence;
             vulkan_device& device;
 
-            uint32_t reuse_index = 0;
+            std::atomic<uint32_t> reuse_index = 0; // note: views can be observed from other threads than the one resetting the fence
         };
 
         std::shared_ptr<fence_state> state;
 
+        friend class multi_fence_view;
+        friend class multi_fence_promise;
+    };
+
+    // a late-bound fence, used when the submission which will finish some work is not known yet (eg. a stream
+    // split across multiple batches), views of the promise report eNotReady until it gets bound to a multi_fence
+
+    class multi_fence_promise {
+    public:
+        multi_fence_promise() : state{std::make_shared<promise_state>()} { }
+        ~multi_fence_promise() noexcept = default;
+
+        // binds the promise to the *current* submission of [fence], must be called at most once
+        void bind(const multi_fence& fence) noexcept {
+            assert(!state->is_bound.load() && "Tried to bind a multi_fence_promise twice");
+
+            state->reuse_index = fence.state->reuse_index.load(std::memory_order_relaxed);
+            state->fence = fence.state;
+
+            state->is_bound.store(true, std::memory_order_release);
+        }
+
+        multi_fence_view view() const noexcept;
+
+    private:
+        struct promise_state {
+            std::shared_ptr<multi_fence::fence_state> fence;
+            uint32_t reuse_index = 0;
+
+            std::atomic<bool> is_bound = false; // guards [fence] and [reuse_index], bind() may be called from a different thread than the views
+        };
+
+        std::shared_ptr<promise_state> state;
+
         friend class multi_fence_view;
     };
 
     class multi_fence_view {
     public:
-        multi_fence_view(std::shared_ptr<multi_fence::fence_state> state) noexcept : state{state}, view_reuse_index{state->reuse_index} { }
+        multi_fence_view(std::shared_ptr<multi_fence::fence_state> state) noexcept : state{state}, view_reuse_index{state->reuse_index.load(std::memory_order_relaxed)} { }
+        multi_fence_view(std::shared_ptr<multi_fence_promise::promise_state> promise) noexcept : state{nullptr}, promise{promise}, view_reuse_index{0} { }
         multi_fence_view() noexcept : state{nullptr}, view_reuse_index{0} { }
         
         ~multi_fence_view() noexcept = default;
 
         vk::Result status() const {
-            if (state->reuse_index > view_reuse_index) return vk::Result::eSuccess;
+            if (promise) {
+                if (!promise->is_bound.load(std::memory_order_acquire)) return vk::Result::eNotReady;
+
+                return status(*promise->fence, promise->reuse_index);
+            }
 
-            return state->device.get_device().getFenceStatus(state->fence);
+            return status(*state, view_reuse_index);
         }
 
+        // note: waiting on a unbound promise view only returns once some other thread binds it (or [timeout] expires)
         vk::Result wait(uint64_t timeout = std::numeric_limits<uint64_t>::max()) const {
-            if (state->reuse_index > view_reuse_index) return vk::Result::eSuccess;
+            if (promise) {
+                auto wait_start = std::chrono::steady_clock::now();
 
-            return state->device.get_device().waitForFences(state->fence, vk::True, timeout);
+                while (!promise->is_bound.load(std::memory_order_acquire)) {
+                    if (static_cast<uint64_t>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - wait_start).count()) >= timeout) return vk::Result::eTimeout;
+                    std::this_thread::yield();
+                }
+
+                return wait(*promise->fence, promise->reuse_index, timeout);
+            }
+
+            return wait(*state, view_reuse_index, timeout);
         }
 
     private:
+        static vk::Result status(multi_fence::fence_state& fence, uint32_t reuse_index) {
+            if (fence.reuse_index.load(std::memory_order_acquire) > reuse_index) return vk::Result::eSuccess;
+
+            return fence.device.get_device().getFenceStatus(fence.fence);
+        }
+
+        static vk::Result wait(multi_fence::fence_state& fence, uint32_t reuse_index, uint64_t timeout) {
+            if (fence.reuse_index.load(std::memory_order_acquire) > reuse_index) return vk::Result::eSuccess;
+
+            return fence.device.get_device().waitForFences(fence.fence, vk::True, timeout);
+        }
+
         std::shared_ptr<multi_fence::fence_state> state;
+        std::shared_ptr<multi_fence_promise::promise_state> promise;
         uint32_t view_reuse_index;
     };
 
     inline multi_fence_view multi_fence::view() const noexcept { 
         return multi_fence_view(state);
     }
+
+    inline multi_fence_view multi_fence_promise::view() const noexcept { 
+        return multi_fence_view(state);
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <core/abort.hpp>
 #include <core/logger.hpp>
+#include <algorithm>
 #include <limits>
 
 namespace photon::rendering {
@@ -27,6 +28,7 @@ namespace photon::rendering {
     inline static vulkan_device create_vk_device(vulkan_instance& instance) noexcept {
         std::vector<std::pair<const char*, bool>> extensions;
         extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME, true);
+        extensions.emplace_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME, false); // texture uploads without staging
         
         vulkan_device::device_config config{
             .instance = instance,
@@ -50,7 +52,33 @@ namespace photon::rendering {
             .min_swapchain_image_count = 3,
         }},
         shared_batch_buffer{vk_device, max_frames_in_flight, false},
-        streamer{vk_device, max_frames_in_flight},
+        streamer{vk_device, max_frames_in_flight, asset_streamer::streamer_config{
+            .staging_ring_size = 64 * 1024 * 1024,
+            .thread_staging_ring_size = 16 * 1024 * 1024,
+            .frame_byte_budget = 16 * 1024 * 1024,
+            .frame_copy_budget = 512,
+            .stream_aging_frames = 30,
+            .use_submit_thread = false,
+            .use_gpu_transcoding = false, // opt-in, bc1/bc7 compresses loaded srgb images at some quality cost
+            .use_gpu_decompression = true,
+        }},
+        atlas{streamer, loader_pool, max_frames_in_flight, texture_atlas::atlas_config{
+            .min_extent = 64,
+            .max_extent = 256,
+            .layers_per_array = 64,
+            .repack_occupancy = .25f,
+            .priority = stream_priority::normal,
+        }},
+        texture_cache{derived_data_cache::cache_config{
+            .path = "cache/textures",
+            .max_size = 2ull * 1024 * 1024 * 1024,
+        }},
+        loader_pool{std::max(2U, std::thread::hardware_concurrency()) - 1}, // leaves a core to the main thread
+        file_reader{async_reader::reader_config{
+            .queue_depth = 64,
+            .fallback_thread_count = 4,
+            .use_io_uring = true,
+        }},
         transforms{vk_device, max_frames_in_flight},
         renderer{vk_device, vk_display, shared_batch_buffer, max_frames_in_flight},
         max_frames_in_flight{max_frames_in_flight}
@@ -96,6 +124,27 @@ namespace photon::rendering {
         }
     }
 
+    virtual_texture_cache& rendering_stack::get_virtual_textures() {
+        if (virtual_textures) return virtual_textures.value();
+
+        // note: the cache costs its whole page array up front, so apps without virtual textures don't create it
+        vk::Format format = virtual_texture_cache::is_format_supported(vk_device, vk::Format::eBc7SrgbBlock) ? vk::Format::eBc7SrgbBlock : vk::Format::eR8G8B8A8Srgb;
+
+        virtual_textures.emplace(streamer, loader_pool, max_frames_in_flight, virtual_texture_cache::cache_config{
+            .format = format,
+            .page_count = 1024,
+            .page_table_capacity = 256 * 1024,
+            .max_pending_pages = 32,
+            .priority = stream_priority::normal,
+        });
+
+        // the feedback resources are created by the refresh of each frame
+        renderer.set_feedback_enabled(true);
+        for (uint32_t i = 0; i < max_frames_in_flight; i++) frame_invalidated[i] = true;
+
+        return virtual_textures.value();
+    }
+
     void rendering_stack::frame() noexcept {
         try {
             // acquire swapchain frame
@@ -121,6 +170,17 @@ namespace photon::rendering {
             vk_device.get_device().resetFences(frame_fences[current_frame_index]);
             shared_batch_buffer.reset_batch(current_frame_index);
 
+            // virtual texture pages requested by the finished frame, missing ones are streamed in and the page table of this frame is updated
+
+            if (virtual_textures) {
+                virtual_textures->process_feedback(renderer.get_feedback(current_frame_index));
+                virtual_textures->update(current_frame_index);
+            }
+
+            // stream loaded atlas textures and repack sparse arrays (the layer moves are recorded below)
+
+            atlas.update(current_frame_index);
+
             // stream writes
 
             vk::Semaphore streamer_finished_sem = streamer.submit_batch((current_frame_index + 1) % max_frames_in_flight);
@@ -140,6 +200,34 @@ namespace photon::rendering {
             // record frame cmds
     
             std::vector<vk::CommandBuffer> cmds;
+
+            if (streamer.has_graphics_commands()) {
+                // acquire streamed resources released by the transfer queue, generate their mips, transcode them and copy image updates
+
+                vk::CommandBufferBeginInfo begin_info{
+                    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                };
+
+                vk::CommandBuffer streamer_cmd = shared_batch_buffer.begin_recording(begin_info);
+                streamer.record_graphics_commands(streamer_cmd, current_frame_index);
+                streamer_cmd.end();
+
+                cmds.emplace_back(streamer_cmd);
+            }
+
+            if (atlas.has_commands()) {
+                // layer moves of repacked atlas arrays, the textures are sampled from their new layers by this frame already
+
+                vk::CommandBufferBeginInfo begin_info{
+                    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                };
+
+                vk::CommandBuffer atlas_cmd = shared_batch_buffer.begin_recording(begin_info);
+                atlas.record_commands(atlas_cmd);
+                atlas_cmd.end();
+
+                cmds.emplace_back(atlas_cmd);
+            }
     
             frame_context frame_ctx{
                 .cmds = cmds,
@@ -157,7 +245,7 @@ namespace photon::rendering {
             // submit frame cmds
     
             vk::Semaphore submit_wait_sems[] = { streamer_finished_sem, frame_acquire_sems[current_frame_index] };
-            vk::PipelineStageFlags submit_wait_stages[] = { vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eFragmentShader };
+            vk::PipelineStageFlags submit_wait_stages[] = { vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eFragmentShader }; // note: top of pipe wouldn't wait for anything
     
             vk::SubmitInfo submit_info{
                 .waitSemaphoreCount = 2,
@@ -181,7 +269,7 @@ namespace photon::rendering {
                 .pImageIndices = &current_image_index,
             };
     
-            res = vk_device.get_queue(false).presentKHR(&present_info);
+            res = vk_device.present(present_info);
     
             if (res == vk::Result::eSuboptimalKHR | res == vk::Result::eErrorOutOfDateKHR) {
                 vk_display.refresh_swapchain(std::nullopt);
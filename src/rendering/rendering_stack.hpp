@@ -8,7 +8,13 @@
 
 #include "transform_buffers.hpp"
 #include <resources/streamer.hpp>
+#include <resources/virtual_texture.hpp>
+#include <resources/texture_atlas.hpp>
+#include <core/worker_pool.hpp>
+#include <core/async_reader.hpp>
+#include <core/derived_data_cache.hpp>
 
+#include <optional>
 #include <vector>
 
 namespace photon::rendering {
@@ -20,6 +26,13 @@ namespace photon::rendering {
         void frame() noexcept;
 
         transform_buffers& get_tranform_buffers() noexcept { return transforms; }
+        asset_streamer& get_streamer() noexcept { return streamer; }
+        worker_pool& get_loader_pool() noexcept { return loader_pool; } // for texture::load_file_async()
+        async_reader& get_file_reader() noexcept { return file_reader; } // for texture::load_file_async() without blocking loader threads on reads
+        derived_data_cache& get_texture_cache() noexcept { return texture_cache; } // for texture::load_file(), decoded source images of earlier launches
+        // creates the page cache (and enables the feedback pass of the renderer) on first use, in bc7 if the device supports it, rgba8 otherwise
+        virtual_texture_cache& get_virtual_textures();
+        texture_atlas& get_texture_atlas() noexcept { return atlas; } // for small textures
 
     private:
         window& target_window;
@@ -30,6 +43,11 @@ namespace photon::rendering {
 
         batch_buffer shared_batch_buffer;
         asset_streamer streamer;
+        std::optional<virtual_texture_cache> virtual_textures; // note: declared before the loader pool, which finishes the page loads before the cache is destroyed
+        texture_atlas atlas;
+        derived_data_cache texture_cache; // used by loads on the loader pool, so it outlives the pool
+        worker_pool loader_pool; // note: declared after the streamer, so loads still running finish before it's destroyed
+        async_reader file_reader; // note: declared after the loader pool, reads still in flight hand their decodes over to it
 
         transform_buffers transforms;
 
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <optional>
+#include <atomic>
 
 #include <cassert>
 
@@ -53,4 +54,57 @@ namespace photon::rendering {
 
         index_t pool_size;
     };
+
+    // a lock-free multi-producer single-consumer queue, producers push onto a intrusive (Treiber) stack
+    // and the consumer takes the whole stack at once, reversing it back to push order
+    
+    template<typename value_t>
+    class mpsc_queue {
+    public:
+        mpsc_queue() noexcept = default;
+        ~mpsc_queue() noexcept {
+            drain([](value_t&&) { });
+        }
+
+        mpsc_queue(const mpsc_queue&) = delete;
+        mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+        // can be called from any thread
+        void push(value_t value) {
+            queue_node* node = new queue_node{ std::move(value), queue_head.load(std::memory_order_relaxed) };
+
+            while (!queue_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+        }
+
+        // pops all queued values and forwards them to [consume] (in push order for each producer), must be called from a single thread only
+        template<typename consume_t>
+        void drain(consume_t&& consume) {
+            queue_node* node = queue_head.exchange(nullptr, std::memory_order_acquire);
+            queue_node* reversed = nullptr;
+
+            while (node) {
+                queue_node* next = node->next;
+                node->next = reversed;
+                reversed = node;
+                node = next;
+            }
+
+            while (reversed) {
+                queue_node* next = reversed->next;
+
+                consume(std::move(reversed->value));
+                delete reversed;
+
+                reversed = next;
+            }
+        }
+
+    private:
+        struct queue_node {
+            value_t value;
+            queue_node* next;
+        };
+
+        std::atomic<queue_node*> queue_head = nullptr;
+    };
 }
\ No newline at end of file
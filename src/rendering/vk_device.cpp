@@ -3,6 +3,7 @@
 #include <core/abort.hpp>
 #include <core/logger.hpp>
 #include <span>
+#include <algorithm>
 
 namespace photon::rendering {
     vulkan_device::vulkan_device(const device_config& config) noexcept :
@@ -49,12 +50,14 @@ namespace photon::rendering {
                     
                     queue_infos[0] = main_queue.value();
                     graphics_queue_family_index = queue_infos[0].queueFamilyIndex;
+                    graphics_transfer_granularity = queue_families[graphics_queue_family_index].queueFamilyProperties.minImageTransferGranularity;
 
                     auto transfer_queue = get_queue_info(queue_families, queue_priorities.data(), vk::QueueFlagBits::eTransfer, vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute);
 
                     if (transfer_queue) {
                         queue_infos[1] = transfer_queue.value();
                         transfer_queue_family_index = queue_infos[1].queueFamilyIndex;
+                        transfer_transfer_granularity = queue_families[transfer_queue_family_index].queueFamilyProperties.minImageTransferGranularity;
 
                         P_LOG_D("Using a second Vulkan transfer queue!");
                     } else {
@@ -69,7 +72,12 @@ namespace photon::rendering {
                 std::vector<const char*> extensions = enable_extensions(config);
                 active_extensions.insert(extensions.begin(), extensions.end());
 
-                vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan13Features> device_info{
+                if (has_extension(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+                    auto supported_features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostImageCopyFeaturesEXT>();
+                    is_host_image_copy_enabled = supported_features.get<vk::PhysicalDeviceHostImageCopyFeaturesEXT>().hostImageCopy;
+                }
+
+                vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceHostImageCopyFeaturesEXT> device_info{
                     vk::DeviceCreateInfo {
                         .queueCreateInfoCount = queue_infos.size(),
                         .pQueueCreateInfos = queue_infos.data(),
@@ -81,8 +89,32 @@ namespace photon::rendering {
                         .synchronization2 = vk::True,
                         .dynamicRendering = vk::True,
                     },
+                    vk::PhysicalDeviceHostImageCopyFeaturesEXT{
+                        .hostImageCopy = vk::True,
+                    },
                 };
 
+                if (is_host_image_copy_enabled) {
+                    // query the layouts which can be used as host copy destinations
+
+                    auto props = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceHostImageCopyPropertiesEXT>();
+                    host_image_copy_dst_layouts.resize(props.get<vk::PhysicalDeviceHostImageCopyPropertiesEXT>().copyDstLayoutCount);
+
+                    vk::StructureChain<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceHostImageCopyPropertiesEXT> layout_props{
+                        vk::PhysicalDeviceProperties2{},
+                        vk::PhysicalDeviceHostImageCopyPropertiesEXT{
+                            .copyDstLayoutCount = static_cast<uint32_t>(host_image_copy_dst_layouts.size()),
+                            .pCopyDstLayouts = host_image_copy_dst_layouts.data(),
+                        },
+                    };
+
+                    physical_device.getProperties2(&layout_props.get<vk::PhysicalDeviceProperties2>());
+
+                    P_LOG_D("Using VK_EXT_host_image_copy for texture uploads");
+                } else {
+                    device_info.unlink<vk::PhysicalDeviceHostImageCopyFeaturesEXT>();
+                }
+
                 device = physical_device.createDevice(device_info.get<vk::DeviceCreateInfo>());
 
                 // query allocated queues from device 
@@ -140,6 +172,19 @@ namespace photon::rendering {
 
                 VkResult res = vmaCreateAllocator(&allocator_info, &allocator);
                 vk::resultCheck(static_cast<vk::Result>(res), "Failed to create a VMA allocator");
+
+                // detect UMA / resizable BAR
+
+                const VkPhysicalDeviceMemoryProperties* memory_properties;
+                vmaGetMemoryProperties(allocator, &memory_properties);
+
+                constexpr VkMemoryPropertyFlags host_visible_device_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+                for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+                    if ((memory_properties->memoryTypes[i].propertyFlags & host_visible_device_flags) == host_visible_device_flags) {
+                        is_device_memory_host_visible = true;
+                    }
+                }
             }
 
         } catch (std::exception& e) {
@@ -155,13 +200,30 @@ namespace photon::rendering {
 
     void vulkan_device::submit(std::span<vk::SubmitInfo> submit_infos, vk::Fence fence, bool is_transfer) {
         if (is_transfer && transfer_queue) {
+            std::lock_guard<std::mutex> l(transfer_queue_lock);
+
             transfer_queue.submit(submit_infos, fence);
             return;
         }
 
+        std::lock_guard<std::mutex> l(graphics_queue_lock);
         graphics_queue.submit(submit_infos, fence);
     }
 
+    vk::Result vulkan_device::present(const vk::PresentInfoKHR& present_info) {
+        std::lock_guard<std::mutex> l(graphics_queue_lock);
+
+        return graphics_queue.presentKHR(&present_info);
+    }
+
+    bool vulkan_device::is_host_image_copy_supported(vk::Format format, vk::ImageLayout layout) noexcept {
+        if (!is_host_image_copy_enabled) return false;
+        if (std::find(host_image_copy_dst_layouts.begin(), host_image_copy_dst_layouts.end(), layout) == host_image_copy_dst_layouts.end()) return false;
+
+        auto format_props = physical_device.getFormatProperties2<vk::FormatProperties2, vk::FormatProperties3>(format);
+        return static_cast<bool>(format_props.get<vk::FormatProperties3>().optimalTilingFeatures & vk::FormatFeatureFlagBits2::eHostImageTransferEXT);
+    }
+
     bool vulkan_device::is_physical_device_suitable(vk::PhysicalDevice device, const device_config& config) noexcept {
         return true; // assume always capable (allow the user to reorder devices if wanted)
     }
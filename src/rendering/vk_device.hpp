@@ -5,6 +5,7 @@
 
 #include <optional>
 #include <span>
+#include <mutex>
 
 namespace photon::rendering {
     // a monolith class containing a Vulkan physical/logical device and its queues
@@ -30,13 +31,23 @@ namespace photon::rendering {
         VmaAllocator get_allocator() noexcept { return allocator; }
 
         // [is_transfer] controls if should be submited to the transfer queue (if available)
-        // note: fence is optional according to vulkan spec
+        // note: fence is optional according to vulkan spec, submits are internally synchronized and can be called from any thread
         void submit(std::span<vk::SubmitInfo> submit_infos, vk::Fence fence, bool is_transfer = false);
+        vk::Result present(const vk::PresentInfoKHR& present_info);
     
         // note: only the VK_ prefixed name marcos must be used as the pointers are used for the lookup
         bool has_extension(const char* name) const noexcept { return active_extensions.contains(name); }
         uint32_t get_queue_family(bool is_transfer) const noexcept { return is_transfer && transfer_queue ? transfer_queue_family_index : graphics_queue_family_index; }
 
+        // note: a zero extent means only whole mip levels can be copied on that queue
+        vk::Extent3D get_image_transfer_granularity(bool is_transfer) const noexcept { return is_transfer && transfer_queue ? transfer_transfer_granularity : graphics_transfer_granularity; }
+
+        // true if some device local memory type is also host visible (UMA or resizable BAR), allowing uploads without staging
+        bool has_host_visible_device_memory() const noexcept { return is_device_memory_host_visible; }
+
+        // true if images of [format] (optimal tiling) can be copied to from the host and transitioned to [layout] on the host (VK_EXT_host_image_copy)
+        bool is_host_image_copy_supported(vk::Format format, vk::ImageLayout layout) noexcept;
+
     private:
         static bool is_physical_device_suitable(vk::PhysicalDevice device, const device_config& config) noexcept;
         
@@ -49,6 +60,9 @@ namespace photon::rendering {
 
         vk::Queue graphics_queue; // will also support present
         vk::Queue transfer_queue = {}; // note: will be the null if no special transfer queue family is supported
+
+        std::mutex graphics_queue_lock;
+        std::mutex transfer_queue_lock;
         
         vulkan_instance& instance;
         vk::PhysicalDevice physical_device;
@@ -58,5 +72,13 @@ namespace photon::rendering {
 
         uint32_t graphics_queue_family_index = ~0U;
         uint32_t transfer_queue_family_index = ~0U; // note: same as [transfer_queue], will be ~0U if not supported
+
+        vk::Extent3D graphics_transfer_granularity;
+        vk::Extent3D transfer_transfer_granularity;
+
+        bool is_device_memory_host_visible = false;
+
+        bool is_host_image_copy_enabled = false;
+        std::vector<vk::ImageLayout> host_image_copy_dst_layouts;
     };
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "asset_pack.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <bit>
+
+namespace photon {
+    asset_pack::asset_pack(mapped_file&& mapped, std::string pack_path) noexcept :
+        file{std::move(mapped)},
+        path{std::move(pack_path)}
+    {
+        const std::byte* data = file.get_data().data();
+
+        header = reinterpret_cast<const pack::header*>(data);
+        entries = reinterpret_cast<const pack::entry*>(data + header->toc_offset);
+        index = reinterpret_cast<const uint32_t*>(data + header->index_offset);
+        names = reinterpret_cast<const char*>(data + header->names_offset);
+    }
+
+    std::optional<asset_pack> asset_pack::open(const std::string& path) noexcept {
+        std::optional<mapped_file> file = mapped_file::map(path);
+        if (!file) return std::nullopt;
+
+        // the table of contents is used in place, only the bounds of its sections and of the payloads and names are checked
+
+        std::span<const std::byte> data = file->get_data();
+        const pack::header* header = reinterpret_cast<const pack::header*>(data.data());
+
+        if (data.size() < sizeof(pack::header) || header->magic != pack::magic || header->version != pack::version) {
+            P_LOG_E("Invalid asset pack header! ({})", path);
+            return std::nullopt;
+        }
+
+        uint64_t toc_end = header->toc_offset + header->toc_size;
+        uint64_t index_end = header->index_offset + static_cast<uint64_t>(header->index_size) * sizeof(uint32_t);
+
+        if (toc_end > data.size() || header->toc_offset % pack::page_size != 0 || !std::has_single_bit(header->index_size) ||
+            header->index_size < header->entry_count || header->toc_offset + header->entry_count * sizeof(pack::entry) > header->index_offset ||
+            index_end > header->names_offset || header->names_offset > toc_end) {
+            P_LOG_E("Invalid asset pack table of contents! ({})", path);
+            return std::nullopt;
+        }
+
+        const pack::entry* entries = reinterpret_cast<const pack::entry*>(data.data() + header->toc_offset);
+        uint64_t names_size = toc_end - header->names_offset;
+
+        for (uint32_t id = 0; id < header->entry_count; id++) {
+            const pack::entry& entry = entries[id];
+
+            bool is_stored_size_valid = entry.compression == pack::compression_type::lz_chunks || (entry.compression == pack::compression_type::none && entry.stored_size == entry.size);
+
+            if (entry.offset > data.size() || entry.stored_size > data.size() - entry.offset || !is_stored_size_valid ||
+                static_cast<uint64_t>(entry.name_offset) + entry.name_length > names_size) {
+                P_LOG_E("Invalid asset pack entry {}! ({})", id, path);
+                return std::nullopt;
+            }
+        }
+
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(data.data() + header->index_offset);
+        uint32_t empty_slots = 0; // probes end at empty slots, so there has to be one
+        bool has_invalid_slot = false;
+
+        for (uint32_t slot = 0; slot < header->index_size; slot++) {
+            if (index[slot] == pack::no_entry) empty_slots++;
+            else has_invalid_slot |= index[slot] >= header->entry_count;
+        }
+
+        if (empty_slots == 0 || has_invalid_slot) {
+            P_LOG_E("Invalid asset pack name index! ({})", path);
+            return std::nullopt;
+        }
+
+        return asset_pack(std::move(file.value()), path);
+    }
+
+    asset_pack::entry_id asset_pack::find(std::string_view name) const noexcept {
+        uint64_t hash = pack::hash_name(name);
+        uint32_t mask = header->index_size - 1;
+
+        // the index always has empty slots, so the probe ends
+        for (uint32_t slot = static_cast<uint32_t>(hash) & mask;; slot = (slot + 1) & mask) {
+            entry_id id = index[slot];
+            if (id == no_entry) return no_entry;
+
+            if (entries[id].name_hash == hash && get_name(id) == name) return id;
+        }
+    }
+
+    std::string_view asset_pack::get_name(entry_id id) const noexcept {
+        return { names + entries[id].name_offset, entries[id].name_length };
+    }
+
+    std::span<const std::byte> asset_pack::get_data(entry_id id) const noexcept {
+        return file.get_data().subspan(entries[id].offset, entries[id].stored_size);
+    }
+
+    void asset_pack::read(entry_id id, uint64_t offset, std::span<std::byte> dst, worker_pool* pool) const noexcept {
+        if (!pack::read_payload(entries[id], get_data(id), offset, dst, pool)) {
+            P_LOG_E("Malformed asset pack payload! ({} in {})", get_name(id), path);
+            engine_abort();
+        }
+    }
+
+    texture_container asset_pack::get_texture_container(entry_id id) const noexcept {
+        const pack::texture_info& info = entries[id].texture;
+
+        return texture_container{
+            .format = static_cast<VkFormat>(info.format),
+            .dimension_count = info.dimension_count,
+            .width = info.width,
+            .height = info.height,
+            .depth = info.depth,
+            .layer_count = info.layer_count,
+            .face_count = info.face_count,
+            .level_count = info.level_count,
+            .generate_levels = info.generate_levels != 0,
+            .is_layer_major = info.is_layer_major != 0,
+            .data_offset = 0,
+        };
+    }
+
+    rendering::multi_fence_view asset_pack::stream_buffer(rendering::asset_streamer& streamer, entry_id id, const rendering::asset_streamer::buffer_stream_info& stream, rendering::stream_priority priority, worker_pool* pool) const noexcept {
+        const pack::entry& entry = entries[id];
+
+        if (entry.compression == pack::compression_type::lz_chunks && streamer.is_decompression_supported()) {
+            return streamer.stream_compressed(stream, { .stored = get_data(id), .payload_size = entry.size, .offset = 0 }, entry.size, priority);
+        }
+
+        rendering::asset_streamer::pending_stream pending = streamer.begin_stream(stream, entries[id].size, priority);
+
+        // note: the pages of the payload are read from disk by the copy (or decompression) into staging
+        read(id, 0, pending.get_data(), pool);
+
+        return streamer.commit_stream(std::move(pending));
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "streamer.hpp"
+#include "asset_pack_format.hpp"
+#include "texture_container.hpp"
+#include <core/mapped_file.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace photon {
+    // runtime side of an asset pack (see asset_pack_format.hpp), the mapping and the table of contents are shared by all loads
+
+    class asset_pack {
+    public:
+        using entry_id = uint32_t;
+
+        static constexpr entry_id no_entry = pack::no_entry;
+
+        // maps the pack and checks its header, returns nullopt (and logs the reason) if it can't be opened or isn't a valid pack
+        static std::optional<asset_pack> open(const std::string& path) noexcept;
+
+        // O(1) lookup through the name index, no_entry if the pack doesn't contain [name]
+        entry_id find(std::string_view name) const noexcept;
+
+        const pack::entry& get_entry(entry_id id) const noexcept { return entries[id]; }
+        std::string_view get_name(entry_id id) const noexcept;
+        uint32_t get_entry_count() const noexcept { return header->entry_count; }
+
+        // the stored payload inside the mapping (the chunks and their offsets if it's compressed), valid as long as the pack
+        std::span<const std::byte> get_data(entry_id id) const noexcept;
+
+        // copies or decompresses the uncompressed range at [offset] of the payload into [dst] (see pack::read_payload()),
+        // aborts if the payload is malformed
+        void read(entry_id id, uint64_t offset, std::span<std::byte> dst, worker_pool* pool = nullptr) const noexcept;
+
+        // the container description of a texture entry (without level ranges, the payload is packed for streaming)
+        texture_container get_texture_container(entry_id id) const noexcept;
+
+        // streams a payload into a buffer, the data is copied (or decompressed on [pool]) from the mapping into staging memory without an intermediate copy,
+        // compressed payloads are staged as stored and decompressed on the gpu if the streamer supports it
+        rendering::multi_fence_view stream_buffer(rendering::asset_streamer& streamer, entry_id id, const rendering::asset_streamer::buffer_stream_info& stream, rendering::stream_priority priority, worker_pool* pool = nullptr) const noexcept;
+
+        const std::string& get_path() const noexcept { return path; }
+
+    private:
+        asset_pack(mapped_file&& file, std::string path) noexcept;
+
+        mapped_file file;
+        std::string path;
+
+        // point into [file]
+        const pack::header* header;
+        const pack::entry* entries;
+        const uint32_t* index;
+        const char* names;
+    };
+}
@@ -0,0 +1,133 @@
+#include "asset_pack_format.hpp"
+#include <lz4.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace photon::pack {
+    // note: chunks are at most chunk_size, so their sizes always fit the int sizes of the lz4 api
+
+    // returns false if [src] is malformed or doesn't decompress to exactly [dst.size()] bytes
+    static bool decompress_chunk(std::span<const std::byte> src, std::span<std::byte> dst) noexcept {
+        int size = LZ4_decompress_safe(reinterpret_cast<const char*>(src.data()), reinterpret_cast<char*>(dst.data()), static_cast<int>(src.size()), static_cast<int>(dst.size()));
+        return size >= 0 && static_cast<size_t>(size) == dst.size();
+    }
+
+    std::optional<std::vector<std::byte>> compress_payload(std::span<const std::byte> payload, worker_pool& pool) {
+        uint64_t chunk_count = get_chunk_count(payload.size());
+        if (chunk_count == 0) return std::nullopt;
+
+        // every chunk is compressed into its own buffer, chunks which don't shrink are stored as is
+
+        std::vector<std::vector<std::byte>> chunks(chunk_count);
+
+        pool.parallel_for(chunk_count, [&](size_t chunk) {
+            std::span<const std::byte> src = payload.subspan(chunk * chunk_size, std::min<uint64_t>(chunk_size, payload.size() - chunk * chunk_size));
+
+            std::vector<std::byte>& dst = chunks[chunk];
+            dst.resize(LZ4_compressBound(static_cast<int>(src.size())));
+
+            int size = LZ4_compress_default(reinterpret_cast<const char*>(src.data()), reinterpret_cast<char*>(dst.data()), static_cast<int>(src.size()), static_cast<int>(dst.size()));
+
+            if (size <= 0 || static_cast<size_t>(size) >= src.size()) {
+                dst.assign(src.begin(), src.end());
+            } else {
+                dst.resize(size);
+            }
+        });
+
+        uint64_t table_size = (chunk_count + 1) * sizeof(uint64_t);
+        uint64_t stored_size = table_size;
+
+        for (const std::vector<std::byte>& chunk : chunks) stored_size += chunk.size();
+
+        if (stored_size >= payload.size()) return std::nullopt;
+
+        std::vector<std::byte> stored(stored_size);
+        uint64_t offset = table_size;
+
+        for (uint64_t chunk = 0; chunk <= chunk_count; chunk++) {
+            std::memcpy(stored.data() + chunk * sizeof(uint64_t), &offset, sizeof(uint64_t));
+            if (chunk == chunk_count) break;
+
+            std::memcpy(stored.data() + offset, chunks[chunk].data(), chunks[chunk].size());
+            offset += chunks[chunk].size();
+        }
+
+        return stored;
+    }
+
+    bool read_payload(const entry& entry, std::span<const std::byte> stored, uint64_t offset, std::span<std::byte> dst, worker_pool* pool) noexcept {
+        if (offset > entry.size || dst.size() > entry.size - offset) return false;
+
+        if (entry.compression == compression_type::none) {
+            std::memcpy(dst.data(), stored.data() + offset, dst.size());
+            return true;
+        }
+
+        if (dst.empty()) return true;
+
+        uint64_t chunk_count = get_chunk_count(entry.size);
+        if (stored.size() < (chunk_count + 1) * sizeof(uint64_t)) return false;
+
+        uint64_t first_chunk = offset / chunk_size;
+        uint64_t last_chunk = (offset + dst.size() - 1) / chunk_size;
+
+        std::atomic<bool> is_valid = true;
+
+        auto read_chunk = [&](size_t index) {
+            uint64_t chunk = first_chunk + index;
+
+            uint64_t begin, end;
+            std::memcpy(&begin, stored.data() + chunk * sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&end, stored.data() + (chunk + 1) * sizeof(uint64_t), sizeof(uint64_t));
+
+            if (begin > end || end > stored.size()) {
+                is_valid.store(false, std::memory_order_relaxed);
+                return;
+            }
+
+            std::span<const std::byte> src = stored.subspan(begin, end - begin);
+
+            // the part of the chunk inside the read range
+            uint64_t chunk_begin = chunk * chunk_size;
+            uint64_t chunk_length = std::min(chunk_size, entry.size - chunk_begin);
+            uint64_t copy_begin = std::max(chunk_begin, offset);
+            uint64_t copy_end = std::min(chunk_begin + chunk_length, offset + dst.size());
+
+            std::span<std::byte> out = dst.subspan(copy_begin - offset, copy_end - copy_begin);
+
+            if (src.size() == chunk_length) {
+                std::memcpy(out.data(), src.data() + (copy_begin - chunk_begin), out.size());
+                return;
+            }
+
+            bool is_decoded;
+
+            if (out.size() == chunk_length) {
+                // whole chunks are decompressed straight into the destination (usually staging memory)
+                is_decoded = decompress_chunk(src, out);
+            } else {
+                // only the first and the last chunk of a range can be partial
+                thread_local std::vector<std::byte> chunk_data;
+                chunk_data.resize(chunk_length);
+
+                is_decoded = decompress_chunk(src, chunk_data);
+                if (is_decoded) std::memcpy(out.data(), chunk_data.data() + (copy_begin - chunk_begin), out.size());
+            }
+
+            if (!is_decoded) is_valid.store(false, std::memory_order_relaxed);
+        };
+
+        size_t read_count = static_cast<size_t>(last_chunk - first_chunk + 1);
+
+        if (pool && read_count > 1) {
+            pool->parallel_for(read_count, read_chunk);
+        } else {
+            for (size_t index = 0; index < read_count; index++) read_chunk(index);
+        }
+
+        return is_valid.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <core/hash.hpp>
+#include <core/worker_pool.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace photon {
+    // asset packs bundle many assets into one file which is memory mapped at runtime, the table of contents is used in place
+    // (no parsing), names resolve through a hash index and payloads are copied from the mapping straight into staging memory
+
+    // layout (the table of contents and every payload start on a [pack::page_size] boundary, all fields little endian):
+    // header - in the first page
+    // table of contents - entries, then the name index (open addressing, linear probing), then the names (not null terminated)
+    // payloads - one per entry, see pack::entry_type for their contents, optionally compressed in chunks (see pack::compression_type)
+
+    // note: packs are written by photon-pack (see cook/pack_writer.hpp)
+
+    namespace pack {
+        constexpr uint32_t magic = 0x4B415050; // "PPAK"
+        constexpr uint32_t version = 2;
+        constexpr uint64_t page_size = 4096;
+
+        // uncompressed size of the chunks of compressed payloads (the last one can be shorter), chunks are decompressed independently
+        constexpr uint64_t chunk_size = 64 * 1024;
+
+        constexpr uint32_t no_entry = std::numeric_limits<uint32_t>::max(); // empty name index slot
+
+        inline uint64_t align_to_page(uint64_t offset) noexcept {
+            return (offset + page_size - 1) / page_size * page_size;
+        }
+
+        enum class entry_type : uint32_t {
+            raw = 0, // the file as is (eg. source images decoded by texture::load_packed(), buffer data)
+            texture = 1, // texel data of a ktx2 or dds file, packed as described by asset_streamer::stream() (per layer if [is_layer_major])
+        };
+
+        enum class compression_type : uint32_t {
+            none = 0,
+
+            // the payload starts with the offsets of the chunks (relative to the payload) followed by the end of the last one (chunk count + 1 uint64s),
+            // every chunk is an lz4 block (ext/lz4) unless its stored size equals its uncompressed size
+            lz_chunks = 1,
+        };
+
+        // what texture::load_container() reads from the container header, filled in by the writer
+        struct texture_info {
+            uint32_t format; // VkFormat
+            uint32_t dimension_count;
+            uint32_t width, height, depth;
+            uint32_t layer_count;
+            uint32_t face_count;
+            uint32_t level_count; // stored levels
+            uint32_t generate_levels;
+            uint32_t is_layer_major; // dds, every layer (or face) is followed by its levels, otherwise every level holds all layers
+        };
+
+        struct header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t entry_count;
+            uint32_t index_size; // slots of the name index, a power of two
+
+            uint64_t toc_offset;
+            uint64_t toc_size;
+            uint64_t index_offset; // absolute
+            uint64_t names_offset; // absolute
+        };
+
+        struct entry {
+            uint64_t name_hash; // hash64() of the name
+            uint64_t offset; // of the payload, page aligned
+            uint64_t size; // uncompressed
+            uint64_t stored_size; // in the pack
+
+            uint32_t name_offset; // relative to [names_offset]
+            uint32_t name_length;
+
+            entry_type type;
+            compression_type compression;
+
+            texture_info texture; // only for entry_type::texture
+        };
+
+        static_assert(sizeof(header) == 48 && sizeof(texture_info) == 40 && sizeof(entry) == 88);
+
+        inline uint64_t get_chunk_count(uint64_t size) noexcept {
+            return (size + chunk_size - 1) / chunk_size;
+        }
+
+        // compresses a payload in chunks (in parallel on [pool]), returns nullopt if that doesn't make it smaller
+        std::optional<std::vector<std::byte>> compress_payload(std::span<const std::byte> payload, worker_pool& pool);
+
+        // reads [dst.size()] bytes at the uncompressed [offset] of the payload stored in [stored] into [dst], the chunks overlapping the range are
+        // decompressed straight into [dst] (in parallel if [pool] is given), returns false if the stored chunks are malformed
+        bool read_payload(const entry& entry, std::span<const std::byte> stored, uint64_t offset, std::span<std::byte> dst, worker_pool* pool) noexcept;
+
+        // names are paths relative to the packed directory with '/' separators
+        inline uint64_t hash_name(std::string_view name) noexcept {
+            return hash64(name.data(), name.size());
+        }
+    }
+}
@@ -0,0 +1,217 @@
+#include "dynamic_texture.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace photon {
+    // rects are merged if their bounding box is at most this much larger than both of them, a little extra data beats another copy
+    static constexpr float merge_slack = 1.25f;
+
+    dynamic_texture::dynamic_texture(rendering::asset_streamer& streamer, const dynamic_config& config) noexcept :
+        tex{streamer},
+        config{config},
+        block_extent{vk::blockExtent(config.format)},
+        block_size{vk::blockSize(config.format)}
+    {
+        constexpr vk::FormatFeatureFlags required_features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eTransferDst;
+
+        if ((streamer.get_device().get_physical_device().getFormatProperties(config.format).optimalTilingFeatures & required_features) != required_features) {
+            P_LOG_E("Dynamic texture format {} is not supported by the device!", vk::to_string(config.format));
+            engine_abort();
+        }
+
+        // host copy, packed like a stream of all levels and layers
+
+        VkDeviceSize size = 0;
+
+        for (uint32_t level = 0; level < config.level_count; level++) {
+            uint32_t width = std::max(1U, config.width >> level);
+            uint32_t height = std::max(1U, config.height >> level);
+
+            level_layout& layout = levels.emplace_back(level_layout{
+                .width = width,
+                .height = height,
+                .row_size = static_cast<VkDeviceSize>((width + block_extent[0] - 1) / block_extent[0]) * block_size,
+                .row_count = (height + block_extent[1] - 1) / block_extent[1],
+                .offset = size,
+            });
+
+            size += layout.row_size * layout.row_count * config.layer_count;
+        }
+
+        texels.resize(size);
+        dirty_rects.resize(static_cast<size_t>(config.level_count) * config.layer_count);
+
+        vk::ImageCreateInfo image_info{
+            .imageType = vk::ImageType::e2D,
+            .format = config.format,
+            .extent = { config.width, config.height, 1 },
+            .mipLevels = config.level_count,
+            .arrayLayers = config.layer_count,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        vk::ImageViewCreateInfo view_info{
+            .viewType = config.layer_count > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D,
+            .format = config.format,
+            .subresourceRange{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = config.level_count,
+                .baseArrayLayer = 0,
+                .layerCount = config.layer_count,
+            },
+        };
+
+        try {
+            tex.create(image_info, vk::ImageLayout::eShaderReadOnlyOptimal, alloc_info, view_info);
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to create a dynamic texture: {}", e.what());
+            engine_abort();
+        }
+
+        // the only whole image stream, every later change is an update of its dirty rects
+
+        tex.stream(texels.data(), texels.size(), {
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = config.layer_count,
+        }, config.level_count, 0, config.priority);
+    }
+
+    std::span<std::byte> dynamic_texture::get_texels(uint32_t level, uint32_t layer) noexcept {
+        const level_layout& layout = levels[level];
+        VkDeviceSize layer_size = layout.row_size * layout.row_count;
+
+        return std::span(texels).subspan(layout.offset + layer * layer_size, layer_size);
+    }
+
+    void dynamic_texture::write(uint32_t level, uint32_t layer, vk::Offset2D offset, vk::Extent2D extent, const void* data) {
+        const level_layout& layout = levels[level];
+
+        bool is_aligned = offset.x % block_extent[0] == 0 && offset.y % block_extent[1] == 0 &&
+            (extent.width % block_extent[0] == 0 || offset.x + extent.width == layout.width) &&
+            (extent.height % block_extent[1] == 0 || offset.y + extent.height == layout.height);
+
+        if (offset.x < 0 || offset.y < 0 || offset.x + extent.width > layout.width || offset.y + extent.height > layout.height || !is_aligned) {
+            P_LOG_E("Invalid dynamic texture write! (offset: {}x{} extent: {}x{} level: {})", offset.x, offset.y, extent.width, extent.height, level);
+            engine_abort();
+        }
+
+        // copy the block rows of the region into the rows of the subresource
+
+        std::span<std::byte> dst = get_texels(level, layer);
+
+        VkDeviceSize src_row_size = static_cast<VkDeviceSize>((extent.width + block_extent[0] - 1) / block_extent[0]) * block_size;
+        VkDeviceSize dst_x = static_cast<VkDeviceSize>(offset.x / block_extent[0]) * block_size;
+        uint32_t dst_y = offset.y / block_extent[1];
+        uint32_t row_count = (extent.height + block_extent[1] - 1) / block_extent[1];
+
+        for (uint32_t row = 0; row < row_count; row++) {
+            std::memcpy(dst.data() + (dst_y + row) * layout.row_size + dst_x, static_cast<const std::byte*>(data) + row * src_row_size, src_row_size);
+        }
+
+        mark_dirty(level, layer, offset, extent);
+    }
+
+    void dynamic_texture::mark_dirty(uint32_t level, uint32_t layer, vk::Offset2D offset, vk::Extent2D extent) noexcept {
+        const level_layout& layout = levels[level];
+
+        // grow to whole texel blocks, the level edge is the only place where partial blocks can be copied
+
+        uint32_t x0 = std::max(offset.x, 0) / block_extent[0] * block_extent[0];
+        uint32_t y0 = std::max(offset.y, 0) / block_extent[1] * block_extent[1];
+        uint32_t x1 = std::min((offset.x + extent.width + block_extent[0] - 1) / block_extent[0] * block_extent[0], layout.width);
+        uint32_t y1 = std::min((offset.y + extent.height + block_extent[1] - 1) / block_extent[1] * block_extent[1], layout.height);
+
+        if (x0 >= x1 || y0 >= y1) return;
+
+        dirty_rects[static_cast<size_t>(level) * config.layer_count + layer].emplace_back(dirty_rect{ x0, y0, x1, y1 });
+    }
+
+    void dynamic_texture::flush() {
+        // updates must not race the initial stream
+        if (!tex.is_ready()) return;
+
+        for (uint32_t level = 0; level < config.level_count; level++) {
+            const level_layout& layout = levels[level];
+
+            for (uint32_t layer = 0; layer < config.layer_count; layer++) {
+                std::vector<dirty_rect>& rects = dirty_rects[static_cast<size_t>(level) * config.layer_count + layer];
+                if (rects.empty()) continue;
+
+                coalesce(rects);
+
+                std::span<const std::byte> src = get_texels(level, layer);
+
+                for (const dirty_rect& rect : rects) {
+                    // pack the block rows of the rect
+
+                    VkDeviceSize x_offset = static_cast<VkDeviceSize>(rect.x0 / block_extent[0]) * block_size;
+                    VkDeviceSize row_size = static_cast<VkDeviceSize>((rect.x1 - rect.x0 + block_extent[0] - 1) / block_extent[0]) * block_size;
+                    uint32_t row_begin = rect.y0 / block_extent[1];
+                    uint32_t row_count = (rect.y1 - rect.y0 + block_extent[1] - 1) / block_extent[1];
+
+                    update_data.resize(row_size * row_count);
+
+                    for (uint32_t row = 0; row < row_count; row++) {
+                        std::memcpy(update_data.data() + row * row_size, src.data() + (row_begin + row) * layout.row_size + x_offset, row_size);
+                    }
+
+                    tex.update(update_data.data(), update_data.size(), {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = level,
+                        .baseArrayLayer = layer,
+                        .layerCount = 1,
+                    }, { static_cast<int32_t>(rect.x0), static_cast<int32_t>(rect.y0), 0 }, { rect.x1 - rect.x0, rect.y1 - rect.y0, 1 });
+
+                    update_bytes += update_data.size();
+                }
+
+                rects.clear();
+            }
+        }
+    }
+
+    void dynamic_texture::coalesce(std::vector<dirty_rect>& rects) noexcept {
+        auto area = [](const dirty_rect& rect) {
+            return static_cast<uint64_t>(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+        };
+
+        // note: the rect count per frame is small, so the quadratic passes are cheap
+
+        for (bool is_merged = true; is_merged;) {
+            is_merged = false;
+
+            for (size_t i = 0; i < rects.size(); i++) {
+                for (size_t j = i + 1; j < rects.size();) {
+                    const dirty_rect& a = rects[i];
+                    const dirty_rect& b = rects[j];
+
+                    dirty_rect bounds{ std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+                    bool is_overlapping = a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1;
+
+                    if (!is_overlapping && static_cast<float>(area(bounds)) > static_cast<float>(area(a) + area(b)) * merge_slack) {
+                        j++;
+                        continue;
+                    }
+
+                    rects[i] = bounds;
+                    rects.erase(rects.begin() + j);
+                    is_merged = true;
+                }
+            }
+        }
+    }
+}
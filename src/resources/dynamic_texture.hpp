@@ -0,0 +1,84 @@
+#pragma once
+
+#include "streamer.hpp"
+#include "texture.hpp"
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace photon {
+    // a 2D (array) texture whose contents change in small regions every frame (glyph caches, minimaps, paint layers)
+
+    // the texture keeps a host copy of all its levels and layers, writes go to the host copy and mark their region dirty,
+    // flush() coalesces the dirty rects of each subresource and copies only those regions (see texture::update()),
+    // so the rest of the image is never re-uploaded or discarded
+
+    // note: not thread-safe, meant to be written and flushed by the thread recording the frame
+
+    class dynamic_texture {
+    public:
+        struct dynamic_config {
+            vk::Format format; // needs sampled and transfer dst support
+            uint32_t width, height;
+            uint32_t level_count;
+            uint32_t layer_count; // viewed as a 2D array if more than one
+
+            // of the initial stream clearing the texture, the first flush() waits for it
+            rendering::stream_priority priority;
+        };
+
+        dynamic_texture(rendering::asset_streamer& streamer, const dynamic_config& config) noexcept;
+
+        dynamic_texture(const dynamic_texture&) = delete;
+        dynamic_texture& operator=(const dynamic_texture&) = delete;
+
+        // copies the region from [data] (tightly packed texel block rows) into the host copy and marks it dirty,
+        // [offset] must be a multiple of the block extent and [extent] too unless the region ends at the level edge
+        void write(uint32_t level, uint32_t layer, vk::Offset2D offset, vk::Extent2D extent, const void* data);
+
+        // the host copy of a subresource (texel block rows), changes written through it have to be marked by mark_dirty()
+        std::span<std::byte> get_texels(uint32_t level, uint32_t layer) noexcept;
+        void mark_dirty(uint32_t level, uint32_t layer, vk::Offset2D offset, vk::Extent2D extent) noexcept;
+
+        // coalesces the dirty rects of every subresource and queues their updates, call once per frame before asset_streamer::record_graphics_commands()
+        // note: the dirty rects are kept until the initial stream is finished
+        void flush();
+
+        texture& get_texture() noexcept { return tex; }
+
+        // total amount of bytes copied by flush() so far
+        uint64_t get_update_bytes() const noexcept { return update_bytes; }
+
+    private:
+        // in texels, aligned to texel blocks (or the level edge), [x1, y1] is exclusive
+        struct dirty_rect {
+            uint32_t x0, y0;
+            uint32_t x1, y1;
+        };
+
+        struct level_layout {
+            uint32_t width, height; // in texels
+            VkDeviceSize row_size; // in bytes
+            uint32_t row_count; // block rows
+            VkDeviceSize offset; // of the first layer in [texels]
+        };
+
+        // merges overlapping rects and neighbours whose bounding box doesn't waste much area, until no pair merges anymore
+        static void coalesce(std::vector<dirty_rect>& rects) noexcept;
+
+        texture tex;
+        dynamic_config config;
+
+        std::array<uint8_t, 3> block_extent;
+        uint32_t block_size;
+
+        std::vector<level_layout> levels;
+        std::vector<std::byte> texels; // packed as described by asset_streamer::stream()
+
+        std::vector<std::vector<dirty_rect>> dirty_rects; // indexed by level * layer_count + layer
+        std::vector<std::byte> update_data; // reused by flush()
+
+        uint64_t update_bytes = 0;
+    };
+}
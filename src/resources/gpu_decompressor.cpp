@@ -0,0 +1,374 @@
+#include "gpu_decompressor.hpp"
+#include "asset_pack_format.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+
+namespace photon::rendering {
+    static const uint32_t lz_decompress_spv[] = {
+#include <shaders/lz_decompress.comp.spv.inc>
+    };
+
+    // matches the push constants of lz_decompress.comp
+    struct decompress_params {
+        uint32_t chunk_count;
+        uint32_t chunk_size;
+        uint32_t last_chunk_size;
+        uint32_t output_offset; // in bytes
+    };
+
+    gpu_decompressor::gpu_decompressor(vulkan_device& device, uint32_t max_frames_in_flight) :
+        device{device},
+        retired_decompressions(max_frames_in_flight)
+    {
+        vk::Device dev = device.get_device();
+
+        vk::DescriptorSetLayoutBinding bindings[] = {
+            {
+                .binding = 0,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            },
+            {
+                .binding = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            },
+        };
+
+        set_layout = dev.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+            .bindingCount = 2,
+            .pBindings = bindings,
+        });
+
+        vk::PushConstantRange push_range{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(decompress_params),
+        };
+
+        pipeline_layout = dev.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts = &set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_range,
+        });
+
+        vk::ShaderModule shader = dev.createShaderModule(vk::ShaderModuleCreateInfo{
+            .codeSize = sizeof(lz_decompress_spv),
+            .pCode = lz_decompress_spv,
+        });
+
+        vk::ComputePipelineCreateInfo pipeline_info{
+            .stage{
+                .stage = vk::ShaderStageFlagBits::eCompute,
+                .module = shader,
+                .pName = "main",
+            },
+            .layout = pipeline_layout,
+        };
+
+        pipeline = dev.createComputePipeline(nullptr, pipeline_info).value;
+
+        dev.destroyShaderModule(shader);
+
+        vk::DescriptorPoolSize pool_size{
+            .type = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 2 * max_decompressions_per_frame * max_frames_in_flight,
+        };
+
+        descriptor_pool = dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+            .maxSets = max_decompressions_per_frame * max_frames_in_flight,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size,
+        });
+    }
+
+    gpu_decompressor::~gpu_decompressor() noexcept {
+        for (auto& decompression : queued_decompressions) {
+            destroy_decompression(*decompression);
+        }
+
+        for (auto& frame_decompressions : retired_decompressions) {
+            for (auto& decompression : frame_decompressions) {
+                destroy_decompression(*decompression);
+            }
+        }
+
+        vk::Device dev = device.get_device();
+
+        dev.destroyDescriptorPool(descriptor_pool);
+        dev.destroyPipeline(pipeline);
+        dev.destroyPipelineLayout(pipeline_layout);
+        dev.destroyDescriptorSetLayout(set_layout);
+    }
+
+    std::shared_ptr<gpu_decompressor::decompression> gpu_decompressor::create_decompression(decompression_info&& info) {
+        auto result = std::make_shared<decompression>();
+        result->info = std::move(info);
+
+        const decompression_info& i = result->info;
+
+        // the chunks are decoded at their place in the payload shifted by [output_offset], so the range starts aligned
+        result->output_offset = (i.range_alignment - i.range_offset % i.range_alignment) % i.range_alignment;
+
+        VkDeviceSize output_size = result->output_offset + static_cast<VkDeviceSize>(i.chunk_count - 1) * pack::chunk_size + i.last_chunk_size;
+
+        // the shader accesses whole uints
+        vk::BufferCreateInfo input_info{
+            .size = (i.input_size + 3) / 4 * 4,
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        vk::BufferCreateInfo output_info{
+            .size = (output_size + 3) / 4 * 4,
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkBuffer buf;
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<const VkBufferCreateInfo&>(input_info), &alloc_info, &buf, &result->input_alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        result->input_buffer = buf;
+
+        res = vmaCreateBuffer(device.get_allocator(), &static_cast<const VkBufferCreateInfo&>(output_info), &alloc_info, &buf, &result->output_alloc, nullptr);
+
+        if (res != VK_SUCCESS) {
+            vmaDestroyBuffer(device.get_allocator(), result->input_buffer, result->input_alloc);
+            vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+        }
+
+        result->output_buffer = buf;
+
+        return result;
+    }
+
+    multi_fence_view gpu_decompressor::queue_decompression(std::shared_ptr<decompression> decompression, multi_fence_view input_ready) {
+        decompression->input_ready = input_ready;
+        multi_fence_view ready_fence = decompression->ready_promise.view();
+
+        std::lock_guard<std::mutex> l(queued_decompressions_lock);
+        queued_decompressions.emplace_back(std::move(decompression));
+
+        return ready_fence;
+    }
+
+    bool gpu_decompressor::has_work() noexcept {
+        {
+            std::lock_guard<std::mutex> l(queued_decompressions_lock);
+            if (!queued_decompressions.empty()) return true;
+        }
+
+        // retired scratch buffers are freed by record()
+        return std::any_of(retired_decompressions.begin(), retired_decompressions.end(), [](const auto& frame_decompressions) { return !frame_decompressions.empty(); });
+    }
+
+    void gpu_decompressor::record(vk::CommandBuffer cmd, uint32_t frame_index, const multi_fence& finished_fence) {
+        for (auto& decompression : retired_decompressions[frame_index]) {
+            destroy_decompression(*decompression);
+        }
+
+        retired_decompressions[frame_index].clear();
+
+        // the input is ready once its stream is finished (incl. the acquire recorded before this)
+
+        std::vector<std::shared_ptr<decompression>> decompressions;
+
+        {
+            std::lock_guard<std::mutex> l(queued_decompressions_lock);
+
+            for (auto iter = queued_decompressions.begin(); iter != queued_decompressions.end() && decompressions.size() < max_decompressions_per_frame;) {
+                if ((*iter)->input_ready.status() != vk::Result::eSuccess) {
+                    iter++;
+                    continue;
+                }
+
+                decompressions.emplace_back(std::move(*iter));
+                iter = queued_decompressions.erase(iter);
+            }
+        }
+
+        if (decompressions.empty()) return;
+
+        vk::Device dev = device.get_device();
+
+        std::vector<vk::DescriptorSetLayout> set_layouts(decompressions.size(), set_layout);
+        std::vector<vk::DescriptorSet> sets = dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data(),
+        });
+
+        std::vector<vk::DescriptorBufferInfo> buffer_infos;
+        std::vector<vk::WriteDescriptorSet> writes;
+
+        buffer_infos.reserve(decompressions.size() * 2);
+
+        std::vector<vk::BufferMemoryBarrier2> pre_barriers;
+        std::vector<vk::BufferMemoryBarrier2> output_barriers;
+        std::vector<vk::ImageMemoryBarrier2> dst_transitions;
+        std::vector<vk::ImageMemoryBarrier2> post_barriers;
+
+        for (size_t i = 0; i < decompressions.size(); i++) {
+            decompression& d = *decompressions[i];
+            d.descriptor_set = sets[i];
+
+            buffer_infos.push_back({ .buffer = d.input_buffer, .offset = 0, .range = vk::WholeSize });
+            writes.push_back({ .dstSet = d.descriptor_set, .dstBinding = 0, .descriptorCount = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .pBufferInfo = &buffer_infos.back() });
+
+            buffer_infos.push_back({ .buffer = d.output_buffer, .offset = 0, .range = vk::WholeSize });
+            writes.push_back({ .dstSet = d.descriptor_set, .dstBinding = 1, .descriptorCount = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .pBufferInfo = &buffer_infos.back() });
+
+            // note: the input may have been written by copies recorded before
+            pre_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                .srcAccessMask = vk::AccessFlagBits2::eMemoryWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+                .buffer = d.input_buffer,
+                .offset = 0,
+                .size = vk::WholeSize,
+            });
+
+            pre_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+                .buffer = d.output_buffer,
+                .offset = 0,
+                .size = vk::WholeSize,
+            });
+
+            output_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+                .buffer = d.output_buffer,
+                .offset = 0,
+                .size = vk::WholeSize,
+            });
+
+            if (d.info.buf) continue;
+
+            dst_transitions.push_back({
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .image = d.info.image,
+                .subresourceRange = d.info.subresource_range,
+            });
+
+            post_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = d.info.normal_layout,
+                .image = d.info.image,
+                .subresourceRange = d.info.subresource_range,
+            });
+        }
+
+        dev.updateDescriptorSets(writes, {});
+
+        // the shader ors the bytes into the output
+        for (const auto& d : decompressions) {
+            cmd.fillBuffer(d->output_buffer, 0, vk::WholeSize, 0);
+        }
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(pre_barriers.size()),
+            .pBufferMemoryBarriers = pre_barriers.data(),
+        });
+
+        // one workgroup per chunk
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+
+        for (const auto& d : decompressions) {
+            decompress_params params{
+                .chunk_count = d->info.chunk_count,
+                .chunk_size = static_cast<uint32_t>(pack::chunk_size),
+                .last_chunk_size = d->info.last_chunk_size,
+                .output_offset = static_cast<uint32_t>(d->output_offset),
+            };
+
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, d->descriptor_set, {});
+            cmd.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+            cmd.dispatch(params.chunk_count, 1, 1);
+        }
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(output_barriers.size()),
+            .pBufferMemoryBarriers = output_barriers.data(),
+            .imageMemoryBarrierCount = static_cast<uint32_t>(dst_transitions.size()),
+            .pImageMemoryBarriers = dst_transitions.data(),
+        });
+
+        for (const auto& d : decompressions) {
+            VkDeviceSize range_begin = d->output_offset + d->info.range_offset;
+
+            if (d->info.buf) {
+                cmd.copyBuffer(d->output_buffer, d->info.buf, vk::BufferCopy{
+                    .srcOffset = range_begin,
+                    .dstOffset = d->info.dst_offset,
+                    .size = d->info.range_size,
+                });
+
+                continue;
+            }
+
+            std::vector<vk::BufferImageCopy> regions = d->info.regions;
+            for (auto& region : regions) region.bufferOffset += range_begin;
+
+            cmd.copyBufferToImage(d->output_buffer, d->info.image, vk::ImageLayout::eTransferDstOptimal, regions);
+        }
+
+        // buffer destinations are made visible by a global barrier, images are transitioned to their normal layout
+
+        vk::MemoryBarrier2 buffer_barrier{
+            .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+        };
+
+        bool has_buffers = std::any_of(decompressions.begin(), decompressions.end(), [](const auto& d) { return static_cast<bool>(d->info.buf); });
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .memoryBarrierCount = has_buffers ? 1U : 0U,
+            .pMemoryBarriers = &buffer_barrier,
+            .imageMemoryBarrierCount = static_cast<uint32_t>(post_barriers.size()),
+            .pImageMemoryBarriers = post_barriers.data(),
+        });
+
+        // note: graphics work recorded after this point is ordered after the decompression
+        for (auto& d : decompressions) {
+            d->ready_promise.bind(finished_fence);
+            retired_decompressions[frame_index].emplace_back(std::move(d));
+        }
+    }
+
+    void gpu_decompressor::destroy_decompression(const decompression& decompression) noexcept {
+        if (decompression.descriptor_set) device.get_device().freeDescriptorSets(descriptor_pool, decompression.descriptor_set);
+
+        vmaDestroyBuffer(device.get_allocator(), decompression.input_buffer, decompression.input_alloc);
+        vmaDestroyBuffer(device.get_allocator(), decompression.output_buffer, decompression.output_alloc);
+    }
+}
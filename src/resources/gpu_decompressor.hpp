@@ -0,0 +1,88 @@
+#pragma once
+
+#include <rendering/vk_device.hpp>
+#include <rendering/multi_fence.hpp>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace photon::rendering {
+    // decompresses streams of lz chunks (see pack::compression_type::lz_chunks) with a compute shader on the graphics queue (used by asset_streamer)
+
+    // the chunks covering the streamed range are streamed unchanged into an input scratch buffer, decoded into an output scratch buffer
+    // (one workgroup per chunk) and the range is copied into the destination buffer or image, the scratch buffers are freed afterwards,
+    // so staging and transfers only carry the compressed bytes and the host doesn't decode anything
+
+    class gpu_decompressor {
+    public:
+        struct decompression_info {
+            // the destination, a buffer range if [buf] is set, otherwise the regions of [image]
+            vk::Buffer buf;
+            VkDeviceSize dst_offset;
+
+            vk::Image image;
+            vk::ImageLayout normal_layout;
+            vk::ImageSubresourceRange subresource_range; // transitioned from eUndefined, so the streamed subresources are discarded
+            std::vector<vk::BufferImageCopy> regions; // buffer offsets relative to the start of the range
+
+            // the start of the range is placed at a multiple of this in the output buffer (image copies need texel block and 4 byte aligned offsets)
+            VkDeviceSize range_alignment;
+
+            uint32_t chunk_count; // covering the range
+            uint32_t last_chunk_size; // uncompressed size of the last covered chunk
+            VkDeviceSize input_size; // chunk offsets (uint32s, relative to the input buffer) followed by the chunks
+
+            VkDeviceSize range_offset; // in the first chunk
+            VkDeviceSize range_size;
+        };
+
+        struct decompression {
+            decompression_info info;
+            VkDeviceSize output_offset; // of the first chunk
+
+            vk::Buffer input_buffer;
+            VmaAllocation input_alloc;
+
+            vk::Buffer output_buffer;
+            VmaAllocation output_alloc;
+
+            vk::DescriptorSet descriptor_set;
+
+            multi_fence_view input_ready;
+            multi_fence_promise ready_promise;
+        };
+
+        gpu_decompressor(vulkan_device& device, uint32_t max_frames_in_flight);
+        ~gpu_decompressor() noexcept; // assumes the device is idle
+
+        // creates the scratch buffers, the input has to be streamed into [input_buffer] (exclusive sharing), can be called from any thread
+        std::shared_ptr<decompression> create_decompression(decompression_info&& info);
+
+        // queues the decompression once its input stream is submitted, returns the ready fence of the destination
+        multi_fence_view queue_decompression(std::shared_ptr<decompression> decompression, multi_fence_view input_ready);
+
+        // records the decompressions whose inputs are ready (graphics work recorded before is ordered before them),
+        // the scratch buffers are kept until [frame_index] is recorded again (its previous submission must be finished by then)
+        bool has_work() noexcept;
+        void record(vk::CommandBuffer cmd, uint32_t frame_index, const multi_fence& finished_fence);
+
+    private:
+        // limits the descriptor sets in flight
+        static constexpr uint32_t max_decompressions_per_frame = 32;
+
+        void destroy_decompression(const decompression& decompression) noexcept;
+
+        vulkan_device& device;
+
+        vk::DescriptorSetLayout set_layout;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline pipeline;
+        vk::DescriptorPool descriptor_pool;
+
+        std::vector<std::shared_ptr<decompression>> queued_decompressions;
+        std::mutex queued_decompressions_lock; // guards [queued_decompressions]
+
+        std::vector<std::vector<std::shared_ptr<decompression>>> retired_decompressions; // per frame index
+    };
+}
@@ -0,0 +1,71 @@
+#include "image_decoder.hpp"
+#include "png_decoder.hpp"
+
+#include <vector>
+
+// note: stb_image uses its sse2 jpeg idct and ycbcr conversion on x86-64 by default, neon has to be requested
+#if defined(__aarch64__)
+#define STBI_NEON
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+namespace photon {
+    // fallback for every format stb_image knows (jpeg, png, tga, bmp, psd, gif, hdr, pic, pnm)
+    class stb_decoder final : public image_decoder {
+    public:
+        const char* get_name() const noexcept override { return "stb_image"; }
+
+        bool can_decode(std::span<const std::byte>) const noexcept override { return true; }
+
+        std::optional<decoded_image> decode(std::span<const std::byte> file) const noexcept override {
+            int x, y, comp;
+            uint8_t* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()), &x, &y, &comp, 0 /*keep the source components*/);
+
+            if (!data) return std::nullopt;
+
+            return decoded_image{
+                .texels = std::unique_ptr<uint8_t[], decoded_image::texel_deleter>(data), // note: STBI_MALLOC is malloc
+                .width = static_cast<uint32_t>(x),
+                .height = static_cast<uint32_t>(y),
+                .component_count = static_cast<uint32_t>(comp),
+            };
+        }
+    };
+
+    static std::vector<std::unique_ptr<image_decoder>> registered_decoders;
+
+    void register_image_decoder(std::unique_ptr<image_decoder> decoder) {
+        registered_decoders.push_back(std::move(decoder));
+    }
+
+    std::optional<decoded_image> decode_image(std::span<const std::byte> file) noexcept {
+        // the last registered decoder is tried first
+        for (auto it = registered_decoders.rbegin(); it != registered_decoders.rend(); it++) {
+            if (!(*it)->can_decode(file)) continue;
+
+            std::optional<decoded_image> image = (*it)->decode(file);
+            if (image) return image;
+        }
+
+        for (const image_decoder* decoder : { &get_png_decoder(), &get_stb_decoder() }) {
+            if (!decoder->can_decode(file)) continue;
+
+            std::optional<decoded_image> image = decoder->decode(file);
+            if (image) return image;
+        }
+
+        return std::nullopt;
+    }
+
+    const image_decoder& get_png_decoder() noexcept {
+        static const png_decoder decoder;
+        return decoder;
+    }
+
+    const image_decoder& get_stb_decoder() noexcept {
+        static const stb_decoder decoder;
+        return decoder;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace photon {
+    // decodes source images (png, jpeg, ...) into 8 bit texels, see decode_image()
+
+    struct decoded_image {
+        struct texel_deleter {
+            void operator()(uint8_t* texels) const noexcept { std::free(texels); }
+        };
+
+        // tightly packed rows of [component_count] (1 to 4) 8 bit components, allocated with malloc
+        std::unique_ptr<uint8_t[], texel_deleter> texels;
+
+        uint32_t width, height;
+        uint32_t component_count; // the component count of the file (gray, gray + alpha, rgb or rgba)
+    };
+
+    class image_decoder {
+    public:
+        virtual ~image_decoder() noexcept = default;
+
+        virtual const char* get_name() const noexcept = 0;
+
+        // true if [file] starts with a signature of a format the decoder handles
+        virtual bool can_decode(std::span<const std::byte> file) const noexcept = 0;
+
+        // returns nullopt if the file is invalid or uses a feature the decoder doesn't handle (the next decoder is tried then)
+        // note: called from loader threads, must not modify the decoder
+        virtual std::optional<decoded_image> decode(std::span<const std::byte> file) const noexcept = 0;
+    };
+
+    // adds a decoder in front of the builtin ones (simd png decoder, then stb_image for everything else), later registrations are tried first
+    // note: not thread safe, decoders must be registered before any image is decoded
+    void register_image_decoder(std::unique_ptr<image_decoder> decoder);
+
+    // decodes [file] with the first decoder that can decode it, falls back to the next ones on failure, stb_image is the last one
+    std::optional<decoded_image> decode_image(std::span<const std::byte> file) noexcept;
+
+    // the builtin decoders, exposed for benchmarking (see bench/decode_bench.cpp)
+    const image_decoder& get_png_decoder() noexcept;
+    const image_decoder& get_stb_decoder() noexcept;
+}
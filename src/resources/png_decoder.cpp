@@ -0,0 +1,690 @@
+#include "png_decoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHOTON_PNG_SSE2
+#endif
+
+namespace photon {
+    // inflate (rfc 1950 / 1951)
+
+    struct inflate_huffman {
+        static constexpr uint32_t fast_bits = 10;
+
+        uint16_t fast[1 << fast_bits]; // (code length << 9) | symbol, indexed by the next (reversed) bits, 0 for longer codes
+        uint16_t first_code[16];
+        uint16_t first_symbol[16];
+        uint32_t max_code[17]; // exclusive, left aligned to 16 bits
+        uint16_t symbols[288]; // sorted by code
+    };
+
+    // lsb first bit buffer, refilled 8 bytes at a time, reads past the end return zeros (counted in [overrun])
+    struct inflate_bits {
+        const uint8_t* in;
+        const uint8_t* end;
+
+        uint64_t buffer = 0;
+        uint32_t bit_count = 0;
+        uint32_t overrun = 0;
+
+        // guarantees at least 56 bits
+        inline void refill() noexcept {
+            if (end - in >= 8) {
+                uint64_t word;
+                std::memcpy(&word, in, sizeof(word));
+
+                buffer |= word << bit_count;
+                in += (63 - bit_count) >> 3;
+                bit_count |= 56;
+            } else {
+                while (bit_count <= 56) {
+                    if (in < end) {
+                        buffer |= static_cast<uint64_t>(*in++) << bit_count;
+                    } else {
+                        overrun++;
+                    }
+
+                    bit_count += 8;
+                }
+            }
+        }
+
+        inline void consume(uint32_t count) noexcept {
+            buffer >>= count;
+            bit_count -= count;
+        }
+
+        // note: expects enough bits to be buffered
+        inline uint32_t take(uint32_t count) noexcept {
+            uint32_t value = static_cast<uint32_t>(buffer & ((1ULL << count) - 1));
+            consume(count);
+            return value;
+        }
+
+        inline uint32_t read(uint32_t count) noexcept {
+            if (bit_count < count) refill();
+            return take(count);
+        }
+
+        // true if bits past the end of the input were consumed
+        bool is_truncated() const noexcept { return overrun * 8 > bit_count; }
+    };
+
+    static uint32_t reverse_bits(uint32_t value, uint32_t count) noexcept {
+        uint32_t reversed = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            reversed = (reversed << 1) | (value & 1);
+            value >>= 1;
+        }
+
+        return reversed;
+    }
+
+    static bool build_huffman(inflate_huffman& huffman, const uint8_t* lengths, uint32_t count) noexcept {
+        uint32_t length_counts[16]{};
+
+        for (uint32_t i = 0; i < count; i++) {
+            length_counts[lengths[i]]++;
+        }
+
+        length_counts[0] = 0;
+
+        uint32_t next_code[16]{};
+        uint32_t code = 0, symbol_index = 0;
+
+        for (uint32_t length = 1; length < 16; length++) {
+            next_code[length] = code;
+            huffman.first_code[length] = static_cast<uint16_t>(code);
+            huffman.first_symbol[length] = static_cast<uint16_t>(symbol_index);
+
+            code += length_counts[length];
+            if (code > (1U << length)) return false; // oversubscribed
+
+            huffman.max_code[length] = code << (16 - length);
+            code <<= 1;
+            symbol_index += length_counts[length];
+        }
+
+        huffman.max_code[16] = 0x10000;
+        std::memset(huffman.fast, 0, sizeof(huffman.fast));
+
+        for (uint32_t symbol = 0; symbol < count; symbol++) {
+            uint32_t length = lengths[symbol];
+            if (!length) continue;
+
+            huffman.symbols[next_code[length] - huffman.first_code[length] + huffman.first_symbol[length]] = static_cast<uint16_t>(symbol);
+
+            if (length <= inflate_huffman::fast_bits) {
+                uint16_t entry = static_cast<uint16_t>((length << 9) | symbol);
+
+                for (uint32_t i = reverse_bits(next_code[length], length); i < (1U << inflate_huffman::fast_bits); i += 1U << length) {
+                    huffman.fast[i] = entry;
+                }
+            }
+
+            next_code[length]++;
+        }
+
+        return true;
+    }
+
+    static int decode_symbol_slow(inflate_bits& bits, const inflate_huffman& huffman) noexcept {
+        uint32_t code = reverse_bits(static_cast<uint32_t>(bits.buffer & 0xFFFF), 16);
+        uint32_t length = inflate_huffman::fast_bits + 1;
+
+        while (length < 16 && code >= huffman.max_code[length]) length++;
+        if (length == 16) return -1;
+
+        bits.consume(length);
+        return huffman.symbols[(code >> (16 - length)) - huffman.first_code[length] + huffman.first_symbol[length]];
+    }
+
+    // note: expects at least 15 bits to be buffered
+    static inline int decode_symbol(inflate_bits& bits, const inflate_huffman& huffman) noexcept {
+        uint16_t entry = huffman.fast[bits.buffer & ((1U << inflate_huffman::fast_bits) - 1)];
+        if (!entry) return decode_symbol_slow(bits, huffman);
+
+        bits.consume(entry >> 9);
+        return entry & 511;
+    }
+
+    constexpr uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    constexpr uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    // [out] must have 8 bytes of slack after [out_end], long matches are copied in 8 byte steps
+    static bool inflate_block(inflate_bits& bits_state, const inflate_huffman& lengths, const inflate_huffman& distances, uint8_t* out_begin, uint8_t*& out_state, uint8_t* out_end) noexcept {
+        // note: the bit reader and output are kept in locals, the byte stores could alias them otherwise (~1.5x slower)
+        inflate_bits bits = bits_state;
+        uint8_t* out = out_state;
+
+        auto finish = [&](bool is_valid) {
+            bits_state = bits;
+            out_state = out;
+            return is_valid;
+        };
+
+        for (;;) {
+            // a refill lasts for several literals
+            if (bits.bit_count < 15) bits.refill();
+
+            int symbol = decode_symbol(bits, lengths);
+
+            if (symbol < 256) {
+                if (symbol < 0 || out == out_end) return finish(false);
+
+                *out++ = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            if (symbol == 256) return finish(!bits.is_truncated());
+
+            symbol -= 257;
+            if (symbol >= 29) return finish(false);
+
+            // length extra bits, distance and its extra bits take at most 33 bits
+            if (bits.bit_count < 33) bits.refill();
+
+            uint32_t length = length_base[symbol] + bits.take(length_extra[symbol]);
+
+            int distance_symbol = decode_symbol(bits, distances);
+            if (distance_symbol < 0 || distance_symbol >= 30) return finish(false);
+
+            uint32_t distance = distance_base[distance_symbol] + bits.take(distance_extra[distance_symbol]);
+
+            if (distance > static_cast<size_t>(out - out_begin) || length > static_cast<size_t>(out_end - out)) return finish(false);
+
+            const uint8_t* src = out - distance;
+            uint8_t* match_end = out + length;
+
+            if (distance >= 8) {
+                // every 8 byte step only reads bytes that were already written
+                do {
+                    std::memcpy(out, src, 8);
+                    out += 8;
+                    src += 8;
+                } while (out < match_end);
+            } else if (distance == 1) {
+                std::memset(out, *src, length);
+            } else {
+                while (out < match_end) *out++ = *src++;
+            }
+
+            out = match_end;
+        }
+    }
+
+    static bool read_dynamic_huffman(inflate_bits& bits, inflate_huffman& lengths, inflate_huffman& distances) noexcept {
+        constexpr uint8_t code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        bits.refill();
+
+        uint32_t length_count = bits.take(5) + 257;
+        uint32_t distance_count = bits.take(5) + 1;
+        uint32_t code_length_count = bits.take(4) + 4;
+
+        uint8_t code_length_lengths[19]{};
+
+        for (uint32_t i = 0; i < code_length_count; i++) {
+            code_length_lengths[code_length_order[i]] = static_cast<uint8_t>(bits.read(3));
+        }
+
+        inflate_huffman code_lengths;
+        if (!build_huffman(code_lengths, code_length_lengths, 19)) return false;
+
+        uint8_t code_sizes[286 + 30];
+        uint32_t code_count = 0;
+
+        while (code_count < length_count + distance_count) {
+            bits.refill();
+
+            int symbol = decode_symbol(bits, code_lengths);
+            if (symbol < 0) return false;
+
+            if (symbol < 16) {
+                code_sizes[code_count++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t repeated = 0;
+            uint32_t repeat_count;
+
+            if (symbol == 16) {
+                if (code_count == 0) return false;
+
+                repeated = code_sizes[code_count - 1];
+                repeat_count = bits.take(2) + 3;
+            } else if (symbol == 17) {
+                repeat_count = bits.take(3) + 3;
+            } else {
+                repeat_count = bits.take(7) + 11;
+            }
+
+            if (code_count + repeat_count > length_count + distance_count) return false;
+
+            std::memset(code_sizes + code_count, repeated, repeat_count);
+            code_count += repeat_count;
+        }
+
+        if (bits.is_truncated() || code_sizes[256] == 0) return false;
+
+        return build_huffman(lengths, code_sizes, length_count) && build_huffman(distances, code_sizes + length_count, distance_count);
+    }
+
+    struct fixed_huffman {
+        fixed_huffman() noexcept {
+            uint8_t code_sizes[288];
+
+            std::fill(code_sizes, code_sizes + 144, 8);
+            std::fill(code_sizes + 144, code_sizes + 256, 9);
+            std::fill(code_sizes + 256, code_sizes + 280, 7);
+            std::fill(code_sizes + 280, code_sizes + 288, 8);
+            build_huffman(lengths, code_sizes, 288);
+
+            std::fill(code_sizes, code_sizes + 30, 5);
+            build_huffman(distances, code_sizes, 30);
+        }
+
+        inflate_huffman lengths;
+        inflate_huffman distances;
+    };
+
+    // inflates a zlib stream into [out], which must hold [out_size] + 8 bytes, returns false unless exactly [out_size] bytes are produced
+    static bool zlib_inflate(std::span<const uint8_t> in, uint8_t* out, size_t out_size) noexcept {
+        if (in.size() < 2) return false;
+
+        uint8_t cmf = in[0], flg = in[1];
+        if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false; // deflate without a preset dictionary
+
+        static const fixed_huffman fixed;
+
+        inflate_bits bits{ .in = in.data() + 2, .end = in.data() + in.size() };
+        inflate_huffman lengths, distances;
+
+        uint8_t* out_begin = out;
+        uint8_t* out_end = out + out_size;
+        bool is_final = false;
+
+        while (!is_final) {
+            is_final = bits.read(1);
+            uint32_t type = bits.read(2);
+
+            if (type == 0) {
+                // stored, the buffered whole bytes are given back to the input
+                bits.consume(bits.bit_count & 7);
+
+                uint32_t buffered = bits.bit_count >> 3;
+                if (bits.overrun > buffered) return false;
+
+                bits.in -= buffered - bits.overrun;
+                bits.buffer = 0;
+                bits.bit_count = 0;
+                bits.overrun = 0;
+
+                if (bits.end - bits.in < 4) return false;
+
+                uint16_t length = static_cast<uint16_t>(bits.in[0] | bits.in[1] << 8);
+                uint16_t length_complement = static_cast<uint16_t>(bits.in[2] | bits.in[3] << 8);
+                bits.in += 4;
+
+                if (length != static_cast<uint16_t>(~length_complement) || bits.end - bits.in < length || out_end - out < length) return false;
+
+                std::memcpy(out, bits.in, length);
+                out += length;
+                bits.in += length;
+            } else if (type == 1) {
+                if (!inflate_block(bits, fixed.lengths, fixed.distances, out_begin, out, out_end)) return false;
+            } else if (type == 2) {
+                if (!read_dynamic_huffman(bits, lengths, distances)) return false;
+                if (!inflate_block(bits, lengths, distances, out_begin, out, out_end)) return false;
+            } else {
+                return false;
+            }
+        }
+
+        return out == out_end;
+    }
+
+    // png unfiltering, the rows of the inflated data are prefixed with their filter type
+
+    // note: written without branches, the choice is unpredictable for noisy images
+    static inline uint8_t paeth_predictor(int a, int b, int c) noexcept {
+        int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+
+        int nearest = pb <= pc ? b : c;
+        return static_cast<uint8_t>((pa <= pb) & (pa <= pc) ? a : nearest);
+    }
+
+    // the left (and upper left) pixel is kept in registers, reading it back from [dst] stalls on the store every byte
+    template<uint32_t pixel_size>
+    static void unfilter_row_scalar(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_size) noexcept {
+        uint8_t a[pixel_size]{}, c[pixel_size]{};
+
+        switch (filter) {
+            case 1: // sub
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    for (uint32_t k = 0; k < pixel_size; k++) dst[i + k] = a[k] = src[i + k] + a[k];
+                }
+
+                break;
+
+            case 2: // up
+                for (size_t i = 0; i < row_size; i++) dst[i] = src[i] + prior[i];
+                break;
+
+            case 3: // average
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    for (uint32_t k = 0; k < pixel_size; k++) dst[i + k] = a[k] = src[i + k] + ((a[k] + prior[i + k]) >> 1);
+                }
+
+                break;
+
+            case 4: // paeth
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    for (uint32_t k = 0; k < pixel_size; k++) {
+                        uint8_t b = prior[i + k];
+
+                        dst[i + k] = a[k] = src[i + k] + paeth_predictor(a[k], b, c[k]);
+                        c[k] = b;
+                    }
+                }
+
+                break;
+
+            default:
+                std::memcpy(dst, src, row_size);
+                break;
+        }
+    }
+
+#ifdef PHOTON_PNG_SSE2
+    // sub, average and paeth depend on the pixel to the left, so 3 and 4 byte pixels are processed one at a time in a register
+
+    // note: always reads 4 bytes (3 byte loads are split and ~2.5x slower), rows are followed by at least one readable byte
+    static inline __m128i load_pixel(const uint8_t* src) noexcept {
+        uint32_t pixel;
+        std::memcpy(&pixel, src, sizeof(pixel));
+        return _mm_cvtsi32_si128(static_cast<int>(pixel));
+    }
+
+    // 3 byte pixels are stored with 4 bytes as well (the extra byte is overwritten by the next pixel), except for the last one
+    template<uint32_t pixel_size>
+    static inline void store_pixel(uint8_t* dst, __m128i value, bool is_last) noexcept {
+        uint32_t pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(value));
+        std::memcpy(dst, &pixel, pixel_size == 4 || !is_last ? 4 : pixel_size);
+    }
+
+    static inline __m128i abs_epi16(__m128i value) noexcept {
+        return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+    }
+
+    static inline __m128i select_epi16(__m128i mask, __m128i a, __m128i b) noexcept {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    template<uint32_t pixel_size>
+    static void unfilter_row_sse2(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_size) noexcept {
+        const __m128i zero = _mm_setzero_si128();
+
+        switch (filter) {
+            case 1: { // sub
+                __m128i a = zero;
+
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    a = _mm_add_epi8(a, load_pixel(src + i));
+                    store_pixel<pixel_size>(dst + i, a, i + pixel_size == row_size);
+                }
+
+                break;
+            }
+
+            case 3: { // average, avg_epu8 rounds up so the carry of a ^ b is subtracted
+                const __m128i one = _mm_set1_epi8(1);
+                __m128i a = zero;
+
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    __m128i b = load_pixel(prior + i);
+                    __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+
+                    a = _mm_add_epi8(load_pixel(src + i), average);
+                    store_pixel<pixel_size>(dst + i, a, i + pixel_size == row_size);
+                }
+
+                break;
+            }
+
+            case 4: { // paeth, in 16 bit lanes
+                __m128i a = zero, c = zero;
+
+                for (size_t i = 0; i < row_size; i += pixel_size) {
+                    __m128i b = _mm_unpacklo_epi8(load_pixel(prior + i), zero);
+
+                    __m128i pa = _mm_sub_epi16(b, c);
+                    __m128i pb = _mm_sub_epi16(a, c);
+                    __m128i pc = abs_epi16(_mm_add_epi16(pa, pb));
+                    pa = abs_epi16(pa);
+                    pb = abs_epi16(pb);
+
+                    // ties prefer a over b over c
+                    __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+                    __m128i nearest = select_epi16(_mm_cmpeq_epi16(smallest, pa), a, select_epi16(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+                    __m128i d = _mm_add_epi8(load_pixel(src + i), _mm_packus_epi16(nearest, nearest));
+                    store_pixel<pixel_size>(dst + i, d, i + pixel_size == row_size);
+
+                    a = _mm_unpacklo_epi8(d, zero);
+                    c = b;
+                }
+
+                break;
+            }
+        }
+    }
+
+    static void unfilter_row(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_size, uint32_t pixel_size) noexcept {
+        if (filter == 2) {
+            // up has no dependency inside the row
+            size_t i = 0;
+
+            for (; i + 16 <= row_size; i += 16) {
+                __m128i value = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+            }
+
+            for (; i < row_size; i++) dst[i] = src[i] + prior[i];
+        } else if (filter == 0 || filter > 4) {
+            std::memcpy(dst, src, row_size);
+        } else if (pixel_size == 4) {
+            unfilter_row_sse2<4>(filter, src, prior, dst, row_size);
+        } else if (pixel_size == 3) {
+            unfilter_row_sse2<3>(filter, src, prior, dst, row_size);
+        } else if (pixel_size == 2) {
+            unfilter_row_scalar<2>(filter, src, prior, dst, row_size);
+        } else {
+            unfilter_row_scalar<1>(filter, src, prior, dst, row_size);
+        }
+    }
+#else
+    static void unfilter_row(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_size, uint32_t pixel_size) noexcept {
+        switch (pixel_size) {
+            case 4: unfilter_row_scalar<4>(filter, src, prior, dst, row_size); break;
+            case 3: unfilter_row_scalar<3>(filter, src, prior, dst, row_size); break;
+            case 2: unfilter_row_scalar<2>(filter, src, prior, dst, row_size); break;
+            default: unfilter_row_scalar<1>(filter, src, prior, dst, row_size); break;
+        }
+    }
+#endif
+
+    // png container
+
+    constexpr uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    static inline uint32_t read_be32(const uint8_t* data) noexcept {
+        return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | data[3];
+    }
+
+    static constexpr uint32_t make_chunk_type(const char (&name)[5]) noexcept {
+        return static_cast<uint32_t>(name[0]) << 24 | static_cast<uint32_t>(name[1]) << 16 | static_cast<uint32_t>(name[2]) << 8 | static_cast<uint32_t>(name[3]);
+    }
+
+    bool png_decoder::can_decode(std::span<const std::byte> file) const noexcept {
+        return file.size() >= sizeof(png_signature) && std::memcmp(file.data(), png_signature, sizeof(png_signature)) == 0;
+    }
+
+    std::optional<decoded_image> png_decoder::decode(std::span<const std::byte> file) const noexcept {
+        if (!can_decode(file)) return std::nullopt;
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+        size_t offset = sizeof(png_signature);
+
+        uint32_t width = 0, height = 0, bit_depth = 0, color_type = 0;
+        bool has_header = false;
+
+        std::array<uint8_t, 256 * 4> palette{}; // rgba
+        uint32_t palette_size = 0;
+        bool has_transparency = false;
+
+        // the zlib stream is split across the idat chunks, it's only copied if there are multiple
+        std::span<const uint8_t> compressed;
+        std::vector<uint8_t> joined_compressed;
+
+        for (;;) {
+            if (file.size() - offset < 12) return std::nullopt;
+
+            uint32_t chunk_size = read_be32(data + offset);
+            uint32_t chunk_type = read_be32(data + offset + 4);
+            const uint8_t* chunk = data + offset + 8;
+
+            if (chunk_size > file.size() - offset - 12) return std::nullopt;
+            offset += 12 + static_cast<size_t>(chunk_size);
+
+            if (chunk_type == make_chunk_type("IHDR")) {
+                if (chunk_size != 13) return std::nullopt;
+
+                width = read_be32(chunk);
+                height = read_be32(chunk + 4);
+                bit_depth = chunk[8];
+                color_type = chunk[9];
+
+                // compression and filter method must be 0, interlaced images are left to the fallback
+                if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) return std::nullopt;
+
+                has_header = true;
+            } else if (!has_header) {
+                return std::nullopt;
+            } else if (chunk_type == make_chunk_type("PLTE")) {
+                if (chunk_size % 3 != 0 || chunk_size > 256 * 3) return std::nullopt;
+
+                palette_size = chunk_size / 3;
+
+                for (uint32_t i = 0; i < palette_size; i++) {
+                    palette[i * 4 + 0] = chunk[i * 3 + 0];
+                    palette[i * 4 + 1] = chunk[i * 3 + 1];
+                    palette[i * 4 + 2] = chunk[i * 3 + 2];
+                    palette[i * 4 + 3] = 0xFF;
+                }
+            } else if (chunk_type == make_chunk_type("tRNS")) {
+                // note: color keys of gray and rgb images are left to the fallback
+                if (color_type != 3 || chunk_size > palette_size) return std::nullopt;
+
+                for (uint32_t i = 0; i < chunk_size; i++) palette[i * 4 + 3] = chunk[i];
+                has_transparency = true;
+            } else if (chunk_type == make_chunk_type("IDAT")) {
+                if (compressed.empty() && joined_compressed.empty()) {
+                    compressed = std::span(chunk, chunk_size);
+                } else {
+                    if (joined_compressed.empty()) joined_compressed.assign(compressed.begin(), compressed.end());
+                    joined_compressed.insert(joined_compressed.end(), chunk, chunk + chunk_size);
+                }
+            } else if (chunk_type == make_chunk_type("IEND")) {
+                break;
+            } else if (!(chunk_type & 0x20000000)) {
+                return std::nullopt; // unknown critical chunk
+            }
+        }
+
+        if (!joined_compressed.empty()) compressed = joined_compressed;
+
+        uint32_t channel_count;
+
+        switch (color_type) {
+            case 0: channel_count = 1; break;
+            case 2: channel_count = 3; break;
+            case 3: channel_count = 1; break;
+            case 4: channel_count = 2; break;
+            case 6: channel_count = 4; break;
+            default: return std::nullopt;
+        }
+
+        bool is_low_depth = bit_depth == 1 || bit_depth == 2 || bit_depth == 4;
+
+        if (bit_depth != 8 && !(is_low_depth && (color_type == 0 || color_type == 3))) return std::nullopt; // 16 bit images are left to the fallback
+        if (color_type == 3 && palette_size == 0) return std::nullopt;
+        if (width == 0 || height == 0 || width > (1U << 24) || height > (1U << 24)) return std::nullopt;
+
+        uint32_t component_count = color_type == 3 ? (has_transparency ? 4 : 3) : channel_count;
+        uint32_t pixel_size = std::max(1U, channel_count * bit_depth / 8);
+        size_t row_size = (static_cast<size_t>(width) * channel_count * bit_depth + 7) / 8;
+        size_t texel_size = static_cast<size_t>(width) * height * component_count;
+
+        // inflated rows are prefixed with their filter type
+        size_t filtered_size = (row_size + 1) * height;
+        if (filtered_size / 1032 > compressed.size()) return std::nullopt; // more than deflate's maximum ratio, the header is bogus
+        std::unique_ptr<uint8_t[]> filtered(new uint8_t[filtered_size + 8]);
+
+        if (!zlib_inflate(compressed, filtered.get(), filtered_size)) return std::nullopt;
+
+        decoded_image image{
+            .texels = std::unique_ptr<uint8_t[], decoded_image::texel_deleter>(static_cast<uint8_t*>(std::malloc(texel_size))),
+            .width = width,
+            .height = height,
+            .component_count = component_count,
+        };
+
+        if (!image.texels) return std::nullopt;
+
+        // 8 bit gray and color rows are unfiltered straight into the image, the others are expanded row by row
+        bool is_direct = bit_depth == 8 && color_type != 3;
+
+        // padded by a byte for the 4 byte pixel loads
+        std::vector<uint8_t> zero_row(row_size + 1, 0);
+        std::vector<uint8_t> rows(is_direct ? 0 : row_size * 2 + 1);
+
+        const uint8_t* prior = zero_row.data();
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* src = filtered.get() + y * (row_size + 1);
+            uint8_t filter = src[0];
+            if (filter > 4) return std::nullopt;
+
+            uint8_t* dst = is_direct ? image.texels.get() + y * row_size : rows.data() + (y & 1) * row_size;
+            unfilter_row(filter, src + 1, prior, dst, row_size, pixel_size);
+            prior = dst;
+
+            if (is_direct) continue;
+
+            uint8_t* texels = image.texels.get() + static_cast<size_t>(y) * width * component_count;
+            uint32_t mask = (1U << bit_depth) - 1;
+
+            for (uint32_t x = 0; x < width; x++) {
+                uint32_t bit_offset = x * bit_depth;
+                uint32_t value = (dst[bit_offset >> 3] >> (8 - bit_depth - (bit_offset & 7))) & mask;
+
+                if (color_type == 0) {
+                    texels[x] = static_cast<uint8_t>(value * (0xFF / mask)); // scales low bit depths to the full range
+                } else {
+                    std::memcpy(texels + x * component_count, palette.data() + value * 4, component_count);
+                }
+            }
+        }
+
+        return image;
+    }
+}
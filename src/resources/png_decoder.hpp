@@ -0,0 +1,18 @@
+#pragma once
+
+#include "image_decoder.hpp"
+
+namespace photon {
+    // png decoder with a table driven inflate and sse2 unfiltering (3 and 4 byte pixels), for 8 bit gray, gray + alpha, rgb, rgba
+    // and palette images (incl. low bit depths), interlaced and 16 bit images are left to the stb fallback
+
+    // note: neither the chunk crcs nor the zlib adler32 are verified (as with stb_image)
+
+    class png_decoder final : public image_decoder {
+    public:
+        const char* get_name() const noexcept override { return "photon png"; }
+
+        bool can_decode(std::span<const std::byte> file) const noexcept override;
+        std::optional<decoded_image> decode(std::span<const std::byte> file) const noexcept override;
+    };
+}
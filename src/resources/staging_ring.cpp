@@ -0,0 +1,154 @@
+#include "staging_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace photon::rendering {
+    inline static VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment) noexcept {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    staging_ring::staging_ring(vulkan_device& device, VkDeviceSize ring_size) :
+        device{device},
+        ring_size{ring_size}
+    {
+        // the transfer queue copies most of the staged data, image updates are copied by the graphics queue (see asset_streamer::update())
+        std::array<uint32_t, 2> queue_families{ device.get_queue_family(true), device.get_queue_family(false) };
+        bool is_shared = queue_families[0] != queue_families[1];
+
+        vk::BufferCreateInfo buffer_info{
+            .size = ring_size,
+            .usage = vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = is_shared ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+            .queueFamilyIndexCount = is_shared ? 2U : 0U,
+            .pQueueFamilyIndices = queue_families.data(),
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        VkBuffer buf;
+        VmaAllocationInfo alloc_info;
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &alloc_cinfo, &buf, &ring_alloc, &alloc_info);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        ring_buffer = buf;
+        ring_data = static_cast<std::byte*>(alloc_info.pMappedData);
+    }
+
+    staging_ring::~staging_ring() noexcept {
+        assert(ring_head.load() == ring_tail.load() && "staging_ring destroyed with live allocations");
+
+        vmaDestroyBuffer(device.get_allocator(), ring_buffer, ring_alloc);
+    }
+
+    std::optional<staging_ring::allocation> staging_ring::alloc(VkDeviceSize size, VkDeviceSize alignment) noexcept {
+        if (size > ring_size) return std::nullopt;
+
+        uint64_t head = ring_head.load(std::memory_order_relaxed);
+        uint64_t tail = ring_tail.load(std::memory_order_acquire); // the device is done with memory before [tail]
+
+        VkDeviceSize head_offset = head % ring_size;
+        VkDeviceSize data_offset = align_up(head_offset, alignment);
+
+        uint64_t data_begin;
+
+        if (data_offset + size <= ring_size) {
+            data_begin = head + (data_offset - head_offset);
+        } else {
+            // wrap around, the rest of the buffer is padding
+            data_offset = 0;
+            data_begin = head + (ring_size - head_offset);
+        }
+
+        uint64_t data_end = data_begin + size;
+        if (data_end - tail > ring_size) return std::nullopt;
+
+        allocation alloc{
+            .mapped_data = ring_data + data_offset,
+            .buffer_offset = data_offset,
+            .size = size,
+            .range_begin = head,
+            .range_end = data_end,
+        };
+
+        ring_head.store(data_end, std::memory_order_relaxed);
+
+        if (data_end - tail > high_water_mark.load(std::memory_order_relaxed)) {
+            high_water_mark.store(data_end - tail, std::memory_order_relaxed);
+        }
+
+        return alloc;
+    }
+
+    void staging_ring::free(const allocation& alloc) noexcept {
+        std::lock_guard<std::mutex> l(free_lock);
+
+        uint64_t tail = ring_tail.load(std::memory_order_relaxed);
+        assert(alloc.range_begin >= tail);
+
+        freed_ranges.emplace(alloc.range_begin, alloc.range_end);
+
+        for (auto iter = freed_ranges.begin(); iter != freed_ranges.end() && iter->first == tail; iter = freed_ranges.erase(iter)) {
+            tail = iter->second;
+        }
+
+        ring_tail.store(tail, std::memory_order_release);
+    }
+
+    std::pair<staging_ring::allocation, staging_ring::allocation> staging_ring::split(const allocation& alloc, VkDeviceSize size) noexcept {
+        assert(size <= alloc.size);
+
+        // the padding stays with the first part, the virtual ranges stay contiguous so the tail advances over both once freed
+        uint64_t split_point = alloc.range_end - (alloc.size - size);
+
+        allocation first{
+            .mapped_data = alloc.mapped_data,
+            .buffer_offset = alloc.buffer_offset,
+            .size = size,
+            .range_begin = alloc.range_begin,
+            .range_end = split_point,
+        };
+
+        allocation second{
+            .mapped_data = static_cast<std::byte*>(alloc.mapped_data) + size,
+            .buffer_offset = alloc.buffer_offset + size,
+            .size = alloc.size - size,
+            .range_begin = split_point,
+            .range_end = alloc.range_end,
+        };
+
+        return { first, second };
+    }
+
+    VkDeviceSize staging_ring::get_max_alloc_size(VkDeviceSize alignment) const noexcept {
+        uint64_t head = ring_head.load(std::memory_order_relaxed);
+        VkDeviceSize free_size = ring_size - (head - ring_tail.load(std::memory_order_acquire));
+
+        VkDeviceSize head_offset = head % ring_size;
+        VkDeviceSize data_offset = align_up(head_offset, alignment);
+
+        VkDeviceSize max_size = 0;
+
+        // allocation right after the head
+        if (data_offset < ring_size && free_size > data_offset - head_offset) {
+            max_size = std::min(ring_size - data_offset, free_size - (data_offset - head_offset));
+        }
+
+        // allocation after wrapping around
+        if (free_size > ring_size - head_offset) {
+            max_size = std::max(max_size, free_size - (ring_size - head_offset));
+        }
+
+        return max_size;
+    }
+
+    void staging_ring::flush(const allocation& alloc) {
+        VkResult res = vmaFlushAllocation(device.get_allocator(), ring_alloc, alloc.buffer_offset, alloc.size);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaFlushAllocation");
+    }
+}
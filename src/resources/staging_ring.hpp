@@ -0,0 +1,76 @@
+#pragma once
+
+#include <rendering/vk_device.hpp>
+
+#include <map>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <utility>
+
+namespace photon::rendering {
+    // a persistent, mapped staging buffer which hands out linear suballocations in a ring
+
+    // allocations are addressed by "virtual" offsets which only ever grow (the buffer offset is [virtual % ring_size]),
+    // they can be freed in any order but the ring tail only advances over a contiguous run of freed allocations
+
+    // note: the ring is safe to use from one allocating thread while any threads free allocations
+
+    class staging_ring {
+    public:
+        struct allocation {
+            void* mapped_data;
+            VkDeviceSize buffer_offset; // offset of [mapped_data] in the ring buffer
+            VkDeviceSize size;
+
+            // the virtual range owned by this allocation (incl. alignment and wrap-around padding)
+            uint64_t range_begin;
+            uint64_t range_end;
+        };
+
+        staging_ring(vulkan_device& device, VkDeviceSize ring_size);
+        ~staging_ring() noexcept;
+
+        // returns nullopt if the ring doesn't have enough contiguous free space left
+        std::optional<allocation> alloc(VkDeviceSize size, VkDeviceSize alignment) noexcept;
+        void free(const allocation& alloc) noexcept;
+
+        // splits [alloc] into its first [size] bytes and the rest, both parts have to be freed separately
+        static std::pair<allocation, allocation> split(const allocation& alloc, VkDeviceSize size) noexcept;
+
+        // returns the size of the largest allocation (with [alignment]) which would currently succeed
+        VkDeviceSize get_max_alloc_size(VkDeviceSize alignment) const noexcept;
+
+        // makes host writes to [alloc] visible to the device, no-op for host coherent memory
+        void flush(const allocation& alloc);
+
+        vk::Buffer get_buffer() const noexcept { return ring_buffer; }
+
+        // the whole persistently mapped ring, allocations always lie within it
+        std::span<std::byte> get_mapped_data() const noexcept { return std::span(ring_data, ring_size); }
+
+        VkDeviceSize get_size() const noexcept { return ring_size; }
+        VkDeviceSize get_used_size() const noexcept { return ring_head.load(std::memory_order_relaxed) - ring_tail.load(std::memory_order_relaxed); }
+        VkDeviceSize get_high_water_mark() const noexcept { return high_water_mark.load(std::memory_order_relaxed); }
+
+    private:
+        vulkan_device& device;
+
+        vk::Buffer ring_buffer;
+        VmaAllocation ring_alloc;
+        std::byte* ring_data;
+
+        VkDeviceSize ring_size;
+
+        // [ring_head] is only written by the allocating thread, [ring_tail] and [freed_ranges] only by free()
+        std::atomic<uint64_t> ring_head = 0;
+        std::atomic<uint64_t> ring_tail = 0;
+
+        // freed allocations which are not yet reachable from [ring_tail], range_begin -> range_end
+        std::map<uint64_t, uint64_t> freed_ranges;
+        std::mutex free_lock; // guards [freed_ranges] and writes to [ring_tail]
+
+        std::atomic<VkDeviceSize> high_water_mark = 0;
+    };
+}
@@ -1,13 +1,32 @@
 #include "streamer.hpp"
+#include "asset_pack_format.hpp"
 #include <cassert>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include <core/abort.hpp>
 #include <core/logger.hpp>
 
 namespace photon::rendering {
-    asset_streamer::asset_streamer(rendering::vulkan_device& device, uint32_t max_frames_in_flight) noexcept :
+    static std::atomic<uint64_t> next_streamer_id = 0;
+
+    asset_streamer::asset_streamer(rendering::vulkan_device& device, uint32_t max_frames_in_flight, const streamer_config& config) noexcept :
         device{device},
         batch_cmd_buffer{device, max_frames_in_flight, true},
+        staging{device, config.staging_ring_size},
+        thread_staging_ring_size{config.thread_staging_ring_size},
+        streamer_id{next_streamer_id.fetch_add(1, std::memory_order_relaxed)},
+        use_submit_thread{config.use_submit_thread},
+        thread_cmd_buffer{device, max_frames_in_flight, true},
+        frame_byte_budget{config.frame_byte_budget},
+        frame_copy_budget{config.frame_copy_budget},
+        stream_aging_frames{config.stream_aging_frames},
         max_frames_in_flight{max_frames_in_flight}
     {
         try {
@@ -23,6 +42,36 @@ namespace photon::rendering {
 
                 batch_buffers.emplace_back(fence, device.get_device().createSemaphore(semaphore_info));
             }
+
+            update_staging_allocs.resize(max_frames_in_flight);
+
+            optimal_copy_alignment = device.get_physical_device().getProperties().limits.optimalBufferCopyOffsetAlignment;
+            finished_fence = multi_fence(device, fence_info);
+
+            if (device.has_host_visible_device_memory()) {
+                P_LOG_I("asset_streamer: host visible device memory available, direct uploads enabled");
+            }
+
+            if (config.use_gpu_transcoding) {
+                transcoder.emplace(device, max_frames_in_flight);
+            }
+
+            if (config.use_gpu_decompression) {
+                decompressor.emplace(device, max_frames_in_flight);
+            }
+
+            if (use_submit_thread) {
+                // the submit thread batches are not synchronized with frames, so they don't need a blocking semaphore
+
+                thread_batch_buffers.reserve(max_frames_in_flight);
+                for (uint32_t i = 0; i < max_frames_in_flight; i++) {
+                    multi_fence fence(device, fence_info);
+
+                    thread_batch_buffers.emplace_back(fence, vk::Semaphore{});
+                }
+
+                submit_thread = std::thread(&asset_streamer::run_submit_thread, this);
+            }
         } catch(std::exception& e) {
             P_LOG_E("Failed to init asset_streamer: {}", e.what());
             engine_abort();
@@ -30,81 +79,147 @@ namespace photon::rendering {
     }
 
     asset_streamer::~asset_streamer() noexcept {
+        if (submit_thread.joinable()) {
+            stop_submit_thread.store(true, std::memory_order_release);
+
+            submit_epoch.fetch_add(1, std::memory_order_release);
+            submit_epoch.notify_all();
+
+            submit_thread.join();
+        }
+
+        for (auto& batch : thread_batch_buffers) {
+            batch.ready_fence.wait(); // the device doesn't have to be idle yet when the submit thread stops
+
+            for (auto& alloc : batch.retired_staging_allocs) {
+                alloc.ring->free(alloc.alloc);
+            }
+        }
+
         for (auto& batch : batch_buffers) {
             assert(batch.ready_fence.status() == vk::Result::eSuccess); // assume device is idle
-            
-            // infos
 
-            for (auto& stream : batch.blocking.buffer_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-            }
-            for (auto& stream : batch.blocking.image_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
+            for (auto& alloc : batch.staging_allocs) {
+                alloc.ring->free(alloc.alloc);
             }
 
-            for (auto& stream : batch.deferred.buffer_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-            }
-            for (auto& stream : batch.deferred.image_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
+            for (auto& alloc : batch.retired_staging_allocs) {
+                alloc.ring->free(alloc.alloc);
             }
 
-            // retired infos
+            device.get_device().destroySemaphore(batch.blocking_ready_semaphore);
+        }
 
-            for (auto& stream : batch.retired_blocking.buffer_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-            }
-            for (auto& stream : batch.retired_blocking.image_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
+        for (auto& allocs : update_staging_allocs) {
+            for (auto& alloc : allocs) {
+                alloc.ring->free(alloc.alloc);
             }
+        }
 
-            for (auto& stream : batch.retired_deferred.buffer_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-            }
-            for (auto& stream : batch.retired_deferred.image_infos) {
-                vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-            }
+        for (auto& update : update_queue) {
+            if (update.staging_alloc.ring) update.staging_alloc.ring->free(update.staging_alloc.alloc);
+        }
 
-            device.get_device().destroySemaphore(batch.blocking_ready_semaphore);
+        drain_submissions(true, true);
+
+        for (auto& queue : stream_queues) {
+            for (auto& stream : queue) {
+                for (auto& copy : stream.staged_copies) {
+                    copy.staging_alloc.ring->free(copy.staging_alloc.alloc);
+                }
+            }
         }
+
+        P_LOG_D("asset_streamer staging high-water mark: {} / {} bytes (+ {} thread staging rings)", staging.get_high_water_mark(), staging.get_size(), thread_staging_rings.size());
+        P_LOG_D("asset_streamer direct stream bytes: {} host copy stream bytes: {}", direct_stream_bytes.load(), host_copy_stream_bytes.load());
+        P_LOG_D("asset_streamer decompressed stream bytes: {} (staged compressed: {})", decompressed_stream_bytes.load(), compressed_stream_bytes.load());
     }
 
     vk::Semaphore asset_streamer::submit_batch(uint32_t next_frame_index) {
         frame_buffer& batch = batch_buffers[current_frame_index];
         assert(batch.ready_fence.status() == vk::Result::eSuccess && "Stream batch reset before being finished");
 
-        batch.ready_fence.reset();
+        retire_batch(batch);
 
-        // cleanup retired staging buffers
+        // take over streams submitted since the last batch, the submit thread (if used) takes care of the non-blocking ones
 
-        for (auto& stream : batch.retired_blocking.buffer_infos) {
-            vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-        }
-        batch.retired_blocking.buffer_infos.clear();
-        
-        for (auto& stream : batch.retired_blocking.image_infos) {
-            vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
-        }
-        batch.retired_blocking.image_infos.clear();
+        drain_submissions(true, !use_submit_thread);
+        schedule_streams(batch, 0, use_submit_thread ? 1 : stream_priority_count);
+
+        submit_streams(batch, batch_cmd_buffer, current_frame_index);
+
+        current_frame_index = next_frame_index;
+
+        return batch.blocking_ready_semaphore;
+    }
+
+    void asset_streamer::run_submit_thread() noexcept {
+        uint32_t batch_index = 0;
+
+        try {
+            while (!stop_submit_thread.load(std::memory_order_acquire)) {
+                uint32_t epoch = submit_epoch.load(std::memory_order_acquire);
+
+                // wait for the oldest batch, keeping up to [max_frames_in_flight] batches in flight
+
+                frame_buffer& batch = thread_batch_buffers[batch_index];
+
+                vk::Result res = batch.ready_fence.wait();
+                vk::resultCheck(res, "waitForFences");
+
+                retire_batch(batch);
+
+                drain_submissions(false, true);
+                schedule_streams(batch, 1, stream_priority_count);
+
+                if (batch.deferred.buffer_copies.empty() && batch.deferred.image_copies.empty() && batch.finished_promises.empty() && batch.deferred.released_promises.empty()) {
+                    bool has_queued_streams = false;
+
+                    for (uint32_t i = 1; i < stream_priority_count; i++) {
+                        has_queued_streams |= !stream_queues[i].empty();
+                    }
 
-        for (auto& stream : batch.retired_deferred.buffer_infos) {
-            vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
+                    // nothing recorded, either sleep until new streams get submitted or wait for the next in-flight batch to free up staging space
+                    if (!has_queued_streams) {
+                        submit_epoch.wait(epoch, std::memory_order_acquire);
+                    } else {
+                        batch_index = (batch_index + 1) % thread_batch_buffers.size();
+                    }
+
+                    continue;
+                }
+
+                submit_streams(batch, thread_cmd_buffer, batch_index);
+                batch_index = (batch_index + 1) % thread_batch_buffers.size();
+            }
+        } catch (std::exception& e) {
+            P_LOG_E("Error in the asset_streamer submit thread: {}", e.what());
+            engine_abort();
         }
-        batch.retired_deferred.buffer_infos.clear();
-        
-        for (auto& stream : batch.retired_deferred.image_infos) {
-            vmaDestroyBuffer(device.get_allocator(), stream.staging_buf, stream.staging_alloc);
+    }
+
+    void asset_streamer::retire_batch(frame_buffer& batch) noexcept {
+        // release staging memory of the retired batch
+
+        for (auto& alloc : batch.retired_staging_allocs) {
+            alloc.ring->free(alloc.alloc);
         }
-        batch.retired_deferred.image_infos.clear();
+        batch.retired_staging_allocs.clear();
+    }
+
+    void asset_streamer::submit_streams(frame_buffer& batch, batch_buffer& cmd_buffer, uint32_t batch_index) {
+        batch.ready_fence.reset();
+        cmd_buffer.reset_batch(batch_index);
 
-        batch_cmd_buffer.reset_batch(current_frame_index);
+        graphics_work blocking_work{ .is_blocking = true };
+        graphics_work deferred_work{ .is_blocking = false };
 
-        vk::CommandBuffer blocking_cmd = begin_stream_recording();
-        record_streams(blocking_cmd, batch.blocking);
+        vk::CommandBuffer blocking_cmd = begin_stream_recording(cmd_buffer);
+        record_streams(blocking_cmd, batch.blocking, blocking_work);
         blocking_cmd.end();
 
-        vk::CommandBuffer deferred_cmd = begin_stream_recording();
-        record_streams(deferred_cmd, batch.deferred);
+        vk::CommandBuffer deferred_cmd = begin_stream_recording(cmd_buffer);
+        record_streams(deferred_cmd, batch.deferred, deferred_work);
         deferred_cmd.end();
 
         // submit current batch
@@ -117,7 +232,7 @@ namespace photon::rendering {
                 .commandBufferCount = 1,
                 .pCommandBuffers = &blocking_cmd,
 
-                .signalSemaphoreCount = 1,
+                .signalSemaphoreCount = batch.blocking_ready_semaphore ? 1U : 0U,
                 .pSignalSemaphores = &batch.blocking_ready_semaphore,
             },
 
@@ -132,119 +247,1649 @@ namespace photon::rendering {
             },
         };
 
-        batch_cmd_buffer.submit_batch(submit_infos, batch.ready_fence.get_fence());
-        current_frame_index = max_frames_in_flight;
+        cmd_buffer.submit_batch(submit_infos, batch.ready_fence.get_fence());
+
+        for (auto& promise : batch.finished_promises) {
+            promise.bind(batch.ready_fence);
+        }
+        batch.finished_promises.clear();
 
-        // retire in-use infos
-        batch.retired_blocking = std::move(batch.blocking);
-        batch.retired_deferred = std::move(batch.deferred);
+        // released streams are finished once the graphics queue family acquires them
 
-        batch.blocking = frame_buffer::streams_buffer();
-        batch.deferred = frame_buffer::streams_buffer();
+        blocking_work.promises = std::move(batch.blocking.released_promises);
+        deferred_work.promises = std::move(batch.deferred.released_promises);
+        batch.blocking.released_promises.clear();
+        batch.deferred.released_promises.clear();
 
-        current_frame_index = next_frame_index;
+        for (graphics_work* work : { &blocking_work, &deferred_work }) {
+            work->release_fence = batch.ready_fence.view();
+            work->batch_fence = batch.ready_fence;
 
-        return batch.blocking_ready_semaphore;
+            queue_graphics_work(std::move(*work));
+        }
+
+        // retire in-use staging memory
+
+        batch.blocking.buffer_copies.clear();
+        batch.blocking.image_copies.clear();
+        batch.deferred.buffer_copies.clear();
+        batch.deferred.image_copies.clear();
+
+        std::swap(batch.retired_staging_allocs, batch.staging_allocs);
     }
 
-    multi_fence_view asset_streamer::stream(const buffer_stream_info& stream, bool is_deferred) noexcept {
-        frame_buffer& batch = batch_buffers[current_frame_index];
-        assert(current_frame_index != max_frames_in_flight && "Tried to stream to a buffer which is already submited!");
-        
-        if (is_deferred) {
-            batch.deferred.buffer_infos.emplace_back(stream);
-        } else {
-            batch.blocking.buffer_infos.emplace_back(stream);
+    void asset_streamer::queue_graphics_work(graphics_work&& work) {
+        if (work.buffer_barriers.empty() && work.image_barriers.empty() && work.mip_generations.empty() && work.promises.empty()) return;
+
+        std::lock_guard<std::mutex> l(graphics_work_lock);
+        graphics_work_queue.emplace_back(std::move(work));
+    }
+
+    bool asset_streamer::has_graphics_commands() noexcept {
+        if (transcoder && transcoder->has_work()) return true;
+        if (decompressor && decompressor->has_work()) return true;
+
+        {
+            std::lock_guard<std::mutex> l(update_lock);
+            if (!update_queue.empty()) return true;
         }
 
-        return batch.ready_fence.view();
+        std::lock_guard<std::mutex> l(graphics_work_lock);
+        return !graphics_work_queue.empty();
     }
 
-    multi_fence_view asset_streamer::stream(const image_stream_info& stream, bool is_deferred) noexcept {
-        frame_buffer& batch = batch_buffers[current_frame_index];
-        assert(current_frame_index != max_frames_in_flight && "Tried to stream to a buffer which is already submited!");
-        
-        if (is_deferred) {
-            batch.deferred.image_infos.emplace_back(stream);
-        } else {
-            batch.blocking.image_infos.emplace_back(stream);
+    void asset_streamer::record_graphics_commands(vk::CommandBuffer cmd, uint32_t frame_index) {
+        record_graphics_work(cmd);
+
+        // transcodes and decompressions read the scratch resources finished by the graphics work above
+        if (transcoder) transcoder->record(cmd, frame_index, finished_fence);
+        if (decompressor) decompressor->record(cmd, frame_index, finished_fence);
+
+        record_updates(cmd, frame_index);
+    }
+
+    multi_fence_view asset_streamer::update(const image_update_info& update, const void* data, VkDeviceSize data_size) noexcept {
+        // the region is packed like a single level stream
+        image_stream_info region_stream{
+            .image = update.image,
+            .format = update.format,
+            .normal_layout = update.normal_layout,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .image_subresource = update.image_subresource,
+            .level_count = 1,
+            .generated_level_count = 0,
+            .image_offset = update.image_offset,
+            .image_extent = update.image_extent,
+            .dst_alloc = VK_NULL_HANDLE,
+            .is_host_copyable = false,
+        };
+
+        VkDeviceSize expected_size = get_image_stream_size(region_stream);
+
+        if (data_size != expected_size) {
+            P_LOG_E("Unexpected image update size! (expected: {} received: {})", expected_size, data_size);
+            engine_abort();
+        }
+
+        // updates are copied at once, they aren't split into chunks like streams
+        if (data_size > thread_staging_ring_size) {
+            P_LOG_E("Image update doesn't fit into a staging ring! (size: {} ring size: {})", data_size, thread_staging_ring_size);
+            engine_abort();
+        }
+
+        queued_update queued{
+            .target = update,
+        };
+
+        multi_fence_view view = queued.ready_promise.view();
+
+        try {
+            staging_ring& ring = get_thread_staging();
+
+            if (std::optional<staging_ring::allocation> alloc = ring.alloc(data_size, get_image_copy_alignment(update.format))) {
+                std::memcpy(alloc->mapped_data, data, data_size);
+                ring.flush(alloc.value());
+
+                queued.staging_alloc = { &ring, alloc.value() };
+            } else {
+                // staged by the recording thread
+                queued.data.assign(static_cast<const std::byte*>(data), static_cast<const std::byte*>(data) + data_size);
+            }
+
+            std::lock_guard<std::mutex> l(update_lock);
+            update_queue.emplace_back(std::move(queued));
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to queue an image update: {}", e.what());
+            engine_abort();
         }
 
-        return batch.ready_fence.view();
+        return view;
     }
 
-    void asset_streamer::record_streams(vk::CommandBuffer cmd, const frame_buffer::streams_buffer& streams) noexcept {
-        // perform buffer transfers
+    void asset_streamer::record_updates(vk::CommandBuffer cmd, uint32_t frame_index) {
+        // the previous submission of [frame_index] is finished, and so are its updates
+
+        for (auto& alloc : update_staging_allocs[frame_index]) {
+            alloc.ring->free(alloc.alloc);
+        }
+        update_staging_allocs[frame_index].clear();
+
+        std::vector<queued_update> updates;
+
+        {
+            std::lock_guard<std::mutex> l(update_lock);
+
+            // stage the updates kept on the host, the ones after the first which doesn't fit wait for a later frame to keep their order
+
+            size_t staged_count = 0;
+
+            for (; staged_count < update_queue.size(); staged_count++) {
+                queued_update& queued = update_queue[staged_count];
+                if (queued.staging_alloc.ring) continue;
+
+                staging_ring& ring = get_thread_staging();
+                std::optional<staging_ring::allocation> alloc = ring.alloc(queued.data.size(), get_image_copy_alignment(queued.target.format));
+                if (!alloc) break;
+
+                std::memcpy(alloc->mapped_data, queued.data.data(), queued.data.size());
+                ring.flush(alloc.value());
+
+                queued.staging_alloc = { &ring, alloc.value() };
+                queued.data = {};
+            }
+
+            updates.assign(std::make_move_iterator(update_queue.begin()), std::make_move_iterator(update_queue.begin() + staged_count));
+            update_queue.erase(update_queue.begin(), update_queue.begin() + staged_count);
+        }
+
+        if (updates.empty()) return;
+
+        // one transition per updated layer from its normal layout (not eUndefined, which would discard the rest of it), duplicates are skipped
+
+        std::vector<vk::ImageMemoryBarrier2> barriers;
+
+        for (const queued_update& queued : updates) {
+            const image_update_info& update = queued.target;
+
+            for (uint32_t layer = 0; layer < update.image_subresource.layerCount; layer++) {
+                vk::ImageSubresourceRange range{
+                    .aspectMask = update.image_subresource.aspectMask,
+                    .baseMipLevel = update.image_subresource.mipLevel,
+                    .levelCount = 1,
+                    .baseArrayLayer = update.image_subresource.baseArrayLayer + layer,
+                    .layerCount = 1,
+                };
+
+                bool is_duplicate = std::any_of(barriers.begin(), barriers.end(), [&](const vk::ImageMemoryBarrier2& barrier) {
+                    return barrier.image == update.image && barrier.subresourceRange == range;
+                });
+
+                if (is_duplicate) continue;
+
+                barriers.emplace_back(vk::ImageMemoryBarrier2{
+                    .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                    .srcAccessMask = vk::AccessFlagBits2::eMemoryWrite,
+                    .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                    .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                    .oldLayout = update.normal_layout,
+                    .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .image = update.image,
+                    .subresourceRange = range,
+                });
+            }
+        }
+
+        vk::DependencyInfo update_dep{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pImageMemoryBarriers = barriers.data(),
+        };
+
+        cmd.pipelineBarrier2(update_dep);
+
+        // overlapping updates of the same image are separated by a barrier, so the later one wins
+
+        auto is_overlapping = [](const image_update_info& a, const image_update_info& b) {
+            auto overlaps = [](int32_t a_begin, uint32_t a_size, int32_t b_begin, uint32_t b_size) {
+                return a_begin < b_begin + static_cast<int32_t>(b_size) && b_begin < a_begin + static_cast<int32_t>(a_size);
+            };
+
+            return a.image == b.image && a.image_subresource.mipLevel == b.image_subresource.mipLevel &&
+                overlaps(a.image_subresource.baseArrayLayer, a.image_subresource.layerCount, b.image_subresource.baseArrayLayer, b.image_subresource.layerCount) &&
+                overlaps(a.image_offset.x, a.image_extent.width, b.image_offset.x, b.image_extent.width) &&
+                overlaps(a.image_offset.y, a.image_extent.height, b.image_offset.y, b.image_extent.height) &&
+                overlaps(a.image_offset.z, a.image_extent.depth, b.image_offset.z, b.image_extent.depth);
+        };
+
+        std::vector<const image_update_info*> written; // since the last barrier
+
+        for (queued_update& queued : updates) {
+            const image_update_info& update = queued.target;
+
+            if (std::any_of(written.begin(), written.end(), [&](const image_update_info* other) { return is_overlapping(*other, update); })) {
+                vk::MemoryBarrier2 write_barrier{
+                    .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                    .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                    .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                    .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                };
+
+                vk::DependencyInfo write_dep{
+                    .memoryBarrierCount = 1,
+                    .pMemoryBarriers = &write_barrier,
+                };
+
+                cmd.pipelineBarrier2(write_dep);
+                written.clear();
+            }
+
+            vk::BufferImageCopy region{
+                .bufferOffset = queued.staging_alloc.alloc.buffer_offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = update.image_subresource,
+                .imageOffset = update.image_offset,
+                .imageExtent = update.image_extent,
+            };
+
+            cmd.copyBufferToImage(queued.staging_alloc.ring->get_buffer(), update.image, vk::ImageLayout::eTransferDstOptimal, region);
+            written.emplace_back(&update);
+
+            update_staging_allocs[frame_index].emplace_back(queued.staging_alloc);
+
+            // note: graphics work recorded after this point is ordered after the copy
+            queued.ready_promise.bind(finished_fence);
+        }
+
+        for (vk::ImageMemoryBarrier2& barrier : barriers) {
+            barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+            barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+            barrier.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+            barrier.dstAccessMask = vk::AccessFlagBits2::eMemoryRead;
+            std::swap(barrier.oldLayout, barrier.newLayout);
+        }
+
+        cmd.pipelineBarrier2(update_dep);
+    }
+
+    bool asset_streamer::is_transcode_supported(vk::Format data_format, vk::Format format) noexcept {
+        return transcoder && transcoder->is_supported(data_format, format);
+    }
+
+    void asset_streamer::record_graphics_work(vk::CommandBuffer cmd) {
+        std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+        std::vector<vk::ImageMemoryBarrier2> image_barriers;
+        std::vector<mip_generation> mip_generations;
+
+        std::lock_guard<std::mutex> l(graphics_work_lock);
+
+        // deferred releases are only acquired once their batch is finished as the graphics queue doesn't wait for them
+
+        for (auto iter = graphics_work_queue.begin(); iter != graphics_work_queue.end();) {
+            if (!iter->is_blocking && iter->release_fence.status() != vk::Result::eSuccess) {
+                iter++;
+                continue;
+            }
+
+            buffer_barriers.insert(buffer_barriers.end(), iter->buffer_barriers.begin(), iter->buffer_barriers.end());
+            image_barriers.insert(image_barriers.end(), iter->image_barriers.begin(), iter->image_barriers.end());
+            mip_generations.insert(mip_generations.end(), iter->mip_generations.begin(), iter->mip_generations.end());
+
+            // note: graphics work recorded after this point is ordered after the acquire, so the promises can report ready as soon as the release is finished
+            for (auto& promise : iter->promises) {
+                promise.bind(iter->batch_fence);
+            }
 
-        for (uint32_t i = 0; i < streams.buffer_infos.size(); i++) {
-            cmd.copyBuffer(streams.buffer_infos[i].staging_buf, streams.buffer_infos[i].buf, streams.buffer_infos[i].transfer_region);
+            iter = graphics_work_queue.erase(iter);
         }
 
-        // transition images to dst optimal
+        // the generated levels start as undefined, the streamed ones are made visible to the blits (unless already acquired)
 
-        std::vector<vk::ImageMemoryBarrier2> image_transitions; 
-        image_transitions.resize(streams.image_infos.size());
+        for (const mip_generation& generation : mip_generations) {
+            vk::ImageSubresourceRange generated_range = generation.streamed_range;
+            generated_range.baseMipLevel += generation.streamed_range.levelCount;
+            generated_range.levelCount = generation.level_count;
 
-        for (uint32_t i = 0; i < streams.image_infos.size(); i++) {
-            image_transitions[i] = vk::ImageMemoryBarrier2{
+            image_barriers.emplace_back(vk::ImageMemoryBarrier2{
                 .srcStageMask = {},
                 .srcAccessMask = {},
                 .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
                 .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
-                .oldLayout = vk::ImageLayout::eUndefined, // no need to preserve data
+                .oldLayout = vk::ImageLayout::eUndefined,
                 .newLayout = vk::ImageLayout::eTransferDstOptimal,
-                .image = streams.image_infos[i].image,
-                .subresourceRange{
-                    .aspectMask = streams.image_infos[i].image_subresource.aspectMask,
-                    .baseMipLevel = streams.image_infos[i].image_subresource.mipLevel,
-                    .levelCount = 1,
-                    .baseArrayLayer = streams.image_infos[i].image_subresource.layerCount,
-                    .layerCount = streams.image_infos[i].image_subresource.layerCount,
-                }
-            };
+                .image = generation.image,
+                .subresourceRange = generated_range,
+            });
+
+            if (generation.is_acquired) continue;
+
+            image_barriers.emplace_back(vk::ImageMemoryBarrier2{
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+                .oldLayout = generation.streamed_layout,
+                .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+                .image = generation.image,
+                .subresourceRange = generation.streamed_range,
+            });
         }
 
-        vk::DependencyInfo in_dep{
-            .dependencyFlags = vk::DependencyFlagBits::eByRegion,
-            .imageMemoryBarrierCount = image_transitions.size(),
-            .pImageMemoryBarriers = image_transitions.data(),
+        if (buffer_barriers.empty() && image_barriers.empty()) return;
+
+        vk::DependencyInfo acquire_dep{
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size()),
+            .pBufferMemoryBarriers = buffer_barriers.data(),
+            .imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size()),
+            .pImageMemoryBarriers = image_barriers.data(),
         };
 
-        cmd.pipelineBarrier2(in_dep);
+        cmd.pipelineBarrier2(acquire_dep);
 
-        // perform staging to dst copy
+        record_mip_generations(cmd, mip_generations);
+    }
+
+    void asset_streamer::record_mip_generations(vk::CommandBuffer cmd, const std::vector<mip_generation>& generations) {
+        if (generations.empty()) return;
+
+        std::vector<vk::ImageMemoryBarrier2> level_barriers;
+
+        // blit one level of every image at a time, so each step needs only a single barrier
+
+        for (uint32_t step = 0;; step++) {
+            level_barriers.clear();
+
+            for (const mip_generation& generation : generations) {
+                if (step >= generation.level_count) continue;
+
+                uint32_t dst_level = generation.streamed_range.baseMipLevel + generation.streamed_range.levelCount + step;
+
+                vk::Extent3D src_extent{ std::max(1U, generation.last_level_extent.width >> step), std::max(1U, generation.last_level_extent.height >> step), std::max(1U, generation.last_level_extent.depth >> step) };
+                vk::Extent3D dst_extent{ std::max(1U, src_extent.width >> 1), std::max(1U, src_extent.height >> 1), std::max(1U, src_extent.depth >> 1) };
+
+                vk::ImageBlit2 region{
+                    .srcSubresource{
+                        .aspectMask = generation.streamed_range.aspectMask,
+                        .mipLevel = dst_level - 1,
+                        .baseArrayLayer = generation.streamed_range.baseArrayLayer,
+                        .layerCount = generation.streamed_range.layerCount,
+                    },
+                    .srcOffsets = std::array<vk::Offset3D, 2>{ vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ static_cast<int32_t>(src_extent.width), static_cast<int32_t>(src_extent.height), static_cast<int32_t>(src_extent.depth) } },
+                    .dstSubresource{
+                        .aspectMask = generation.streamed_range.aspectMask,
+                        .mipLevel = dst_level,
+                        .baseArrayLayer = generation.streamed_range.baseArrayLayer,
+                        .layerCount = generation.streamed_range.layerCount,
+                    },
+                    .dstOffsets = std::array<vk::Offset3D, 2>{ vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ static_cast<int32_t>(dst_extent.width), static_cast<int32_t>(dst_extent.height), static_cast<int32_t>(dst_extent.depth) } },
+                };
+
+                bool is_filterable = static_cast<bool>(device.get_physical_device().getFormatProperties(generation.format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+
+                vk::BlitImageInfo2 blit_info{
+                    .srcImage = generation.image,
+                    .srcImageLayout = vk::ImageLayout::eTransferSrcOptimal,
+                    .dstImage = generation.image,
+                    .dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .regionCount = 1,
+                    .pRegions = &region,
+                    .filter = is_filterable ? vk::Filter::eLinear : vk::Filter::eNearest,
+                };
+
+                cmd.blitImage2(blit_info);
+
+                // the generated level is the source of the next step
+
+                level_barriers.emplace_back(vk::ImageMemoryBarrier2{
+                    .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                    .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                    .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                    .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+                    .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                    .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+                    .image = generation.image,
+                    .subresourceRange{
+                        .aspectMask = generation.streamed_range.aspectMask,
+                        .baseMipLevel = dst_level,
+                        .levelCount = 1,
+                        .baseArrayLayer = generation.streamed_range.baseArrayLayer,
+                        .layerCount = generation.streamed_range.layerCount,
+                    },
+                });
+            }
+
+            if (level_barriers.empty()) break;
+
+            vk::DependencyInfo level_dep{
+                .imageMemoryBarrierCount = static_cast<uint32_t>(level_barriers.size()),
+                .pImageMemoryBarriers = level_barriers.data(),
+            };
 
-        for (uint32_t i = 0; i < streams.image_infos.size(); i++) {
-            cmd.copyBufferToImage(streams.image_infos[i].staging_buf, streams.image_infos[i].image, vk::ImageLayout::eTransferDstOptimal, streams.image_infos[i].transfer_region);
+            cmd.pipelineBarrier2(level_dep);
         }
 
-        // transition to normal layout and transfer ownership
+        // transition the whole chains to their normal layouts at once
+
+        level_barriers.clear();
 
-        for (uint32_t i = 0; i < streams.image_infos.size(); i++) {
-            image_transitions[i] = vk::ImageMemoryBarrier2{
+        for (const mip_generation& generation : generations) {
+            vk::ImageSubresourceRange chain_range = generation.streamed_range;
+            chain_range.levelCount += generation.level_count;
+
+            level_barriers.emplace_back(vk::ImageMemoryBarrier2{
                 .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
-                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
-                .dstStageMask = {}, // vk::PipelineStageFlagBits2::eBottomOfPipe,
-                .dstAccessMask = {}, // vk::AccessFlagBits2::eMemoryRead,
-                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
-                .newLayout = streams.image_infos[i].normal_layout,
-                .image = streams.image_infos[i].image,
-                .subresourceRange{
-                    .aspectMask = streams.image_infos[i].image_subresource.aspectMask,
-                    .baseMipLevel = streams.image_infos[i].image_subresource.mipLevel,
-                    .levelCount = 1,
-                    .baseArrayLayer = streams.image_infos[i].image_subresource.layerCount,
-                    .layerCount = streams.image_infos[i].image_subresource.layerCount,
-                },
-            };  
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferSrcOptimal,
+                .newLayout = generation.normal_layout,
+                .image = generation.image,
+                .subresourceRange = chain_range,
+            });
+        }
+
+        vk::DependencyInfo normal_dep{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(level_barriers.size()),
+            .pImageMemoryBarriers = level_barriers.data(),
+        };
+
+        cmd.pipelineBarrier2(normal_dep);
+    }
+
+    bool asset_streamer::is_graphics_finished(const stream_target& target) const noexcept {
+        if (const image_stream_info* image_stream = std::get_if<image_stream_info>(&target)) {
+            return image_stream->generated_level_count || is_ownership_transfer(image_stream->sharing_mode);
+        }
+
+        return is_ownership_transfer(std::get<buffer_stream_info>(target).sharing_mode);
+    }
+
+    bool asset_streamer::is_ownership_transfer(vk::SharingMode sharing_mode) const noexcept {
+        return sharing_mode == vk::SharingMode::eExclusive && device.get_queue_family(true) != device.get_queue_family(false);
+    }
+
+    bool asset_streamer::is_transcoded(const image_stream_info& stream) const noexcept {
+        return stream.data_format != vk::Format::eUndefined && stream.data_format != stream.format;
+    }
+
+    asset_streamer::pending_stream asset_streamer::begin_transcode(const image_stream_info& stream, stream_priority priority) noexcept {
+        if (!is_transcode_supported(stream.data_format, stream.format) || stream.image_subresource.layerCount != 1 || stream.image_extent.depth != 1 ||
+            stream.image_offset != vk::Offset3D{ 0, 0, 0 }) {
+            P_LOG_E("Unsupported image stream transcode! ({} to {})", vk::to_string(stream.data_format), vk::to_string(stream.format));
+            engine_abort();
+        }
+
+        // the data is streamed into the transcode's scratch image (incl. the mip generation), which is encoded into [stream.image] afterwards
+
+        std::shared_ptr<texture_transcoder::transcode> transcode;
+
+        try {
+            transcode = transcoder->create_transcode({
+                .image = stream.image,
+                .format = stream.format,
+                .data_format = stream.data_format,
+                .normal_layout = stream.normal_layout,
+                .base_level = stream.image_subresource.mipLevel,
+                .level_count = stream.level_count + stream.generated_level_count,
+                .extent = { stream.image_extent.width, stream.image_extent.height },
+            });
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to create a transcode: {}", e.what());
+            engine_abort();
+        }
+
+        image_stream_info scratch_stream{
+            .image = transcode->scratch_image,
+            .format = stream.data_format,
+            .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .image_subresource{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .level_count = stream.level_count,
+            .generated_level_count = stream.generated_level_count,
+            .image_offset = { 0, 0, 0 },
+            .image_extent = stream.image_extent,
+            .dst_alloc = VK_NULL_HANDLE,
+            .is_host_copyable = false,
+        };
+
+        pending_stream pending = begin_stream(scratch_stream, priority);
+        pending.transcode = std::move(transcode);
+
+        return pending;
+    }
+
+    bool asset_streamer::is_decompression_supported(const image_stream_info& stream) const noexcept {
+        if (!decompressor || is_transcoded(stream) || stream.generated_level_count) return false;
+
+        // the levels are copied from the output at their offsets in the range, which have to be valid image copy offsets
+        VkDeviceSize row_alignment = std::lcm(static_cast<VkDeviceSize>(vk::blockSize(stream.format)), VkDeviceSize{4});
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            if (get_image_stream_layout(stream, level).row_size % row_alignment != 0) return false;
+        }
+
+        return true;
+    }
+
+    multi_fence_view asset_streamer::stream_compressed(const buffer_stream_info& stream, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        if (!decompressor) {
+            P_LOG_E("Compressed streams need gpu decompression!");
+            engine_abort();
+        }
+
+        return queue_decompression({
+            .buf = stream.buf,
+            .dst_offset = stream.dst_offset,
+            .range_alignment = 4,
+        }, data, data_size, priority);
+    }
+
+    multi_fence_view asset_streamer::stream_compressed(const image_stream_info& stream, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        if (!is_decompression_supported(stream)) {
+            P_LOG_E("Unsupported compressed image stream! ({})", vk::to_string(stream.format));
+            engine_abort();
+        }
+
+        VkDeviceSize expected_size = get_image_stream_size(stream);
+
+        if (data_size != expected_size) {
+            P_LOG_E("Unexpected image stream size! (expected: {} received: {})", expected_size, data_size);
+            engine_abort();
         }
 
-        vk::DependencyInfo out_dep{
-            .dependencyFlags = vk::DependencyFlagBits::eByRegion,
-            .imageMemoryBarrierCount = image_transitions.size(),
-            .pImageMemoryBarriers = image_transitions.data(),
+        gpu_decompressor::decompression_info info{
+            .image = stream.image,
+            .normal_layout = stream.normal_layout,
+            .subresource_range{
+                .aspectMask = stream.image_subresource.aspectMask,
+                .baseMipLevel = stream.image_subresource.mipLevel,
+                .levelCount = stream.level_count,
+                .baseArrayLayer = stream.image_subresource.baseArrayLayer,
+                .layerCount = stream.image_subresource.layerCount,
+            },
+            .range_alignment = std::lcm(static_cast<VkDeviceSize>(vk::blockSize(stream.format)), VkDeviceSize{4}),
         };
 
-        cmd.pipelineBarrier2(out_dep); 
+        // the levels follow each other in the range, packed like the data of stream()
+
+        VkDeviceSize level_offset = 0;
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            image_stream_layout layout = get_image_stream_layout(stream, level);
+
+            info.regions.push_back({
+                .bufferOffset = level_offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource{
+                    .aspectMask = stream.image_subresource.aspectMask,
+                    .mipLevel = stream.image_subresource.mipLevel + level,
+                    .baseArrayLayer = stream.image_subresource.baseArrayLayer,
+                    .layerCount = stream.image_subresource.layerCount,
+                },
+                .imageOffset = layout.level_offset,
+                .imageExtent = layout.level_extent,
+            });
+
+            level_offset += layout.level_size;
+        }
+
+        return queue_decompression(std::move(info), data, data_size, priority);
+    }
+
+    multi_fence_view asset_streamer::queue_decompression(gpu_decompressor::decompression_info&& info, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        const std::byte* stored = data.stored.data();
+
+        auto get_chunk_offset = [&](uint64_t chunk) {
+            uint64_t offset;
+            std::memcpy(&offset, stored + chunk * sizeof(uint64_t), sizeof(offset));
+
+            return offset;
+        };
+
+        uint64_t first_chunk = data.offset / pack::chunk_size;
+        uint64_t end_chunk = pack::get_chunk_count(data.offset + data_size);
+
+        // the chunk offsets are rebased onto the input buffer, which starts with the uint32 offsets of the covered chunks
+        VkDeviceSize table_size = (end_chunk - first_chunk + 1) * sizeof(uint32_t);
+
+        bool is_valid = data_size > 0 && data.offset + data_size <= data.payload_size &&
+            data.stored.size() >= (pack::get_chunk_count(data.payload_size) + 1) * sizeof(uint64_t) && end_chunk - first_chunk <= 65535;
+
+        for (uint64_t chunk = first_chunk; is_valid && chunk < end_chunk; chunk++) {
+            is_valid = get_chunk_offset(chunk) <= get_chunk_offset(chunk + 1);
+        }
+
+        uint64_t chunks_begin = is_valid ? get_chunk_offset(first_chunk) : 0;
+        uint64_t chunks_end = is_valid ? get_chunk_offset(end_chunk) : 0;
+
+        if (!is_valid || chunks_end > data.stored.size() || table_size + (chunks_end - chunks_begin) > std::numeric_limits<uint32_t>::max()) {
+            P_LOG_E("Invalid compressed stream! (range: {} + {} payload size: {})", data.offset, data_size, data.payload_size);
+            engine_abort();
+        }
+
+        info.chunk_count = static_cast<uint32_t>(end_chunk - first_chunk);
+        info.last_chunk_size = static_cast<uint32_t>(std::min(pack::chunk_size, data.payload_size - (end_chunk - 1) * pack::chunk_size));
+        info.input_size = table_size + (chunks_end - chunks_begin);
+        info.range_offset = data.offset - first_chunk * pack::chunk_size;
+        info.range_size = data_size;
+
+        std::shared_ptr<gpu_decompressor::decompression> decompression;
+
+        try {
+            decompression = decompressor->create_decompression(std::move(info));
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to create a decompression: {}", e.what());
+            engine_abort();
+        }
+
+        // the chunks are staged as stored
+
+        pending_stream pending = begin_stream(buffer_stream_info{
+            .buf = decompression->input_buffer,
+            .dst_offset = 0,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .dst_alloc = VK_NULL_HANDLE,
+        }, decompression->info.input_size, priority);
+
+        std::byte* input = pending.get_data().data();
+
+        for (uint64_t chunk = first_chunk; chunk <= end_chunk; chunk++) {
+            uint32_t offset = static_cast<uint32_t>(table_size + get_chunk_offset(chunk) - chunks_begin);
+            std::memcpy(input + (chunk - first_chunk) * sizeof(uint32_t), &offset, sizeof(offset));
+        }
+
+        std::memcpy(input + table_size, stored + chunks_begin, chunks_end - chunks_begin);
+
+        decompressed_stream_bytes.fetch_add(data_size, std::memory_order_relaxed);
+        compressed_stream_bytes.fetch_add(decompression->info.input_size, std::memory_order_relaxed);
+
+        multi_fence_view input_ready = commit_stream(std::move(pending));
+
+        try {
+            return decompressor->queue_decompression(std::move(decompression), input_ready);
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to queue a decompression: {}", e.what());
+            engine_abort();
+        }
+    }
+
+    void asset_streamer::drain_submissions(bool include_blocking, bool include_deferred) {
+        auto enqueue = [this](queued_stream&& stream) {
+            stream_queues[static_cast<uint32_t>(stream.priority)].emplace_back(std::move(stream));
+        };
+
+        if (include_blocking) submission_queues[0].drain(enqueue);
+        if (include_deferred) submission_queues[1].drain(enqueue);
+    }
+
+    staging_ring& asset_streamer::get_schedule_staging(bool is_blocking) {
+        // [staging] belongs to the thread scheduling non-blocking streams, with the submit thread
+        // blocking streams are scheduled by a different thread so they use that thread's ring
+        return use_submit_thread && is_blocking ? get_thread_staging() : staging;
+    }
+
+    multi_fence_view asset_streamer::stream(const buffer_stream_info& stream, const void* data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        if (std::optional<multi_fence_view> ready_fence = write_unstaged(stream, static_cast<const std::byte*>(data), data_size)) return ready_fence.value();
+
+        return queue_stream(stream, static_cast<const std::byte*>(data), data_size, priority);
+    }
+
+    multi_fence_view asset_streamer::stream(const image_stream_info& stream, const void* data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        if (is_transcoded(stream)) {
+            pending_stream pending = begin_stream(stream, priority);
+
+            if (data_size != pending.get_data().size()) {
+                P_LOG_E("Unexpected image stream size! (expected: {} received: {})", pending.get_data().size(), data_size);
+                engine_abort();
+            }
+
+            std::memcpy(pending.get_data().data(), data, data_size);
+            return commit_stream(std::move(pending));
+        }
+
+        VkDeviceSize expected_size = get_image_stream_size(stream);
+
+        if (data_size != expected_size) {
+            P_LOG_E("Unexpected image stream size! (expected: {} received: {})", expected_size, data_size);
+            engine_abort();
+        }
+
+        // the first level has the largest minimal chunk
+        VkDeviceSize min_chunk_size = get_min_chunk_size(get_image_stream_layout(stream, 0));
+
+        if (min_chunk_size > staging.get_size()) {
+            P_LOG_E("Image stream can't be split into chunks fitting the staging ring! (min chunk size: {} ring size: {})", min_chunk_size, staging.get_size());
+            engine_abort();
+        }
+
+        if (std::optional<multi_fence_view> ready_fence = write_unstaged(stream, static_cast<const std::byte*>(data))) return ready_fence.value();
+
+        return queue_stream(stream, static_cast<const std::byte*>(data), data_size, priority);
+    }
+
+    asset_streamer::pending_stream asset_streamer::begin_stream(const buffer_stream_info& stream, VkDeviceSize data_size, stream_priority priority) noexcept {
+        return reserve_stream(stream, data_size, priority, buffer_copy_alignment);
+    }
+
+    asset_streamer::pending_stream asset_streamer::begin_stream(const image_stream_info& stream, stream_priority priority) noexcept {
+        if (is_transcoded(stream)) return begin_transcode(stream, priority);
+
+        // the reservation is sliced into chunks at block row boundaries, which are only valid copy offsets if all rows are aligned
+
+        VkDeviceSize row_alignment = std::lcm(static_cast<VkDeviceSize>(vk::blockSize(stream.format)), VkDeviceSize{4});
+        bool is_sliceable = true;
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            is_sliceable &= get_image_stream_layout(stream, level).row_size % row_alignment == 0;
+        }
+
+        return reserve_stream(stream, get_image_stream_size(stream), priority, is_sliceable ? get_image_copy_alignment(stream.format) : 0);
+    }
+
+    asset_streamer::pending_stream& asset_streamer::pending_stream::operator=(pending_stream&& other) noexcept {
+        if (this == &other) return *this;
+
+        release();
+
+        target = std::move(other.target);
+        priority = other.priority;
+        ring = std::exchange(other.ring, nullptr);
+        staging_alloc = other.staging_alloc;
+        host_data = std::move(other.host_data); // note: moving keeps the buffer, so [data] stays valid
+        data = std::exchange(other.data, {});
+        transcode = std::move(other.transcode);
+
+        return *this;
+    }
+
+    void asset_streamer::pending_stream::release() noexcept {
+        if (!ring) return;
+
+        // note: empty ranges must not be freed, they could collide with the range of the next allocation
+        if (staging_alloc.range_end != staging_alloc.range_begin) ring->free(staging_alloc);
+
+        ring = nullptr;
+        data = {};
+    }
+
+    asset_streamer::pending_stream asset_streamer::reserve_stream(const stream_target& target, VkDeviceSize data_size, stream_priority priority, VkDeviceSize alignment) noexcept {
+        pending_stream pending;
+        pending.target = target;
+        pending.priority = priority;
+
+        try {
+            staging_ring& ring = get_thread_staging();
+            std::optional<staging_ring::allocation> alloc;
+            if (alignment) alloc = ring.alloc(data_size, alignment);
+
+            if (alloc) {
+                pending.ring = &ring;
+                pending.staging_alloc = alloc.value();
+                pending.data = std::span(static_cast<std::byte*>(alloc->mapped_data), data_size);
+            } else {
+                // doesn't fit into staging at once, commit_stream() will stream it like stream() does
+                pending.host_data.resize(data_size);
+                pending.data = pending.host_data;
+            }
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to reserve a stream: {}", e.what());
+            engine_abort();
+        }
+
+        return pending;
+    }
+
+    multi_fence_view asset_streamer::commit_stream(pending_stream&& pending) noexcept {
+        if (pending.transcode) {
+            std::shared_ptr<texture_transcoder::transcode> transcode = std::move(pending.transcode);
+
+            multi_fence_view scratch_ready = commit_stream(std::move(pending));
+
+            try {
+                return transcoder->queue_transcode(std::move(transcode), scratch_ready);
+            } catch (std::exception& e) {
+                P_LOG_E("Failed to queue a transcode: {}", e.what());
+                engine_abort();
+            }
+        }
+
+        if (!pending.ring) {
+            return std::visit([&](const auto& target) { return stream(target, pending.data.data(), pending.data.size(), pending.priority); }, pending.target);
+        }
+
+        // the unstaged paths read straight from the reservation, which is released afterwards
+
+        std::optional<multi_fence_view> ready_fence = std::visit([&](const auto& target) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(target)>, buffer_stream_info>) {
+                return write_unstaged(target, pending.data.data(), pending.data.size());
+            } else {
+                return write_unstaged(target, pending.data.data());
+            }
+        }, pending.target);
+
+        if (ready_fence) {
+            pending.release();
+            return ready_fence.value();
+        }
+
+        queued_stream stream{
+            .target = pending.target,
+            .priority = pending.priority,
+            .waiting_frames = 0,
+            .data_offset = 0,
+            .data_size = pending.data.size(),
+            .staged_size = 0,
+        };
+
+        multi_fence_view view = stream.ready_promise.view();
+
+        try {
+            pending.ring->flush(pending.staging_alloc);
+            slice_stream(stream, *pending.ring, pending.staging_alloc);
+            pending.ring = nullptr; // the staged copies own the reservation now
+
+            submit_stream(std::move(stream));
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to commit a stream: {}", e.what());
+            engine_abort();
+        }
+
+        return view;
+    }
+
+    std::optional<multi_fence_view> asset_streamer::write_unstaged(const buffer_stream_info& stream, const std::byte* data, VkDeviceSize data_size) noexcept {
+        try {
+            // host writes are visible to all later submissions, so the stream is finished right away
+            if (stream.dst_alloc && write_direct(stream, data, data_size)) return finished_fence.view();
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to write a buffer stream directly: {}", e.what());
+            engine_abort();
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<multi_fence_view> asset_streamer::write_unstaged(const image_stream_info& stream, const std::byte* data) noexcept {
+        try {
+            // prefer host image copies, then direct writes
+
+            multi_fence_promise ready_promise;
+
+            if (stream.is_host_copyable && copy_host_image(stream, data, ready_promise)) return ready_promise.view();
+            if (stream.dst_alloc && !stream.generated_level_count && write_direct(stream, data, ready_promise)) return ready_promise.view();
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to write an image stream directly: {}", e.what());
+            engine_abort();
+        }
+
+        return std::nullopt;
+    }
+
+    bool asset_streamer::is_host_visible(VmaAllocation alloc) noexcept {
+        VkMemoryPropertyFlags memory_flags;
+        vmaGetAllocationMemoryProperties(device.get_allocator(), alloc, &memory_flags);
+
+        return memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    bool asset_streamer::write_direct(const buffer_stream_info& stream, const std::byte* data, VkDeviceSize data_size) {
+        if (!is_host_visible(stream.dst_alloc)) return false;
+
+        // note: the allocation can be mapped by multiple threads at once, VMA reference counts the mappings
+
+        void* mapped_data;
+        VkResult res = vmaMapMemory(device.get_allocator(), stream.dst_alloc, &mapped_data);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaMapMemory");
+
+        std::memcpy(static_cast<std::byte*>(mapped_data) + stream.dst_offset, data, data_size);
+
+        res = vmaFlushAllocation(device.get_allocator(), stream.dst_alloc, stream.dst_offset, data_size);
+        vmaUnmapMemory(device.get_allocator(), stream.dst_alloc);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaFlushAllocation");
+
+        direct_stream_bytes.fetch_add(data_size, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool asset_streamer::write_direct(const image_stream_info& stream, const std::byte* data, multi_fence_promise& ready_promise) {
+        if (!is_host_visible(stream.dst_alloc)) return false;
+
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(stream.format);
+        uint8_t block_size = vk::blockSize(stream.format);
+
+        void* mapped_data;
+        VkResult res = vmaMapMemory(device.get_allocator(), stream.dst_alloc, &mapped_data);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaMapMemory");
+
+        // copy the packed block rows into the (row pitched) subresources
+
+        const std::byte* src = data;
+        bool is_3d = stream.image_extent.depth > 1;
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            image_stream_layout layout = get_image_stream_layout(stream, level);
+
+            VkDeviceSize x_offset = static_cast<VkDeviceSize>(layout.level_offset.x / block_extent[0]) * block_size;
+            uint32_t y_offset = layout.level_offset.y / block_extent[1];
+
+            for (uint32_t plane = 0; plane < layout.plane_count; plane++) {
+                vk::ImageSubresource subresource{
+                    .aspectMask = stream.image_subresource.aspectMask,
+                    .mipLevel = stream.image_subresource.mipLevel + level,
+                    .arrayLayer = stream.image_subresource.baseArrayLayer + (is_3d ? 0 : plane),
+                };
+
+                vk::SubresourceLayout subresource_layout = device.get_device().getImageSubresourceLayout(stream.image, subresource);
+
+                std::byte* dst = static_cast<std::byte*>(mapped_data) + subresource_layout.offset + x_offset + y_offset * subresource_layout.rowPitch;
+                if (is_3d) dst += (layout.level_offset.z + plane) * subresource_layout.depthPitch;
+
+                for (uint32_t row = 0; row < layout.plane_rows; row++) {
+                    std::memcpy(dst + row * subresource_layout.rowPitch, src, layout.row_size);
+                    src += layout.row_size;
+                }
+            }
+        }
+
+        res = vmaFlushAllocation(device.get_allocator(), stream.dst_alloc, 0, VK_WHOLE_SIZE);
+        vmaUnmapMemory(device.get_allocator(), stream.dst_alloc);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaFlushAllocation");
+
+        direct_stream_bytes.fetch_add(src - data, std::memory_order_relaxed);
+
+        // the layout transition (which preserves the preinitialized contents) is recorded on the graphics queue
+
+        graphics_work transition{
+            .is_blocking = true, // host writes don't have to be waited for
+            .batch_fence = finished_fence,
+        };
+
+        transition.image_barriers.emplace_back(vk::ImageMemoryBarrier2{
+            .srcStageMask = {},
+            .srcAccessMask = {},
+            .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+            .oldLayout = vk::ImageLayout::ePreinitialized,
+            .newLayout = stream.normal_layout,
+            .image = stream.image,
+            .subresourceRange{
+                .aspectMask = stream.image_subresource.aspectMask,
+                .baseMipLevel = stream.image_subresource.mipLevel,
+                .levelCount = stream.level_count,
+                .baseArrayLayer = stream.image_subresource.baseArrayLayer,
+                .layerCount = stream.image_subresource.layerCount,
+            },
+        });
+
+        transition.promises.emplace_back(ready_promise);
+        queue_graphics_work(std::move(transition));
+
+        return true;
+    }
+
+    bool asset_streamer::copy_host_image(const image_stream_info& stream, const std::byte* data, multi_fence_promise& ready_promise) {
+        // the host copy can write straight to [normal_layout], so there is no transition afterwards (unless mips are generated on the graphics queue)
+        vk::ImageLayout host_layout = stream.generated_level_count ? vk::ImageLayout::eGeneral : stream.normal_layout;
+
+        if (!device.is_host_image_copy_supported(stream.format, host_layout)) return false;
+
+        vk::HostImageLayoutTransitionInfoEXT transition{
+            .image = stream.image,
+            .oldLayout = vk::ImageLayout::eUndefined, // no need to preserve data
+            .newLayout = host_layout,
+            .subresourceRange{
+                .aspectMask = stream.image_subresource.aspectMask,
+                .baseMipLevel = stream.image_subresource.mipLevel,
+                .levelCount = stream.level_count,
+                .baseArrayLayer = stream.image_subresource.baseArrayLayer,
+                .layerCount = stream.image_subresource.layerCount,
+            },
+        };
+
+        device.get_device().transitionImageLayoutEXT(transition);
+
+        // one region per level, the packed stream layout matches tightly packed host memory
+
+        std::vector<vk::MemoryToImageCopyEXT> regions;
+        regions.reserve(stream.level_count);
+
+        VkDeviceSize level_begin = 0;
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            image_stream_layout layout = get_image_stream_layout(stream, level);
+
+            vk::MemoryToImageCopyEXT region{
+                .pHostPointer = data + level_begin,
+                .memoryRowLength = 0,
+                .memoryImageHeight = 0,
+                .imageSubresource = stream.image_subresource,
+                .imageOffset = layout.level_offset,
+                .imageExtent = layout.level_extent,
+            };
+
+            region.imageSubresource.mipLevel += level;
+            regions.emplace_back(region);
+
+            level_begin += layout.level_size;
+        }
+
+        vk::CopyMemoryToImageInfoEXT copy_info{
+            .dstImage = stream.image,
+            .dstImageLayout = host_layout,
+            .regionCount = static_cast<uint32_t>(regions.size()),
+            .pRegions = regions.data(),
+        };
+
+        device.get_device().copyMemoryToImageEXT(copy_info);
+
+        host_copy_stream_bytes.fetch_add(level_begin, std::memory_order_relaxed);
+
+        if (!stream.generated_level_count) {
+            ready_promise.bind(finished_fence);
+            return true;
+        }
+
+        graphics_work generation{
+            .is_blocking = true, // host copies don't have to be waited for
+            .batch_fence = finished_fence,
+        };
+
+        generation.mip_generations.emplace_back(mip_generation{
+            .image = stream.image,
+            .format = stream.format,
+            .streamed_layout = host_layout,
+            .normal_layout = stream.normal_layout,
+            .is_acquired = false,
+            .streamed_range = transition.subresourceRange,
+            .last_level_extent = get_image_stream_layout(stream, stream.level_count - 1).level_extent,
+            .level_count = stream.generated_level_count,
+        });
+
+        generation.promises.emplace_back(ready_promise);
+        queue_graphics_work(std::move(generation));
+
+        return true;
+    }
+
+    multi_fence_view asset_streamer::queue_stream(const stream_target& target, const std::byte* data, VkDeviceSize data_size, stream_priority priority) noexcept {
+        queued_stream stream{
+            .target = target,
+            .priority = priority,
+            .waiting_frames = 0,
+            .data_offset = 0,
+            .data_size = data_size,
+            .staged_size = 0,
+        };
+
+        multi_fence_view ready_fence = stream.ready_promise.view();
+
+        try {
+            if (!stage_stream(stream, data, 0, get_thread_staging())) {
+                // out of staging space, keep the rest of the data until it can be staged by the following batches
+
+                stream.data.assign(data + stream.staged_size, data + data_size);
+                stream.data_offset = stream.staged_size;
+            }
+
+            submit_stream(std::move(stream));
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to stage a stream: {}", e.what());
+            engine_abort();
+        }
+
+        return ready_fence;
+    }
+
+    void asset_streamer::submit_stream(queued_stream&& stream) {
+        bool is_blocking = stream.priority == stream_priority::blocking;
+        submission_queues[is_blocking ? 0 : 1].push(std::move(stream));
+
+        if (!is_blocking && use_submit_thread) {
+            submit_epoch.fetch_add(1, std::memory_order_release);
+            submit_epoch.notify_one();
+        }
+    }
+
+    staging_ring& asset_streamer::get_thread_staging() {
+        // note: keyed by [streamer_id] and not by this, so a streamer reusing the address of a destroyed one doesn't find stale rings
+        thread_local std::vector<std::pair<uint64_t, staging_ring*>> thread_rings;
+
+        for (auto& [id, ring] : thread_rings) {
+            if (id == streamer_id) return *ring;
+        }
+
+        std::lock_guard<std::mutex> l(thread_staging_lock);
+        staging_ring* ring = thread_staging_rings.emplace_back(std::make_unique<staging_ring>(device, thread_staging_ring_size)).get();
+
+        thread_rings.emplace_back(streamer_id, ring);
+        return *ring;
+    }
+
+    std::span<std::byte> asset_streamer::get_thread_staging_memory() noexcept {
+        try {
+            return get_thread_staging().get_mapped_data();
+        } catch (std::exception& e) {
+            P_LOG_E("Failed to create a staging ring: {}", e.what());
+            engine_abort();
+        }
+    }
+
+    VkDeviceSize asset_streamer::get_staging_high_water_mark() noexcept {
+        std::lock_guard<std::mutex> l(thread_staging_lock);
+        VkDeviceSize high_water_mark = staging.get_high_water_mark();
+
+        for (auto& ring : thread_staging_rings) {
+            high_water_mark = std::max(high_water_mark, ring->get_high_water_mark());
+        }
+
+        return high_water_mark;
+    }
+
+    bool asset_streamer::stage_stream(queued_stream& stream, const std::byte* data, VkDeviceSize data_offset, staging_ring& ring) {
+        if (const buffer_stream_info* buffer_stream = std::get_if<buffer_stream_info>(&stream.target)) {
+            while (stream.staged_size < stream.data_size) {
+                VkDeviceSize chunk_size = std::min({ stream.data_size - stream.staged_size, ring.get_max_alloc_size(buffer_copy_alignment), frame_byte_budget });
+                if (!chunk_size) return false;
+
+                std::optional<staging_ring::allocation> alloc = ring.alloc(chunk_size, buffer_copy_alignment);
+                if (!alloc) return false;
+
+                std::memcpy(alloc->mapped_data, data + (stream.staged_size - data_offset), chunk_size);
+                ring.flush(alloc.value());
+
+                add_buffer_copy(stream, *buffer_stream, ring, alloc.value());
+            }
+
+            return true;
+        }
+
+        const image_stream_info& image_stream = std::get<image_stream_info>(stream.target);
+        VkDeviceSize alignment = get_image_copy_alignment(image_stream.format);
+
+        while (stream.staged_size < stream.data_size) {
+            image_chunk chunk = get_image_chunk(image_stream, stream.staged_size, ring.get_max_alloc_size(alignment));
+            if (!chunk.size) return false;
+
+            std::optional<staging_ring::allocation> alloc = ring.alloc(chunk.size, alignment);
+            if (!alloc) return false;
+
+            std::memcpy(alloc->mapped_data, data + (stream.staged_size - data_offset), chunk.size);
+            ring.flush(alloc.value());
+
+            add_image_copy(stream, image_stream, chunk.region, ring, alloc.value());
+        }
+
+        return true;
+    }
+
+    void asset_streamer::slice_stream(queued_stream& stream, staging_ring& ring, staging_ring::allocation alloc) {
+        // cut the reservation into the same chunks stage_stream() would have staged, each part is freed separately
+
+        while (stream.staged_size < stream.data_size) {
+            VkDeviceSize chunk_size;
+            vk::BufferImageCopy image_region;
+
+            if (std::holds_alternative<buffer_stream_info>(stream.target)) {
+                chunk_size = std::min(alloc.size, frame_byte_budget);
+            } else {
+                image_chunk chunk = get_image_chunk(std::get<image_stream_info>(stream.target), stream.staged_size, alloc.size);
+
+                chunk_size = chunk.size;
+                image_region = chunk.region;
+            }
+
+            assert(chunk_size && "Failed to slice a stream reservation");
+
+            auto [chunk_alloc, rest_alloc] = staging_ring::split(alloc, chunk_size);
+            alloc = rest_alloc;
+
+            if (const buffer_stream_info* buffer_stream = std::get_if<buffer_stream_info>(&stream.target)) {
+                add_buffer_copy(stream, *buffer_stream, ring, chunk_alloc);
+            } else {
+                add_image_copy(stream, std::get<image_stream_info>(stream.target), image_region, ring, chunk_alloc);
+            }
+        }
+
+        // note: empty ranges must not be freed, they could collide with the range of the next allocation
+        if (alloc.range_end != alloc.range_begin) ring.free(alloc);
+    }
+
+    void asset_streamer::add_buffer_copy(queued_stream& stream, const buffer_stream_info& buffer_stream, staging_ring& ring, const staging_ring::allocation& alloc) {
+        stream.staged_copies.emplace_back(staged_copy{
+            .copy = buffer_copy{
+                .staging_buf = ring.get_buffer(),
+                .buf = buffer_stream.buf,
+                .region = {
+                    .srcOffset = alloc.buffer_offset,
+                    .dstOffset = buffer_stream.dst_offset + stream.staged_size,
+                    .size = alloc.size,
+                },
+                .stream_offset = buffer_stream.dst_offset,
+                .stream_size = stream.data_size,
+                .is_last_copy = stream.staged_size + alloc.size == stream.data_size,
+                .is_released = is_ownership_transfer(buffer_stream.sharing_mode),
+            },
+            .staging_alloc = { &ring, alloc },
+        });
+
+        stream.staged_size += alloc.size;
+    }
+
+    void asset_streamer::add_image_copy(queued_stream& stream, const image_stream_info& image_stream, vk::BufferImageCopy region, staging_ring& ring, const staging_ring::allocation& alloc) {
+        region.bufferOffset = alloc.buffer_offset;
+
+        stream.staged_copies.emplace_back(staged_copy{
+            .copy = image_copy{
+                .staging_buf = ring.get_buffer(),
+                .image = image_stream.image,
+                .normal_layout = image_stream.normal_layout,
+                .subresource_range{
+                    .aspectMask = image_stream.image_subresource.aspectMask,
+                    .baseMipLevel = image_stream.image_subresource.mipLevel,
+                    .levelCount = image_stream.level_count,
+                    .baseArrayLayer = image_stream.image_subresource.baseArrayLayer,
+                    .layerCount = image_stream.image_subresource.layerCount,
+                },
+                .region = region,
+                .format = image_stream.format,
+                .last_level_extent = get_image_stream_layout(image_stream, image_stream.level_count - 1).level_extent,
+                .generated_level_count = image_stream.generated_level_count,
+                .is_first_copy = stream.staged_size == 0,
+                .is_last_copy = stream.staged_size + alloc.size == stream.data_size,
+                .is_released = is_ownership_transfer(image_stream.sharing_mode),
+            },
+            .staging_alloc = { &ring, alloc },
+        });
+
+        stream.staged_size += alloc.size;
+    }
+
+    asset_streamer::image_chunk asset_streamer::get_image_chunk(const image_stream_info& stream, VkDeviceSize stream_offset, VkDeviceSize max_size) const noexcept {
+        // find the level containing [stream_offset], chunks never cross mip levels (small levels just end up as separate regions of the same copy command)
+
+        uint32_t level = 0;
+        VkDeviceSize level_begin = 0;
+
+        image_stream_layout layout = get_image_stream_layout(stream, level);
+
+        while (stream_offset >= level_begin + layout.level_size) {
+            level_begin += layout.level_size;
+            layout = get_image_stream_layout(stream, ++level);
+        }
+
+        VkDeviceSize plane_size = layout.row_size * layout.plane_rows;
+        max_size = std::min(max_size, std::max(frame_byte_budget, get_min_chunk_size(layout)));
+
+        // split the level either into whole planes (slices / layers) or block rows of a single plane
+
+        uint32_t row_index = (stream_offset - level_begin) / layout.row_size;
+        uint32_t plane_index = row_index / layout.plane_rows;
+        uint32_t plane_row = row_index % layout.plane_rows;
+
+        uint32_t plane_count = 1;
+        uint32_t row_count = layout.plane_rows;
+
+        if (plane_row == 0 && plane_size <= max_size) {
+            plane_count = std::min<VkDeviceSize>(max_size / plane_size, layout.plane_count - plane_index);
+        } else {
+            row_count = std::min<VkDeviceSize>(max_size / layout.row_size, layout.plane_rows - plane_row);
+
+            if (plane_row + row_count < layout.plane_rows) {
+                row_count = layout.rows_granularity ? row_count - row_count % layout.rows_granularity : 0;
+            }
+        }
+
+        if (!row_count) return image_chunk{ .size = 0 };
+
+        vk::BufferImageCopy region{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = stream.image_subresource,
+            .imageOffset = layout.level_offset,
+            .imageExtent = layout.level_extent,
+        };
+
+        region.imageSubresource.mipLevel += level;
+
+        if (stream.image_extent.depth > 1) {
+            region.imageOffset.z += plane_index;
+            region.imageExtent.depth = plane_count;
+        } else {
+            region.imageSubresource.baseArrayLayer += plane_index;
+            region.imageSubresource.layerCount = plane_count;
+        }
+
+        region.imageOffset.y += plane_row * layout.block_height;
+        region.imageExtent.height = std::min(row_count * layout.block_height, layout.level_extent.height - plane_row * layout.block_height);
+
+        return image_chunk{
+            .size = layout.row_size * row_count * plane_count,
+            .region = region,
+        };
+    }
+
+    VkDeviceSize asset_streamer::get_image_stream_size(const image_stream_info& stream) const noexcept {
+        VkDeviceSize size = 0;
+
+        for (uint32_t level = 0; level < stream.level_count; level++) {
+            size += get_image_stream_layout(stream, level).level_size;
+        }
+
+        return size;
+    }
+
+    void asset_streamer::schedule_streams(frame_buffer& batch, uint32_t priority_begin, uint32_t priority_end) {
+        VkDeviceSize bytes_left = frame_byte_budget;
+        uint32_t copies_left = frame_copy_budget;
+
+        // streams are recorded in queue order, a stream which can't be finished in this batch (out of staging space or budget)
+        // holds back every stream queued after it, lower priorities included, so streams finish in the order they were queued
+        bool is_stalled = false;
+
+        for (uint32_t priority = priority_begin; priority < priority_end && !is_stalled; priority++) {
+            bool is_blocking = priority == static_cast<uint32_t>(stream_priority::blocking);
+            if (!is_blocking && (!bytes_left || !copies_left)) break;
+
+            frame_buffer::streams_buffer& streams = is_blocking ? batch.blocking : batch.deferred;
+            std::deque<queued_stream>& queue = stream_queues[priority];
+
+            while (!queue.empty()) {
+                if (!is_blocking && (!bytes_left || !copies_left)) {
+                    is_stalled = true;
+                    break;
+                }
+
+                queued_stream& stream = queue.front();
+
+                // stage the host part of the stream into freed up staging space
+
+                if (stream.staged_size < stream.data_size && stage_stream(stream, stream.data.data(), stream.data_offset, get_schedule_staging(is_blocking))) {
+                    stream.data = std::vector<std::byte>();
+                }
+
+                // record staged copies within the budget, blocking streams are always recorded (but still use up the budget)
+                // note: a single copy larger than the whole budget is allowed into an otherwise empty batch
+
+                while (!stream.staged_copies.empty()) {
+                    staged_copy& copy = stream.staged_copies.front();
+
+                    bool is_budget_unused = bytes_left == frame_byte_budget && copies_left == frame_copy_budget;
+                    if (!is_blocking && !is_budget_unused && (copy.staging_alloc.alloc.size > bytes_left || !copies_left)) break;
+
+                    if (const buffer_copy* buf_copy = std::get_if<buffer_copy>(&copy.copy)) {
+                        streams.buffer_copies.emplace_back(*buf_copy);
+                    } else {
+                        streams.image_copies.emplace_back(std::get<image_copy>(copy.copy));
+                    }
+
+                    batch.staging_allocs.emplace_back(copy.staging_alloc);
+
+                    bytes_left -= std::min(bytes_left, copy.staging_alloc.alloc.size);
+                    copies_left -= std::min(copies_left, 1U);
+
+                    stream.staged_copies.pop_front();
+                }
+
+                if (stream.staged_size == stream.data_size && stream.staged_copies.empty()) {
+                    if (is_graphics_finished(stream.target)) {
+                        streams.released_promises.emplace_back(std::move(stream.ready_promise));
+                    } else {
+                        batch.finished_promises.emplace_back(std::move(stream.ready_promise));
+                    }
+                    queue.pop_front();
+
+                    continue;
+                }
+
+                is_stalled = true;
+                break;
+            }
+        }
+
+        // age up starved streams (normal -> high, background -> normal), never into blocking
+
+        for (uint32_t priority = std::max(priority_begin, static_cast<uint32_t>(stream_priority::normal)); priority < priority_end; priority++) {
+            std::deque<queued_stream>& queue = stream_queues[priority];
+
+            for (auto iter = queue.begin(); iter != queue.end();) {
+                if (++iter->waiting_frames < stream_aging_frames) {
+                    iter++;
+                    continue;
+                }
+
+                iter->waiting_frames = 0;
+                iter->priority = static_cast<stream_priority>(priority - 1);
+
+                stream_queues[priority - 1].emplace_back(std::move(*iter));
+                iter = queue.erase(iter);
+            }
+        }
+    }
+
+    asset_streamer::image_stream_layout asset_streamer::get_image_stream_layout(const image_stream_info& stream, uint32_t level) const noexcept {
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(stream.format);
+        uint8_t block_size = vk::blockSize(stream.format);
+
+        vk::Extent3D granularity = device.get_image_transfer_granularity(true);
+
+        vk::Offset3D level_offset{ stream.image_offset.x >> level, stream.image_offset.y >> level, stream.image_offset.z >> level };
+        vk::Extent3D level_extent{ std::max(1U, stream.image_extent.width >> level), std::max(1U, stream.image_extent.height >> level), std::max(1U, stream.image_extent.depth >> level) };
+
+        uint32_t block_columns = (level_extent.width + block_extent[0] - 1) / block_extent[0];
+        uint32_t block_rows = (level_extent.height + block_extent[1] - 1) / block_extent[1];
+        uint32_t plane_count = level_extent.depth * stream.image_subresource.layerCount;
+
+        assert((stream.image_extent.depth == 1 || stream.image_subresource.layerCount == 1) && "3D images can't have multiple array layers");
+
+        return image_stream_layout{
+            .level_offset = level_offset,
+            .level_extent = level_extent,
+            .level_size = static_cast<VkDeviceSize>(block_columns) * block_size * block_rows * plane_count,
+            .row_size = static_cast<VkDeviceSize>(block_columns) * block_size,
+            .block_height = block_extent[1],
+            .plane_rows = block_rows,
+            .plane_count = plane_count,
+            .rows_granularity = granularity.width ? std::max<uint32_t>(1, (granularity.height + block_extent[1] - 1) / block_extent[1]) : 0,
+        };
+    }
+
+    VkDeviceSize asset_streamer::get_min_chunk_size(const image_stream_layout& layout) const noexcept {
+        return layout.rows_granularity ? layout.row_size * std::min(layout.rows_granularity, layout.plane_rows) : layout.row_size * layout.plane_rows;
+    }
+
+    VkDeviceSize asset_streamer::get_image_copy_alignment(vk::Format format) const noexcept {
+        // buffer offsets of image copies must be a multiple of the texel block size and 4
+        return std::lcm(std::lcm(static_cast<VkDeviceSize>(vk::blockSize(format)), VkDeviceSize{4}), optimal_copy_alignment);
+    }
+
+    void asset_streamer::record_streams(vk::CommandBuffer cmd, const frame_buffer::streams_buffer& streams, graphics_work& work) {
+        uint32_t transfer_family = device.get_queue_family(true);
+        uint32_t graphics_family = device.get_queue_family(false);
+
+        // group copies by staging buffer and destination (stable, so chunks of a stream keep their order),
+        // each group is recorded as a single multi-region copy
+
+        std::vector<uint32_t> copy_order;
+
+        copy_order.resize(streams.buffer_copies.size());
+        std::iota(copy_order.begin(), copy_order.end(), 0);
+
+        std::stable_sort(copy_order.begin(), copy_order.end(), [&](uint32_t a, uint32_t b) {
+            const buffer_copy& copy_a = streams.buffer_copies[a];
+            const buffer_copy& copy_b = streams.buffer_copies[b];
+
+            return std::tie(copy_a.staging_buf, copy_a.buf) < std::tie(copy_b.staging_buf, copy_b.buf);
+        });
+
+        // perform buffer transfers
+
+        std::vector<vk::BufferCopy> buffer_regions;
+
+        for (uint32_t i = 0; i < copy_order.size(); i++) {
+            const buffer_copy& copy = streams.buffer_copies[copy_order[i]];
+            buffer_regions.emplace_back(copy.region);
+
+            if (i + 1 < copy_order.size()) {
+                const buffer_copy& next_copy = streams.buffer_copies[copy_order[i + 1]];
+                if (next_copy.staging_buf == copy.staging_buf && next_copy.buf == copy.buf) continue;
+            }
+
+            cmd.copyBuffer(copy.staging_buf, copy.buf, buffer_regions);
+            buffer_regions.clear();
+        }
+
+        // transition images to dst optimal (only for the first copy of a stream, chunks in later batches find the image already in dst optimal)
+
+        std::vector<vk::ImageMemoryBarrier2> image_transitions;
+        image_transitions.reserve(streams.image_copies.size());
+
+        for (uint32_t i = 0; i < streams.image_copies.size(); i++) {
+            if (!streams.image_copies[i].is_first_copy) continue;
+
+            image_transitions.emplace_back(vk::ImageMemoryBarrier2{
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined, // no need to preserve data
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .image = streams.image_copies[i].image,
+                .subresourceRange = streams.image_copies[i].subresource_range,
+            });
+        }
+
+        if (!image_transitions.empty()) {
+            vk::DependencyInfo in_dep{
+                .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+                .imageMemoryBarrierCount = static_cast<uint32_t>(image_transitions.size()),
+                .pImageMemoryBarriers = image_transitions.data(),
+            };
+
+            cmd.pipelineBarrier2(in_dep);
+        }
+
+        // perform staging to dst copy
+
+        copy_order.resize(streams.image_copies.size());
+        std::iota(copy_order.begin(), copy_order.end(), 0);
+
+        std::stable_sort(copy_order.begin(), copy_order.end(), [&](uint32_t a, uint32_t b) {
+            const image_copy& copy_a = streams.image_copies[a];
+            const image_copy& copy_b = streams.image_copies[b];
+
+            return std::tie(copy_a.staging_buf, copy_a.image) < std::tie(copy_b.staging_buf, copy_b.image);
+        });
+
+        std::vector<vk::BufferImageCopy> image_regions;
+
+        for (uint32_t i = 0; i < copy_order.size(); i++) {
+            const image_copy& copy = streams.image_copies[copy_order[i]];
+            image_regions.emplace_back(copy.region);
+
+            if (i + 1 < copy_order.size()) {
+                const image_copy& next_copy = streams.image_copies[copy_order[i + 1]];
+                if (next_copy.staging_buf == copy.staging_buf && next_copy.image == copy.image) continue;
+            }
+
+            cmd.copyBufferToImage(copy.staging_buf, copy.image, vk::ImageLayout::eTransferDstOptimal, image_regions);
+            image_regions.clear();
+        }
+
+        // transition to normal layout and release ownership to the graphics queue family (once the last chunk of a stream is copied)
+
+        std::vector<vk::BufferMemoryBarrier2> buffer_releases;
+        image_transitions.clear();
+
+        for (uint32_t i = 0; i < streams.buffer_copies.size(); i++) {
+            const buffer_copy& copy = streams.buffer_copies[i];
+            if (!copy.is_last_copy || !copy.is_released) continue;
+
+            vk::BufferMemoryBarrier2 release{
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = {},
+                .dstAccessMask = {},
+                .srcQueueFamilyIndex = transfer_family,
+                .dstQueueFamilyIndex = graphics_family,
+                .buffer = copy.buf,
+                .offset = copy.stream_offset,
+                .size = copy.stream_size,
+            };
+
+            buffer_releases.emplace_back(release);
+
+            // the acquire must match the release, except for its own stage and access scope
+            release.srcStageMask = {};
+            release.srcAccessMask = {};
+            release.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+            release.dstAccessMask = vk::AccessFlagBits2::eMemoryRead;
+
+            work.buffer_barriers.emplace_back(release);
+        }
+
+        for (uint32_t i = 0; i < streams.image_copies.size(); i++) {
+            const image_copy& copy = streams.image_copies[i];
+            if (!copy.is_last_copy) continue;
+
+            // images generating mips stay in transfer src until the generation finishes
+
+            vk::ImageMemoryBarrier2 transition{
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = {}, // vk::PipelineStageFlagBits2::eBottomOfPipe,
+                .dstAccessMask = {}, // vk::AccessFlagBits2::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = copy.generated_level_count ? vk::ImageLayout::eTransferSrcOptimal : copy.normal_layout,
+                .image = copy.image,
+                .subresourceRange = copy.subresource_range,
+            };
+
+            if (copy.is_released) {
+                transition.srcQueueFamilyIndex = transfer_family;
+                transition.dstQueueFamilyIndex = graphics_family;
+            }
+
+            image_transitions.emplace_back(transition);
+
+            if (copy.is_released) {
+                transition.srcStageMask = {};
+                transition.srcAccessMask = {};
+                transition.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+                transition.dstAccessMask = vk::AccessFlagBits2::eMemoryRead;
+
+                work.image_barriers.emplace_back(transition);
+            }
+
+            if (copy.generated_level_count) {
+                work.mip_generations.emplace_back(mip_generation{
+                    .image = copy.image,
+                    .format = copy.format,
+                    .streamed_layout = vk::ImageLayout::eTransferSrcOptimal,
+                    .normal_layout = copy.normal_layout,
+                    .is_acquired = copy.is_released,
+                    .streamed_range = copy.subresource_range,
+                    .last_level_extent = copy.last_level_extent,
+                    .level_count = copy.generated_level_count,
+                });
+            }
+        }
+
+        if (!buffer_releases.empty() || !image_transitions.empty()) {
+            vk::DependencyInfo out_dep{
+                .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+                .bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_releases.size()),
+                .pBufferMemoryBarriers = buffer_releases.data(),
+                .imageMemoryBarrierCount = static_cast<uint32_t>(image_transitions.size()),
+                .pImageMemoryBarriers = image_transitions.data(),
+            };
+
+            cmd.pipelineBarrier2(out_dep);
+        }
     }
-}
\ No newline at end of file
+}
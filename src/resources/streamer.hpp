@@ -3,83 +3,529 @@
 #include <rendering/vk_device.hpp>
 #include <rendering/batch_buffer.hpp>
 #include <rendering/multi_fence.hpp>
+#include <rendering/utils.hpp>
+#include "staging_ring.hpp"
+#include "texture_transcoder.hpp"
+#include "gpu_decompressor.hpp"
 
 #include <variant>
 #include <vector>
+#include <deque>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <span>
 
 namespace photon::rendering {
     // TODO: the multi cmd model might serialize all transfer copy commands if some barriers exist in them (eg. image transitions)
 
+    enum class stream_priority : uint32_t {
+        blocking = 0, // blocks the next frame until finished, never rolled over by the frame budget
+        high,
+        normal,
+        background,
+    };
+
+    constexpr uint32_t stream_priority_count = 4;
+
     class asset_streamer {
     public:
-        asset_streamer(rendering::vulkan_device& device, uint32_t max_frames_in_flight) noexcept;
+        struct streamer_config {
+            // size of the persistent staging ring used for the parts of streams which didn't fit into staging on submission,
+            // those are split into chunks across multiple batches
+            VkDeviceSize staging_ring_size;
+
+            // size of the staging rings created for each thread calling stream()
+            VkDeviceSize thread_staging_ring_size;
+
+            // limits of copies recorded per batch, non-blocking streams over the budget roll over to later batches
+            VkDeviceSize frame_byte_budget;
+            uint32_t frame_copy_budget;
+
+            // non-blocking streams waiting for this many batches get promoted to the next priority class
+            uint32_t stream_aging_frames;
+
+            // submits non-blocking streams from a background thread at its own pace instead of once per frame,
+            // only blocking streams are still submitted by submit_batch() (the budgets then apply to each submit thread batch)
+            bool use_submit_thread;
+
+            // enables compressing rgba8 image streams into bc1/bc7 images on the gpu (see image_stream_info::data_format)
+            bool use_gpu_transcoding;
+
+            // enables streaming lz chunk compressed data which is decompressed on the gpu (see stream_compressed())
+            bool use_gpu_decompression;
+        };
+
+        asset_streamer(rendering::vulkan_device& device, uint32_t max_frames_in_flight, const streamer_config& config) noexcept;
         ~asset_streamer() noexcept;
 
         // submits the submit batch to the device transfer queue, the previous submit by the current batch must *not* be in flight by this point
         // the streamer will automatically reset to the batch [next_frame_index] and can be used immidiatelly after submit (even if that batch is in flight)
         // returns the semaphore used for waiting for the blocking part of the stream batch
+        // note: with [use_submit_thread] only the blocking streams are submitted here
         vk::Semaphore submit_batch(uint32_t next_frame_index);
 
-        struct buffer_stream_info {
-            vk::Buffer staging_buf; 
-            VmaAllocation staging_alloc;
+        // note: streamed resources with eExclusive sharing are released by the transfer queue family once streamed and
+        // acquired by the graphics queue family in record_graphics_commands(), their ready fence is only signaled after that
+
+        // note: if [dst_alloc] is supplied and its memory is host visible (UMA, resizable BAR), the data is written directly into it
+        // on stream() without any staging or transfer commands, the destination range must not be in use by the device at that point
 
+        struct buffer_stream_info {
             vk::Buffer buf;
-            vk::BufferCopy transfer_region;
+            VkDeviceSize dst_offset;
+            vk::SharingMode sharing_mode;
+
+            VmaAllocation dst_alloc; // optional, enables direct writes
         };
 
         struct image_stream_info {
-            vk::Buffer staging_buf; 
-            VmaAllocation staging_alloc;
+            vk::Image image;
+            vk::Format format; // used for splitting oversized streams along texel block rows
+            vk::ImageLayout normal_layout;
+            vk::SharingMode sharing_mode;
+
+            vk::ImageSubresourceLayers image_subresource;
+            uint32_t level_count; // number of mip levels streamed starting at image_subresource.mipLevel
+
+            // number of mip levels following the streamed ones which are generated by blits on the graphics queue (the image needs eTransferSrc usage),
+            // the whole range is transitioned to [normal_layout] once generated
+            uint32_t generated_level_count;
+
+            // region of the first streamed mip level, the following levels use the region scaled down to their size
+            vk::Offset3D image_offset;
+            vk::Extent3D image_extent;
+
+            // optional, enables direct writes, must only be set for linear images with the streamed range still in ePreinitialized layout
+            // (it's transitioned to [normal_layout] by record_graphics_commands()), not used for streams generating mips
+            VmaAllocation dst_alloc;
+
+            // the image was created with eHostTransferEXT usage, if the device supports host copies of [format] to [normal_layout]
+            // the data is copied on stream() by the host (VK_EXT_host_image_copy), the image must not be in use by the device
+            bool is_host_copyable;
+
+            // optional, the format of the streamed data if it differs from [format], the data is then transcoded on the graphics queue
+            // (only rgba8 to bc1/bc7 of whole 2D single layer regions, see is_transcode_supported())
+            vk::Format data_format;
+        };
+
+        // copies [data] to staging memory and queues a new stream, the stream is submitted in the following batches according to its [priority] and the frame budget
+        // if the staging ring runs out of space the rest of the stream is kept on the host and staged in the following batches
+        // note: can be called from any thread, each thread stages into its own staging ring and queued streams are drained once per submit_batch
+        // returns ready_fence which checks if the whole stream is finished (including all its chunks)
+        // note: staged streams of the same priority finish in the order they were queued (from any thread), a stream that can't be finished
+        // in a batch holds back the ones queued after it (see schedule_streams()), streams of different priorities and unstaged streams
+        // (direct writes and host copies, finished on return) can finish in any order, only the fence of a stream tells if it's finished
+        // note: image [data] must be tightly packed (texel block rows, then depth slices, then array layers, then mip levels)
+        multi_fence_view stream(const buffer_stream_info& stream, const void* data, VkDeviceSize data_size, stream_priority priority) noexcept;
+        multi_fence_view stream(const image_stream_info& stream, const void* data, VkDeviceSize data_size, stream_priority priority) noexcept;
+
+        // a stream reserved by begin_stream(), the data has to be written to [get_data()] before committing it
+        // note: move-only, a stream destroyed without being committed frees its reservation (eg. when a loader unwinds)
+        class pending_stream {
+        public:
+            pending_stream() noexcept = default;
+            ~pending_stream() noexcept { release(); }
+
+            pending_stream(pending_stream&& other) noexcept { *this = std::move(other); }
+            pending_stream& operator=(pending_stream&& other) noexcept;
+
+            pending_stream(const pending_stream&) = delete;
+            pending_stream& operator=(const pending_stream&) = delete;
+
+            std::span<std::byte> get_data() const noexcept { return data; }
+
+        private:
+            // frees the staging reservation, the stream can't be committed afterwards
+            void release() noexcept;
+
+            std::variant<buffer_stream_info, image_stream_info> target;
+            stream_priority priority;
+
+            // mapped staging memory of the reserving thread, or [host_data] if the stream didn't fit into staging
+            staging_ring* ring = nullptr;
+            staging_ring::allocation staging_alloc;
+
+            std::vector<std::byte> host_data;
+            std::span<std::byte> data;
 
+            // set if [target] is the scratch image of a transcode
+            std::shared_ptr<texture_transcoder::transcode> transcode;
+
+            friend class asset_streamer;
+        };
+
+        // two-phase streaming, decoders can write the stream data straight into staging memory instead of handing a decoded buffer to stream()
+        // note: the reservation blocks the staging ring of the calling thread until committed (or destroyed), so commit it as soon as the data is written
+        // note: image data is packed the same way as for stream(), its size is derived from [stream]
+        pending_stream begin_stream(const buffer_stream_info& stream, VkDeviceSize data_size, stream_priority priority) noexcept;
+        pending_stream begin_stream(const image_stream_info& stream, stream_priority priority) noexcept;
+
+        // queues a reserved stream, can be called from any thread
+        multi_fence_view commit_stream(pending_stream&& stream) noexcept;
+
+        // the mapped staging ring of the calling thread, which its begin_stream() reservations lie in (eg. to register it with an async_reader)
+        std::span<std::byte> get_thread_staging_memory() noexcept;
+
+        // an uncompressed range of a payload compressed in lz chunks (laid out like pack::compression_type::lz_chunks, see resources/asset_pack_format.hpp)
+        struct compressed_range {
+            std::span<const std::byte> stored; // the chunk offsets followed by the chunks
+            uint64_t payload_size; // uncompressed
+            uint64_t offset; // of the range in the uncompressed payload
+        };
+
+        // like stream(), but only the stored chunks covering the range are staged, they're decompressed into the destination by a compute pass
+        // recorded by record_graphics_commands() (see gpu_decompressor), the host only checks and copies the chunks
+        // note: can be called from any thread, needs [use_gpu_decompression] (and images is_decompression_supported()),
+        // the unstaged paths (direct writes, host image copies) aren't used and the destination is written on the graphics queue
+        // note: decompressions are recorded once their input is staged, they can finish in any order relative to other streams
+        multi_fence_view stream_compressed(const buffer_stream_info& stream, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept;
+        multi_fence_view stream_compressed(const image_stream_info& stream, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept;
+
+        // true if compressed streams of [stream] can be decompressed on the gpu (not transcoded, no generated mips, texel block rows aligned to 4 bytes)
+        bool is_decompression_supported() const noexcept { return decompressor.has_value(); }
+        bool is_decompression_supported(const image_stream_info& stream) const noexcept;
+
+        // a region of a single mip level of an image which already holds data (eg. the dirty part of a dynamic texture)
+        struct image_update_info {
             vk::Image image;
+            vk::Format format;
             vk::ImageLayout normal_layout;
-            vk::BufferImageCopy transfer_region;
+
             vk::ImageSubresourceLayers image_subresource;
+            vk::Offset3D image_offset; // multiple of the texel block extent
+            vk::Extent3D image_extent;
         };
 
-        // schedule a new stream, blocks the next frame until finished if [is_deferred] is false
-        // returns ready_fence which checks if the stream batch containing this stream is finished
-        multi_fence_view stream(const buffer_stream_info& stream, bool is_deferred) noexcept;
-        multi_fence_view stream(const image_stream_info& stream, bool is_deferred) noexcept;
+        // stages [data] (packed like a single level stream) and copies it into the region on the graphics queue in the next record_graphics_commands(),
+        // unlike streams (which discard the whole streamed subresources) the image is transitioned from and back to [normal_layout], so the rest of it is kept
+        // note: can be called from any thread, the image must be owned by the graphics queue family (its streams finished) and have eTransferDst usage,
+        // updates are recorded in call order, the returned fence is ready once the copy is recorded (later graphics work sees the update)
+        multi_fence_view update(const image_update_info& update, const void* data, VkDeviceSize data_size) noexcept;
+
+        // records the graphics queue part of submitted streams (queue family ownership acquires, direct write transitions, mip generation, transcodes, decompressions)
+        // and the queued image updates into [cmd],
+        // must be recorded into the first graphics submission after submit_batch() (which also waits for the returned semaphore)
+        // note: [frame_index] is the graphics frame [cmd] is submitted with, its previous submission must be finished
+        bool has_graphics_commands() noexcept;
+        void record_graphics_commands(vk::CommandBuffer cmd, uint32_t frame_index);
+
+        // true if image streams of [data_format] can be transcoded into images of [format]
+        bool is_transcode_supported(vk::Format data_format, vk::Format format) noexcept;
+
+        // the peak amount of staging memory used at once by any of the staging rings, useful for tuning the ring sizes
+        VkDeviceSize get_staging_high_water_mark() noexcept;
+
+        // total amount of stream bytes written directly into host visible destination memory
+        uint64_t get_direct_stream_bytes() const noexcept { return direct_stream_bytes.load(std::memory_order_relaxed); }
+
+        // total amount of stream bytes copied into images by the host (VK_EXT_host_image_copy)
+        uint64_t get_host_copy_stream_bytes() const noexcept { return host_copy_stream_bytes.load(std::memory_order_relaxed); }
+
+        // total amount of compressed stream bytes (uncompressed) and of the chunks staged for them
+        uint64_t get_decompressed_stream_bytes() const noexcept { return decompressed_stream_bytes.load(std::memory_order_relaxed); }
+        uint64_t get_compressed_stream_bytes() const noexcept { return compressed_stream_bytes.load(std::memory_order_relaxed); }
 
         vulkan_device& get_device() noexcept { return device; }
     private:
+        using stream_target = std::variant<buffer_stream_info, image_stream_info>;
+
+        struct buffer_copy {
+            vk::Buffer staging_buf;
+            vk::Buffer buf;
+            vk::BufferCopy region;
+
+            // range of the whole stream, released to the graphics queue family with the last copy (if [is_released])
+            VkDeviceSize stream_offset;
+            VkDeviceSize stream_size;
+
+            bool is_last_copy;
+            bool is_released;
+        };
+
+        struct image_copy {
+            vk::Buffer staging_buf;
+            vk::Image image;
+            vk::ImageLayout normal_layout;
+            vk::ImageSubresourceRange subresource_range; // range of the whole stream, not only of this copy
+            vk::BufferImageCopy region;
+
+            // mip generation after the last copy
+            vk::Format format;
+            vk::Extent3D last_level_extent;
+            uint32_t generated_level_count;
+
+            bool is_first_copy; // transitions the image from eUndefined
+            bool is_last_copy; // transitions the image to [normal_layout]
+            bool is_released; // the last copy also releases the image to the graphics queue family
+        };
+
+        struct ring_allocation {
+            staging_ring* ring;
+            staging_ring::allocation alloc;
+        };
+
+        // a staged chunk of a stream waiting to be recorded
+        struct staged_copy {
+            std::variant<buffer_copy, image_copy> copy;
+            ring_allocation staging_alloc;
+        };
+
+        struct queued_stream {
+            stream_target target;
+            stream_priority priority;
+            uint32_t waiting_frames; // used for aging up the priority of starved streams
+
+            // host copy of the not yet staged part of the stream, starting from [data_offset] (empty if staged on submission)
+            std::vector<std::byte> data;
+            VkDeviceSize data_offset;
+            VkDeviceSize data_size;
+            VkDeviceSize staged_size;
+
+            std::deque<staged_copy> staged_copies;
+
+            multi_fence_promise ready_promise;
+        };
+
+        // blits the mip levels following [streamed_range] one by one from the previous level
+        struct mip_generation {
+            vk::Image image;
+            vk::Format format;
+
+            vk::ImageLayout streamed_layout; // layout of the streamed levels before the generation
+            vk::ImageLayout normal_layout;
+            bool is_acquired; // the streamed levels are acquired by a barrier of the same graphics_work
+
+            vk::ImageSubresourceRange streamed_range;
+            vk::Extent3D last_level_extent; // extent of the last streamed level
+            uint32_t level_count;
+        };
+
+        // the graphics queue part of the streams finished by one submit: queue family ownership acquires, layout transitions of directly
+        // written images and mip generation, [promises] are bound once it's recorded
+        struct graphics_work {
+            std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+            std::vector<vk::ImageMemoryBarrier2> image_barriers;
+            std::vector<mip_generation> mip_generations;
+            std::vector<multi_fence_promise> promises;
+
+            bool is_blocking; // the graphics submission waits for the blocking semaphore, so it doesn't have to wait for [release_fence]
+            multi_fence_view release_fence;
+            multi_fence batch_fence;
+        };
+
+        // an image update waiting for record_graphics_commands()
+        struct queued_update {
+            image_update_info target;
+
+            // staging of the update, if it didn't fit into the staging ring of the updating thread [data] holds it until recorded
+            ring_allocation staging_alloc;
+            std::vector<std::byte> data;
+
+            multi_fence_promise ready_promise;
+        };
+
         struct frame_buffer {
             frame_buffer(multi_fence fence, vk::Semaphore block_semaphore) noexcept : ready_fence{std::move(fence)}, blocking_ready_semaphore{block_semaphore} { }
 
             struct streams_buffer {
-                std::vector<buffer_stream_info> buffer_infos;
-                std::vector<image_stream_info> image_infos;
+                std::vector<buffer_copy> buffer_copies;
+                std::vector<image_copy> image_copies;
+
+                // promises of streams finished by this batch which still need graphics work (released or generating mips), handed over to the graphics_work on submit
+                std::vector<multi_fence_promise> released_promises;
             };
 
             streams_buffer blocking;
             streams_buffer deferred;
 
-            streams_buffer retired_blocking;
-            streams_buffer retired_deferred;
+            std::vector<ring_allocation> staging_allocs;
+            std::vector<ring_allocation> retired_staging_allocs;
+
+            // promises of streams which get finished by this batch, bound on submit
+            std::vector<multi_fence_promise> finished_promises;
 
             multi_fence ready_fence;
             vk::Semaphore blocking_ready_semaphore;
         };
 
+        // packed layout of a single mip level of an image stream, in texel blocks
+        struct image_stream_layout {
+            vk::Offset3D level_offset;
+            vk::Extent3D level_extent;
+            VkDeviceSize level_size;
+
+            VkDeviceSize row_size;
+            uint32_t block_height;
+
+            uint32_t plane_rows; // block rows per depth slice / array layer
+            uint32_t plane_count;
+
+            uint32_t rows_granularity; // partial plane copies must be a multiple of this, 0 if only whole planes can be copied
+        };
+
+        struct image_chunk {
+            VkDeviceSize size;
+            vk::BufferImageCopy region;
+        };
+
+        static constexpr VkDeviceSize buffer_copy_alignment = 4;
+
         // returns a in-recording state cmd used for [stream_info] (must be ended before forwarding to [stream_info])
-        vk::CommandBuffer begin_stream_recording() {
+        static vk::CommandBuffer begin_stream_recording(batch_buffer& cmd_buffer) {
             vk::CommandBufferBeginInfo begin_info{
                 .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
             };
 
-            return batch_cmd_buffer.begin_recording(begin_info);
+            return cmd_buffer.begin_recording(begin_info);
         }
 
-        void record_streams(vk::CommandBuffer cmd, const frame_buffer::streams_buffer& streams) noexcept;
+        multi_fence_view queue_stream(const stream_target& target, const std::byte* data, VkDeviceSize data_size, stream_priority priority) noexcept;
+        void submit_stream(queued_stream&& stream);
+
+        // reserves [data_size] bytes of staging with [alignment], falls back to host memory if [alignment] is 0 or the stream doesn't fit
+        pending_stream reserve_stream(const stream_target& target, VkDeviceSize data_size, stream_priority priority, VkDeviceSize alignment) noexcept;
+
+        // tries the paths which don't need staging (host image copies, direct writes), returns nullopt if the stream has to be staged
+        std::optional<multi_fence_view> write_unstaged(const buffer_stream_info& stream, const std::byte* data, VkDeviceSize data_size) noexcept;
+        std::optional<multi_fence_view> write_unstaged(const image_stream_info& stream, const std::byte* data) noexcept;
+
+        // write the stream straight into the mapped destination, return false if its memory isn't host visible
+        bool write_direct(const buffer_stream_info& stream, const std::byte* data, VkDeviceSize data_size);
+        bool write_direct(const image_stream_info& stream, const std::byte* data, multi_fence_promise& ready_promise);
+
+        bool is_host_visible(VmaAllocation alloc) noexcept;
+
+        // copies the stream into the image on the host, return false if the device doesn't support host copies of the image format
+        bool copy_host_image(const image_stream_info& stream, const std::byte* data, multi_fence_promise& ready_promise);
+
+        // stages as much of the stream as fits into [ring] (in chunks of at most [frame_byte_budget]) and appends the copies to [stream.staged_copies]
+        // [data] points to the stream offset [data_offset], returns true once the whole stream is staged
+        bool stage_stream(queued_stream& stream, const std::byte* data, VkDeviceSize data_offset, staging_ring& ring);
+
+        // splits [alloc] (already holding the whole stream) into the staged copies of [stream]
+        void slice_stream(queued_stream& stream, staging_ring& ring, staging_ring::allocation alloc);
+
+        // append the copy of the next [alloc.size] bytes of [stream] (staged in [alloc])
+        void add_buffer_copy(queued_stream& stream, const buffer_stream_info& buffer_stream, staging_ring& ring, const staging_ring::allocation& alloc);
+        void add_image_copy(queued_stream& stream, const image_stream_info& image_stream, vk::BufferImageCopy region, staging_ring& ring, const staging_ring::allocation& alloc);
+
+        // returns the staging ring of the calling thread, creating it on first use
+        staging_ring& get_thread_staging();
+
+        // moves queued streams from [submission_queues] to [stream_queues]
+        void drain_submissions(bool include_blocking, bool include_deferred);
+
+        // moves the staged copies of queued streams in priority classes [priority_begin, priority_end) into [batch] in priority order until the frame budget runs out
+        // or a stream can't be finished (it isn't skipped, so streams finish in queue order)
+        void schedule_streams(frame_buffer& batch, uint32_t priority_begin, uint32_t priority_end);
+
+        // frees the staging memory used by the last submit of [batch], which must be finished
+        void retire_batch(frame_buffer& batch) noexcept;
+
+        // records and submits the scheduled streams of [batch] using [cmd_buffer] batch [batch_index]
+        void submit_streams(frame_buffer& batch, batch_buffer& cmd_buffer, uint32_t batch_index);
+
+        // returns the ring used for staging the host parts of streams, it must only be used by the thread scheduling that priority
+        staging_ring& get_schedule_staging(bool is_blocking);
+
+        void run_submit_thread() noexcept;
+
+        image_stream_layout get_image_stream_layout(const image_stream_info& stream, uint32_t level) const noexcept;
+        VkDeviceSize get_image_stream_size(const image_stream_info& stream) const noexcept;
+
+        // returns the next chunk of [stream] starting at [stream_offset] of at most [max_size] (or the budget), zero sized if nothing fits
+        // note: region.bufferOffset is left zero
+        image_chunk get_image_chunk(const image_stream_info& stream, VkDeviceSize stream_offset, VkDeviceSize max_size) const noexcept;
+        VkDeviceSize get_min_chunk_size(const image_stream_layout& layout) const noexcept;
+        VkDeviceSize get_image_copy_alignment(vk::Format format) const noexcept;
+
+        // records the copies of [streams] merged into one multi-region copy per staging buffer and destination,
+        // surrounded by one combined barrier for the image transitions on each side
+        // the acquire halves of released copies and mip generations are appended to [work]
+        void record_streams(vk::CommandBuffer cmd, const frame_buffer::streams_buffer& streams, graphics_work& work);
+
+        // moves [work] to [graphics_work_queue] unless it's empty
+        void queue_graphics_work(graphics_work&& work);
+
+        // records [generations] batched level by level, ending in one transition to the normal layouts
+        void record_mip_generations(vk::CommandBuffer cmd, const std::vector<mip_generation>& generations);
+
+        // true if the stream is finished on the graphics queue (by an ownership acquire or mip generation)
+        bool is_graphics_finished(const stream_target& target) const noexcept;
+
+        // true if streams with [sharing_mode] need a queue family ownership transfer
+        bool is_ownership_transfer(vk::SharingMode sharing_mode) const noexcept;
+
+        bool is_transcoded(const image_stream_info& stream) const noexcept;
+
+        // reserves the stream of the scratch image of a new transcode of [stream]
+        pending_stream begin_transcode(const image_stream_info& stream, stream_priority priority) noexcept;
+
+        // stages the chunks covering [data_size] bytes of [data] into the input of a new decompression into the destination of [info]
+        multi_fence_view queue_decompression(gpu_decompressor::decompression_info&& info, const compressed_range& data, VkDeviceSize data_size, stream_priority priority) noexcept;
+
+        // records the queued graphics_work (everything besides transcodes)
+        void record_graphics_work(vk::CommandBuffer cmd);
+
+        // stages the host data of queued updates and records their copies, the staging is freed once [frame_index] comes around again
+        void record_updates(vk::CommandBuffer cmd, uint32_t frame_index);
 
         rendering::vulkan_device& device;
 
         std::vector<frame_buffer> batch_buffers;
         batch_buffer batch_cmd_buffer;
 
+        staging_ring staging; // only used by submit_batch()
+
+        std::vector<std::unique_ptr<staging_ring>> thread_staging_rings;
+        std::mutex thread_staging_lock; // guards [thread_staging_rings]
+        VkDeviceSize thread_staging_ring_size;
+
+        uint64_t streamer_id; // unique id used for the thread local staging ring lookup
+
+        multi_fence finished_fence; // never reset, returned for streams which are finished on submission
+        std::atomic<uint64_t> direct_stream_bytes = 0;
+        std::atomic<uint64_t> host_copy_stream_bytes = 0;
+        std::atomic<uint64_t> decompressed_stream_bytes = 0;
+        std::atomic<uint64_t> compressed_stream_bytes = 0;
+
+        std::deque<graphics_work> graphics_work_queue;
+        std::mutex graphics_work_lock; // guards [graphics_work_queue]
+
+        std::vector<queued_update> update_queue;
+        std::mutex update_lock; // guards [update_queue]
+
+        // staging of recorded updates, indexed by the graphics frame_index
+        std::vector<std::vector<ring_allocation>> update_staging_allocs;
+
+        std::optional<texture_transcoder> transcoder; // only with [use_gpu_transcoding]
+        std::optional<gpu_decompressor> decompressor; // only with [use_gpu_decompression]
+
+        // streams submitted by any thread (blocking and non-blocking), drained into [stream_queues] by the thread scheduling them
+        std::array<mpsc_queue<queued_stream>, 2> submission_queues;
+        std::array<std::deque<queued_stream>, stream_priority_count> stream_queues;
+
+        // submit thread state, the thread owns the non-blocking [stream_queues] and [staging]
+        bool use_submit_thread;
+
+        std::vector<frame_buffer> thread_batch_buffers;
+        batch_buffer thread_cmd_buffer;
+
+        std::thread submit_thread;
+        std::atomic<bool> stop_submit_thread = false;
+        std::atomic<uint32_t> submit_epoch = 0; // bumped (and notified) on every non-blocking submission
+
+        VkDeviceSize frame_byte_budget;
+        uint32_t frame_copy_budget;
+        uint32_t stream_aging_frames;
+
+        VkDeviceSize optimal_copy_alignment;
+
         uint32_t current_frame_index = 0;
         uint32_t max_frames_in_flight;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#include "texel_convert.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PHOTON_TEXEL_CONVERT_SSSE3
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define PHOTON_TEXEL_CONVERT_NEON
+#endif
+
+namespace photon {
+    static void expand_rgb_scalar(const uint8_t* src, uint8_t* dst, size_t texel_count) noexcept {
+        for (size_t i = 0; i < texel_count; i++) {
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 0xFF;
+        }
+    }
+
+#ifdef PHOTON_TEXEL_CONVERT_SSSE3
+    // 16 texels (48 bytes in, 64 bytes out) per iteration, every 16 byte load is shuffled into 4 rgba texels
+    __attribute__((target("ssse3"))) static size_t expand_rgb_ssse3(const uint8_t* src, uint8_t* dst, size_t texel_count) noexcept {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+        size_t i = 0;
+
+        for (; i + 16 <= texel_count; i += 16) {
+            const uint8_t* s = src + i * 3;
+
+            __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+            __m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+            __m128i in2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+
+            // realign each group of 4 texels (12 bytes) to the start of a register
+            __m128i t0 = in0;
+            __m128i t1 = _mm_alignr_epi8(in1, in0, 12);
+            __m128i t2 = _mm_alignr_epi8(in2, in1, 8);
+            __m128i t3 = _mm_srli_si128(in2, 4);
+
+            __m128i* d = reinterpret_cast<__m128i*>(dst + i * 4);
+
+            _mm_storeu_si128(d + 0, _mm_or_si128(_mm_shuffle_epi8(t0, shuffle), alpha));
+            _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(t1, shuffle), alpha));
+            _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(t2, shuffle), alpha));
+            _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(t3, shuffle), alpha));
+        }
+
+        return i;
+    }
+#endif
+
+    static void expand_rgb(const uint8_t* src, uint8_t* dst, size_t texel_count) noexcept {
+        size_t expanded = 0;
+
+#if defined(PHOTON_TEXEL_CONVERT_SSSE3)
+        static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+        if (has_ssse3) expanded = expand_rgb_ssse3(src, dst, texel_count);
+#elif defined(PHOTON_TEXEL_CONVERT_NEON)
+        for (; expanded + 16 <= texel_count; expanded += 16) {
+            uint8x16x3_t rgb = vld3q_u8(src + expanded * 3);
+            uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(0xFF) } };
+
+            vst4q_u8(dst + expanded * 4, rgba);
+        }
+#endif
+
+        expand_rgb_scalar(src + expanded * 3, dst + expanded * 4, texel_count - expanded);
+    }
+
+    void expand_to_rgba8(const uint8_t* src, uint8_t* dst, size_t texel_count, uint32_t component_count) noexcept {
+        switch (component_count) {
+            case 1:
+                for (size_t i = 0; i < texel_count; i++) {
+                    dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+                    dst[i * 4 + 3] = 0xFF;
+                }
+                break;
+
+            case 2:
+                for (size_t i = 0; i < texel_count; i++) {
+                    dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i * 2];
+                    dst[i * 4 + 3] = src[i * 2 + 1];
+                }
+                break;
+
+            case 3:
+                expand_rgb(src, dst, texel_count);
+                break;
+
+            default:
+                std::memcpy(dst, src, texel_count * 4);
+                break;
+        }
+    }
+}
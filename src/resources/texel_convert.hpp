@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace photon {
+    // expands tightly packed 8 bit texels with [component_count] (1 to 4) components to rgba8, [dst] must hold 4 * [texel_count] bytes
+    // gray (+ alpha) is replicated into rgb, missing alpha is set to opaque
+    // note: rgb uses a simd kernel (ssse3 picked at runtime on x86-64, neon on arm64)
+    void expand_to_rgba8(const uint8_t* src, uint8_t* dst, size_t texel_count, uint32_t component_count) noexcept;
+}
@@ -1,11 +1,41 @@
 #include "texture.hpp"
 #include <core/abort.hpp>
+#include <core/derived_data_cache.hpp>
+#include <core/hash.hpp>
 #include <core/logger.hpp>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb/stb_image.h>
+#include "asset_pack.hpp"
+#include "texture_container.hpp"
+#include "texel_convert.hpp"
+#include "image_decoder.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <vector>
 
 namespace photon {
+    // derived data cache entries of source images, the converted texels (see texture::get_image_conversion()) follow the header
+    struct cached_image_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t component_count; // of the source image
+        uint32_t data_format; // VkFormat of the texels
+        uint64_t data_size;
+    };
+
+    // hashed into the cache key, entries of other parameters (or versions) are separate entries
+    struct cached_image_params {
+        uint32_t version;
+        uint32_t encoding;
+    };
+
+    static constexpr uint32_t cached_image_magic = 0x49444850; // "PHDI"
+    static constexpr uint32_t cached_image_version = 1;
+
     texture::~texture() noexcept {
         if (image) destroy();
     }
@@ -19,11 +49,10 @@ namespace photon {
         image_normal_layout = normal_layout,
         image_format = image_info.format;
         image_extent = image_info.extent;
-
-        if (image_info.sharingMode != vk::SharingMode::eConcurrent) {
-            P_LOG_E("Photon streaming resources only support Vulkan concurrent sharing mode!");
-            engine_abort();
-        }
+        image_level_count = image_info.mipLevels;
+        image_sharing_mode = image_info.sharingMode; // exclusive images are handed over to the graphics queue by the streamer
+        is_host_writable = image_info.tiling == vk::ImageTiling::eLinear && image_info.initialLayout == vk::ImageLayout::ePreinitialized;
+        is_host_copyable = static_cast<bool>(image_info.usage & vk::ImageUsageFlagBits::eHostTransferEXT);
 
         if (image_info.imageType == vk::ImageType::e2D) {
             image_extent.depth = 1;
@@ -50,85 +79,320 @@ namespace photon {
         device.get_device().destroyImageView(image_view);
         vmaDestroyImage(device.get_allocator(), static_cast<VkImage>(image), image_alloc);
 
-        ready_fence = rendering::multi_fence_view();
+        ready_fences.clear();
 
         image_normal_layout = vk::ImageLayout::eUndefined;
         image_format = {};
+        image_sharing_mode = vk::SharingMode::eExclusive;
+        image_data_format = vk::Format::eUndefined;
+        is_host_writable = false;
+        is_host_copyable = false;
         image_extent = vk::Extent3D{ 0, 0, 0 };
+        image_level_count = 0;
     }
 
-    void texture::stream(void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, bool is_deferred) {
-        size_t image_size = 4 * image_extent.width * image_extent.height * image_extent.depth;
-
-        if (image_size != data_size) {
-            P_LOG_E("Unexpected texture size while streaming a texture! (expected: {} received: {})", image_size, data_size);
-            engine_abort();
-        }
-
-        // alloc staging buf
-
-        vk::BufferCreateInfo staging_info{
-            .size = image_size,
-            .usage = vk::BufferUsageFlagBits::eTransferSrc,
-            .sharingMode = vk::SharingMode::eExclusive,
-        };
-
-        VmaAllocationCreateInfo alloc_create_info{
-            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-            .usage = VMA_MEMORY_USAGE_AUTO,
-        };
+    void texture::stream(const void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count, rendering::stream_priority priority) {
+        // submit to streamer (staged through the streamer's staging ring), the streamer validates [data_size] against the format and levels
+        ready_fences.push_back(streamer.stream(get_stream_info(subresource, level_count, generated_level_count), data, data_size, priority));
+    }
 
-        VkBuffer buf;
-        VmaAllocation alloc;
-        VmaAllocationInfo alloc_info;
+    rendering::asset_streamer::pending_stream texture::begin_stream(vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count, rendering::stream_priority priority) {
+        return streamer.begin_stream(get_stream_info(subresource, level_count, generated_level_count), priority);
+    }
 
-        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(staging_info), &alloc_create_info, &buf, &alloc, &alloc_info);
-        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+    void texture::commit_stream(rendering::asset_streamer::pending_stream&& stream) {
+        ready_fences.push_back(streamer.commit_stream(std::move(stream)));
+    }
 
-        std::memcpy(alloc_info.pMappedData, data, image_size);
+    bool texture::is_ready() {
+        std::erase_if(ready_fences, [](const rendering::multi_fence_view& fence) { return fence.status() == vk::Result::eSuccess; });
+        return ready_fences.empty();
+    }
 
-        // submit to streamer
+    void texture::update(const void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, vk::Offset3D offset, vk::Extent3D extent) {
+        // the ready fences are kept, updates are ordered before any graphics work recorded after them
+        streamer.update({
+            .image = image,
+            .format = image_format,
+            .normal_layout = image_normal_layout,
+            .image_subresource = subresource,
+            .image_offset = offset,
+            .image_extent = extent,
+        }, data, data_size);
+    }
 
+    rendering::asset_streamer::image_stream_info texture::get_stream_info(vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count) noexcept {
         rendering::asset_streamer::image_stream_info info{
-            .staging_buf = buf,
-            .staging_alloc = alloc,
-            
             .image = image,
+            .format = image_format,
             .normal_layout = image_normal_layout,
-            .transfer_region = {
-                .imageSubresource = subresource,
-                .imageExtent = image_extent,
-            },
+            .sharing_mode = image_sharing_mode,
             .image_subresource = subresource,
+            .level_count = level_count,
+            .generated_level_count = generated_level_count,
+            .image_offset = { 0, 0, 0 },
+            .image_extent = { std::max(1U, image_extent.width >> subresource.mipLevel), std::max(1U, image_extent.height >> subresource.mipLevel), std::max(1U, image_extent.depth >> subresource.mipLevel) },
+            .dst_alloc = is_host_writable ? image_alloc : VK_NULL_HANDLE,
+            .is_host_copyable = is_host_copyable,
+            .data_format = image_data_format,
         };
 
-        ready_fence = streamer.stream(info, is_deferred);
+        // only the first stream finds the image preinitialized, note: if the memory isn't host visible the stream discards it anyway
+        is_host_writable = false;
+
+        return info;
+    }
+
+    bool texture::is_mip_format_supported(rendering::vulkan_device& device, vk::Format format) noexcept {
+        constexpr vk::FormatFeatureFlags required_features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+            vk::FormatFeatureFlagBits::eTransferDst | vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst;
+
+        return (device.get_physical_device().getFormatProperties(format).optimalTilingFeatures & required_features) == required_features;
+    }
+
+    texture texture::load_file(rendering::asset_streamer& streamer, const std::string_view path, texture_encoding encoding, derived_data_cache* cache) noexcept {
+        texture tex(streamer);
+        tex.read_file(path, encoding, rendering::stream_priority::blocking, cache);
+
+        return tex;
+    }
+
+    texture_handle texture::load_file_async(worker_pool& pool, rendering::asset_streamer& streamer, std::string path, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) {
+        return load_async(pool, streamer, [path = std::move(path), encoding, priority, cache](texture& tex) {
+            tex.read_file(path, encoding, priority, cache);
+        });
+    }
+
+    texture_handle texture::load_file_async(async_reader& reader, worker_pool& pool, rendering::asset_streamer& streamer, std::string path, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) {
+        if (path.ends_with(".ktx2") || path.ends_with(".dds")) return load_container_async(reader, pool, streamer, std::move(path), 0, priority);
+
+        texture_handle handle;
+        handle.state = std::make_shared<texture_handle::load_state>(streamer);
+
+        // note: the completion only hands the file over, decoding would hold up the following reads
+        reader.read_file(path, [&pool, state = handle.state, path, encoding, priority, cache](std::optional<std::vector<std::byte>> file_data) {
+            if (!file_data) {
+                P_LOG_E("Failed to load texture: {}", path);
+                engine_abort();
+            }
+
+            pool.submit([state, path, encoding, priority, cache, file_data = std::move(file_data.value())]() {
+                state->tex.read_image(file_data, path, encoding, priority, cache);
+                state->set_staged();
+            });
+        });
+
+        return handle;
+    }
+
+    texture_handle texture::load_container_async(worker_pool& pool, rendering::asset_streamer& streamer, std::string path, uint32_t first_level, rendering::stream_priority priority) {
+        return load_async(pool, streamer, [path = std::move(path), first_level, priority](texture& tex) {
+            tex.read_container(path, first_level, priority);
+        });
+    }
+
+    texture_handle texture::load_container_async(async_reader& reader, worker_pool& pool, rendering::asset_streamer& streamer, std::string path, uint32_t first_level, rendering::stream_priority priority) {
+        texture_handle handle;
+        handle.state = std::make_shared<texture_handle::load_state>(streamer);
+
+        // the header is parsed on [pool], the levels are committed by the reader once they're read
+        pool.submit([&reader, state = handle.state, path = std::move(path), first_level, priority]() {
+            state->tex.read_container_async(reader, path, first_level, priority, [state]() { state->set_staged(); });
+        });
+
+        return handle;
+    }
+
+    texture texture::load_packed(rendering::asset_streamer& streamer, const asset_pack& pack, const std::string_view name, texture_encoding encoding, worker_pool* pool) noexcept {
+        texture tex(streamer);
+        tex.read_packed(pack, name, encoding, rendering::stream_priority::blocking, pool);
+
+        return tex;
+    }
+
+    texture_handle texture::load_packed_async(worker_pool& pool, rendering::asset_streamer& streamer, const asset_pack& pack, std::string name, texture_encoding encoding, rendering::stream_priority priority) {
+        return load_async(pool, streamer, [&pack, &pool, name = std::move(name), encoding, priority](texture& tex) {
+            tex.read_packed(pack, name, encoding, priority, &pool);
+        });
+    }
+
+    texture_handle texture::load_async(worker_pool& pool, rendering::asset_streamer& streamer, std::function<void(texture&)> load) {
+        texture_handle handle;
+        handle.state = std::make_shared<texture_handle::load_state>(streamer);
+
+        // note: the task owns the load state too, so dropping the handle while loading is fine
+        pool.submit([state = handle.state, load = std::move(load)]() {
+            load(state->tex);
+            state->set_staged();
+        });
+
+        return handle;
     }
 
-    texture texture::load_file(rendering::asset_streamer& streamer, const std::string_view path) noexcept {
-        int x, y, comp;
-        uint8_t* data = stbi_load(path.data(), &x, &y, &comp, 4 /*reformat to rgba*/);
+    texture_load_state texture_handle::get_state() const {
+        if (!state->is_staged.load(std::memory_order_acquire)) return texture_load_state::loading;
+
+        return state->tex.is_ready() ? texture_load_state::ready : texture_load_state::staged;
+    }
+
+    void texture::read_file(const std::string_view path, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) noexcept {
+        if (path.ends_with(".ktx2") || path.ends_with(".dds")) return read_container(path, 0, priority);
+
+        std::ifstream file(std::string(path), std::ios::binary | std::ios::ate);
+        std::vector<std::byte> file_data;
+
+        if (file) {
+            file_data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(file_data.data()), file_data.size());
+        }
 
-        if (!data) {
+        if (!file) {
             P_LOG_E("Failed to load texture: {}", path);
             engine_abort();
         }
 
-        /* if (comp != 4) {
-            P_LOG_E("Loaded texture is not a RBGA image! {}", comp);
+        read_image(file_data, path, encoding, priority, cache);
+    }
+
+    void texture::read_image(std::span<const std::byte> file_data, const std::string_view name, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) noexcept {
+        // decoding dominates the load, a cached conversion of the same file content is streamed straight from its mapping
+        std::optional<derived_data_cache::cache_key> cache_key;
+
+        if (cache) {
+            cached_image_params params{
+                .version = cached_image_version,
+                .encoding = static_cast<uint32_t>(encoding),
+            };
+
+            cache_key = derived_data_cache::cache_key{
+                .content_hash = hash64(file_data.data(), file_data.size()),
+                .params_hash = hash64(&params, sizeof(params)),
+            };
+
+            if (std::optional<mapped_file> entry = cache->find(cache_key.value())) {
+                if (read_cached_image(entry->get_data(), encoding, priority)) return;
+
+                P_LOG_W("Stale derived data cache entry of texture: {}", name);
+            }
+        }
+
+        std::optional<decoded_image> image = decode_image(file_data);
+
+        if (!image) {
+            P_LOG_E("Failed to load texture: {}", name);
             engine_abort();
-        } */
+        }
+
+        uint32_t x = image->width, y = image->height, comp = image->component_count;
+        image_conversion conversion = get_image_conversion(comp, encoding);
+
+        if (conversion.data_components != comp) {
+            size_t texel_count = static_cast<size_t>(x) * y;
+            decltype(image->texels) rgba_texels(static_cast<uint8_t*>(std::malloc(texel_count * 4)));
+
+            if (!rgba_texels) {
+                P_LOG_E("Failed to allocate {} bytes to expand texture: {}", texel_count * 4, name);
+                engine_abort();
+            }
+
+            expand_to_rgba8(image->texels.get(), rgba_texels.get(), texel_count, comp);
+            image->texels = std::move(rgba_texels);
+        }
+
+        VkDeviceSize data_size = static_cast<VkDeviceSize>(x) * y * conversion.data_components;
+        create_image(x, y, conversion, image->texels.get(), data_size, priority);
+
+        if (cache_key) {
+            cached_image_header header{
+                .magic = cached_image_magic,
+                .version = cached_image_version,
+                .width = x,
+                .height = y,
+                .component_count = comp,
+                .data_format = static_cast<uint32_t>(conversion.data_format),
+                .data_size = data_size,
+            };
+
+            std::span<const std::byte> parts[] = { std::as_bytes(std::span(&header, 1)), std::as_bytes(std::span(image->texels.get(), data_size)) };
+            cache->store(cache_key.value(), parts);
+        }
+    }
+
+    bool texture::read_cached_image(std::span<const std::byte> entry, texture_encoding encoding, rendering::stream_priority priority) noexcept {
+        if (entry.size() < sizeof(cached_image_header)) return false;
+
+        const cached_image_header* header = reinterpret_cast<const cached_image_header*>(entry.data());
+        if (header->magic != cached_image_magic || header->version != cached_image_version) return false;
+
+        // the conversion depends on the device (transcoding and format support), entries of another one are decoded again
+        image_conversion conversion = get_image_conversion(header->component_count, encoding);
+
+        if (static_cast<uint32_t>(conversion.data_format) != header->data_format || header->width == 0 || header->height == 0 ||
+            header->data_size != static_cast<uint64_t>(header->width) * header->height * conversion.data_components ||
+            header->data_size != entry.size() - sizeof(cached_image_header)) return false;
+
+        create_image(header->width, header->height, conversion, entry.data() + sizeof(cached_image_header), header->data_size, priority);
+        return true;
+    }
+
+    texture::image_conversion texture::get_image_conversion(uint32_t component_count, texture_encoding encoding) noexcept {
+        bool is_srgb = encoding == texture_encoding::srgb;
+        bool has_alpha = component_count == 2 || component_count == 4;
+
+        // if the streamer transcodes (use_gpu_transcoding), srgb rgb(a) images are compressed on the gpu (bc1 for opaque images), the rgba8 data only lives
+        // in a scratch image until transcoded, otherwise the image keeps the source components unless the format isn't supported (rgb8 rarely is)
+        // note: linear data (normals, masks) is never transcoded, the bc1/bc7 endpoint quantization would skew it, cook it offline instead (see photon-cook)
+
+        vk::Format rgba_format = is_srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+        vk::Format transcode_format = has_alpha ? vk::Format::eBc7SrgbBlock : vk::Format::eBc1RgbSrgbBlock;
+        bool is_transcoded = is_srgb && component_count >= 3 && streamer.is_transcode_supported(rgba_format, transcode_format);
+
+        constexpr vk::Format srgb_formats[] = { vk::Format::eR8Srgb, vk::Format::eR8G8Srgb, vk::Format::eR8G8B8Srgb, vk::Format::eR8G8B8A8Srgb };
+        constexpr vk::Format unorm_formats[] = { vk::Format::eR8Unorm, vk::Format::eR8G8Unorm, vk::Format::eR8G8B8Unorm, vk::Format::eR8G8B8A8Unorm };
+
+        image_conversion conversion{
+            .data_format = (is_srgb ? srgb_formats : unorm_formats)[std::clamp(component_count, 1U, 4U) - 1],
+            .data_components = component_count,
+            .image_format = is_transcoded ? transcode_format : vk::Format::eUndefined,
+        };
+
+        if (is_transcoded || !is_mip_format_supported(streamer.get_device(), conversion.data_format)) {
+            conversion.data_format = rgba_format;
+            conversion.data_components = 4;
+        }
+
+        if (!is_transcoded) conversion.image_format = conversion.data_format;
+
+        return conversion;
+    }
+
+    void texture::create_image(uint32_t x, uint32_t y, const image_conversion& conversion, const void* data, VkDeviceSize data_size, rendering::stream_priority priority) noexcept {
+        bool is_transcoded = conversion.image_format != conversion.data_format;
+
+        // full mip chain, the levels after the first one are generated by the streamer on the gpu
+
+        uint32_t level_count = std::bit_width(std::max(x, y));
+
+        // gray images are sampled as gray rgb
+        vk::ComponentMapping components{};
+
+        if (conversion.data_components == 1) {
+            components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eOne };
+        } else if (conversion.data_components == 2) {
+            components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG };
+        }
 
         vk::ImageCreateInfo image_info{
             .imageType = vk::ImageType::e2D,
-            .format = vk::Format::eR8G8B8A8Srgb,
-            .extent = { static_cast<uint32_t>(x), static_cast<uint32_t>(y), 1 },
-            .mipLevels = 1,
+            .format = conversion.image_format,
+            .extent = { x, y, 1 },
+            .mipLevels = level_count,
             .arrayLayers = 1,
             .samples = vk::SampleCountFlagBits::e1,
-            .tiling = vk::ImageTiling::eLinear,
-            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
-            .sharingMode = vk::SharingMode::eConcurrent,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
             .initialLayout = vk::ImageLayout::eUndefined,
         };
 
@@ -136,31 +400,338 @@ namespace photon {
             .usage = VMA_MEMORY_USAGE_AUTO,
         };
 
+        if (is_transcoded) {
+            image_info.usage &= ~vk::ImageUsageFlagBits::eTransferSrc; // the mips are generated on the scratch image
+        } else if (streamer.get_device().is_host_image_copy_supported(image_info.format, vk::ImageLayout::eGeneral)) {
+            // the streamer copies the first level on the host (in general layout as the mips are generated afterwards)
+            image_info.usage |= vk::ImageUsageFlagBits::eHostTransferEXT;
+        }
+
         vk::ImageViewCreateInfo view_info{
             .viewType = vk::ImageViewType::e2D,
             .format = image_info.format,
-            // .components = { vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA },
+            .components = components,
             .subresourceRange{
                 .aspectMask = vk::ImageAspectFlagBits::eColor,
                 .baseMipLevel = 0,
-                .levelCount = 1,
+                .levelCount = level_count,
                 .baseArrayLayer = 0,
                 .layerCount = 1,
             },
         };
 
-        texture tex(streamer);
-        tex.create(image_info, vk::ImageLayout::eShaderReadOnlyOptimal, alloc_info, view_info);
+        create(image_info, vk::ImageLayout::eShaderReadOnlyOptimal, alloc_info, view_info);
+
+        if (is_transcoded) image_data_format = conversion.data_format;
 
-        tex.stream(data, 4 * x * y, {
+        stream(data, data_size, {
             .aspectMask = vk::ImageAspectFlagBits::eColor,
             .mipLevel = 0,
             .baseArrayLayer = 0,
             .layerCount = 1,
-        }, false);
+        }, 1, level_count - 1, priority);
+    }
 
-        stbi_image_free(data);
+    texture texture::load_container(rendering::asset_streamer& streamer, const std::string_view path, uint32_t first_level) noexcept {
+        texture tex(streamer);
+        tex.read_container(path, first_level, rendering::stream_priority::blocking);
 
         return tex;
     }
-}
\ No newline at end of file
+
+    // parses the container header of [file], aborts if it's malformed or [first_level] levels can't be skipped
+    static texture_container read_container_header(std::istream& file, const std::string_view path, uint32_t first_level) noexcept {
+        std::optional<texture_container> container;
+        if (file) container = read_texture_container(file);
+
+        if (!container) {
+            P_LOG_E("Failed to load texture: {}", path);
+            engine_abort();
+        }
+
+        // skipping levels needs their offsets, which only ktx2 stores
+        if (first_level && (container->is_layer_major || first_level >= container->level_count)) {
+            P_LOG_E("Can't skip {} levels of texture: {}", first_level, path);
+            engine_abort();
+        }
+
+        return container.value();
+    }
+
+    void texture::begin_container_streams(const texture_container& container, uint32_t first_level, uint32_t generated_level_count, rendering::stream_priority priority,
+        const std::string_view name, const container_read_fn& read) {
+        uint32_t layer_count = container.layer_count * container.face_count;
+
+        auto begin_read = [&](vk::ImageSubresourceLayers subresource, uint32_t stream_level_count, uint32_t stream_generated_level_count, uint64_t offset, std::optional<uint64_t> stored_size) {
+            rendering::asset_streamer::pending_stream stream = begin_stream(subresource, stream_level_count, stream_generated_level_count, priority);
+            uint64_t size = stream.get_data().size();
+
+            if (stored_size && stored_size.value() != size) {
+                P_LOG_E("Texture level size doesn't match its format! (expected: {} stored: {}) {}", size, stored_size.value(), name);
+                engine_abort();
+            }
+
+            read(std::move(stream), offset);
+            return size;
+        };
+
+        if (container.is_layer_major) {
+            // dds, every layer (or cube face) is followed by its mip chain, the chain size follows from the format
+            uint64_t offset = container.data_offset;
+
+            for (uint32_t layer = 0; layer < layer_count; layer++) {
+                offset += begin_read({
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = layer,
+                    .layerCount = 1,
+                }, container.level_count, 0, offset, std::nullopt);
+            }
+        } else {
+            // ktx2, the smallest level is stored first so the levels are streamed in file order
+            for (uint32_t level = container.level_count; level-- > first_level;) {
+                begin_read({
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = level - first_level,
+                    .baseArrayLayer = 0,
+                    .layerCount = layer_count,
+                }, 1, level == first_level ? generated_level_count : 0, container.levels[level].offset, container.levels[level].size);
+            }
+        }
+    }
+
+    void texture::read_container(const std::string_view path, uint32_t first_level, rendering::stream_priority priority) noexcept {
+        std::ifstream file(std::string(path), std::ios::binary);
+        texture_container container = read_container_header(file, path, first_level);
+
+        uint32_t generated_level_count = create_container(container, first_level, path);
+
+        // the texel data is read straight into the streamer's staging memory, one stream per contiguous run in the file,
+        // the texture is ready once all of them are finished (see is_ready())
+
+        begin_container_streams(container, first_level, generated_level_count, priority, path, [&](rendering::asset_streamer::pending_stream&& stream, uint64_t offset) {
+            std::span<std::byte> data = stream.get_data();
+
+            file.clear();
+            file.seekg(offset);
+            file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+            if (static_cast<size_t>(file.gcount()) != data.size()) {
+                P_LOG_E("Texture file is truncated! {}", path);
+                engine_abort();
+            }
+
+            commit_stream(std::move(stream));
+        });
+    }
+
+    void texture::read_container_async(async_reader& reader, const std::string& path, uint32_t first_level, rendering::stream_priority priority, std::function<void()> on_staged) noexcept {
+        texture_container container;
+
+        {
+            std::ifstream file(path, std::ios::binary);
+            container = read_container_header(file, path, first_level);
+        }
+
+        std::shared_ptr<const async_reader::file> source = async_reader::open(path);
+
+        if (!source) {
+            P_LOG_E("Failed to load texture: {}", path);
+            engine_abort();
+        }
+
+        uint32_t generated_level_count = create_container(container, first_level, path);
+
+        // every stream is reserved up front and read into its reservation, the reads complete in any order and are committed as they arrive
+
+        struct stream_read {
+            rendering::asset_streamer::pending_stream stream;
+            uint64_t offset; // in the file
+        };
+
+        std::vector<std::shared_ptr<stream_read>> reads;
+
+        begin_container_streams(container, first_level, generated_level_count, priority, path, [&](rendering::asset_streamer::pending_stream&& stream, uint64_t offset) {
+            reads.push_back(std::make_shared<stream_read>(stream_read{
+                .stream = std::move(stream),
+                .offset = offset,
+            }));
+        });
+
+        struct container_read {
+            std::mutex commit_lock; // guards commit_stream() (and the ready fences) and [remaining_count]
+            size_t remaining_count;
+            std::function<void()> on_staged;
+        };
+
+        std::shared_ptr<container_read> container_state = std::make_shared<container_read>();
+        container_state->remaining_count = reads.size();
+        container_state->on_staged = std::move(on_staged);
+
+        // the reservations lie in the staging ring of this thread, registering it lets io_uring skip pinning its pages on every read
+        reader.register_buffer(streamer.get_thread_staging_memory());
+
+        for (std::shared_ptr<stream_read>& read : reads) {
+            std::span<std::byte> data = read->stream.get_data();
+
+            reader.read(source, read->offset, data, [this, container_state, read, path](std::optional<size_t> size) {
+                if (size != read->stream.get_data().size()) {
+                    P_LOG_E("Texture file is truncated! {}", path);
+                    engine_abort();
+                }
+
+                std::lock_guard lock(container_state->commit_lock);
+                commit_stream(std::move(read->stream));
+
+                if (--container_state->remaining_count == 0) container_state->on_staged();
+            });
+        }
+    }
+
+    void texture::read_packed(const asset_pack& pack, const std::string_view name, texture_encoding encoding, rendering::stream_priority priority, worker_pool* pool) noexcept {
+        asset_pack::entry_id id = pack.find(name);
+
+        if (id == asset_pack::no_entry) {
+            P_LOG_E("Texture not found in asset pack: {} ({})", name, pack.get_path());
+            engine_abort();
+        }
+
+        const pack::entry& entry = pack.get_entry(id);
+
+        if (entry.type == pack::entry_type::raw) {
+            if (entry.compression == pack::compression_type::none) return read_image(pack.get_data(id), name, encoding, priority, nullptr);
+
+            std::vector<std::byte> file_data(entry.size);
+            pack.read(id, 0, file_data, pool);
+
+            return read_image(file_data, name, encoding, priority, nullptr);
+        }
+
+        // the payload is already packed for streaming, so it's copied from the mapping straight into staging by stream(),
+        // compressed payloads are staged as stored and decompressed on the gpu if possible, otherwise straight into a reserved stream
+
+        texture_container container = pack.get_texture_container(id);
+
+        uint32_t generated_level_count = create_container(container, 0, name);
+        uint32_t layer_count = container.layer_count * container.face_count;
+
+        auto read_stream = [&](uint64_t offset, uint64_t size, vk::ImageSubresourceLayers subresource, uint32_t stream_level_count, uint32_t stream_generated_level_count) {
+            if (entry.compression == pack::compression_type::none) {
+                return stream(pack.get_data(id).data() + offset, size, subresource, stream_level_count, stream_generated_level_count, priority);
+            }
+
+            rendering::asset_streamer::image_stream_info stream_info = get_stream_info(subresource, stream_level_count, stream_generated_level_count);
+
+            if (streamer.is_decompression_supported(stream_info)) {
+                // note: decompressions are recorded once their input is staged, so the layers can finish in any order
+                ready_fences.push_back(streamer.stream_compressed(stream_info, { .stored = pack.get_data(id), .payload_size = entry.size, .offset = offset }, size, priority));
+                return;
+            }
+
+            rendering::asset_streamer::pending_stream pending = begin_stream(subresource, stream_level_count, stream_generated_level_count, priority);
+
+            if (pending.get_data().size() != size) {
+                P_LOG_E("Texture data size doesn't match its format! (expected: {} stored: {}) {}", pending.get_data().size(), size, name);
+                engine_abort();
+            }
+
+            pack.read(id, offset, pending.get_data(), pool);
+            commit_stream(std::move(pending));
+        };
+
+        if (container.is_layer_major) {
+            // every layer (or cube face) is followed by its mip chain, all chains have the same size
+            uint64_t chain_size = entry.size / layer_count;
+
+            for (uint32_t layer = 0; layer < layer_count; layer++) {
+                read_stream(layer * chain_size, chain_size, {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = layer,
+                    .layerCount = 1,
+                }, container.level_count, 0);
+            }
+        } else {
+            read_stream(0, entry.size, {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count,
+            }, container.level_count, generated_level_count);
+        }
+    }
+
+    uint32_t texture::create_container(const texture_container& container, uint32_t first_level, const std::string_view name) noexcept {
+        vk::Format format = static_cast<vk::Format>(container.format);
+        vk::FormatFeatureFlags format_features = streamer.get_device().get_physical_device().getFormatProperties(format).optimalTilingFeatures;
+
+        if (!(format_features & vk::FormatFeatureFlagBits::eSampledImage)) {
+            P_LOG_E("Texture format {} is not supported by the device! ({})", vk::to_string(format), name);
+            engine_abort();
+        }
+
+        // levels that aren't stored in the file (ktx2 level count of 0) are generated when the format can be blitted
+        constexpr vk::FormatFeatureFlags blit_features = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        uint32_t generated_level_count = 0;
+
+        if (container.generate_levels && (format_features & blit_features) == blit_features) {
+            generated_level_count = std::bit_width(std::max({ container.width, container.height, container.depth })) - 1;
+        }
+
+        // the image starts at [first_level] of the file
+        uint32_t level_count = container.level_count - first_level + generated_level_count;
+        uint32_t layer_count = container.layer_count * container.face_count;
+
+        vk::ImageCreateInfo image_info{
+            .flags = container.face_count == 6 ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags{},
+            .imageType = container.dimension_count == 3 ? vk::ImageType::e3D : container.dimension_count == 2 ? vk::ImageType::e2D : vk::ImageType::e1D,
+            .format = format,
+            .extent = { std::max(1U, container.width >> first_level), std::max(1U, container.height >> first_level), std::max(1U, container.depth >> first_level) },
+            .mipLevels = level_count,
+            .arrayLayers = layer_count,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        if (generated_level_count) image_info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+        if (streamer.get_device().is_host_image_copy_supported(format, generated_level_count ? vk::ImageLayout::eGeneral : vk::ImageLayout::eShaderReadOnlyOptimal)) {
+            image_info.usage |= vk::ImageUsageFlagBits::eHostTransferEXT;
+        }
+
+        vk::ImageViewType view_type;
+
+        if (container.face_count == 6) {
+            view_type = container.layer_count > 1 ? vk::ImageViewType::eCubeArray : vk::ImageViewType::eCube;
+        } else if (container.dimension_count == 3) {
+            view_type = vk::ImageViewType::e3D;
+        } else if (container.dimension_count == 2) {
+            view_type = layer_count > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+        } else {
+            view_type = layer_count > 1 ? vk::ImageViewType::e1DArray : vk::ImageViewType::e1D;
+        }
+
+        vk::ImageViewCreateInfo view_info{
+            .viewType = view_type,
+            .format = format,
+            .subresourceRange{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = level_count,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count,
+            },
+        };
+
+        create(image_info, vk::ImageLayout::eShaderReadOnlyOptimal, alloc_info, view_info);
+
+        return generated_level_count;
+    }
+}
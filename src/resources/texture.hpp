@@ -1,11 +1,29 @@
 #pragma once
 
 #include <rendering/vk_device.hpp>
+#include <core/async_reader.hpp>
+#include <core/worker_pool.hpp>
 #include "streamer.hpp"
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace photon {
+    // how the texel data of a loaded texture is interpreted
+    enum class texture_encoding {
+        srgb, // color data
+        linear, // non-color data (masks, roughness, normals)
+    };
+
+    class texture_handle;
+    class asset_pack;
+    class derived_data_cache;
+    struct texture_container;
+
     class texture {
     public:
         texture(rendering::asset_streamer& streamer) noexcept : streamer{streamer}, device{streamer.get_device()} { }
@@ -15,8 +33,18 @@ namespace photon {
         void create(const vk::ImageCreateInfo& image_info, vk::ImageLayout normal_layout, const VmaAllocationCreateInfo& alloc_info, vk::ImageViewCreateInfo& view_info);
         void destroy() noexcept;
 
-        // data streaming (staging)
-        void stream(void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, bool is_deferred);
+        // data streaming (staging), note: can be called from loader threads (see asset_streamer::stream())
+        // streams [level_count] mip levels starting at subresource.mipLevel, [data] is packed as described by asset_streamer::stream()
+        // the following [generated_level_count] levels are generated from the last streamed one (requires eTransferSrc usage)
+        void stream(const void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count, rendering::stream_priority priority);
+
+        // two-phase streaming, the data is written to the returned stream's get_data() (see asset_streamer::begin_stream())
+        rendering::asset_streamer::pending_stream begin_stream(vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count, rendering::stream_priority priority);
+        void commit_stream(rendering::asset_streamer::pending_stream&& stream);
+
+        // copies [data] (packed as a single level stream) into a region of one mip level of the streamed image on the graphics queue,
+        // the rest of the image is kept (see asset_streamer::update()), the texture must be ready already
+        void update(const void* data, VkDeviceSize data_size, vk::ImageSubresourceLayers subresource, vk::Offset3D offset, vk::Extent3D extent);
 
         vk::Image get_image() const noexcept { return image; }
         vk::ImageView get_image_view() const noexcept { return image_view; }
@@ -24,13 +52,86 @@ namespace photon {
 
         vk::Format get_format() const noexcept { return image_format; } // note: will return the format of the image, image_view format might differ
         vk::Extent3D get_extent() const noexcept { return image_extent; } // note: for 1D and 2D images it's guaranteed that unused dimensions are equal to 1
+        uint32_t get_level_count() const noexcept { return image_level_count; }
+
+        // true once every stream of the texture is finished, finished fences are dropped
+        // note: streams can finish in any order (see asset_streamer::stream()), so no single fence covers the texture
+        bool is_ready();
+
+        // decodes (see decode_image()) and stages a texture to gpu, .ktx2 and .dds files are loaded with load_container()
+        // the image keeps the component count of the file (R8, RG8 or RGBA8, gray is swizzled to rgb), rgb is expanded to rgba
+        // with a [cache] the converted texels are stored keyed by the file content, later loads of the same content skip decoding and stream the mapped entry
+        static texture load_file(rendering::asset_streamer& streamer, const std::string_view path, texture_encoding encoding = texture_encoding::srgb, derived_data_cache* cache = nullptr) noexcept;
+
+        // decodes and stages the file on a thread of [pool] (see load_file()), returns immediately with a handle in the loading state
+        // note: every loader thread stages into its own staging ring of the streamer
+        static texture_handle load_file_async(worker_pool& pool, rendering::asset_streamer& streamer, std::string path, texture_encoding encoding = texture_encoding::srgb, rendering::stream_priority priority = rendering::stream_priority::normal, derived_data_cache* cache = nullptr);
+
+        // like load_file_async(), but the file is read by [reader] so loader threads don't block on disk reads, source images are decoded
+        // on [pool] once read, container levels are read straight into staging memory (the thread staging ring is registered with [reader])
+        // note: the reader must be destroyed before the streamer and [pool] (its completions submit to the pool), with no container loads still queued on [pool]
+        static texture_handle load_file_async(async_reader& reader, worker_pool& pool, rendering::asset_streamer& streamer, std::string path, texture_encoding encoding = texture_encoding::srgb, rendering::stream_priority priority = rendering::stream_priority::normal, derived_data_cache* cache = nullptr);
+
+        // loads a gpu-ready ktx2 or dds file (block compressed formats, cubemaps, arrays and pre-baked mips),
+        // every level is read straight into staging memory and copied to the image without decoding
+        // the [first_level] largest levels are skipped, the image starts at that level (ktx2 only, see texture_residency)
+        static texture load_container(rendering::asset_streamer& streamer, const std::string_view path, uint32_t first_level = 0) noexcept;
+        static texture_handle load_container_async(worker_pool& pool, rendering::asset_streamer& streamer, std::string path, uint32_t first_level = 0, rendering::stream_priority priority = rendering::stream_priority::normal);
 
-        rendering::multi_fence_view get_ready_fence() noexcept { return ready_fence; }
+        // like load_container_async(), the header is parsed on [pool] and the levels are read by [reader] (see load_file_async())
+        static texture_handle load_container_async(async_reader& reader, worker_pool& pool, rendering::asset_streamer& streamer, std::string path, uint32_t first_level = 0, rendering::stream_priority priority = rendering::stream_priority::normal);
 
-        // uses stb_image to load and stage a texture to gpu
-        static texture load_file(rendering::asset_streamer& streamer, const std::string_view path) noexcept;
+        // loads an entry of a mapped asset pack, texture entries are streamed straight from the mapping without parsing a container,
+        // raw entries (source images) are decoded like load_file() does, compressed payloads are decompressed on the gpu if the streamer
+        // supports it (see asset_streamer::stream_compressed()), otherwise on [pool] (if given)
+        // note: the pack must outlive the async load, which decompresses on its own pool
+        static texture load_packed(rendering::asset_streamer& streamer, const asset_pack& pack, const std::string_view name, texture_encoding encoding = texture_encoding::srgb, worker_pool* pool = nullptr) noexcept;
+        static texture_handle load_packed_async(worker_pool& pool, rendering::asset_streamer& streamer, const asset_pack& pack, std::string name, texture_encoding encoding = texture_encoding::srgb, rendering::stream_priority priority = rendering::stream_priority::normal);
+
+        // true if [format] can be sampled, streamed and have its mips generated
+        static bool is_mip_format_supported(rendering::vulkan_device& device, vk::Format format) noexcept;
 
     private:
+        // create and stream the image of a file, shared by the blocking and async loaders
+        void read_file(const std::string_view path, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) noexcept;
+        void read_container(const std::string_view path, uint32_t first_level, rendering::stream_priority priority) noexcept;
+
+        // like read_container() with the levels read by [reader], [on_staged] runs (on a reader thread) once every level is committed
+        void read_container_async(async_reader& reader, const std::string& path, uint32_t first_level, rendering::stream_priority priority, std::function<void()> on_staged) noexcept;
+
+        // called with every reserved stream of a container and its offset in the file, the stream has to be committed
+        using container_read_fn = std::function<void(rendering::asset_streamer::pending_stream&& stream, uint64_t offset)>;
+
+        // reserves the streams of a container created by create_container() in file order (dds layers with their mip chain, ktx2 levels
+        // from the smallest to [first_level]) and checks their size against the stored one, shared by read_container() and read_container_async()
+        void begin_container_streams(const texture_container& container, uint32_t first_level, uint32_t generated_level_count, rendering::stream_priority priority, const std::string_view name, const container_read_fn& read);
+        void read_packed(const asset_pack& pack, const std::string_view name, texture_encoding encoding, rendering::stream_priority priority, worker_pool* pool) noexcept;
+
+        // decodes a source image file and streams it, [name] is used for errors, [cache] is optional (see load_file())
+        void read_image(std::span<const std::byte> file_data, const std::string_view name, texture_encoding encoding, rendering::stream_priority priority, derived_data_cache* cache) noexcept;
+
+        // streams a derived data cache entry stored by read_image(), returns false if it's malformed or was converted for another device
+        bool read_cached_image(std::span<const std::byte> entry, texture_encoding encoding, rendering::stream_priority priority) noexcept;
+
+        // how decoded texels are streamed, depends on the component count and the device (transcode and format support)
+        struct image_conversion {
+            vk::Format data_format; // of the streamed texels
+            uint32_t data_components;
+            vk::Format image_format; // differs from [data_format] if transcoded
+        };
+
+        image_conversion get_image_conversion(uint32_t component_count, texture_encoding encoding) noexcept;
+
+        // creates a 2D image with a full mip chain and streams its first level from [data] (converted texels), the rest is generated
+        void create_image(uint32_t width, uint32_t height, const image_conversion& conversion, const void* data, VkDeviceSize data_size, rendering::stream_priority priority) noexcept;
+
+        // creates the image described by a container header starting at its [first_level], returns the number of levels to generate
+        uint32_t create_container(const texture_container& container, uint32_t first_level, const std::string_view name) noexcept;
+
+        static texture_handle load_async(worker_pool& pool, rendering::asset_streamer& streamer, std::function<void(texture&)> load);
+
+        rendering::asset_streamer::image_stream_info get_stream_info(vk::ImageSubresourceLayers subresource, uint32_t level_count, uint32_t generated_level_count) noexcept;
+
         vk::Image image;
         vk::ImageView image_view;
         VmaAllocation image_alloc = VK_NULL_HANDLE;
@@ -38,12 +139,56 @@ namespace photon {
         // stores the layout of the image when not in use
         vk::ImageLayout image_normal_layout;
 
-        rendering::multi_fence_view ready_fence;
+        std::vector<rendering::multi_fence_view> ready_fences; // of the streams which weren't seen finished yet
 
         rendering::asset_streamer& streamer;
         rendering::vulkan_device& device;
 
         vk::Format image_format;
         vk::Extent3D image_extent;
+        uint32_t image_level_count;
+        vk::SharingMode image_sharing_mode;
+        vk::Format image_data_format = vk::Format::eUndefined; // format of the streamed data if it's transcoded into [image_format]
+
+        bool is_host_writable = false; // linear image still in ePreinitialized layout, the first stream can be written directly
+        bool is_host_copyable = false; // created with eHostTransferEXT usage
+    };
+
+    enum class texture_load_state {
+        loading, // being decoded on a loader thread
+        staged, // allocated and queued to the streamer, not ready for use yet
+        ready, // the ready fence of the texture is signaled
+    };
+
+    // a texture loaded by texture::load_file_async(), the handle can be copied and polled from any thread
+    class texture_handle {
+    public:
+        texture_handle() noexcept = default;
+
+        texture_load_state get_state() const;
+        bool is_valid() const noexcept { return state != nullptr; }
+
+        // blocks until the texture is staged (its ready fence can then be waited on)
+        void wait_staged() const noexcept { state->is_staged.wait(false, std::memory_order_acquire); }
+
+        // note: only valid once the handle is staged
+        texture& get() noexcept { return state->tex; }
+
+    private:
+        struct load_state {
+            load_state(rendering::asset_streamer& streamer) noexcept : tex{streamer} { }
+
+            void set_staged() noexcept {
+                is_staged.store(true, std::memory_order_release);
+                is_staged.notify_all();
+            }
+
+            texture tex;
+            std::atomic<bool> is_staged = false; // set by the loader thread once [tex] is created and streamed
+        };
+
+        std::shared_ptr<load_state> state;
+
+        friend class texture;
     };
 }
\ No newline at end of file
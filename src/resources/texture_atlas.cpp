@@ -0,0 +1,584 @@
+#include "texture_atlas.hpp"
+#include "texture_container.hpp"
+#include "image_decoder.hpp"
+#include "texel_convert.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+namespace photon {
+    // copies a grid of texel blocks into one of another size, blocks outside of the source repeat its edge blocks
+    static void copy_blocks(const std::byte* src, uint32_t src_width, uint32_t src_height, std::byte* dst, uint32_t dst_width, uint32_t dst_height, size_t block_size) noexcept {
+        uint32_t copied_width = std::min(src_width, dst_width);
+
+        for (uint32_t y = 0; y < dst_height; y++) {
+            const std::byte* src_row = src + static_cast<size_t>(std::min(y, src_height - 1)) * src_width * block_size;
+            std::byte* dst_row = dst + static_cast<size_t>(y) * dst_width * block_size;
+
+            std::memcpy(dst_row, src_row, copied_width * block_size);
+
+            for (uint32_t x = copied_width; x < dst_width; x++) {
+                std::memcpy(dst_row + x * block_size, src_row + (src_width - 1) * block_size, block_size);
+            }
+        }
+    }
+
+    texture_atlas::texture_atlas(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const atlas_config& config) noexcept :
+        streamer{streamer},
+        pool{pool},
+        config{config},
+        max_frames_in_flight{max_frames_in_flight}
+    {
+        retired_layers.resize(max_frames_in_flight);
+        retired_arrays.resize(max_frames_in_flight);
+    }
+
+    texture_atlas::~texture_atlas() noexcept {
+        for (uint32_t array = 0; array < arrays.size(); array++) {
+            if (arrays[array].image) destroy_array(array);
+        }
+    }
+
+    texture_atlas::texture_id texture_atlas::add_texture(std::string path, texture_encoding encoding) {
+        texture_id id = static_cast<texture_id>(entries.size());
+
+        atlas_entry& entry = entries.emplace_back(atlas_entry{
+            .path = path,
+            .state = entry_state::loading,
+            .load = std::make_shared<load_state>(),
+        });
+
+        loading_entries.push_back(id);
+
+        // note: the task only holds the load state, so the atlas doesn't have to outlive it
+        pool.submit([load = entry.load, path = std::move(path), encoding, config = config]() {
+            load->layer = read_layer(path, encoding, config);
+            load->is_loaded.store(true, std::memory_order_release);
+        });
+
+        return id;
+    }
+
+    void texture_atlas::remove_texture(texture_id id) noexcept {
+        entries[id].is_removed = true;
+        removed_entries.push_back(id);
+    }
+
+    void texture_atlas::update(uint32_t frame_index) {
+        // the layers and arrays retired in this frame slot aren't used by the gpu anymore
+
+        for (auto [array, layer] : retired_layers[frame_index]) {
+            arrays[array].free_layers.push_back(layer);
+        }
+
+        for (uint32_t array : retired_arrays[frame_index]) {
+            destroy_array(array);
+        }
+
+        retired_layers[frame_index].clear();
+        retired_arrays[frame_index].clear();
+
+        // removed textures free their layer, the ones still loading or streaming once they're done
+
+        for (texture_id id : removed_entries) {
+            if (entries[id].state == entry_state::ready) retire_layer(entries[id].region, frame_index);
+        }
+
+        removed_entries.clear();
+
+        // stream loaded textures into a layer of their class
+
+        for (uint32_t i = static_cast<uint32_t>(loading_entries.size()); i-- > 0;) {
+            texture_id id = loading_entries[i];
+            atlas_entry& entry = entries[id];
+
+            if (!entry.load->is_loaded.load(std::memory_order_acquire)) continue;
+
+            loading_entries[i] = loading_entries.back();
+            loading_entries.pop_back();
+
+            std::shared_ptr<load_state> load = std::move(entry.load);
+            if (entry.is_removed) continue;
+
+            const layer_data& layer = load->layer;
+
+            if (layer.generated_level_count && !texture::is_mip_format_supported(streamer.get_device(), layer.format)) {
+                P_LOG_E("Texture format {} doesn't support mip generation! ({})", vk::to_string(layer.format), entry.path);
+                engine_abort();
+            }
+
+            auto [array, array_layer] = reserve_layer(layer.format, layer.extent);
+
+            arrays[array].layers[array_layer] = id;
+            arrays[array].used_layer_count++;
+
+            entry.region = atlas_region{
+                .array = array,
+                .layer = array_layer,
+                .uv_rect = glm::vec4(0.f, 0.f, static_cast<float>(layer.width) / layer.extent, static_cast<float>(layer.height) / layer.extent),
+            };
+
+            entry.ready_fence = streamer.stream(rendering::asset_streamer::image_stream_info{
+                .image = arrays[array].image,
+                .format = layer.format,
+                .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .sharing_mode = vk::SharingMode::eExclusive,
+                .image_subresource = {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .mipLevel = 0,
+                    .baseArrayLayer = array_layer,
+                    .layerCount = 1,
+                },
+                .level_count = layer.level_count,
+                .generated_level_count = layer.generated_level_count,
+                .image_offset = { 0, 0, 0 },
+                .image_extent = { layer.extent, layer.extent, 1 },
+                .dst_alloc = VK_NULL_HANDLE,
+                .is_host_copyable = false, // the other layers are in use by the device
+            }, layer.data.data(), layer.data.size(), config.priority);
+
+            entry.state = entry_state::streaming;
+            streaming_entries.push_back(id);
+        }
+
+        // publish finished textures
+
+        for (uint32_t i = static_cast<uint32_t>(streaming_entries.size()); i-- > 0;) {
+            atlas_entry& entry = entries[streaming_entries[i]];
+            if (entry.ready_fence.status() != vk::Result::eSuccess) continue;
+
+            entry.state = entry_state::ready;
+            entry.ready_fence = {};
+
+            if (entry.is_removed) retire_layer(entry.region, frame_index);
+
+            streaming_entries[i] = streaming_entries.back();
+            streaming_entries.pop_back();
+        }
+
+        repack(frame_index);
+    }
+
+    void texture_atlas::record_commands(vk::CommandBuffer cmd) {
+        // move the layers of repacked arrays (with all levels), the destination layers are free so their contents are discarded
+
+        std::vector<vk::ImageMemoryBarrier2> barriers;
+        barriers.reserve(pending_moves.size() * 2);
+
+        auto add_barrier = [&](uint32_t array, uint32_t layer, vk::PipelineStageFlags2 src_stage, vk::AccessFlags2 src_access, vk::ImageLayout old_layout,
+            vk::PipelineStageFlags2 dst_stage, vk::AccessFlags2 dst_access, vk::ImageLayout new_layout) {
+            barriers.push_back(vk::ImageMemoryBarrier2{
+                .srcStageMask = src_stage,
+                .srcAccessMask = src_access,
+                .dstStageMask = dst_stage,
+                .dstAccessMask = dst_access,
+                .oldLayout = old_layout,
+                .newLayout = new_layout,
+                .image = arrays[array].image,
+                .subresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = arrays[array].level_count,
+                    .baseArrayLayer = layer,
+                    .layerCount = 1,
+                }
+            });
+        };
+
+        for (const layer_move& move : pending_moves) {
+            add_barrier(move.src_array, move.src_layer, vk::PipelineStageFlagBits2::eAllGraphics, {}, vk::ImageLayout::eShaderReadOnlyOptimal,
+                vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eTransferSrcOptimal);
+            add_barrier(move.dst_array, move.dst_layer, vk::PipelineStageFlagBits2::eAllGraphics, {}, vk::ImageLayout::eUndefined,
+                vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal);
+        }
+
+        vk::DependencyInfo dep_info{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pImageMemoryBarriers = barriers.data(),
+        };
+
+        cmd.pipelineBarrier2(dep_info);
+
+        std::vector<vk::ImageCopy> regions;
+
+        for (const layer_move& move : pending_moves) {
+            const texture_array& src = arrays[move.src_array];
+            regions.clear();
+
+            for (uint32_t level = 0; level < src.level_count; level++) {
+                uint32_t level_extent = std::max(1U, src.extent >> level);
+
+                regions.push_back(vk::ImageCopy{
+                    .srcSubresource = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = level,
+                        .baseArrayLayer = move.src_layer,
+                        .layerCount = 1,
+                    },
+                    .srcOffset = { 0, 0, 0 },
+                    .dstSubresource = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = level,
+                        .baseArrayLayer = move.dst_layer,
+                        .layerCount = 1,
+                    },
+                    .dstOffset = { 0, 0, 0 },
+                    .extent = { level_extent, level_extent, 1 },
+                });
+            }
+
+            cmd.copyImage(src.image, vk::ImageLayout::eTransferSrcOptimal, arrays[move.dst_array].image, vk::ImageLayout::eTransferDstOptimal, regions);
+        }
+
+        // back to the normal layout, the source arrays are only destroyed after the frames in flight
+
+        barriers.clear();
+
+        for (const layer_move& move : pending_moves) {
+            add_barrier(move.src_array, move.src_layer, vk::PipelineStageFlagBits2::eCopy, {}, vk::ImageLayout::eTransferSrcOptimal,
+                vk::PipelineStageFlagBits2::eAllGraphics, {}, vk::ImageLayout::eShaderReadOnlyOptimal);
+            add_barrier(move.dst_array, move.dst_layer, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal,
+                vk::PipelineStageFlagBits2::eAllGraphics, vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eShaderReadOnlyOptimal);
+        }
+
+        dep_info.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+        dep_info.pImageMemoryBarriers = barriers.data();
+
+        cmd.pipelineBarrier2(dep_info);
+
+        pending_moves.clear();
+    }
+
+    texture_atlas::layer_data texture_atlas::read_layer(const std::string& path, texture_encoding encoding, const atlas_config& config) {
+        std::ifstream file(path, std::ios::binary);
+
+        bool is_container = path.ends_with(".ktx2") || path.ends_with(".dds");
+        std::optional<texture_container> container;
+
+        if (file && is_container) container = read_texture_container(file);
+
+        // the whole file is read, the textures are small
+
+        std::vector<std::byte> file_data;
+
+        if (file) {
+            file.clear();
+            file.seekg(0, std::ios::end);
+            file_data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(file_data.data()), file_data.size());
+        }
+
+        if (!file || (is_container && !container)) {
+            P_LOG_E("Failed to load texture: {}", path);
+            engine_abort();
+        }
+
+        layer_data layer;
+
+        if (is_container) {
+            if (container->dimension_count != 2 || container->layer_count * container->face_count != 1) {
+                P_LOG_E("Only single layer 2D textures can be packed into atlases: {}", path);
+                engine_abort();
+            }
+
+            layer.format = static_cast<vk::Format>(container->format);
+            layer.width = container->width;
+            layer.height = container->height;
+        } else {
+            std::optional<decoded_image> image = decode_image(file_data);
+
+            if (!image) {
+                P_LOG_E("Failed to load texture: {}", path);
+                engine_abort();
+            }
+
+            layer.format = encoding == texture_encoding::srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+            layer.width = image->width;
+            layer.height = image->height;
+
+            // replace the file with the rgba8 texels
+            file_data.resize(static_cast<size_t>(image->width) * image->height * 4);
+            expand_to_rgba8(image->texels.get(), reinterpret_cast<uint8_t*>(file_data.data()), static_cast<size_t>(image->width) * image->height, image->component_count);
+        }
+
+        if (std::max(layer.width, layer.height) > config.max_extent) {
+            P_LOG_E("Texture is too large for an atlas ({}x{}): {}", layer.width, layer.height, path);
+            engine_abort();
+        }
+
+        layer.extent = std::max(config.min_extent, std::bit_ceil(std::max(layer.width, layer.height)));
+
+        uint32_t layer_level_count = std::bit_width(layer.extent);
+
+        // levels of the layer which are read from the texture, the rest is generated
+
+        bool has_stored_levels = is_container && !container->generate_levels;
+
+        layer.level_count = has_stored_levels ? layer_level_count : 1;
+        layer.generated_level_count = layer_level_count - layer.level_count;
+
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(layer.format);
+        size_t block_size = vk::blockSize(layer.format);
+
+        auto get_blocks = [&](uint32_t size, uint32_t level, uint32_t block) { return (std::max(1U, size >> level) + block - 1) / block; };
+
+        size_t data_size = 0;
+
+        for (uint32_t level = 0; level < layer.level_count; level++) {
+            data_size += get_blocks(layer.extent, level, block_extent[0]) * get_blocks(layer.extent, level, block_extent[1]) * block_size;
+        }
+
+        layer.data.resize(data_size);
+
+        // levels the texture doesn't store (its mip chain ends before the one of the layer) repeat its last level
+
+        uint32_t texture_level_count = has_stored_levels ? container->level_count : 1;
+        uint64_t src_offset = is_container ? container->data_offset : 0; // dds stores the levels one after another
+        size_t dst_offset = 0;
+
+        for (uint32_t level = 0; level < layer.level_count; level++) {
+            uint32_t src_level = std::min(level, texture_level_count - 1);
+
+            uint32_t src_width = get_blocks(layer.width, src_level, block_extent[0]);
+            uint32_t src_height = get_blocks(layer.height, src_level, block_extent[1]);
+            size_t src_size = static_cast<size_t>(src_width) * src_height * block_size;
+
+            if (is_container) {
+                if (!container->is_layer_major) {
+                    if (container->levels[src_level].size != src_size) {
+                        P_LOG_E("Texture level size doesn't match its format! (expected: {} stored: {}) {}", src_size, container->levels[src_level].size, path);
+                        engine_abort();
+                    }
+
+                    src_offset = container->levels[src_level].offset;
+                } else if (level != src_level) {
+                    src_offset -= src_size; // the previous (last) level again
+                }
+
+                if (src_offset + src_size > file_data.size()) {
+                    P_LOG_E("Texture file is truncated! {}", path);
+                    engine_abort();
+                }
+            }
+
+            uint32_t dst_width = get_blocks(layer.extent, level, block_extent[0]);
+            uint32_t dst_height = get_blocks(layer.extent, level, block_extent[1]);
+
+            copy_blocks(file_data.data() + src_offset, src_width, src_height, layer.data.data() + dst_offset, dst_width, dst_height, block_size);
+
+            if (is_container && container->is_layer_major) src_offset += src_size;
+            dst_offset += static_cast<size_t>(dst_width) * dst_height * block_size;
+        }
+
+        return layer;
+    }
+
+    std::pair<uint32_t, uint32_t> texture_atlas::reserve_layer(vk::Format format, uint32_t extent) {
+        uint32_t array = 0;
+
+        while (array < arrays.size()) {
+            const texture_array& candidate = arrays[array];
+            if (candidate.image && !candidate.is_retired && candidate.format == format && candidate.extent == extent && !candidate.free_layers.empty()) break;
+
+            array++;
+        }
+
+        if (array == arrays.size()) array = create_array(format, extent);
+
+        uint32_t layer = arrays[array].free_layers.back();
+        arrays[array].free_layers.pop_back();
+
+        return { array, layer };
+    }
+
+    void texture_atlas::retire_layer(const atlas_region& region, uint32_t frame_index) noexcept {
+        texture_array& array = arrays[region.array];
+
+        array.layers[region.layer] = no_texture;
+        array.used_layer_count--;
+
+        retired_layers[frame_index].emplace_back(region.array, region.layer);
+    }
+
+    uint32_t texture_atlas::create_array(vk::Format format, uint32_t extent) {
+        rendering::vulkan_device& device = streamer.get_device();
+
+        constexpr vk::FormatFeatureFlags array_features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eTransferSrc | vk::FormatFeatureFlagBits::eTransferDst;
+
+        if ((device.get_physical_device().getFormatProperties(format).optimalTilingFeatures & array_features) != array_features) {
+            P_LOG_E("Texture format {} is not supported by the device!", vk::to_string(format));
+            engine_abort();
+        }
+
+        // destroyed arrays leave their slot for reuse
+        uint32_t array = 0;
+        while (array < arrays.size() && arrays[array].image) array++;
+
+        if (array == arrays.size()) arrays.emplace_back();
+
+        texture_array& new_array = arrays[array];
+        new_array.format = format;
+        new_array.extent = extent;
+        new_array.level_count = std::bit_width(extent);
+
+        vk::ImageCreateInfo image_info{
+            .imageType = vk::ImageType::e2D,
+            .format = format,
+            .extent = { extent, extent, 1 },
+            .mipLevels = new_array.level_count,
+            .arrayLayers = config.layers_per_array,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc, // transfer src for mip generation and repacks
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        VkImage image;
+
+        VkResult res = vmaCreateImage(device.get_allocator(), &static_cast<VkImageCreateInfo&>(image_info), &alloc_info, &image, &new_array.alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateImage");
+
+        new_array.image = image;
+
+        vk::ImageViewCreateInfo view_info{
+            .image = new_array.image,
+            .viewType = vk::ImageViewType::e2DArray,
+            .format = format,
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = new_array.level_count,
+                .baseArrayLayer = 0,
+                .layerCount = config.layers_per_array,
+            },
+        };
+
+        new_array.view = device.get_device().createImageView(view_info);
+
+        // the whole array is cleared once so the free layers are in the normal layout too (the view covers them)
+        // note: queued before the textures streamed into it, streams of the same priority finish in order
+
+        rendering::asset_streamer::pending_stream clear_stream = streamer.begin_stream(rendering::asset_streamer::image_stream_info{
+            .image = new_array.image,
+            .format = format,
+            .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .image_subresource = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = config.layers_per_array,
+            },
+            .level_count = new_array.level_count,
+            .generated_level_count = 0,
+            .image_offset = { 0, 0, 0 },
+            .image_extent = { extent, extent, 1 },
+            .dst_alloc = VK_NULL_HANDLE,
+            .is_host_copyable = false,
+        }, config.priority);
+
+        std::memset(clear_stream.get_data().data(), 0, clear_stream.get_data().size());
+        new_array.clear_fence = streamer.commit_stream(std::move(clear_stream));
+
+        new_array.layers.assign(config.layers_per_array, no_texture);
+        new_array.free_layers.clear();
+
+        // the first layers are used first
+        for (uint32_t layer = config.layers_per_array; layer-- > 0;) new_array.free_layers.push_back(layer);
+
+        return array;
+    }
+
+    void texture_atlas::destroy_array(uint32_t array) noexcept {
+        rendering::vulkan_device& device = streamer.get_device();
+        texture_array& old_array = arrays[array];
+
+        device.get_device().destroyImageView(old_array.view);
+        vmaDestroyImage(device.get_allocator(), old_array.image, old_array.alloc);
+
+        old_array = texture_array{};
+    }
+
+    void texture_atlas::repack(uint32_t frame_index) {
+        auto is_same_class = [](const texture_array& a, const texture_array& b) { return a.format == b.format && a.extent == b.extent; };
+
+        // arrays which can take the moved layers, their clear must be finished as it would overwrite the copies
+        auto is_repack_target = [&](uint32_t array, uint32_t src_array) {
+            const texture_array& target = arrays[array];
+            return array != src_array && target.image && !target.is_retired && is_same_class(target, arrays[src_array]) && target.clear_fence.status() == vk::Result::eSuccess;
+        };
+
+        // the sparsest array below the occupancy whose textures fit into the free layers of the other arrays of its class,
+        // empty arrays are always destroyed
+
+        uint32_t src_array = no_texture;
+
+        for (uint32_t array = 0; array < arrays.size(); array++) {
+            const texture_array& candidate = arrays[array];
+
+            if (!candidate.image || candidate.is_retired || candidate.used_layer_count > config.repack_occupancy * config.layers_per_array) continue;
+            if (src_array != no_texture && arrays[src_array].used_layer_count <= candidate.used_layer_count) continue;
+
+            size_t free_layer_count = 0;
+
+            for (uint32_t target = 0; target < arrays.size(); target++) {
+                if (is_repack_target(target, array)) free_layer_count += arrays[target].free_layers.size();
+            }
+
+            if (free_layer_count < candidate.used_layer_count) continue;
+
+            // streaming layers are moved once finished
+            bool is_streaming = std::any_of(candidate.layers.begin(), candidate.layers.end(), [&](texture_id id) {
+                return id != no_texture && entries[id].state != entry_state::ready;
+            });
+
+            if (!is_streaming) src_array = array;
+        }
+
+        if (src_array == no_texture) return;
+
+        texture_array& src = arrays[src_array];
+        uint32_t target = 0;
+
+        for (uint32_t layer = 0; layer < src.layers.size(); layer++) {
+            texture_id id = src.layers[layer];
+            if (id == no_texture) continue;
+
+            while (!is_repack_target(target, src_array) || arrays[target].free_layers.empty()) target++;
+
+            texture_array& dst = arrays[target];
+            uint32_t dst_layer = dst.free_layers.back();
+
+            dst.free_layers.pop_back();
+            dst.layers[dst_layer] = id;
+            dst.used_layer_count++;
+
+            pending_moves.push_back(layer_move{
+                .src_array = src_array,
+                .src_layer = layer,
+                .dst_array = target,
+                .dst_layer = dst_layer,
+            });
+
+            // note: the copy is recorded into this frame before any draw, so the new region is used right away
+            entries[id].region.array = target;
+            entries[id].region.layer = dst_layer;
+        }
+
+        src.is_retired = true;
+        src.used_layer_count = 0;
+
+        retired_arrays[frame_index].push_back(src_array);
+    }
+}
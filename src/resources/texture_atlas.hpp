@@ -0,0 +1,178 @@
+#pragma once
+
+#include "streamer.hpp"
+#include "texture.hpp"
+#include <core/worker_pool.hpp>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace photon {
+    // packs small textures into shared 2D array images instead of giving each its own image, view and descriptor
+
+    // textures are grouped by format and size class (the power of two extent fitting them, see atlas_config), every texture takes one layer
+    // of an array of its class, the part of the layer outside of the texture repeats its edge texels so mips don't bleed
+    // note: each texture streams only its own layer (with all levels), so loads never touch the other textures of the array
+
+    // removed textures free their layer, arrays left mostly empty are repacked into the free layers of the other arrays of their class
+    // by copies on the graphics queue (see record_commands()) and destroyed, which moves their textures to a new array and layer
+
+    class texture_atlas {
+    public:
+        using texture_id = uint32_t;
+
+        static constexpr uint32_t no_texture = std::numeric_limits<uint32_t>::max();
+
+        struct atlas_config {
+            // size classes, textures are placed into layers of the smallest power of two extent (at least [min_extent]) fitting them,
+            // textures larger than [max_extent] can't be added
+            uint32_t min_extent;
+            uint32_t max_extent;
+
+            uint32_t layers_per_array;
+
+            // arrays using at most this fraction of their layers are repacked into the other arrays of their class (if those have room)
+            float repack_occupancy;
+
+            rendering::stream_priority priority;
+        };
+
+        // where a texture lives, sampled with uv * uv_rect.zw + uv_rect.xy on layer [layer] of the view of [array]
+        struct atlas_region {
+            uint32_t array; // see get_array_view()
+            uint32_t layer;
+            glm::vec4 uv_rect;
+        };
+
+        texture_atlas(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const atlas_config& config) noexcept;
+        ~texture_atlas() noexcept;
+
+        texture_atlas(const texture_atlas&) = delete;
+        texture_atlas& operator=(const texture_atlas&) = delete;
+
+        // decodes (see decode_image()) or reads (2D .ktx2 and .dds files) the texture on a thread of [pool],
+        // its layer is picked and streamed by the next update() once loaded
+        // note: decoded files are stored as rgba8 with generated mips, containers keep their format and stored mips
+        texture_id add_texture(std::string path, texture_encoding encoding = texture_encoding::srgb);
+
+        // frees the layer of the texture once the frames in flight are finished with it, the id must not be used anymore
+        void remove_texture(texture_id id) noexcept;
+
+        // streams loaded textures, publishes finished ones, frees layers removed [max_frames_in_flight] calls ago and repacks one sparse array
+        void update(uint32_t frame_index);
+
+        // true once the texture is streamed, its region is valid from then on
+        bool is_ready(texture_id id) const noexcept { return entries[id].state == entry_state::ready; }
+
+        // note: the region (and its array) changes when the array of the texture is repacked by update()
+        const atlas_region& get_region(texture_id id) const noexcept { return entries[id].region; }
+
+        // 2D array view with all levels and layers
+        vk::ImageView get_array_view(uint32_t array) const noexcept { return arrays[array].view; }
+        uint32_t get_array_count() const noexcept { return static_cast<uint32_t>(arrays.size()); }
+
+        // records the layer copies of repacked arrays, must be recorded before any draw of the frame of the last update()
+        bool has_commands() const noexcept { return !pending_moves.empty(); }
+        void record_commands(vk::CommandBuffer cmd);
+
+    private:
+        enum class entry_state {
+            loading, // being read on a loader thread
+            streaming, // streamed into its layer
+            ready,
+        };
+
+        // texel data of every level of a whole layer, prepared by the loader thread
+        struct layer_data {
+            vk::Format format;
+            uint32_t extent; // size class
+            uint32_t width, height; // of the texture, the rest of the layer repeats its edges
+
+            // streamed levels, the following ones of the layer (which has all levels of [extent]) are generated from the last one
+            uint32_t level_count;
+            uint32_t generated_level_count;
+
+            std::vector<std::byte> data; // packed as described by asset_streamer::stream()
+        };
+
+        struct load_state {
+            std::atomic<bool> is_loaded = false;
+            layer_data layer;
+        };
+
+        struct atlas_entry {
+            std::string path;
+            entry_state state;
+            bool is_removed = false; // the layer is freed once the texture isn't loading or streaming anymore
+
+            std::shared_ptr<load_state> load; // while loading
+            rendering::multi_fence_view ready_fence; // while streaming
+
+            atlas_region region;
+        };
+
+        struct texture_array {
+            vk::Image image;
+            VmaAllocation alloc = VK_NULL_HANDLE;
+            vk::ImageView view;
+
+            vk::Format format;
+            uint32_t extent;
+            uint32_t level_count;
+
+            // the array is cleared by a stream on creation, repacks only copy into it once that's finished
+            rendering::multi_fence_view clear_fence;
+
+            std::vector<texture_id> layers; // no_texture for free (or retired) layers
+            std::vector<uint32_t> free_layers;
+            uint32_t used_layer_count = 0;
+
+            bool is_retired = false; // repacked, destroyed once the frames in flight finished
+        };
+
+        // a layer copy of a repack
+        struct layer_move {
+            uint32_t src_array, src_layer;
+            uint32_t dst_array, dst_layer;
+        };
+
+        // reads the file into the levels of a layer of its size class
+        static layer_data read_layer(const std::string& path, texture_encoding encoding, const atlas_config& config);
+
+        // a free layer of an array of the class, creates a new array if all are full
+        std::pair<uint32_t, uint32_t> reserve_layer(vk::Format format, uint32_t extent);
+
+        // frees the layer of a removed texture after the frames in flight
+        void retire_layer(const atlas_region& region, uint32_t frame_index) noexcept;
+
+        uint32_t create_array(vk::Format format, uint32_t extent);
+        void destroy_array(uint32_t array) noexcept;
+
+        // moves the textures of the sparsest array of a class into the other arrays of the class if it's below [repack_occupancy]
+        void repack(uint32_t frame_index);
+
+        rendering::asset_streamer& streamer;
+        worker_pool& pool;
+        atlas_config config;
+
+        std::vector<atlas_entry> entries;
+        std::vector<texture_id> loading_entries;
+        std::vector<texture_id> streaming_entries;
+        std::vector<texture_id> removed_entries; // removed since the last update()
+
+        std::vector<texture_array> arrays; // destroyed arrays keep their slot (with a null image) until reused
+
+        // removed layers and repacked arrays, indexed by frame_index
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> retired_layers;
+        std::vector<std::vector<uint32_t>> retired_arrays;
+
+        std::vector<layer_move> pending_moves;
+
+        uint32_t max_frames_in_flight;
+    };
+}
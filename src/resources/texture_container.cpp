@@ -0,0 +1,216 @@
+#include "texture_container.hpp"
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace photon {
+    template<typename value_t>
+    inline static bool read_value(std::istream& file, value_t& value) noexcept {
+        file.read(reinterpret_cast<char*>(&value), sizeof(value_t));
+        return file.gcount() == sizeof(value_t);
+    }
+
+    // the length of a full mip chain, more levels would be invalid image create info
+    inline static uint32_t get_max_level_count(const texture_container& container) noexcept {
+        return static_cast<uint32_t>(std::bit_width(std::max({ container.width, container.height, container.depth })));
+    }
+
+    static std::optional<texture_container> read_ktx2(std::istream& file) noexcept {
+        ktx2::header header;
+        if (!read_value(file, header) || std::memcmp(header.identifier, ktx2::identifier, sizeof(ktx2::identifier)) != 0) {
+            P_LOG_E("Invalid KTX2 header!");
+            return std::nullopt;
+        }
+
+        if (header.supercompression_scheme != 0 || header.vk_format == VK_FORMAT_UNDEFINED) {
+            // note: basis universal and zstd/zlib supercompressed files would have to be transcoded first
+            P_LOG_E("Supercompressed KTX2 files are not supported! (scheme: {} format: {})", header.supercompression_scheme, header.vk_format);
+            return std::nullopt;
+        }
+
+        if (header.pixel_width == 0 || (header.pixel_depth != 0 && header.pixel_height == 0) || (header.face_count != 1 && header.face_count != 6)) {
+            P_LOG_E("Invalid KTX2 image dimensions! ({}x{}x{} faces: {})", header.pixel_width, header.pixel_height, header.pixel_depth, header.face_count);
+            return std::nullopt;
+        }
+
+        texture_container container{
+            .format = static_cast<VkFormat>(header.vk_format),
+            .dimension_count = header.pixel_depth ? 3U : header.pixel_height ? 2U : 1U,
+            .width = header.pixel_width,
+            .height = std::max(1U, header.pixel_height),
+            .depth = std::max(1U, header.pixel_depth),
+            .layer_count = std::max(1U, header.layer_count),
+            .face_count = header.face_count,
+            .level_count = std::max(1U, header.level_count),
+            .generate_levels = header.level_count == 0,
+            .is_layer_major = false,
+            .data_offset = 0,
+        };
+
+        if (container.dimension_count == 3 && container.layer_count > 1) {
+            P_LOG_E("KTX2 3D array images are not supported!");
+            return std::nullopt;
+        }
+
+        if (container.level_count > get_max_level_count(container)) {
+            P_LOG_E("Invalid KTX2 level count! ({} for {}x{}x{})", container.level_count, container.width, container.height, container.depth);
+            return std::nullopt;
+        }
+
+        container.levels.reserve(container.level_count);
+
+        for (uint32_t level = 0; level < container.level_count; level++) {
+            ktx2::level_index index;
+            if (!read_value(file, index)) {
+                P_LOG_E("Truncated KTX2 level index!");
+                return std::nullopt;
+            }
+
+            container.levels.push_back({ .offset = index.byte_offset, .size = index.byte_length });
+        }
+
+        return container;
+    }
+
+    static VkFormat get_dxgi_format(uint32_t dxgi_format) noexcept {
+        switch (dxgi_format) {
+            case 2: return VK_FORMAT_R32G32B32A32_SFLOAT;
+            case 10: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case 24: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+            case 26: return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+            case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+            case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+            case 34: return VK_FORMAT_R16G16_SFLOAT;
+            case 49: return VK_FORMAT_R8G8_UNORM;
+            case 54: return VK_FORMAT_R16_SFLOAT;
+            case 61: return VK_FORMAT_R8_UNORM;
+            case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+            case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+            case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+            case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+            case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+            case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+            case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+            case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+            case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+            case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    static VkFormat get_legacy_dds_format(const dds::pixel_format& format) noexcept {
+        constexpr uint32_t fourcc_flag = 0x4, rgb_flag = 0x40;
+
+        if (format.flags & fourcc_flag) {
+            switch (format.fourcc) {
+                case dds::make_fourcc('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                case dds::make_fourcc('D', 'X', 'T', '2'):
+                case dds::make_fourcc('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+                case dds::make_fourcc('D', 'X', 'T', '4'):
+                case dds::make_fourcc('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+                case dds::make_fourcc('A', 'T', 'I', '1'):
+                case dds::make_fourcc('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+                case dds::make_fourcc('B', 'C', '4', 'S'): return VK_FORMAT_BC4_SNORM_BLOCK;
+                case dds::make_fourcc('A', 'T', 'I', '2'):
+                case dds::make_fourcc('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+                case dds::make_fourcc('B', 'C', '5', 'S'): return VK_FORMAT_BC5_SNORM_BLOCK;
+                default: return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+        if ((format.flags & rgb_flag) && format.rgb_bit_count == 32) {
+            if (format.r_mask == 0x000000FF && format.g_mask == 0x0000FF00 && format.b_mask == 0x00FF0000) return VK_FORMAT_R8G8B8A8_UNORM;
+            if (format.r_mask == 0x00FF0000 && format.g_mask == 0x0000FF00 && format.b_mask == 0x000000FF) return VK_FORMAT_B8G8R8A8_UNORM;
+        }
+
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    static std::optional<texture_container> read_dds(std::istream& file) noexcept {
+        constexpr uint32_t mip_map_count_flag = 0x20000;
+        constexpr uint32_t cubemap_caps = 0x200, volume_caps = 0x200000;
+        constexpr uint32_t dx10_cubemap_flag = 0x4;
+
+        uint32_t magic;
+        dds::header header;
+
+        if (!read_value(file, magic) || magic != dds::magic || !read_value(file, header) || header.size != sizeof(dds::header)) {
+            P_LOG_E("Invalid DDS header!");
+            return std::nullopt;
+        }
+
+        texture_container container{
+            .format = VK_FORMAT_UNDEFINED,
+            .dimension_count = (header.caps2 & volume_caps) ? 3U : 2U,
+            .width = std::max(1U, header.width),
+            .height = std::max(1U, header.height),
+            .depth = (header.caps2 & volume_caps) ? std::max(1U, header.depth) : 1U,
+            .layer_count = 1,
+            .face_count = (header.caps2 & cubemap_caps) ? 6U : 1U, // note: partial cubemaps aren't supported
+            .level_count = (header.flags & mip_map_count_flag) ? std::max(1U, header.mip_map_count) : 1U,
+            .generate_levels = false,
+            .is_layer_major = true,
+            .data_offset = sizeof(magic) + sizeof(dds::header),
+        };
+
+        if (header.format.fourcc == dds::make_fourcc('D', 'X', '1', '0')) {
+            dds::header_dx10 header_dx10;
+            if (!read_value(file, header_dx10)) {
+                P_LOG_E("Truncated DDS DX10 header!");
+                return std::nullopt;
+            }
+
+            container.format = get_dxgi_format(header_dx10.dxgi_format);
+            container.dimension_count = header_dx10.resource_dimension == 4 ? 3U : header_dx10.resource_dimension == 2 ? 1U : 2U;
+            container.height = container.dimension_count == 1 ? 1U : container.height;
+            container.depth = container.dimension_count == 3 ? container.depth : 1U;
+            container.layer_count = std::max(1U, header_dx10.array_size);
+            container.face_count = (header_dx10.misc_flag & dx10_cubemap_flag) ? 6U : 1U;
+            container.data_offset += sizeof(dds::header_dx10);
+        } else {
+            container.format = get_legacy_dds_format(header.format);
+        }
+
+        if (container.format == VK_FORMAT_UNDEFINED) {
+            P_LOG_E("Unsupported DDS pixel format! (fourcc: {:#x})", header.format.fourcc);
+            return std::nullopt;
+        }
+
+        if (container.dimension_count == 3 && container.layer_count > 1) {
+            P_LOG_E("DDS 3D array images are not supported!");
+            return std::nullopt;
+        }
+
+        if (container.level_count > get_max_level_count(container)) {
+            P_LOG_E("Invalid DDS mip map count! ({} for {}x{}x{})", container.level_count, container.width, container.height, container.depth);
+            return std::nullopt;
+        }
+
+        return container;
+    }
+
+    std::optional<texture_container> read_texture_container(std::istream& file) noexcept {
+        uint8_t identifier[sizeof(ktx2::identifier)];
+
+        std::istream::pos_type begin = file.tellg();
+        file.read(reinterpret_cast<char*>(identifier), sizeof(identifier));
+        size_t identifier_size = file.gcount();
+
+        file.clear();
+        file.seekg(begin);
+
+        if (identifier_size == sizeof(identifier) && std::memcmp(identifier, ktx2::identifier, sizeof(identifier)) == 0) return read_ktx2(file);
+        if (identifier_size >= sizeof(dds::magic) && std::memcmp(identifier, &dds::magic, sizeof(dds::magic)) == 0) return read_dds(file);
+
+        P_LOG_E("Unknown texture container!");
+        return std::nullopt;
+    }
+}
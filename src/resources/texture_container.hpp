@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <vector>
+
+namespace photon {
+    // gpu-ready texture containers (KTX2 and DDS), the texel data is stored in its final (block compressed) format
+    // and only needs to be copied into the image, see texture::load_container()
+
+    // note: all fields are little endian, as is every platform we run on
+
+    namespace ktx2 {
+        constexpr uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+        struct header {
+            uint8_t identifier[12];
+            uint32_t vk_format; // VK_FORMAT_UNDEFINED for basis universal
+            uint32_t type_size;
+            uint32_t pixel_width;
+            uint32_t pixel_height; // 0 for 1D images
+            uint32_t pixel_depth; // 0 for 1D and 2D images
+            uint32_t layer_count; // 0 for non array images
+            uint32_t face_count; // 6 for cubemaps
+            uint32_t level_count; // 0 requests the mips to be generated at load time
+            uint32_t supercompression_scheme;
+
+            // index
+            uint32_t dfd_byte_offset;
+            uint32_t dfd_byte_length;
+            uint32_t kvd_byte_offset;
+            uint32_t kvd_byte_length;
+            uint64_t sgd_byte_offset;
+            uint64_t sgd_byte_length;
+        };
+
+        // follows the header, one entry per level (index 0 is the largest level, which is stored last in the file)
+        struct level_index {
+            uint64_t byte_offset;
+            uint64_t byte_length;
+            uint64_t uncompressed_byte_length;
+        };
+
+        static_assert(sizeof(header) == 80 && sizeof(level_index) == 24);
+    }
+
+    namespace dds {
+        constexpr uint32_t magic = 0x20534444; // "DDS "
+
+        constexpr uint32_t make_fourcc(char a, char b, char c, char d) noexcept {
+            return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+        }
+
+        struct pixel_format {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t fourcc;
+            uint32_t rgb_bit_count;
+            uint32_t r_mask, g_mask, b_mask, a_mask;
+        };
+
+        // follows the magic
+        struct header {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t height;
+            uint32_t width;
+            uint32_t pitch_or_linear_size;
+            uint32_t depth;
+            uint32_t mip_map_count;
+            uint32_t reserved1[11];
+            pixel_format format;
+            uint32_t caps, caps2, caps3, caps4;
+            uint32_t reserved2;
+        };
+
+        // follows the header if the pixel format's fourcc is "DX10"
+        struct header_dx10 {
+            uint32_t dxgi_format;
+            uint32_t resource_dimension; // 2: 1D, 3: 2D, 4: 3D
+            uint32_t misc_flag;
+            uint32_t array_size;
+            uint32_t misc_flags2;
+        };
+
+        static_assert(sizeof(header) == 124 && sizeof(header_dx10) == 20);
+    }
+
+    struct texture_container {
+        struct level_range {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        VkFormat format;
+        uint32_t dimension_count; // 1, 2 or 3
+        uint32_t width, height, depth; // unused dimensions are 1
+
+        uint32_t layer_count;
+        uint32_t face_count; // 6 for cubemaps, faces are stored as consecutive layers
+
+        uint32_t level_count;
+        bool generate_levels; // the file stores only the first level, the rest should be generated (ktx2 level_count of 0)
+
+        // ktx2 stores each level with all its layers (level major), the byte range of each level is in [levels]
+        // dds stores each layer with all its levels (layer major), starting at [data_offset]
+        bool is_layer_major;
+        uint64_t data_offset;
+        std::vector<level_range> levels;
+    };
+
+    // parses the header of a ktx2 or dds file (chosen by the magic), leaves [file] at an unspecified position
+    // returns nullopt (and logs the reason) for invalid or unsupported files, e.g. supercompressed ktx2 or unknown formats
+    std::optional<texture_container> read_texture_container(std::istream& file) noexcept;
+}
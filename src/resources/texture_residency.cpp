@@ -0,0 +1,157 @@
+#include "texture_residency.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace photon {
+    texture_residency::texture_residency(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const residency_config& config) noexcept :
+        streamer{streamer},
+        pool{pool},
+        config{config}
+    {
+        retired_textures.resize(max_frames_in_flight);
+    }
+
+    texture_residency::texture_id texture_residency::add_texture(std::string path) {
+        std::ifstream file(path, std::ios::binary);
+        std::optional<texture_container> container;
+        if (file) container = read_texture_container(file);
+
+        // the levels are streamed separately, so they must be stored (and stored per level)
+        if (!container || container->is_layer_major || container->generate_levels) {
+            P_LOG_E("Residency streaming needs a ktx2 texture with pre-baked mips: {}", path);
+            engine_abort();
+        }
+
+        texture_id id = static_cast<texture_id>(textures.size());
+
+        managed_texture& tex = textures.emplace_back(managed_texture{
+            .path = std::move(path),
+            .container = std::move(container.value()),
+        });
+
+        uint32_t level_count = tex.container.level_count;
+
+        tex.level_sizes.resize(level_count + 1, 0);
+
+        for (uint32_t level = level_count; level-- > 0;) {
+            tex.level_sizes[level] = tex.level_sizes[level + 1] + tex.container.levels[level].size;
+        }
+
+        tex.base_level = 0;
+
+        while (tex.base_level + 1 < level_count && std::max({ tex.container.width, tex.container.height, tex.container.depth }) >> tex.base_level > config.min_resident_size) {
+            tex.base_level++;
+        }
+
+        tex.resident_level = tex.base_level;
+        tex.demanded_level = tex.base_level;
+
+        start_load(tex, tex.base_level);
+
+        return id;
+    }
+
+    void texture_residency::request_level(texture_id id, uint32_t level) noexcept {
+        textures[id].requested_level = std::min(textures[id].requested_level, level);
+    }
+
+    void texture_residency::update(uint32_t frame_index) {
+        frame_counter++;
+
+        // the images retired in this frame slot aren't used by the gpu anymore
+        retired_textures[frame_index].clear();
+
+        VkDeviceSize base_size = 0;
+
+        for (managed_texture& tex : textures) {
+            // swap in finished images, the replaced one is kept until the frames using it finished
+
+            if (tex.pending.is_valid() && tex.pending.get_state() == texture_load_state::ready) {
+                if (tex.resident.is_valid()) {
+                    resident_size -= tex.level_sizes[tex.resident_level];
+                    retired_textures[frame_index].push_back(std::move(tex.resident));
+                }
+
+                resident_size += tex.level_sizes[tex.pending_level];
+
+                tex.resident = std::move(tex.pending);
+                tex.resident_level = tex.pending_level;
+                tex.pending = texture_handle();
+
+                pending_load_count--;
+            }
+
+            // finer requests are taken at once, coarser ones (or no request) only after the eviction delay
+
+            uint32_t requested_level = std::min(tex.requested_level, tex.base_level);
+            tex.requested_level = no_demand;
+
+            if (requested_level <= tex.demanded_level || frame_counter - tex.demand_frame > config.eviction_delay_frames) {
+                tex.demanded_level = requested_level;
+                tex.demand_frame = frame_counter;
+            }
+
+            base_size += tex.level_sizes[tex.base_level];
+        }
+
+        // the budget goes to the most recently demanded textures first, then to the ones demanding finer levels
+
+        budget_order.resize(textures.size());
+        for (texture_id id = 0; id < budget_order.size(); id++) budget_order[id] = id;
+
+        std::sort(budget_order.begin(), budget_order.end(), [&](texture_id a, texture_id b) {
+            if (textures[a].demand_frame != textures[b].demand_frame) return textures[a].demand_frame > textures[b].demand_frame;
+            return textures[a].demanded_level < textures[b].demanded_level;
+        });
+
+        // note: an image and its replacement are both allocated while the replacement streams, which the budget doesn't account for
+        VkDeviceSize remaining_budget = config.memory_budget > base_size ? config.memory_budget - base_size : 0;
+
+        for (texture_id id : budget_order) {
+            managed_texture& tex = textures[id];
+
+            uint32_t level = tex.demanded_level;
+            while (level < tex.base_level && tex.level_sizes[level] - tex.level_sizes[tex.base_level] > remaining_budget) level++;
+
+            remaining_budget -= tex.level_sizes[level] - tex.level_sizes[tex.base_level];
+
+            // residency changes wait for the always resident levels and the previous change
+            if (level == tex.resident_level || !tex.resident.is_valid() || tex.pending.is_valid() || pending_load_count >= config.max_pending_loads) continue;
+
+            start_load(tex, level);
+        }
+    }
+
+    texture* texture_residency::get_texture(texture_id id) noexcept {
+        managed_texture& tex = textures[id];
+        return tex.resident.is_valid() ? &tex.resident.get() : nullptr;
+    }
+
+    void texture_residency::start_load(managed_texture& tex, uint32_t level) {
+        if (config.reader) {
+            tex.pending = texture::load_container_async(*config.reader, pool, streamer, tex.path, level, config.priority);
+        } else {
+            tex.pending = texture::load_container_async(pool, streamer, tex.path, level, config.priority);
+        }
+
+        tex.pending_level = level;
+
+        pending_load_count++;
+    }
+
+    uint32_t estimate_texture_level(uint32_t texture_size, float world_size, float distance, float fov_y, uint32_t viewport_height) noexcept {
+        if (distance <= 0.f) return 0;
+
+        // projected size of the surface in pixels
+        float pixel_size = world_size / (2.f * distance * std::tan(fov_y * .5f)) * static_cast<float>(viewport_height);
+        float texels_per_pixel = static_cast<float>(texture_size) / pixel_size;
+
+        if (!(texels_per_pixel > 1.f)) return 0;
+
+        return static_cast<uint32_t>(std::min(std::floor(std::log2(texels_per_pixel)), 31.f));
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "texture.hpp"
+#include "texture_container.hpp"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace photon {
+    // mip level residency of cooked (ktx2) textures, driven by the on-screen demand
+
+    // every texture starts with only its small levels resident, finer levels are streamed in once a level is requested
+    // (see request_level()) and evicted again when they are no longer requested or the memory budget is exceeded
+
+    // note: the image of a texture only holds the resident levels (see texture::load_container() [first_level]), so sampling
+    // is clamped to them and evicted levels free their memory, changing the residency streams a new image which replaces the old one once ready
+
+    class texture_residency {
+    public:
+        using texture_id = uint32_t;
+
+        static constexpr uint32_t no_demand = std::numeric_limits<uint32_t>::max();
+
+        struct residency_config {
+            // size of the levels of all textures, levels of the least demanded textures are evicted above it
+            // note: the always resident levels are not limited by the budget
+            VkDeviceSize memory_budget;
+
+            // levels up to this size (largest dimension in texels) are always resident
+            uint32_t min_resident_size;
+
+            // a texture keeps its finer levels for this many frames after they were last requested
+            uint32_t eviction_delay_frames;
+
+            // residency changes streaming at once, the others wait for a later update()
+            uint32_t max_pending_loads;
+
+            rendering::stream_priority priority;
+
+            // reads the levels without blocking the loader threads if set (see texture::load_container_async()), must outlive the residency
+            async_reader* reader;
+        };
+
+        texture_residency(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const residency_config& config) noexcept;
+        ~texture_residency() noexcept = default;
+
+        texture_residency(const texture_residency&) = delete;
+        texture_residency& operator=(const texture_residency&) = delete;
+
+        // reads the header of a ktx2 file with pre-baked mips and starts streaming its always resident levels
+        texture_id add_texture(std::string path);
+
+        // the finest level (0 being the full size) needed by the texture this frame, the finest request of a frame is used
+        // note: filled from cpu estimates (see estimate_texture_level()) or gpu feedback
+        void request_level(texture_id id, uint32_t level) noexcept;
+
+        // applies this frame's requests: swaps in finished images, picks the levels which fit the budget and streams the changes,
+        // images replaced [max_frames_in_flight] calls ago are destroyed
+        void update(uint32_t frame_index);
+
+        // the texture holding the resident levels, nullptr until the always resident levels are ready
+        // note: the texture (and its image view) can change with every update()
+        texture* get_texture(texture_id id) noexcept;
+
+        // the finest resident level, relative to the full size texture
+        uint32_t get_resident_level(texture_id id) const noexcept { return textures[id].resident_level; }
+
+        VkDeviceSize get_resident_size() const noexcept { return resident_size; }
+
+    private:
+        struct managed_texture {
+            std::string path;
+            texture_container container;
+
+            std::vector<VkDeviceSize> level_sizes; // size of the levels from each level to the smallest one
+            uint32_t base_level; // coarsest level that is still resident, the finer ones are streamed on demand
+
+            texture_handle resident;
+            uint32_t resident_level;
+
+            texture_handle pending; // replaces [resident] once ready
+            uint32_t pending_level;
+
+            uint32_t requested_level = no_demand; // this frame
+            uint32_t demanded_level; // finest level requested in the last [eviction_delay_frames]
+            uint64_t demand_frame = 0;
+        };
+
+        void start_load(managed_texture& tex, uint32_t level);
+
+        rendering::asset_streamer& streamer;
+        worker_pool& pool;
+        residency_config config;
+
+        std::vector<managed_texture> textures;
+        std::vector<texture_id> budget_order; // reused by update()
+
+        // replaced images, indexed by frame_index
+        std::vector<std::vector<texture_handle>> retired_textures;
+
+        VkDeviceSize resident_size = 0;
+        uint32_t pending_load_count = 0;
+        uint64_t frame_counter = 0;
+    };
+
+    // the level sampled on a surface which maps [texture_size] texels across [world_size] units, seen at [distance] by a camera
+    // with a vertical [fov_y] (radians) on a viewport [viewport_height] pixels high
+    uint32_t estimate_texture_level(uint32_t texture_size, float world_size, float distance, float fov_y, uint32_t viewport_height) noexcept;
+}
@@ -0,0 +1,447 @@
+#include "texture_transcoder.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+
+namespace photon::rendering {
+    static const uint32_t bc_transcode_spv[] = {
+#include <shaders/bc_transcode.comp.spv.inc>
+    };
+
+    // matches the push constants of bc_transcode.comp
+    struct transcode_params {
+        int32_t level;
+        uint32_t blocks_x;
+        uint32_t blocks_y;
+        uint32_t block_offset; // in uints
+    };
+
+    texture_transcoder::texture_transcoder(vulkan_device& device, uint32_t max_frames_in_flight) :
+        device{device},
+        retired_transcodes(max_frames_in_flight)
+    {
+        vk::Device dev = device.get_device();
+
+        sampler = dev.createSampler(vk::SamplerCreateInfo{
+            .magFilter = vk::Filter::eNearest,
+            .minFilter = vk::Filter::eNearest,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+            .maxLod = vk::LodClampNone,
+        });
+
+        vk::DescriptorSetLayoutBinding bindings[] = {
+            {
+                .binding = 0,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                .pImmutableSamplers = &sampler,
+            },
+            {
+                .binding = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            },
+        };
+
+        set_layout = dev.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+            .bindingCount = 2,
+            .pBindings = bindings,
+        });
+
+        vk::PushConstantRange push_range{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset = 0,
+            .size = sizeof(transcode_params),
+        };
+
+        pipeline_layout = dev.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts = &set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_range,
+        });
+
+        vk::ShaderModule shader = dev.createShaderModule(vk::ShaderModuleCreateInfo{
+            .codeSize = sizeof(bc_transcode_spv),
+            .pCode = bc_transcode_spv,
+        });
+
+        // one pipeline per block format (specialization constant 0)
+
+        auto create_pipeline = [&](uint32_t block_format) {
+            vk::SpecializationMapEntry spec_entry{ .constantID = 0, .offset = 0, .size = sizeof(uint32_t) };
+
+            vk::SpecializationInfo spec_info{
+                .mapEntryCount = 1,
+                .pMapEntries = &spec_entry,
+                .dataSize = sizeof(uint32_t),
+                .pData = &block_format,
+            };
+
+            vk::ComputePipelineCreateInfo pipeline_info{
+                .stage{
+                    .stage = vk::ShaderStageFlagBits::eCompute,
+                    .module = shader,
+                    .pName = "main",
+                    .pSpecializationInfo = &spec_info,
+                },
+                .layout = pipeline_layout,
+            };
+
+            return dev.createComputePipeline(nullptr, pipeline_info).value;
+        };
+
+        bc1_pipeline = create_pipeline(0);
+        bc7_pipeline = create_pipeline(1);
+
+        dev.destroyShaderModule(shader);
+
+        vk::DescriptorPoolSize pool_sizes[] = {
+            { .type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = max_transcodes_per_frame * max_frames_in_flight },
+            { .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = max_transcodes_per_frame * max_frames_in_flight },
+        };
+
+        descriptor_pool = dev.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+            .maxSets = max_transcodes_per_frame * max_frames_in_flight,
+            .poolSizeCount = 2,
+            .pPoolSizes = pool_sizes,
+        });
+    }
+
+    texture_transcoder::~texture_transcoder() noexcept {
+        for (auto& transcode : queued_transcodes) {
+            destroy_transcode(*transcode);
+        }
+
+        for (auto& frame_transcodes : retired_transcodes) {
+            for (auto& transcode : frame_transcodes) {
+                destroy_transcode(*transcode);
+            }
+        }
+
+        vk::Device dev = device.get_device();
+
+        dev.destroyDescriptorPool(descriptor_pool);
+        dev.destroyPipeline(bc1_pipeline);
+        dev.destroyPipeline(bc7_pipeline);
+        dev.destroyPipelineLayout(pipeline_layout);
+        dev.destroyDescriptorSetLayout(set_layout);
+        dev.destroySampler(sampler);
+    }
+
+    bool texture_transcoder::is_supported(vk::Format data_format, vk::Format format) noexcept {
+        if (data_format != vk::Format::eR8G8B8A8Srgb && data_format != vk::Format::eR8G8B8A8Unorm) return false;
+
+        switch (format) {
+            case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbUnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+            case vk::Format::eBc7UnormBlock:
+                break;
+
+            default:
+                return false;
+        }
+
+        if (is_srgb(data_format) != is_srgb(format)) return false;
+
+        constexpr vk::FormatFeatureFlags required_features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eTransferDst;
+        vk::FormatFeatureFlags format_features = device.get_physical_device().getFormatProperties(format).optimalTilingFeatures;
+
+        return (format_features & required_features) == required_features;
+    }
+
+    std::shared_ptr<texture_transcoder::transcode> texture_transcoder::create_transcode(const transcode_info& info) {
+        auto result = std::make_shared<transcode>();
+        result->info = info;
+
+        // the scratch image is sampled through a unorm view, so srgb data is encoded as stored
+        vk::ImageCreateInfo image_info{
+            .flags = vk::ImageCreateFlagBits::eMutableFormat,
+            .imageType = vk::ImageType::e2D,
+            .format = info.data_format,
+            .extent = { info.extent.width, info.extent.height, 1 },
+            .mipLevels = info.level_count,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        vk::BufferCreateInfo buffer_info{
+            .size = get_level_offset(info, info.level_count),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkImage img;
+        VkResult res = vmaCreateImage(device.get_allocator(), &static_cast<const VkImageCreateInfo&>(image_info), &alloc_info, &img, &result->scratch_alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateImage");
+
+        result->scratch_image = img;
+
+        VkBuffer buf;
+        res = vmaCreateBuffer(device.get_allocator(), &static_cast<const VkBufferCreateInfo&>(buffer_info), &alloc_info, &buf, &result->block_alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        result->block_buffer = buf;
+
+        result->scratch_view = device.get_device().createImageView(vk::ImageViewCreateInfo{
+            .image = result->scratch_image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .subresourceRange{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = info.level_count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        });
+
+        return result;
+    }
+
+    multi_fence_view texture_transcoder::queue_transcode(std::shared_ptr<transcode> transcode, multi_fence_view scratch_ready) {
+        transcode->scratch_ready = scratch_ready;
+        multi_fence_view ready_fence = transcode->ready_promise.view();
+
+        std::lock_guard<std::mutex> l(queued_transcodes_lock);
+        queued_transcodes.emplace_back(std::move(transcode));
+
+        return ready_fence;
+    }
+
+    bool texture_transcoder::has_work() noexcept {
+        {
+            std::lock_guard<std::mutex> l(queued_transcodes_lock);
+            if (!queued_transcodes.empty()) return true;
+        }
+
+        // retired scratch resources are freed by record()
+        return std::any_of(retired_transcodes.begin(), retired_transcodes.end(), [](const auto& frame_transcodes) { return !frame_transcodes.empty(); });
+    }
+
+    void texture_transcoder::record(vk::CommandBuffer cmd, uint32_t frame_index, const multi_fence& finished_fence) {
+        for (auto& transcode : retired_transcodes[frame_index]) {
+            destroy_transcode(*transcode);
+        }
+
+        retired_transcodes[frame_index].clear();
+
+        // the scratch image is ready once its stream is finished (incl. the acquire and mip generation recorded before this)
+
+        std::vector<std::shared_ptr<transcode>> transcodes;
+
+        {
+            std::lock_guard<std::mutex> l(queued_transcodes_lock);
+
+            for (auto iter = queued_transcodes.begin(); iter != queued_transcodes.end() && transcodes.size() < max_transcodes_per_frame;) {
+                if ((*iter)->scratch_ready.status() != vk::Result::eSuccess) {
+                    iter++;
+                    continue;
+                }
+
+                transcodes.emplace_back(std::move(*iter));
+                iter = queued_transcodes.erase(iter);
+            }
+        }
+
+        if (transcodes.empty()) return;
+
+        vk::Device dev = device.get_device();
+
+        std::vector<vk::DescriptorSetLayout> set_layouts(transcodes.size(), set_layout);
+        std::vector<vk::DescriptorSet> sets = dev.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data(),
+        });
+
+        std::vector<vk::DescriptorImageInfo> image_infos;
+        std::vector<vk::DescriptorBufferInfo> buffer_infos;
+        std::vector<vk::WriteDescriptorSet> writes;
+
+        image_infos.reserve(transcodes.size());
+        buffer_infos.reserve(transcodes.size());
+
+        std::vector<vk::ImageMemoryBarrier2> pre_barriers;
+        std::vector<vk::BufferMemoryBarrier2> block_barriers;
+        std::vector<vk::ImageMemoryBarrier2> post_barriers;
+
+        for (size_t i = 0; i < transcodes.size(); i++) {
+            transcode& t = *transcodes[i];
+            t.descriptor_set = sets[i];
+
+            image_infos.push_back({ .imageView = t.scratch_view, .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal });
+            buffer_infos.push_back({ .buffer = t.block_buffer, .offset = 0, .range = vk::WholeSize });
+
+            writes.push_back({ .dstSet = t.descriptor_set, .dstBinding = 0, .descriptorCount = 1, .descriptorType = vk::DescriptorType::eCombinedImageSampler, .pImageInfo = &image_infos.back() });
+            writes.push_back({ .dstSet = t.descriptor_set, .dstBinding = 1, .descriptorCount = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .pBufferInfo = &buffer_infos.back() });
+
+            vk::ImageSubresourceRange dst_range{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = t.info.base_level,
+                .levelCount = t.info.level_count,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            };
+
+            // note: the scratch image may have been written by blits or copies recorded before, its layout stays the same
+            pre_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                .srcAccessMask = vk::AccessFlagBits2::eMemoryWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
+                .oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .image = t.scratch_image,
+                .subresourceRange{
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = t.info.level_count,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            });
+
+            pre_barriers.push_back({
+                .srcStageMask = {},
+                .srcAccessMask = {},
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .image = t.info.image,
+                .subresourceRange = dst_range,
+            });
+
+            block_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+                .buffer = t.block_buffer,
+                .offset = 0,
+                .size = vk::WholeSize,
+            });
+
+            post_barriers.push_back({
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = t.info.normal_layout,
+                .image = t.info.image,
+                .subresourceRange = dst_range,
+            });
+        }
+
+        dev.updateDescriptorSets(writes, {});
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(pre_barriers.size()),
+            .pImageMemoryBarriers = pre_barriers.data(),
+        });
+
+        // one dispatch per level, one invocation per block
+
+        for (const auto& t : transcodes) {
+            bool is_bc7 = t->info.format == vk::Format::eBc7SrgbBlock || t->info.format == vk::Format::eBc7UnormBlock;
+
+            cmd.bindPipeline(vk::PipelineBindPoint::eCompute, is_bc7 ? bc7_pipeline : bc1_pipeline);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, t->descriptor_set, {});
+
+            for (uint32_t level = 0; level < t->info.level_count; level++) {
+                transcode_params params{
+                    .level = static_cast<int32_t>(level),
+                    .blocks_x = (std::max(1U, t->info.extent.width >> level) + 3) / 4,
+                    .blocks_y = (std::max(1U, t->info.extent.height >> level) + 3) / 4,
+                    .block_offset = static_cast<uint32_t>(get_level_offset(t->info, level) / sizeof(uint32_t)),
+                };
+
+                cmd.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+                cmd.dispatch((params.blocks_x + 7) / 8, (params.blocks_y + 7) / 8, 1);
+            }
+        }
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(block_barriers.size()),
+            .pBufferMemoryBarriers = block_barriers.data(),
+        });
+
+        for (const auto& t : transcodes) {
+            std::vector<vk::BufferImageCopy> regions;
+            regions.reserve(t->info.level_count);
+
+            for (uint32_t level = 0; level < t->info.level_count; level++) {
+                regions.push_back({
+                    .bufferOffset = get_level_offset(t->info, level),
+                    .bufferRowLength = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource{
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = t->info.base_level + level,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                    },
+                    .imageOffset = { 0, 0, 0 },
+                    .imageExtent = { std::max(1U, t->info.extent.width >> level), std::max(1U, t->info.extent.height >> level), 1 },
+                });
+            }
+
+            cmd.copyBufferToImage(t->block_buffer, t->info.image, vk::ImageLayout::eTransferDstOptimal, regions);
+        }
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(post_barriers.size()),
+            .pImageMemoryBarriers = post_barriers.data(),
+        });
+
+        // note: graphics work recorded after this point is ordered after the transcode
+        for (auto& t : transcodes) {
+            t->ready_promise.bind(finished_fence);
+            retired_transcodes[frame_index].emplace_back(std::move(t));
+        }
+    }
+
+    bool texture_transcoder::is_srgb(vk::Format format) noexcept {
+        return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc7SrgbBlock;
+    }
+
+    VkDeviceSize texture_transcoder::get_level_offset(const transcode_info& info, uint32_t level) noexcept {
+        VkDeviceSize block_size = vk::blockSize(info.format);
+        VkDeviceSize offset = 0;
+
+        for (uint32_t i = 0; i < level; i++) {
+            VkDeviceSize blocks_x = (std::max(1U, info.extent.width >> i) + 3) / 4;
+            VkDeviceSize blocks_y = (std::max(1U, info.extent.height >> i) + 3) / 4;
+
+            offset += blocks_x * blocks_y * block_size;
+        }
+
+        return offset;
+    }
+
+    void texture_transcoder::destroy_transcode(const transcode& transcode) noexcept {
+        if (transcode.descriptor_set) device.get_device().freeDescriptorSets(descriptor_pool, transcode.descriptor_set);
+
+        device.get_device().destroyImageView(transcode.scratch_view);
+        vmaDestroyImage(device.get_allocator(), transcode.scratch_image, transcode.scratch_alloc);
+        vmaDestroyBuffer(device.get_allocator(), transcode.block_buffer, transcode.block_alloc);
+    }
+}
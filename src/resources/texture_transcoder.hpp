@@ -0,0 +1,86 @@
+#pragma once
+
+#include <rendering/vk_device.hpp>
+#include <rendering/multi_fence.hpp>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace photon::rendering {
+    // compresses rgba8 image streams into bc1 or bc7 images with a compute shader on the graphics queue (used by asset_streamer)
+
+    // the data is streamed into an rgba8 scratch image (incl. its generated mips), which is encoded level by level
+    // into a scratch buffer of blocks and copied into the destination image, the scratch resources are freed afterwards
+
+    class texture_transcoder {
+    public:
+        struct transcode_info {
+            vk::Image image;
+            vk::Format format; // block compressed format of [image]
+            vk::Format data_format; // rgba8 format of the streamed data
+            vk::ImageLayout normal_layout;
+
+            uint32_t base_level;
+            uint32_t level_count; // including the levels generated on the scratch image
+            vk::Extent2D extent; // extent of [base_level]
+        };
+
+        struct transcode {
+            transcode_info info;
+
+            vk::Image scratch_image;
+            vk::ImageView scratch_view;
+            VmaAllocation scratch_alloc;
+
+            vk::Buffer block_buffer;
+            VmaAllocation block_alloc;
+
+            vk::DescriptorSet descriptor_set;
+
+            multi_fence_view scratch_ready;
+            multi_fence_promise ready_promise;
+        };
+
+        texture_transcoder(vulkan_device& device, uint32_t max_frames_in_flight);
+        ~texture_transcoder() noexcept; // assumes the device is idle
+
+        // true if [data_format] streams can be transcoded to [format] (rgba8 to bc1 or bc7 with the same srgb-ness)
+        bool is_supported(vk::Format data_format, vk::Format format) noexcept;
+
+        // creates the scratch resources the rgba8 data should be streamed into (level 0 of the scratch image is [info.base_level]),
+        // the scratch image needs to end up in eShaderReadOnlyOptimal, can be called from any thread
+        std::shared_ptr<transcode> create_transcode(const transcode_info& info);
+
+        // queues the transcode once the scratch stream is submitted, returns the ready fence of the destination image
+        multi_fence_view queue_transcode(std::shared_ptr<transcode> transcode, multi_fence_view scratch_ready);
+
+        // records the transcodes whose scratch images are ready (graphics work recorded before is ordered before them),
+        // the scratch resources are kept until [frame_index] is recorded again (its previous submission must be finished by then)
+        bool has_work() noexcept;
+        void record(vk::CommandBuffer cmd, uint32_t frame_index, const multi_fence& finished_fence);
+
+    private:
+        // limits the descriptor sets in flight
+        static constexpr uint32_t max_transcodes_per_frame = 16;
+
+        static bool is_srgb(vk::Format format) noexcept;
+        static VkDeviceSize get_level_offset(const transcode_info& info, uint32_t level) noexcept; // in bytes, level == level_count gives the total size
+
+        void destroy_transcode(const transcode& transcode) noexcept;
+
+        vulkan_device& device;
+
+        vk::Sampler sampler;
+        vk::DescriptorSetLayout set_layout;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline bc1_pipeline;
+        vk::Pipeline bc7_pipeline;
+        vk::DescriptorPool descriptor_pool;
+
+        std::vector<std::shared_ptr<transcode>> queued_transcodes;
+        std::mutex queued_transcodes_lock; // guards [queued_transcodes]
+
+        std::vector<std::vector<std::shared_ptr<transcode>>> retired_transcodes; // per frame index
+    };
+}
@@ -0,0 +1,503 @@
+#include "virtual_texture.hpp"
+#include <core/abort.hpp>
+#include <core/logger.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+namespace photon {
+    bool virtual_texture_cache::is_format_supported(rendering::vulkan_device& device, vk::Format format) noexcept {
+        constexpr vk::FormatFeatureFlags cache_features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear | vk::FormatFeatureFlagBits::eTransferDst;
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(format);
+
+        // pages and their borders are copied in whole texel blocks
+        return (device.get_physical_device().getFormatProperties(format).optimalTilingFeatures & cache_features) == cache_features && page_border % block_extent[0] == 0 && page_border % block_extent[1] == 0;
+    }
+
+    virtual_texture_cache::virtual_texture_cache(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const cache_config& config) :
+        streamer{streamer},
+        pool{pool},
+        config{config},
+        max_frames_in_flight{max_frames_in_flight}
+    {
+        rendering::vulkan_device& device = streamer.get_device();
+
+        if (!is_format_supported(device, config.format)) {
+            P_LOG_E("Virtual texture cache format {} is not supported!", vk::to_string(config.format));
+            engine_abort();
+        }
+
+        page_count = std::min(config.page_count, device.get_physical_device().getProperties().limits.maxImageArrayLayers);
+
+        // page cache
+
+        vk::ImageCreateInfo image_info{
+            .imageType = vk::ImageType::e2D,
+            .format = config.format,
+            .extent = { page_size, page_size, 1 },
+            .mipLevels = 1,
+            .arrayLayers = page_count,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+
+        VmaAllocationCreateInfo image_alloc_info{
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        VkImage image;
+
+        VkResult res = vmaCreateImage(device.get_allocator(), &static_cast<VkImageCreateInfo&>(image_info), &image_alloc_info, &image, &cache_alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateImage");
+
+        cache_image = image;
+
+        vk::ImageViewCreateInfo view_info{
+            .image = cache_image,
+            .viewType = vk::ImageViewType::e2DArray,
+            .format = config.format,
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = page_count,
+            },
+        };
+
+        cache_view = device.get_device().createImageView(view_info);
+
+        // the whole cache is cleared once so every layer is in its normal layout before it's sampled (pages are then streamed layer by layer)
+        // note: queued before any page, streams of the same priority finish in order
+
+        rendering::asset_streamer::pending_stream clear_stream = streamer.begin_stream(rendering::asset_streamer::image_stream_info{
+            .image = cache_image,
+            .format = config.format,
+            .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .image_subresource = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = page_count,
+            },
+            .level_count = 1,
+            .generated_level_count = 0,
+            .image_offset = { 0, 0, 0 },
+            .image_extent = { page_size, page_size, 1 },
+            .dst_alloc = VK_NULL_HANDLE,
+            .is_host_copyable = false,
+        }, config.priority);
+
+        std::memset(clear_stream.get_data().data(), 0, clear_stream.get_data().size());
+        streamer.commit_stream(std::move(clear_stream));
+
+        // page table buffers
+
+        vk::BufferCreateInfo buffer_info{
+            .size = static_cast<VkDeviceSize>(config.page_table_capacity) * sizeof(uint32_t),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+            .sharingMode = vk::SharingMode::eExclusive, // main queue usage only
+        };
+
+        VmaAllocationCreateInfo buffer_alloc_info{
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        table_buffers.resize(max_frames_in_flight);
+        table_mapped_data.resize(max_frames_in_flight);
+
+        for (uint32_t i = 0; i < max_frames_in_flight; i++) {
+            VmaAllocationInfo alloc_info;
+            VkBuffer buf;
+
+            res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &buffer_alloc_info, &buf, &table_buffers[i].second, &alloc_info);
+            vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+            table_buffers[i].first = buf;
+            table_mapped_data[i] = static_cast<uint32_t*>(alloc_info.pMappedData);
+
+            // no texture has a table yet
+            std::memset(table_mapped_data[i], 0, max_textures * sizeof(uint32_t));
+        }
+
+        pages.resize(page_count);
+
+        // the first layers are used first
+        for (uint32_t layer = page_count; layer-- > 0;) free_layers.push_back(layer);
+
+        retired_layers.resize(max_frames_in_flight);
+    }
+
+    virtual_texture_cache::~virtual_texture_cache() noexcept {
+        rendering::vulkan_device& device = streamer.get_device();
+
+        for (auto& buf : table_buffers) {
+            vmaDestroyBuffer(device.get_allocator(), buf.first, buf.second);
+        }
+
+        device.get_device().destroyImageView(cache_view);
+        vmaDestroyImage(device.get_allocator(), cache_image, cache_alloc);
+    }
+
+    virtual_texture_cache::texture_id virtual_texture_cache::add_texture(std::string path) {
+        std::ifstream file(path, std::ios::binary);
+        std::optional<texture_container> container;
+        if (file) container = read_texture_container(file);
+
+        // pages are read from single levels, so they must be stored (and stored per level)
+        if (!container || container->is_layer_major || container->generate_levels || container->dimension_count != 2 || container->layer_count * container->face_count != 1) {
+            P_LOG_E("Virtual texturing needs a 2D ktx2 texture with pre-baked mips: {}", path);
+            engine_abort();
+        }
+
+        if (static_cast<vk::Format>(container->format) != config.format) {
+            P_LOG_E("Virtual texture format {} doesn't match the page cache format {}! ({})", vk::to_string(static_cast<vk::Format>(container->format)), vk::to_string(config.format), path);
+            engine_abort();
+        }
+
+        if (textures.size() == max_textures || container->width > max_pages * page_payload || container->height > max_pages * page_payload) {
+            P_LOG_E("Too many or too large virtual textures! ({})", path);
+            engine_abort();
+        }
+
+        texture_id id = static_cast<texture_id>(textures.size());
+        managed_texture& tex = textures.emplace_back();
+
+        // page grids of the levels up to the first one fitting into a single page
+
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(config.format);
+        uint32_t block_size = vk::blockSize(config.format);
+
+        for (uint32_t level = 0;; level++) {
+            if (level == container->level_count || level == max_levels) {
+                P_LOG_E("Virtual texture needs its mips down to a single page: {}", path);
+                engine_abort();
+            }
+
+            uint32_t width = std::max(1U, container->width >> level);
+            uint32_t height = std::max(1U, container->height >> level);
+
+            uint64_t level_size = static_cast<uint64_t>((width + block_extent[0] - 1) / block_extent[0]) * ((height + block_extent[1] - 1) / block_extent[1]) * block_size;
+
+            if (container->levels[level].size != level_size) {
+                P_LOG_E("Texture level size doesn't match its format! (expected: {} stored: {}) {}", level_size, container->levels[level].size, path);
+                engine_abort();
+            }
+
+            level_layout& layout = tex.levels.emplace_back(level_layout{
+                .width = width,
+                .height = height,
+                .pages_x = (width + page_payload - 1) / page_payload,
+                .pages_y = (height + page_payload - 1) / page_payload,
+            });
+
+            if (layout.pages_x == 1 && layout.pages_y == 1) break;
+        }
+
+        tex.pinned_level = static_cast<uint32_t>(tex.levels.size()) - 1;
+        tex.source = std::make_shared<const page_source>(page_source{ .path = std::move(path), .container = std::move(container.value()) });
+
+        // table layout, see the header comment
+
+        uint32_t entry_offset = 3 + static_cast<uint32_t>(tex.levels.size());
+
+        for (level_layout& layout : tex.levels) {
+            layout.table_offset = entry_offset;
+            entry_offset += layout.pages_x * layout.pages_y;
+        }
+
+        if (table_size + entry_offset > config.page_table_capacity) {
+            P_LOG_E("Virtual texture page tables exceed their capacity of {} entries! ({})", config.page_table_capacity, tex.source->path);
+            engine_abort();
+        }
+
+        tex.table.resize(entry_offset);
+        tex.table_offset = table_size;
+        table_size += entry_offset;
+
+        rebuild_table(id);
+        tex.table_frames_to_write = max_frames_in_flight;
+
+        if (!start_load(pack_page(id, tex.pinned_level, 0, 0), true)) {
+            P_LOG_E("Virtual texture cache is too small for the pinned pages! ({} pages)", page_count);
+            engine_abort();
+        }
+
+        return id;
+    }
+
+    void virtual_texture_cache::process_feedback(std::span<const uint32_t> feedback) {
+        // the feedback repeats the same pages a lot
+        feedback_keys.assign(feedback.begin(), feedback.end());
+
+        std::sort(feedback_keys.begin(), feedback_keys.end());
+        feedback_keys.erase(std::unique(feedback_keys.begin(), feedback_keys.end()), feedback_keys.end());
+
+        for (uint32_t key : feedback_keys) {
+            if (key == no_feedback) continue;
+
+            texture_id id = key >> 24;
+            uint32_t level = key >> 20 & 0xF;
+            uint32_t page_y = key >> 10 & 0x3FF;
+            uint32_t page_x = key & 0x3FF;
+
+            if (id >= textures.size()) continue;
+
+            managed_texture& tex = textures[id];
+            if (level > tex.pinned_level || page_x >= tex.levels[level].pages_x || page_y >= tex.levels[level].pages_y) continue;
+
+            // the page and its ancestors (which the page table falls back to) are used
+            for (;; level++) {
+                uint32_t ancestor_key = pack_page(id, level, page_x, page_y);
+                auto it = resident_pages.find(ancestor_key);
+
+                if (it == resident_pages.end()) {
+                    missing_pages.push_back(ancestor_key);
+                } else {
+                    cache_page& page = pages[it->second];
+
+                    // the remaining ancestors were already marked by another page
+                    if (page.last_used == frame_counter) break;
+                    page.last_used = frame_counter;
+
+                    if (!page.load && !page.is_pinned) lru_pages.splice(lru_pages.begin(), lru_pages, page.lru_entry);
+                }
+
+                if (level == tex.pinned_level) break;
+
+                // note: a level can be more than half the pages of the next one (see level_layout), the last pages then share their parent
+                page_x = std::min(page_x >> 1, tex.levels[level + 1].pages_x - 1);
+                page_y = std::min(page_y >> 1, tex.levels[level + 1].pages_y - 1);
+            }
+        }
+    }
+
+    void virtual_texture_cache::update(uint32_t frame_index) {
+        // the layers evicted in this frame slot aren't referenced by the gpu anymore
+        free_layers.insert(free_layers.end(), retired_layers[frame_index].begin(), retired_layers[frame_index].end());
+        retired_layers[frame_index].clear();
+
+        // publish the finished pages
+
+        for (uint32_t i = static_cast<uint32_t>(loading_layers.size()); i-- > 0;) {
+            uint32_t layer = loading_layers[i];
+            cache_page& page = pages[layer];
+
+            if (!page.load->is_staged.load(std::memory_order_acquire) || page.load->ready_fence.status() != vk::Result::eSuccess) continue;
+
+            page.load.reset();
+            page.last_used = frame_counter;
+
+            if (!page.is_pinned) {
+                lru_pages.push_front(layer);
+                page.lru_entry = lru_pages.begin();
+            }
+
+            textures[page.key >> 24].is_table_dirty = true;
+            pending_load_count--;
+
+            loading_layers[i] = loading_layers.back();
+            loading_layers.pop_back();
+        }
+
+        // stream the missing pages, coarse levels first as their children fall back to them
+
+        std::sort(missing_pages.begin(), missing_pages.end(), [](uint32_t a, uint32_t b) {
+            if ((a >> 20 & 0xF) != (b >> 20 & 0xF)) return (a >> 20 & 0xF) > (b >> 20 & 0xF);
+            return a < b;
+        });
+
+        missing_pages.erase(std::unique(missing_pages.begin(), missing_pages.end()), missing_pages.end());
+
+        size_t wanted_layers = std::min<size_t>(missing_pages.size(), config.max_pending_pages - std::min(pending_load_count, config.max_pending_pages));
+
+        // note: evicted layers are only reused [max_frames_in_flight] updates later (the ones still retired count as free), pages used this frame are never evicted
+        size_t available_layers = free_layers.size();
+        for (const std::vector<uint32_t>& retired : retired_layers) available_layers += retired.size();
+
+        while (available_layers < wanted_layers && !lru_pages.empty() && pages[lru_pages.back()].last_used != frame_counter) {
+            evict(lru_pages.back(), frame_index);
+            available_layers++;
+        }
+
+        for (uint32_t key : missing_pages) {
+            if (pending_load_count >= config.max_pending_pages || !start_load(key, false)) break;
+        }
+
+        missing_pages.clear();
+
+        // write the changed page tables, every frame slot gets its own copy
+
+        for (texture_id id = 0; id < textures.size(); id++) {
+            managed_texture& tex = textures[id];
+
+            if (tex.is_table_dirty) {
+                rebuild_table(id);
+
+                tex.is_table_dirty = false;
+                tex.table_frames_to_write = max_frames_in_flight;
+            }
+
+            if (tex.table_frames_to_write == 0) continue;
+
+            std::memcpy(table_mapped_data[frame_index] + tex.table_offset, tex.table.data(), tex.table.size() * sizeof(uint32_t));
+            table_mapped_data[frame_index][id] = tex.table_offset;
+
+            tex.table_frames_to_write--;
+        }
+
+        frame_counter++;
+    }
+
+    bool virtual_texture_cache::start_load(uint32_t key, bool is_pinned) {
+        if (free_layers.empty()) return false;
+
+        uint32_t layer = free_layers.back();
+        free_layers.pop_back();
+
+        cache_page& page = pages[layer];
+        page.key = key;
+        page.last_used = frame_counter;
+        page.load = std::make_shared<page_load>();
+        page.is_pinned = is_pinned;
+
+        resident_pages.emplace(key, layer);
+        loading_layers.push_back(layer);
+        pending_load_count++;
+
+        rendering::asset_streamer::image_stream_info stream_info{
+            .image = cache_image,
+            .format = config.format,
+            .normal_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .sharing_mode = vk::SharingMode::eExclusive,
+            .image_subresource = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = 0,
+                .baseArrayLayer = layer,
+                .layerCount = 1,
+            },
+            .level_count = 1,
+            .generated_level_count = 0,
+            .image_offset = { 0, 0, 0 },
+            .image_extent = { page_size, page_size, 1 },
+            .dst_alloc = VK_NULL_HANDLE,
+            .is_host_copyable = false, // the other layers are in use by the device
+        };
+
+        // note: the task only holds shared state and the cache image, the loader pool finishes its tasks before the cache is destroyed (see rendering_stack)
+        pool.submit([&streamer = streamer, stream_info, source = textures[key >> 24].source, load = page.load, priority = config.priority, key]() {
+            rendering::asset_streamer::pending_stream stream = streamer.begin_stream(stream_info, priority);
+            read_page(*source, stream_info.format, key >> 20 & 0xF, key & 0x3FF, key >> 10 & 0x3FF, stream.get_data());
+
+            load->ready_fence = streamer.commit_stream(std::move(stream));
+            load->is_staged.store(true, std::memory_order_release);
+        });
+
+        return true;
+    }
+
+    void virtual_texture_cache::evict(uint32_t layer, uint32_t frame_index) {
+        cache_page& page = pages[layer];
+
+        resident_pages.erase(page.key);
+        lru_pages.erase(page.lru_entry);
+        textures[page.key >> 24].is_table_dirty = true;
+
+        page.key = no_page;
+        retired_layers[frame_index].push_back(layer);
+    }
+
+    void virtual_texture_cache::rebuild_table(texture_id id) {
+        managed_texture& tex = textures[id];
+
+        tex.table[0] = tex.levels[0].width;
+        tex.table[1] = tex.levels[0].height;
+        tex.table[2] = static_cast<uint32_t>(tex.levels.size());
+
+        for (uint32_t level = 0; level < tex.levels.size(); level++) {
+            tex.table[3 + level] = tex.levels[level].table_offset;
+        }
+
+        // entries are the cache layer (16 bits) and the level of the page in it, pages which aren't resident take the entry of their parent
+
+        for (uint32_t level = tex.pinned_level + 1; level-- > 0;) {
+            const level_layout& layout = tex.levels[level];
+
+            for (uint32_t page_y = 0; page_y < layout.pages_y; page_y++) {
+                for (uint32_t page_x = 0; page_x < layout.pages_x; page_x++) {
+                    uint32_t& entry = tex.table[layout.table_offset + page_y * layout.pages_x + page_x];
+                    auto it = resident_pages.find(pack_page(id, level, page_x, page_y));
+
+                    if (it != resident_pages.end() && !pages[it->second].load) {
+                        entry = it->second | level << 16;
+                    } else if (level == tex.pinned_level) {
+                        entry = no_page;
+                    } else {
+                        const level_layout& parent = tex.levels[level + 1];
+                        entry = tex.table[parent.table_offset + std::min(page_y >> 1, parent.pages_y - 1) * parent.pages_x + std::min(page_x >> 1, parent.pages_x - 1)];
+                    }
+                }
+            }
+        }
+    }
+
+    void virtual_texture_cache::read_page(const page_source& source, vk::Format format, uint32_t level, uint32_t page_x, uint32_t page_y, std::span<std::byte> data) {
+        std::array<uint8_t, 3> block_extent = vk::blockExtent(format);
+        size_t block_size = vk::blockSize(format);
+
+        // in texel blocks
+        int32_t level_width = static_cast<int32_t>((std::max(1U, source.container.width >> level) + block_extent[0] - 1) / block_extent[0]);
+        int32_t level_height = static_cast<int32_t>((std::max(1U, source.container.height >> level) + block_extent[1] - 1) / block_extent[1]);
+
+        int32_t page_width = page_size / block_extent[0];
+        int32_t page_height = page_size / block_extent[1];
+
+        // the page starts [page_border] texels before its payload, which can be outside of the level
+        int32_t origin_x = (static_cast<int32_t>(page_x * page_payload) - static_cast<int32_t>(page_border)) / block_extent[0];
+        int32_t origin_y = (static_cast<int32_t>(page_y * page_payload) - static_cast<int32_t>(page_border)) / block_extent[1];
+
+        // the part of each row inside of the level, the rest repeats the edge blocks
+        int32_t first_x = std::max(origin_x, 0);
+        int32_t last_x = std::min(origin_x + page_width, level_width);
+
+        size_t row_size = page_width * block_size;
+
+        std::ifstream file(source.path, std::ios::binary);
+        int32_t prev_y = -1;
+
+        for (int32_t row = 0; row < page_height; row++) {
+            std::byte* dst = data.data() + row * row_size;
+            int32_t y = std::clamp(origin_y + row, 0, level_height - 1);
+
+            if (y == prev_y) {
+                std::memcpy(dst, dst - row_size, row_size);
+                continue;
+            }
+
+            prev_y = y;
+
+            file.seekg(source.container.levels[level].offset + (static_cast<uint64_t>(y) * level_width + first_x) * block_size);
+            file.read(reinterpret_cast<char*>(dst + (first_x - origin_x) * block_size), (last_x - first_x) * block_size);
+
+            if (!file) {
+                P_LOG_E("Failed to read a virtual texture page! {}", source.path);
+                engine_abort();
+            }
+
+            for (int32_t x = 0; x < first_x - origin_x; x++) {
+                std::memcpy(dst + x * block_size, dst + (first_x - origin_x) * block_size, block_size);
+            }
+
+            for (int32_t x = last_x - origin_x; x < page_width; x++) {
+                std::memcpy(dst + x * block_size, dst + (last_x - origin_x - 1) * block_size, block_size);
+            }
+        }
+    }
+}
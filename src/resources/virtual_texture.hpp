@@ -0,0 +1,177 @@
+#pragma once
+
+#include "streamer.hpp"
+#include "texture_container.hpp"
+#include <core/worker_pool.hpp>
+
+#include <atomic>
+#include <limits>
+#include <list>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace photon {
+    // software virtual texturing of cooked (ktx2) textures larger than what fits into memory at once
+
+    // the textures are split into pages of [page_payload] texels per level, the pages seen on screen (reported by the feedback
+    // pass of the renderer, see forward_renderer::get_feedback()) are streamed into a fixed page cache, the least recently seen ones are evicted,
+    // a page table per texture maps every page to the cache layer of its finest resident ancestor
+
+    // note: the cache is a 2D array image with one page per layer, every page stream only discards its own layer,
+    // so no sparse binding is needed (runs on lavapipe too), pages carry a [page_border] texel border for filtering across pages
+
+    // note: the page tables live in a host visible buffer per frame in flight (see get_page_table_buffer()), shaders sample through
+    // shaders/virtual_texture.glsl, the layout is:
+    // [0, max_textures) - offset of the table of each texture
+    // table - width, height, level_count, offset of the entries of each level (relative to the table), entries (row major pages)
+
+    class virtual_texture_cache {
+    public:
+        using texture_id = uint32_t;
+
+        // must match shaders/virtual_texture.glsl
+        static constexpr uint32_t page_size = 128;
+        static constexpr uint32_t page_border = 4;
+        static constexpr uint32_t page_payload = page_size - 2 * page_border;
+
+        // feedback texels are packed as id (8 bits), level (4 bits), page y (10 bits), page x (10 bits)
+        static constexpr uint32_t max_textures = 256;
+        static constexpr uint32_t max_levels = 16;
+        static constexpr uint32_t max_pages = 1024; // per dimension
+
+        static constexpr uint32_t no_feedback = std::numeric_limits<uint32_t>::max(); // feedback texels without a virtual texture
+        static constexpr uint32_t no_page = std::numeric_limits<uint32_t>::max(); // page table entries without a resident ancestor
+
+        static constexpr uint32_t pack_page(texture_id id, uint32_t level, uint32_t page_x, uint32_t page_y) noexcept {
+            return id << 24 | level << 20 | page_y << 10 | page_x;
+        }
+
+        struct cache_config {
+            vk::Format format; // of the page cache, every virtual texture must be stored in it
+            uint32_t page_count; // clamped to the max array layers of the device
+
+            // size of each page table buffer in uints
+            uint32_t page_table_capacity;
+
+            // page streams in flight at once, the other missing pages wait for a later update()
+            uint32_t max_pending_pages;
+
+            rendering::stream_priority priority;
+        };
+
+        virtual_texture_cache(rendering::asset_streamer& streamer, worker_pool& pool, uint32_t max_frames_in_flight, const cache_config& config);
+        ~virtual_texture_cache() noexcept;
+
+        virtual_texture_cache(const virtual_texture_cache&) = delete;
+        virtual_texture_cache& operator=(const virtual_texture_cache&) = delete;
+
+        // reads the header of a 2D ktx2 file with pre-baked mips and streams the coarsest level that fits into a single page,
+        // which stays resident
+        texture_id add_texture(std::string path);
+
+        // marks the pages of a finished frame's feedback (and their ancestors) as used, missing ones are queued for streaming
+        void process_feedback(std::span<const uint32_t> feedback);
+
+        // publishes finished pages, streams missing pages (evicting the least recently used ones) and writes the changed page tables
+        // into the table buffer of [frame_index], pages evicted [max_frames_in_flight] calls ago are reused
+        void update(uint32_t frame_index);
+
+        // true if [format] can be used for the page cache (sampled with linear filtering, streamed in whole texel blocks of the page border)
+        static bool is_format_supported(rendering::vulkan_device& device, vk::Format format) noexcept;
+
+        vk::Format get_format() const noexcept { return config.format; } // virtual textures have to be cooked to it
+        vk::ImageView get_cache_view() const noexcept { return cache_view; }
+        vk::Buffer get_page_table_buffer(uint32_t frame_index) const noexcept { return table_buffers[frame_index].first; }
+
+        uint32_t get_page_count() const noexcept { return page_count; }
+        uint32_t get_resident_page_count() const noexcept { return static_cast<uint32_t>(resident_pages.size()); } // including the streaming ones
+
+    private:
+        struct level_layout {
+            uint32_t width, height; // in texels
+            uint32_t pages_x, pages_y;
+            uint32_t table_offset; // of the entries, relative to the table
+        };
+
+        // shared with the loader threads
+        struct page_source {
+            std::string path;
+            texture_container container;
+        };
+
+        struct managed_texture {
+            std::shared_ptr<const page_source> source;
+
+            std::vector<level_layout> levels; // up to the pinned level
+            uint32_t pinned_level; // coarsest level, a single page which is never evicted
+
+            // cpu copy of the page table, written into the table buffers while [table_frames_to_write] isn't zero
+            std::vector<uint32_t> table;
+            uint32_t table_offset;
+            uint32_t table_frames_to_write = 0;
+            bool is_table_dirty = false;
+        };
+
+        // state of a page stream, shared with the loader thread
+        struct page_load {
+            std::atomic<bool> is_staged = false;
+            rendering::multi_fence_view ready_fence; // set before [is_staged]
+        };
+
+        struct cache_page {
+            uint32_t key = no_page;
+            uint64_t last_used = 0;
+
+            std::shared_ptr<page_load> load; // set while streaming
+            std::list<uint32_t>::iterator lru_entry; // position in [lru_pages], only for evictable resident pages
+            bool is_pinned = false;
+        };
+
+        // streams the page [key] into a free cache layer on the loader pool, false if no layer is free
+        bool start_load(uint32_t key, bool is_pinned);
+
+        // removes the page from the page table, its layer is reused once the frames in flight finished
+        void evict(uint32_t layer, uint32_t frame_index);
+
+        // rebuilds the cpu page table of texture [id] from the resident pages, coarse to fine
+        void rebuild_table(texture_id id);
+
+        // reads the page into [data] (texel block rows), the border is clamped to the level edges
+        static void read_page(const page_source& source, vk::Format format, uint32_t level, uint32_t page_x, uint32_t page_y, std::span<std::byte> data);
+
+        rendering::asset_streamer& streamer;
+        worker_pool& pool;
+        cache_config config;
+
+        vk::Image cache_image;
+        VmaAllocation cache_alloc;
+        vk::ImageView cache_view;
+        uint32_t page_count;
+
+        // host visible page table buffers, indexed by frame_index
+        std::vector<std::pair<vk::Buffer, VmaAllocation>> table_buffers;
+        std::vector<uint32_t*> table_mapped_data;
+        uint32_t table_size = max_textures; // used part of the table buffers
+
+        std::vector<managed_texture> textures;
+
+        std::vector<cache_page> pages; // indexed by layer
+        std::unordered_map<uint32_t, uint32_t> resident_pages; // key -> layer, resident or streaming
+        std::vector<uint32_t> free_layers;
+        std::vector<uint32_t> loading_layers;
+        std::list<uint32_t> lru_pages; // evictable resident layers, most recently used first
+
+        // evicted layers, indexed by frame_index
+        std::vector<std::vector<uint32_t>> retired_layers;
+
+        std::vector<uint32_t> feedback_keys; // reused by process_feedback()
+        std::vector<uint32_t> missing_pages; // keys queued for streaming
+
+        uint32_t pending_load_count = 0;
+        uint64_t frame_counter = 0;
+        uint32_t max_frames_in_flight;
+    };
+}
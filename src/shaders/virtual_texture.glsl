@@ -0,0 +1,62 @@
+// virtual texture sampling and page feedback, see resources/virtual_texture.hpp for the page table layout
+
+// the including shader declares the page table buffer of the frame first:
+// layout(std430, binding = ...) readonly buffer vt_page_table_buffer { uint vt_page_table[]; };
+
+// must match virtual_texture_cache
+#define VT_PAGE_SIZE 128
+#define VT_PAGE_BORDER 4
+#define VT_PAGE_PAYLOAD (VT_PAGE_SIZE - 2 * VT_PAGE_BORDER)
+#define VT_NO_PAGE 0xFFFFFFFFu
+
+uvec2 vt_level_extent(uint table, uint level) {
+    return max(uvec2(vt_page_table[table], vt_page_table[table + 1]) >> level, uvec2(1));
+}
+
+uvec2 vt_level_pages(uvec2 extent) {
+    return (extent + VT_PAGE_PAYLOAD - 1) / VT_PAGE_PAYLOAD;
+}
+
+// mip level of [uv] clamped to the levels of the table, [lod_bias] compensates the lower resolution of the feedback pass (-log2 of its divisor)
+uint vt_level(uint table, vec2 uv, float lod_bias) {
+    vec2 texel = uv * vec2(vt_level_extent(table, 0));
+    vec2 dx = dFdx(texel), dy = dFdy(texel);
+
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lod_bias;
+
+    return uint(clamp(lod, 0.0, float(vt_page_table[table + 2] - 1)));
+}
+
+// the page holding [uv] at [level], uvs are repeated
+// note: pages are clamped at the level edges, filtering doesn't wrap across them
+uvec2 vt_page(uint table, vec2 uv, uint level) {
+    uvec2 extent = vt_level_extent(table, level);
+    return min(uvec2(fract(uv) * vec2(extent)) / VT_PAGE_PAYLOAD, vt_level_pages(extent) - 1);
+}
+
+// the page request written by the feedback pass (r32ui), id (8 bits), level (4 bits), page y (10 bits), page x (10 bits)
+uint vt_feedback(uint id, vec2 uv, float lod_bias) {
+    uint table = vt_page_table[id];
+    uint level = vt_level(table, uv, lod_bias);
+    uvec2 page = vt_page(table, uv, level);
+
+    return id << 24 | level << 20 | page.y << 10 | page.x;
+}
+
+// samples the finest resident page of [uv] from the page cache (bilinear within the resident level)
+vec4 vt_sample(sampler2DArray cache, uint id, vec2 uv) {
+    uint table = vt_page_table[id];
+    uint level = vt_level(table, uv, 0.0);
+    uvec2 page = vt_page(table, uv, level);
+
+    uint entry = vt_page_table[table + vt_page_table[table + 3 + level] + page.y * vt_level_pages(vt_level_extent(table, level)).x + page.x];
+    if (entry == VT_NO_PAGE) return vec4(0.0);
+
+    // the entry can point to a coarser page (the finest resident ancestor)
+    uint resident_level = entry >> 16;
+
+    vec2 texel = fract(uv) * vec2(vt_level_extent(table, resident_level));
+    vec2 page_origin = vec2(vt_page(table, uv, resident_level) * VT_PAGE_PAYLOAD);
+
+    return textureLod(cache, vec3((texel - page_origin + VT_PAGE_BORDER) / VT_PAGE_SIZE, float(entry & 0xFFFFu)), 0.0);
+}
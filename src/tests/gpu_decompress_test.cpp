@@ -0,0 +1,258 @@
+#include "test_device.hpp"
+#include <resources/asset_pack_format.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// photon-gpu-decompress-test, decodes lz chunk payloads with the compute shader (asset_streamer::stream_compressed(), see gpu_decompressor)
+// and compares the result byte for byte with the cpu decoder (pack::read_payload())
+// usage: photon-gpu-decompress-test
+
+// the payload mixes chunks which are stored raw (random data), short repeating patterns (lz4 encodes them as matches overlapping
+// their own output) and regular matches, and ends in a partial chunk, ranges start and end inside chunks
+
+namespace photon::tests {
+    using namespace rendering;
+
+    constexpr uint64_t payload_size = 7 * pack::chunk_size + 12345;
+
+    constexpr std::chrono::seconds ready_timeout{60};
+
+    static std::vector<std::byte> create_payload() {
+        std::mt19937 random(7);
+        std::vector<std::byte> payload(payload_size);
+
+        constexpr const char* words[] = { "photon ", "texture ", "stream ", "chunk ", "vulkan ", "staging ", "mip " };
+
+        for (uint64_t chunk = 0; chunk < pack::get_chunk_count(payload_size); chunk++) {
+            uint64_t begin = chunk * pack::chunk_size;
+            uint64_t end = std::min(begin + pack::chunk_size, payload_size);
+
+            switch (chunk % 4) {
+            case 0: // doesn't shrink, stored raw
+                for (uint64_t i = begin; i < end; i++) payload[i] = static_cast<std::byte>(random());
+                break;
+            case 1: // runs of a single byte, the matches overlap by all but one byte
+                for (uint64_t i = begin; i < end; i++) payload[i] = static_cast<std::byte>(0x50 + (i - begin) / 4096);
+                break;
+            case 2: // short periods with a bit of noise
+                for (uint64_t i = begin; i < end; i++) payload[i] = static_cast<std::byte>(random() % 61 == 0 ? random() : (i - begin) % (3 + chunk % 5));
+                break;
+            case 3: // text, regular matches
+                for (uint64_t i = begin; i < end;) {
+                    const char* word = words[random() % std::size(words)];
+                    for (size_t c = 0; word[c] && i < end; c++) payload[i++] = static_cast<std::byte>(word[c]);
+                }
+                break;
+            }
+        }
+
+        return payload;
+    }
+
+    // true if a sequence of the lz4 block [chunk] has a match offset shorter than its length (the source overlaps the output)
+    static bool has_overlapping_match(std::span<const std::byte> chunk) noexcept {
+        auto read = [&](size_t pos) { return static_cast<uint32_t>(chunk[pos]); };
+
+        for (size_t pos = 0; pos < chunk.size();) {
+            uint32_t token = read(pos++);
+            size_t literal_count = token >> 4;
+
+            if (literal_count == 15) {
+                for (uint32_t value = 255; value == 255 && pos < chunk.size();) literal_count += value = read(pos++);
+            }
+
+            pos += literal_count;
+            if (pos + 2 > chunk.size()) break;
+
+            uint32_t match_offset = read(pos) | read(pos + 1) << 8;
+            pos += 2;
+
+            size_t match_count = token & 15;
+
+            if (match_count == 15) {
+                for (uint32_t value = 255; value == 255 && pos < chunk.size();) match_count += value = read(pos++);
+            }
+
+            if (match_offset < match_count + 4) return true;
+        }
+
+        return false;
+    }
+
+    // checks that the stored payload covers what the test is meant to cover
+    static bool check_coverage(std::span<const std::byte> stored) {
+        uint64_t chunk_count = pack::get_chunk_count(payload_size);
+        uint32_t raw_count = 0, overlapping_count = 0;
+
+        for (uint64_t chunk = 0; chunk < chunk_count; chunk++) {
+            uint64_t begin, end;
+            std::memcpy(&begin, stored.data() + chunk * sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&end, stored.data() + (chunk + 1) * sizeof(uint64_t), sizeof(uint64_t));
+
+            uint64_t chunk_length = std::min(pack::chunk_size, payload_size - chunk * pack::chunk_size);
+
+            if (end - begin == chunk_length) {
+                raw_count++;
+            } else if (has_overlapping_match(stored.subspan(begin, end - begin))) {
+                overlapping_count++;
+            }
+        }
+
+        if (!raw_count || !overlapping_count || payload_size % pack::chunk_size == 0) {
+            P_LOG_E("Test payload doesn't cover raw chunks, overlapping matches and a partial last chunk! (raw: {} overlapping: {})", raw_count, overlapping_count);
+            return false;
+        }
+
+        return true;
+    }
+
+    static int run() {
+        std::vector<std::byte> payload = create_payload();
+        std::optional<std::vector<std::byte>> stored;
+
+        {
+            worker_pool pool(4);
+            stored = pack::compress_payload(payload, pool);
+        }
+
+        if (!stored) {
+            P_LOG_E("Failed to compress the test payload!");
+            return 1;
+        }
+
+        if (!check_coverage(stored.value())) return 1;
+
+        pack::entry entry{
+            .size = payload_size,
+            .stored_size = stored->size(),
+            .type = pack::entry_type::raw,
+            .compression = pack::compression_type::lz_chunks,
+        };
+
+        struct test_range {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        constexpr uint64_t last_chunk_begin = payload_size / pack::chunk_size * pack::chunk_size;
+
+        constexpr test_range ranges[] = {
+            { 0, payload_size }, // everything
+            { pack::chunk_size - 4096, 2 * pack::chunk_size + 8192 }, // partial first and last chunk
+            { 2 * pack::chunk_size + 100, 64 }, // inside a single chunk
+            { last_chunk_begin - 1024, payload_size - last_chunk_begin + 1024 }, // into the partial last chunk, up to the (odd) end of the payload
+            { last_chunk_begin + 4, 4000 }, // only the partial last chunk
+        };
+
+        vulkan_instance instance = create_test_instance();
+        vulkan_device device = create_test_device(instance);
+
+        constexpr uint32_t max_frames_in_flight = 2;
+        bool is_passed = true;
+
+        VkDeviceSize buffer_size = 0;
+        for (const test_range& range : ranges) buffer_size += range.size;
+
+        vk::BufferCreateInfo buffer_info{
+            .size = buffer_size,
+            .usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkBuffer buf;
+        VmaAllocation alloc;
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &alloc_cinfo, &buf, &alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        {
+            asset_streamer streamer(device, max_frames_in_flight, asset_streamer::streamer_config{
+                .staging_ring_size = 8 * 1024 * 1024,
+                .thread_staging_ring_size = 4 * 1024 * 1024,
+                .frame_byte_budget = 4 * 1024 * 1024,
+                .frame_copy_budget = 64,
+                .stream_aging_frames = 8,
+                .use_submit_thread = false,
+                .use_gpu_transcoding = false,
+                .use_gpu_decompression = true,
+            });
+
+            if (!streamer.is_decompression_supported()) {
+                P_LOG_E("The streamer doesn't support gpu decompression!");
+                is_passed = false;
+            }
+
+            test_frames frames(device, max_frames_in_flight);
+            std::vector<multi_fence_view> fences;
+
+            VkDeviceSize dst_offset = 0;
+
+            for (const test_range& range : ranges) {
+                if (!is_passed) break;
+
+                fences.emplace_back(streamer.stream_compressed(asset_streamer::buffer_stream_info{
+                    .buf = buf,
+                    .dst_offset = dst_offset,
+                    .sharing_mode = vk::SharingMode::eExclusive,
+                    .dst_alloc = VK_NULL_HANDLE,
+                }, asset_streamer::compressed_range{
+                    .stored = stored.value(),
+                    .payload_size = payload_size,
+                    .offset = range.offset,
+                }, range.size, stream_priority::normal));
+
+                dst_offset += range.size;
+            }
+
+            is_passed &= frames.run_until_ready(streamer, fences, ready_timeout);
+
+            // frees the scratch buffers of the finished decompressions before the streamer is destroyed
+            for (uint32_t i = 0; i < max_frames_in_flight; i++) frames.frame(streamer);
+            device.get_device().waitIdle();
+
+            if (is_passed) {
+                std::vector<std::byte> decoded = read_back(device, buf, 0, buffer_size);
+                std::vector<std::byte> expected;
+
+                dst_offset = 0;
+
+                for (const test_range& range : ranges) {
+                    expected.resize(range.size);
+
+                    if (!pack::read_payload(entry, stored.value(), range.offset, expected, nullptr)) {
+                        P_LOG_E("Failed to decode the test payload on the cpu!");
+                        is_passed = false;
+                        break;
+                    }
+
+                    auto mismatch = std::mismatch(expected.begin(), expected.end(), decoded.begin() + dst_offset);
+
+                    if (mismatch.first != expected.end()) {
+                        uint64_t position = range.offset + (mismatch.first - expected.begin());
+                        P_LOG_E("Gpu decompression mismatch at payload byte {} (chunk {}) of range [{}, {})", position, position / pack::chunk_size, range.offset, range.offset + range.size);
+                        is_passed = false;
+                    }
+
+                    dst_offset += range.size;
+                }
+            }
+
+            P_LOG_I("gpu decompression of {} ranges: {}", std::size(ranges), is_passed ? "passed" : "failed");
+        }
+
+        vmaDestroyBuffer(device.get_allocator(), buf, alloc);
+        return is_passed ? 0 : 1;
+    }
+}
+
+int main() {
+    return photon::tests::run();
+}
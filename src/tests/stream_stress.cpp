@@ -0,0 +1,202 @@
+#include "test_device.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// photon-stream-stress, streams into a buffer from many producer threads at once while the main thread runs frames
+// usage: photon-stream-stress [--threads=N]
+
+// every producer fills its own slice of the destination buffer with streams of random size and priority, mixing stream(),
+// begin_stream() / commit_stream() and direct writes, the thread staging rings are kept small so streams also fall back to host memory
+// and get split across batches, once all ready fences signal the buffer is read back and compared with the streamed pattern
+// note: runs once with streams submitted by submit_batch() and once with the submit thread
+
+namespace photon::tests {
+    using namespace rendering;
+
+    constexpr VkDeviceSize slice_size = 4 * 1024 * 1024;
+    constexpr VkDeviceSize max_stream_size = 1536 * 1024; // larger than the thread staging rings
+
+    constexpr std::chrono::seconds ready_timeout{120};
+
+    // the streamed content of byte [offset] of the destination buffer
+    static std::byte get_pattern(VkDeviceSize offset) noexcept {
+        return static_cast<std::byte>((offset * 2654435761ULL) >> 15);
+    }
+
+    static void fill_pattern(std::span<std::byte> data, VkDeviceSize offset) noexcept {
+        for (VkDeviceSize i = 0; i < data.size(); i++) data[i] = get_pattern(offset + i);
+    }
+
+    // streams the slice [slice_offset, slice_offset + slice_size) of [buf], returns the ready fences of its streams
+    static std::vector<multi_fence_view> produce(asset_streamer& streamer, vk::Buffer buf, VmaAllocation alloc, VkDeviceSize slice_offset, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<VkDeviceSize> size_dist(1, max_stream_size / 4);
+
+        std::vector<multi_fence_view> fences;
+        std::vector<std::byte> data;
+
+        VkDeviceSize offset = slice_offset;
+        VkDeviceSize slice_end = slice_offset + slice_size;
+
+        for (uint32_t i = 0; offset < slice_end; i++) {
+            // note: multiples of 4, the streamer splits copies along buffer_copy_alignment
+            VkDeviceSize size = std::min(size_dist(random) * 4, slice_end - offset);
+            stream_priority priority = static_cast<stream_priority>(random() % stream_priority_count);
+
+            asset_streamer::buffer_stream_info stream{
+                .buf = buf,
+                .dst_offset = offset,
+                .sharing_mode = vk::SharingMode::eExclusive,
+            };
+
+            switch (random() % 3) {
+            case 0: {
+                data.resize(size);
+                fill_pattern(data, offset);
+
+                fences.emplace_back(streamer.stream(stream, data.data(), size, priority));
+                break;
+            }
+            case 1: {
+                asset_streamer::pending_stream pending = streamer.begin_stream(stream, size, priority);
+                fill_pattern(pending.get_data(), offset);
+
+                fences.emplace_back(streamer.commit_stream(std::move(pending)));
+                break;
+            }
+            case 2: {
+                // written straight into the buffer if the device memory is host visible (lavapipe), staged otherwise
+                stream.dst_alloc = alloc;
+
+                data.resize(size);
+                fill_pattern(data, offset);
+
+                fences.emplace_back(streamer.stream(stream, data.data(), size, priority));
+                break;
+            }
+            }
+
+            offset += size;
+
+            // let the frames catch up now and then, so the rings are reused while other threads keep streaming
+            if (i % 16 == 15) std::this_thread::yield();
+        }
+
+        return fences;
+    }
+
+    static bool run_stress(vulkan_device& device, uint32_t thread_count, bool use_submit_thread) {
+        constexpr uint32_t max_frames_in_flight = 2;
+
+        VkDeviceSize buffer_size = slice_size * thread_count;
+
+        vk::BufferCreateInfo buffer_info{
+            .size = buffer_size,
+            .usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        VkBuffer buf;
+        VmaAllocation alloc;
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &alloc_cinfo, &buf, &alloc, nullptr);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        bool is_passed = true;
+
+        {
+            asset_streamer streamer(device, max_frames_in_flight, asset_streamer::streamer_config{
+                .staging_ring_size = 8 * 1024 * 1024,
+                .thread_staging_ring_size = 1024 * 1024,
+                .frame_byte_budget = 2 * 1024 * 1024,
+                .frame_copy_budget = 64,
+                .stream_aging_frames = 8,
+                .use_submit_thread = use_submit_thread,
+                .use_gpu_transcoding = false,
+                .use_gpu_decompression = false,
+            });
+
+            test_frames frames(device, max_frames_in_flight);
+
+            std::vector<std::vector<multi_fence_view>> thread_fences(thread_count);
+            std::vector<std::thread> producers;
+            std::atomic<uint32_t> running_count = thread_count;
+
+            for (uint32_t i = 0; i < thread_count; i++) {
+                producers.emplace_back([&, i]() {
+                    thread_fences[i] = produce(streamer, buf, alloc, slice_size * i, i + 1);
+                    running_count.fetch_sub(1, std::memory_order_release);
+                });
+            }
+
+            // the producers only stage, the frames have to keep going for their rings to be freed
+            while (running_count.load(std::memory_order_acquire)) frames.frame(streamer);
+
+            for (std::thread& producer : producers) producer.join();
+
+            std::vector<multi_fence_view> fences;
+            for (auto& thread_fence : thread_fences) fences.insert(fences.end(), thread_fence.begin(), thread_fence.end());
+
+            is_passed = frames.run_until_ready(streamer, fences, ready_timeout);
+
+            // flushes the staging of the finished streams before the streamer is destroyed
+            for (uint32_t i = 0; i < max_frames_in_flight; i++) frames.frame(streamer);
+            device.get_device().waitIdle();
+
+            if (is_passed) {
+                std::vector<std::byte> data = read_back(device, buf, 0, buffer_size);
+
+                for (VkDeviceSize i = 0; i < buffer_size; i++) {
+                    if (data[i] != get_pattern(i)) {
+                        P_LOG_E("Streamed data mismatch at byte {} (slice {})", i, i / slice_size);
+                        is_passed = false;
+                        break;
+                    }
+                }
+            }
+
+            P_LOG_I("{} streams from {} threads ({}): {}", fences.size(), thread_count, use_submit_thread ? "submit thread" : "submit_batch", is_passed ? "passed" : "failed");
+        }
+
+        vmaDestroyBuffer(device.get_allocator(), buf, alloc);
+        return is_passed;
+    }
+
+    static int run(int argc, char** argv) {
+        uint32_t thread_count = 8;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (arg.starts_with("--threads=")) {
+                thread_count = std::max(std::stoi(arg.substr(10)), 1);
+            } else {
+                P_LOG_E("usage: photon-stream-stress [--threads=N]");
+                return 1;
+            }
+        }
+
+        vulkan_instance instance = create_test_instance();
+        vulkan_device device = create_test_device(instance);
+
+        bool is_passed = run_stress(device, thread_count, false);
+        is_passed &= run_stress(device, thread_count, true);
+
+        return is_passed ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    return photon::tests::run(argc, argv);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <rendering/vk_instance.hpp>
+#include <rendering/vk_device.hpp>
+#include <rendering/batch_buffer.hpp>
+#include <resources/streamer.hpp>
+#include <core/logger.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+// headless setup shared by the gpu tests (and benches), no window or swapchain is created so they run on any vulkan 1.3 device,
+// in ci that's lavapipe (select it with VK_ICD_FILENAMES=<path>/lvp_icd.x86_64.json if other drivers are installed)
+
+namespace photon::tests {
+    inline rendering::vulkan_instance create_test_instance() noexcept {
+        std::vector<std::pair<const char*, bool>> layers;
+
+#ifndef NDEBUG
+        layers.emplace_back("VK_LAYER_KHRONOS_validation", false);
+#endif
+
+        rendering::vulkan_instance::instance_config config{
+            .requested_layers = std::move(layers),
+        };
+
+        return rendering::vulkan_instance(config);
+    }
+
+    inline rendering::vulkan_device create_test_device(rendering::vulkan_instance& instance) noexcept {
+        std::vector<std::pair<const char*, bool>> extensions;
+        extensions.emplace_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME, false);
+
+        rendering::vulkan_device::device_config config{
+            .instance = instance,
+            .requested_extensions = std::move(extensions),
+        };
+
+        return rendering::vulkan_device(config);
+    }
+
+    // the graphics side of the rendering_stack frame loop without presenting: every frame() submits the streamer batch and
+    // the graphics commands of the streamer, waiting for its blocking semaphore
+    class test_frames {
+    public:
+        test_frames(rendering::vulkan_device& device, uint32_t max_frames_in_flight) :
+            device{device},
+            cmd_buffer{device, max_frames_in_flight, false},
+            max_frames_in_flight{max_frames_in_flight}
+        {
+            for (uint32_t i = 0; i < max_frames_in_flight; i++) {
+                frame_fences.emplace_back(device.get_device().createFence(vk::FenceCreateInfo{ .flags = vk::FenceCreateFlagBits::eSignaled }));
+            }
+        }
+
+        ~test_frames() noexcept {
+            device.get_device().waitIdle();
+
+            for (vk::Fence fence : frame_fences) device.get_device().destroyFence(fence);
+        }
+
+        test_frames(const test_frames&) = delete;
+        test_frames& operator=(const test_frames&) = delete;
+
+        void frame(rendering::asset_streamer& streamer) {
+            vk::Result res = device.get_device().waitForFences(frame_fences[frame_index], vk::True, std::numeric_limits<uint64_t>::max());
+            vk::resultCheck(res, "waitForFences");
+
+            device.get_device().resetFences(frame_fences[frame_index]);
+            cmd_buffer.reset_batch(frame_index);
+
+            vk::Semaphore streamer_finished_sem = streamer.submit_batch((frame_index + 1) % max_frames_in_flight);
+
+            std::vector<vk::CommandBuffer> cmds;
+
+            if (streamer.has_graphics_commands()) {
+                vk::CommandBufferBeginInfo begin_info{
+                    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                };
+
+                vk::CommandBuffer cmd = cmd_buffer.begin_recording(begin_info);
+                streamer.record_graphics_commands(cmd, frame_index);
+                cmd.end();
+
+                cmds.emplace_back(cmd);
+            }
+
+            vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+
+            vk::SubmitInfo submit_info{
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &streamer_finished_sem,
+                .pWaitDstStageMask = &wait_stage,
+                .commandBufferCount = static_cast<uint32_t>(cmds.size()),
+                .pCommandBuffers = cmds.data(),
+            };
+
+            cmd_buffer.submit_batch(std::span(&submit_info, 1), frame_fences[frame_index]);
+
+            frame_index = (frame_index + 1) % max_frames_in_flight;
+        }
+
+        // runs frames until all [fences] are signaled, false (and logs) if that takes longer than [timeout]
+        bool run_until_ready(rendering::asset_streamer& streamer, std::span<const rendering::multi_fence_view> fences, std::chrono::seconds timeout) {
+            auto start = std::chrono::steady_clock::now();
+
+            for (const rendering::multi_fence_view& fence : fences) {
+                while (fence.status() != vk::Result::eSuccess) {
+                    if (std::chrono::steady_clock::now() - start > timeout) {
+                        P_LOG_E("Streams not ready after {}s", timeout.count());
+                        return false;
+                    }
+
+                    frame(streamer);
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        rendering::vulkan_device& device;
+        rendering::batch_buffer cmd_buffer;
+
+        std::vector<vk::Fence> frame_fences;
+        uint32_t frame_index = 0;
+        uint32_t max_frames_in_flight;
+    };
+
+    // copies [size] bytes at [offset] of [buf] back to the host on the graphics queue, the buffer must be owned by the graphics queue family and idle
+    inline std::vector<std::byte> read_back(rendering::vulkan_device& device, vk::Buffer buf, VkDeviceSize offset, VkDeviceSize size) {
+        vk::BufferCreateInfo buffer_info{
+            .size = size,
+            .usage = vk::BufferUsageFlagBits::eTransferDst,
+            .sharingMode = vk::SharingMode::eExclusive,
+        };
+
+        VmaAllocationCreateInfo alloc_cinfo{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+        };
+
+        VkBuffer readback_buf;
+        VmaAllocation readback_alloc;
+        VmaAllocationInfo alloc_info;
+
+        VkResult res = vmaCreateBuffer(device.get_allocator(), &static_cast<VkBufferCreateInfo&>(buffer_info), &alloc_cinfo, &readback_buf, &readback_alloc, &alloc_info);
+        vk::resultCheck(static_cast<vk::Result>(res), "vmaCreateBuffer");
+
+        vk::CommandPool pool = device.get_device().createCommandPool(vk::CommandPoolCreateInfo{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = device.get_queue_family(false),
+        });
+
+        vk::CommandBufferAllocateInfo cmd_info{
+            .commandPool = pool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        };
+
+        vk::CommandBuffer cmd = device.get_device().allocateCommandBuffers(cmd_info)[0];
+        cmd.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+        cmd.copyBuffer(buf, readback_buf, vk::BufferCopy{ .srcOffset = offset, .dstOffset = 0, .size = size });
+
+        vk::MemoryBarrier2 host_barrier{
+            .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+            .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+        };
+
+        cmd.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &host_barrier });
+        cmd.end();
+
+        vk::Fence fence = device.get_device().createFence({});
+
+        vk::SubmitInfo submit_info{
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmd,
+        };
+
+        device.submit(std::span(&submit_info, 1), fence);
+
+        vk::Result wait_res = device.get_device().waitForFences(fence, vk::True, std::numeric_limits<uint64_t>::max());
+        vk::resultCheck(wait_res, "waitForFences");
+
+        vmaInvalidateAllocation(device.get_allocator(), readback_alloc, 0, VK_WHOLE_SIZE);
+
+        std::vector<std::byte> data(size);
+        std::memcpy(data.data(), alloc_info.pMappedData, size);
+
+        device.get_device().destroyFence(fence);
+        device.get_device().destroyCommandPool(pool);
+        vmaDestroyBuffer(device.get_allocator(), readback_buf, readback_alloc);
+
+        return data;
+    }
+}